@@ -0,0 +1,114 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#define ARENA_MIN_CHUNK_SIZE (16 * 1024)
+#define ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+
+struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;
+    max_align_t data[];
+};
+
+// Uses the next chunk if it is big enough (after arena_reset()), otherwise
+// inserts a new one after the current chunk. Chunks grow up to
+// ARENA_MAX_CHUNK_SIZE, bigger allocations get a chunk of their own.
+static struct ArenaChunk *arena_next_chunk(struct Arena *arena, size_t size) {
+    struct ArenaChunk *current = arena->current;
+    struct ArenaChunk *next = current != NULL ? current->next : arena->first;
+
+    if (next != NULL && next->size >= size) {
+        return next;
+    }
+
+    size_t chunk_size = ARENA_MIN_CHUNK_SIZE;
+    if (current != NULL) {
+        chunk_size = current->size < ARENA_MAX_CHUNK_SIZE / 2 ?
+            current->size * 2 : ARENA_MAX_CHUNK_SIZE;
+    }
+    if (chunk_size < size) {
+        chunk_size = size;
+    }
+
+    if (chunk_size > SIZE_MAX - sizeof(struct ArenaChunk)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    struct ArenaChunk *chunk = malloc(sizeof(struct ArenaChunk) + chunk_size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->size = chunk_size;
+    chunk->next = next;
+
+    if (current != NULL) {
+        current->next = chunk;
+    } else {
+        arena->first = chunk;
+    }
+
+    return chunk;
+}
+
+void *arena_alloc(struct Arena *arena, size_t size, size_t align) {
+    assert(align > 0 && (align & (align - 1)) == 0 && align <= _Alignof(max_align_t));
+
+    struct ArenaChunk *chunk = arena->current;
+    if (chunk != NULL) {
+        const size_t offset = (arena->used + align - 1) & ~(align - 1);
+        if (offset <= chunk->size && chunk->size - offset >= size) {
+            arena->used = offset + size;
+            return (char*)chunk->data + offset;
+        }
+    }
+
+    chunk = arena_next_chunk(arena, size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    arena->current = chunk;
+    arena->used = size;
+
+    return chunk->data;
+}
+
+char *arena_strndup(struct Arena *arena, const char *str, size_t len) {
+    if (len == SIZE_MAX) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    char *copy = arena_alloc(arena, len + 1, 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    memcpy(copy, str, len);
+    copy[len] = 0;
+
+    return copy;
+}
+
+void arena_reset(struct Arena *arena) {
+    arena->current = NULL;
+    arena->used = 0;
+}
+
+void arena_free(struct Arena *arena) {
+    struct ArenaChunk *chunk = arena->first;
+    while (chunk != NULL) {
+        struct ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    *arena = (struct Arena)ARENA_INIT();
+}
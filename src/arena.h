@@ -0,0 +1,39 @@
+#ifndef MINMATH_ARENA_H__
+#define MINMATH_ARENA_H__
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ArenaChunk;
+
+// Bump allocator. Single allocations can't be freed, everything is released
+// at once by arena_reset() (keeps the memory for reuse) or arena_free().
+struct Arena {
+    struct ArenaChunk *first;
+    struct ArenaChunk *current;
+    size_t used; // bytes used in the current chunk
+};
+
+#define ARENA_INIT() {  \
+    .first   = NULL,    \
+    .current = NULL,    \
+    .used    = 0,       \
+}
+
+/// align has to be a power of two no bigger than alignof(max_align_t)
+void *arena_alloc(struct Arena *arena, size_t size, size_t align);
+/// copies len chars and adds a terminating zero
+char *arena_strndup(struct Arena *arena, const char *str, size_t len);
+/// releases all allocations in O(1), the chunks are reused
+void arena_reset(struct Arena *arena);
+void arena_free(struct Arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,7 +7,10 @@
 #include <stdint.h>
 #include <errno.h>
 
-#define AST_MALLOC() malloc(sizeof(struct AstNode))
+// nodes come from the arena or from malloc() if there is none
+#define AST_ALLOC(ARENA) ((ARENA) != NULL ? \
+    arena_alloc((ARENA), sizeof(struct AstNode), _Alignof(struct AstNode)) : \
+    malloc(sizeof(struct AstNode)))
 
 bool ast_is_binary(const struct AstNode *expr) {
     switch (expr->type) {
@@ -48,8 +51,8 @@ bool ast_is_unary(const struct AstNode *expr) {
     }
 }
 
-struct AstNode *ast_create_terneary(struct AstNode *cond, struct AstNode *then_expr, struct AstNode *else_expr) {
-    struct AstNode *node = AST_MALLOC();
+struct AstNode *ast_create_terneary_in(struct Arena *arena, struct AstNode *cond, struct AstNode *then_expr, struct AstNode *else_expr) {
+    struct AstNode *node = AST_ALLOC(arena);
     if (node == NULL) {
         return NULL;
     }
@@ -68,7 +71,7 @@ struct AstNode *ast_create_terneary(struct AstNode *cond, struct AstNode *then_e
     return node;
 }
 
-struct AstNode *ast_create_binary(enum NodeType type, struct AstNode *lhs, struct AstNode *rhs) {
+struct AstNode *ast_create_binary_in(struct Arena *arena, enum NodeType type, struct AstNode *lhs, struct AstNode *rhs) {
     assert(
         type == NODE_ADD ||
         type == NODE_SUB ||
@@ -90,7 +93,7 @@ struct AstNode *ast_create_binary(enum NodeType type, struct AstNode *lhs, struc
         type == NODE_RSHIFT
     );
 
-    struct AstNode *node = AST_MALLOC();
+    struct AstNode *node = AST_ALLOC(arena);
     if (node == NULL) {
         return NULL;
     }
@@ -108,10 +111,10 @@ struct AstNode *ast_create_binary(enum NodeType type, struct AstNode *lhs, struc
     return node;
 }
 
-struct AstNode *ast_create_unary(enum NodeType type, struct AstNode *child) {
+struct AstNode *ast_create_unary_in(struct Arena *arena, enum NodeType type, struct AstNode *child) {
     assert(type == NODE_NEG || type == NODE_BIT_NEG || type == NODE_NOT);
 
-    struct AstNode *node = AST_MALLOC();
+    struct AstNode *node = AST_ALLOC(arena);
     if (node == NULL) {
         return NULL;
     }
@@ -126,8 +129,8 @@ struct AstNode *ast_create_unary(enum NodeType type, struct AstNode *child) {
     return node;
 }
 
-struct AstNode *ast_create_int(int value) {
-    struct AstNode *node = AST_MALLOC();
+struct AstNode *ast_create_int_in(struct Arena *arena, int value) {
+    struct AstNode *node = AST_ALLOC(arena);
     if (node == NULL) {
         return NULL;
     }
@@ -142,8 +145,8 @@ struct AstNode *ast_create_int(int value) {
     return node;
 }
 
-struct AstNode *ast_create_var(char *name) {
-    struct AstNode *node = AST_MALLOC();
+struct AstNode *ast_create_var_in(struct Arena *arena, const struct Symbol *symbol) {
+    struct AstNode *node = AST_ALLOC(arena);
     if (node == NULL) {
         return NULL;
     }
@@ -151,13 +154,40 @@ struct AstNode *ast_create_var(char *name) {
     *node = (struct AstNode){
         .type = NODE_VAR,
         .data = {
-            .ident = name
+            .symbol = symbol,
+            .slot = AST_UNBOUND,
         }
     };
 
     return node;
 }
 
+struct AstNode *ast_create_terneary(struct AstNode *cond, struct AstNode *then_expr, struct AstNode *else_expr) {
+    return ast_create_terneary_in(NULL, cond, then_expr, else_expr);
+}
+
+struct AstNode *ast_create_binary(enum NodeType type, struct AstNode *lhs, struct AstNode *rhs) {
+    return ast_create_binary_in(NULL, type, lhs, rhs);
+}
+
+struct AstNode *ast_create_unary(enum NodeType type, struct AstNode *child) {
+    return ast_create_unary_in(NULL, type, child);
+}
+
+struct AstNode *ast_create_int(int value) {
+    return ast_create_int_in(NULL, value);
+}
+
+struct AstNode *ast_create_var(const struct Symbol *symbol) {
+    return ast_create_var_in(NULL, symbol);
+}
+
+void ast_free_in(struct Arena *arena, struct AstNode *node) {
+    if (arena == NULL) {
+        ast_free(node);
+    }
+}
+
 void ast_free(struct AstNode *node) {
     if (node != NULL) {
         switch (node->type) {
@@ -196,9 +226,6 @@ void ast_free(struct AstNode *node) {
                 break;
 
             case NODE_VAR:
-                free(node->data.ident);
-                break;
-
             case NODE_INT:
                 break;
         }
@@ -322,7 +349,7 @@ void ast_print(FILE *stream, const struct AstNode *expr) {
     } else if (expr->type == NODE_INT) {
         fprintf(stream, "%d", expr->data.value);
     } else if (expr->type == NODE_VAR) {
-        fprintf(stream, "%s", expr->data.ident);
+        fprintf(stream, "%s", expr->data.symbol->name);
     } else {
         assert(false);
     }
@@ -338,7 +365,7 @@ void params_sort(struct Param params[], size_t param_count) {
     qsort(params, param_count, sizeof(struct Param), param_cmp);
 }
 
-int params_get(const struct Param params[], size_t param_count, const char *name) {
+const struct Param *params_find(const struct Param params[], size_t param_count, const char *name) {
     size_t left  = 0;
     size_t right = param_count;
 
@@ -348,18 +375,28 @@ int params_get(const struct Param params[], size_t param_count, const char *name
         int cmp = strcmp(name, params[mid].name);
 
         if (cmp == 0) {
-            return params[mid].value;
+            return &params[mid];
         }
 
         if (cmp < 0) {
             right = mid;
         } else {
-            left = mid;
+            left = mid + 1;
         }
     }
 
-    fprintf(stderr, "*** parameter not found: %s\n", name);
-    return 0;
+    return NULL;
+}
+
+int params_get(const struct Param params[], size_t param_count, const char *name) {
+    const struct Param *param = params_find(params, param_count, name);
+
+    if (param == NULL) {
+        fprintf(stderr, "*** parameter not found: %s\n", name);
+        return 0;
+    }
+
+    return param->value;
 }
 
 // ========================================================================== //
@@ -501,7 +538,7 @@ int ast_execute_with_environ(struct AstNode *expr) {
 
         case NODE_VAR:
         {
-            const char *val = getenv(expr->data.ident);
+            const char *val = getenv(expr->data.symbol->name);
             if (val == NULL) {
                 return 0;
             }
@@ -645,7 +682,590 @@ int ast_execute_with_params(struct AstNode *expr, const struct Param params[], s
             return expr->data.value;
 
         case NODE_VAR:
-            return params_get(params, param_count, expr->data.ident);
+            return params_get(params, param_count, expr->data.symbol->name);
+
+        default:
+            assert(false);
+            return 0;
+    }
+}
+
+// ========================================================================== //
+//                                                                            //
+//                          Bound Tree Interpreter                            //
+//                                                                            //
+// ========================================================================== //
+
+// Fibonacci hashing of the name hash: the top log2(capacity) bits of the
+// product depend on all of its bits
+static inline size_t ast_binding_home(const struct AstBinding *binding, uint32_t hash) {
+    return (uint32_t)(hash * UINT32_C(2654435769)) >> (32 - __builtin_ctzll(binding->entries_capacity));
+}
+
+// the entry of symbol, or the free entry where it belongs
+static inline struct AstBindingEntry *ast_binding_find(const struct AstBinding *binding, const struct Symbol *symbol) {
+    const size_t mask = binding->entries_capacity - 1;
+    size_t index = ast_binding_home(binding, symbol->hash);
+
+    for (;;) {
+        struct AstBindingEntry *entry = &binding->entries[index];
+        if (entry->symbol == symbol || entry->symbol == NULL) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static bool ast_binding_grow(struct AstBinding *binding) {
+    size_t new_capacity;
+    if (binding->entries_capacity == 0) {
+        new_capacity = 8;
+    } else if (binding->entries_capacity > UINT32_MAX / 2) {
+        errno = ENOMEM;
+        return false;
+    } else {
+        new_capacity = binding->entries_capacity * 2;
+    }
+
+    struct AstBindingEntry *old_entries = binding->entries;
+    const size_t old_capacity = binding->entries_capacity;
+
+    struct AstBindingEntry *entries = calloc(new_capacity, sizeof(struct AstBindingEntry));
+    if (entries == NULL) {
+        return false;
+    }
+    binding->entries = entries;
+    binding->entries_capacity = new_capacity;
+
+    for (size_t index = 0; index < old_capacity; ++ index) {
+        if (old_entries[index].symbol != NULL) {
+            *ast_binding_find(binding, old_entries[index].symbol) = old_entries[index];
+        }
+    }
+    free(old_entries);
+
+    return true;
+}
+
+// Adds symbol with the given slot if it isn't in the binding yet. Returns
+// NULL on error.
+static struct AstBindingEntry *ast_binding_add(struct AstBinding *binding, const struct Symbol *symbol, uint32_t slot) {
+    if (binding->entries_capacity != 0) {
+        struct AstBindingEntry *entry = ast_binding_find(binding, symbol);
+        if (entry->symbol != NULL) {
+            return entry;
+        }
+    }
+
+    if ((binding->entries_size + 1) * 2 > binding->entries_capacity && !ast_binding_grow(binding)) {
+        return NULL;
+    }
+
+    struct AstBindingEntry *entry = ast_binding_find(binding, symbol);
+    *entry = (struct AstBindingEntry){ .symbol = symbol, .slot = slot };
+    ++ binding->entries_size;
+
+    return entry;
+}
+
+static void ast_binding_clear(struct AstBinding *binding) {
+    if (binding->entries_size > 0) {
+        memset(binding->entries, 0, binding->entries_capacity * sizeof(struct AstBindingEntry));
+        binding->entries_size = 0;
+    }
+}
+
+// adds every variable of expr as unbound
+static bool ast_binding_collect(struct AstBinding *binding, const struct AstNode *expr) {
+    switch (expr->type) {
+        case NODE_INT:
+            return true;
+
+        case NODE_VAR:
+            return ast_binding_add(binding, expr->data.symbol, AST_UNBOUND) != NULL;
+
+        case NODE_NEG:
+        case NODE_BIT_NEG:
+        case NODE_NOT:
+            return ast_binding_collect(binding, expr->data.child);
+
+        case NODE_IF:
+            return (
+                ast_binding_collect(binding, expr->data.terneary.cond) &&
+                ast_binding_collect(binding, expr->data.terneary.then_expr) &&
+                ast_binding_collect(binding, expr->data.terneary.else_expr)
+            );
+
+        default:
+            return (
+                ast_binding_collect(binding, expr->data.binary.lhs) &&
+                ast_binding_collect(binding, expr->data.binary.rhs)
+            );
+    }
+}
+
+// entry of the variable called name, NULL if there is none
+static struct AstBindingEntry *ast_binding_find_name(const struct AstBinding *binding, const char *name) {
+    if (binding->entries_capacity == 0) {
+        return NULL;
+    }
+
+    const size_t length = strlen(name);
+    const uint32_t hash = symbol_hash(name, length);
+    const size_t mask = binding->entries_capacity - 1;
+    size_t index = ast_binding_home(binding, hash);
+
+    for (;;) {
+        struct AstBindingEntry *entry = &binding->entries[index];
+        if (entry->symbol == NULL) {
+            return NULL;
+        }
+        if (entry->symbol->hash == hash && entry->symbol->length == length &&
+            memcmp(entry->symbol->name, name, length) == 0) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+// Writes the slots of binding into the variables of expr. Returns the first
+// variable without a slot, NULL if all are bound.
+static const struct Symbol *ast_bind_slots(const struct AstBinding *binding, struct AstNode *expr) {
+    switch (expr->type) {
+        case NODE_INT:
+            return NULL;
+
+        case NODE_VAR:
+            expr->data.slot = ast_binding_find(binding, expr->data.symbol)->slot;
+            return expr->data.slot == AST_UNBOUND ? expr->data.symbol : NULL;
+
+        case NODE_NEG:
+        case NODE_BIT_NEG:
+        case NODE_NOT:
+            return ast_bind_slots(binding, expr->data.child);
+
+        case NODE_IF:
+        {
+            const struct Symbol *symbol = ast_bind_slots(binding, expr->data.terneary.cond);
+            const struct Symbol *then_symbol = ast_bind_slots(binding, expr->data.terneary.then_expr);
+            const struct Symbol *else_symbol = ast_bind_slots(binding, expr->data.terneary.else_expr);
+            if (symbol == NULL) {
+                symbol = then_symbol;
+            }
+            if (symbol == NULL) {
+                symbol = else_symbol;
+            }
+            return symbol;
+        }
+        default:
+        {
+            const struct Symbol *symbol = ast_bind_slots(binding, expr->data.binary.lhs);
+            const struct Symbol *rhs_symbol = ast_bind_slots(binding, expr->data.binary.rhs);
+            return symbol != NULL ? symbol : rhs_symbol;
+        }
+    }
+}
+
+bool ast_bind(struct AstBinding *binding, struct AstNode *expr, const char *const names[], size_t name_count, const struct Symbol **missing) {
+    assert(expr != NULL);
+
+    if (missing != NULL) {
+        *missing = NULL;
+    }
+
+    if (name_count >= AST_UNBOUND) {
+        errno = ERANGE;
+        return false;
+    }
+
+    ast_binding_clear(binding);
+    if (!ast_binding_collect(binding, expr)) {
+        return false;
+    }
+
+    // backwards, so the first of duplicate names wins, names of no variable
+    // of expr are skipped
+    for (size_t index = name_count; index > 0; -- index) {
+        struct AstBindingEntry *entry = ast_binding_find_name(binding, names[index - 1]);
+        if (entry != NULL) {
+            entry->slot = (uint32_t)(index - 1);
+        }
+    }
+
+    const struct Symbol *unbound = binding->entries_size == 0 ? NULL : ast_bind_slots(binding, expr);
+    if (unbound != NULL) {
+        if (missing != NULL) {
+            *missing = unbound;
+        }
+        errno = ENOENT;
+        return false;
+    }
+
+    return true;
+}
+
+void ast_binding_free(struct AstBinding *binding) {
+    free(binding->entries);
+
+    *binding = (struct AstBinding)AST_BINDING_INIT();
+}
+
+static bool ast_environ_add(struct AstEnviron *env, const struct Symbol *symbol) {
+    if (env->values_size == env->values_capacity) {
+        const size_t new_capacity = env->values_capacity == 0 ? 8 : env->values_capacity * 2;
+
+        int *values = realloc(env->values, new_capacity * sizeof(int));
+        if (values == NULL) {
+            return false;
+        }
+        env->values = values;
+        env->values_capacity = new_capacity;
+    }
+
+    if (ast_binding_add(&env->binding, symbol, (uint32_t)env->values_size) == NULL) {
+        return false;
+    }
+
+    const char *val = getenv(symbol->name);
+    env->values[env->values_size] = val == NULL ? 0 : atoi(val);
+    ++ env->values_size;
+
+    return true;
+}
+
+// gives every variable of expr that has no slot yet the next one and reads
+// its value
+static bool ast_environ_collect(struct AstEnviron *env, const struct AstNode *expr) {
+    switch (expr->type) {
+        case NODE_INT:
+            return true;
+
+        case NODE_VAR:
+            return (
+                (env->binding.entries_capacity != 0 &&
+                 ast_binding_find(&env->binding, expr->data.symbol)->symbol != NULL) ||
+                ast_environ_add(env, expr->data.symbol)
+            );
+
+        case NODE_NEG:
+        case NODE_BIT_NEG:
+        case NODE_NOT:
+            return ast_environ_collect(env, expr->data.child);
+
+        case NODE_IF:
+            return (
+                ast_environ_collect(env, expr->data.terneary.cond) &&
+                ast_environ_collect(env, expr->data.terneary.then_expr) &&
+                ast_environ_collect(env, expr->data.terneary.else_expr)
+            );
+
+        default:
+            return (
+                ast_environ_collect(env, expr->data.binary.lhs) &&
+                ast_environ_collect(env, expr->data.binary.rhs)
+            );
+    }
+}
+
+bool ast_environ_snapshot(struct AstEnviron *env, struct AstNode *expr) {
+    assert(expr != NULL);
+
+    ast_binding_clear(&env->binding);
+    env->values_size = 0;
+
+    if (!ast_environ_collect(env, expr)) {
+        return false;
+    }
+
+    ast_bind_slots(&env->binding, expr);
+
+    return true;
+}
+
+void ast_environ_free(struct AstEnviron *env) {
+    ast_binding_free(&env->binding);
+    free(env->values);
+
+    *env = (struct AstEnviron)AST_ENVIRON_INIT();
+}
+
+int ast_execute_with_slots(const struct AstNode *expr, const int values[]) {
+    assert(expr != NULL);
+
+    switch (expr->type) {
+        case NODE_ADD:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) +
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_SUB:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) -
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_MUL:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) *
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_DIV:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) /
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_MOD:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) %
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_AND:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) &&
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_OR:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) ||
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_LT:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) <
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_GT:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) >
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_LE:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) <=
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_GE:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) >=
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_EQ:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) ==
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_NE:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) !=
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_BIT_AND:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) &
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_BIT_OR:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) |
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_BIT_XOR:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) ^
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_LSHIFT:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) <<
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_RSHIFT:
+            return (
+                ast_execute_with_slots(expr->data.binary.lhs, values) >>
+                ast_execute_with_slots(expr->data.binary.rhs, values)
+            );
+
+        case NODE_NEG:
+            return -ast_execute_with_slots(expr->data.child, values);
+
+        case NODE_BIT_NEG:
+            return ~ast_execute_with_slots(expr->data.child, values);
+
+        case NODE_NOT:
+            return !ast_execute_with_slots(expr->data.child, values);
+
+        case NODE_IF:
+            return (
+                ast_execute_with_slots(expr->data.terneary.cond, values) ?
+                ast_execute_with_slots(expr->data.terneary.then_expr, values) :
+                ast_execute_with_slots(expr->data.terneary.else_expr, values)
+            );
+
+        case NODE_INT:
+            return expr->data.value;
+
+        case NODE_VAR:
+            assert(expr->data.slot != AST_UNBOUND);
+            return values[expr->data.slot];
+
+        default:
+            assert(false);
+            return 0;
+    }
+}
+
+int ast_execute_with_snapshot(const struct AstNode *expr, const struct AstEnviron *env) {
+    assert(expr != NULL);
+
+    switch (expr->type) {
+        case NODE_ADD:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) +
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_SUB:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) -
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_MUL:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) *
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_DIV:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) /
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_MOD:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) %
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_AND:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) &&
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_OR:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) ||
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_LT:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) <
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_GT:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) >
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_LE:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) <=
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_GE:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) >=
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_EQ:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) ==
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_NE:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) !=
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_BIT_AND:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) &
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_BIT_OR:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) |
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_BIT_XOR:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) ^
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_LSHIFT:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) <<
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_RSHIFT:
+            return (
+                ast_execute_with_snapshot(expr->data.binary.lhs, env) >>
+                ast_execute_with_snapshot(expr->data.binary.rhs, env)
+            );
+
+        case NODE_NEG:
+            return -ast_execute_with_snapshot(expr->data.child, env);
+
+        case NODE_BIT_NEG:
+            return ~ast_execute_with_snapshot(expr->data.child, env);
+
+        case NODE_NOT:
+            return !ast_execute_with_snapshot(expr->data.child, env);
+
+        case NODE_IF:
+            return (
+                ast_execute_with_snapshot(expr->data.terneary.cond, env) ?
+                ast_execute_with_snapshot(expr->data.terneary.then_expr, env) :
+                ast_execute_with_snapshot(expr->data.terneary.else_expr, env)
+            );
+
+        case NODE_INT:
+            return expr->data.value;
+
+        case NODE_VAR:
+        {
+            assert(expr->data.slot < env->values_size);
+            return env->values[expr->data.slot];
+        }
 
         default:
             assert(false);
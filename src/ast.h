@@ -3,8 +3,13 @@
 #pragma once
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
+#include "arena.h"
+#include "symbol.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -40,7 +45,10 @@ struct AstNode {
     enum NodeType type;
     union {
         int value;
-        char *ident;
+        struct {
+            const struct Symbol *symbol; // interned, not owned by the node
+            uint32_t slot; // set by ast_bind() or ast_environ_snapshot()
+        };
         struct AstNode *child;
         struct {
             struct AstNode *lhs;
@@ -59,11 +67,66 @@ struct Param {
     int value;
 };
 
+struct AstBindingEntry {
+    const struct Symbol *symbol; // NULL for a free entry
+    uint32_t slot;
+};
+
+// The variables of a tree while ast_bind() resolves them to indices of an int
+// array. The index is written into the slot of every variable node, so
+// ast_execute_with_slots() doesn't look anything up. Open addressing with
+// linear probing over the variables of the bound tree, so the size only
+// depends on the tree. The capacity is a power of two and the table is at most
+// half full. Can be reused for binding other trees.
+struct AstBinding {
+    struct AstBindingEntry *entries;
+    size_t entries_size; // number of variables
+    size_t entries_capacity;
+};
+
+#define AST_UNBOUND UINT32_MAX
+
+#define AST_BINDING_INIT() { \
+    .entries = NULL,         \
+    .entries_size = 0,       \
+    .entries_capacity = 0,   \
+}
+
+// The environment variables named like the variables of a tree. Take the
+// snapshot once with ast_environ_snapshot() and evaluate the tree, or an
+// optimized copy, many times with ast_execute_with_snapshot(). Every variable
+// is read and parsed when the snapshot is taken, evaluation only indexes values
+// by the slot of the variable node.
+struct AstEnviron {
+    struct AstBinding binding;
+    int *values; // by slot, 0 for unset variables like ast_execute_with_environ()
+    size_t values_size; // number of variables
+    size_t values_capacity;
+};
+
+#define AST_ENVIRON_INIT() {       \
+    .binding = AST_BINDING_INIT(), \
+    .values = NULL,                \
+    .values_size = 0,              \
+    .values_capacity = 0,          \
+}
+
 struct AstNode *ast_create_terneary(struct AstNode *cond, struct AstNode *then_expr, struct AstNode *else_expr);
 struct AstNode *ast_create_binary(enum NodeType type, struct AstNode *lhs, struct AstNode *rhs);
 struct AstNode *ast_create_unary(enum NodeType type, struct AstNode *child);
 struct AstNode *ast_create_int(int value);
-struct AstNode *ast_create_var(char *name);
+struct AstNode *ast_create_var(const struct Symbol *symbol);
+
+// The *_in functions allocate from the arena, or with malloc() if arena is
+// NULL. Trees of an arena are released with the arena, ast_free_in() only
+// frees if there is no arena.
+struct AstNode *ast_create_terneary_in(struct Arena *arena, struct AstNode *cond, struct AstNode *then_expr, struct AstNode *else_expr);
+struct AstNode *ast_create_binary_in(struct Arena *arena, enum NodeType type, struct AstNode *lhs, struct AstNode *rhs);
+struct AstNode *ast_create_unary_in(struct Arena *arena, enum NodeType type, struct AstNode *child);
+struct AstNode *ast_create_int_in(struct Arena *arena, int value);
+struct AstNode *ast_create_var_in(struct Arena *arena, const struct Symbol *symbol);
+void ast_free_in(struct Arena *arena, struct AstNode *node);
+
 bool ast_is_binary(const struct AstNode *expr);
 bool ast_is_unary(const struct AstNode *expr);
 void ast_print(FILE *stream, const struct AstNode *expr);
@@ -73,8 +136,27 @@ int ast_execute_with_environ(struct AstNode *expr);
 /// params need to be sorted
 int ast_execute_with_params(struct AstNode *expr, const struct Param params[], size_t param_count);
 
+/// Sets the slot of every variable of expr to the index of its name in names,
+/// replacing the slots of an earlier ast_bind() or ast_environ_snapshot().
+/// Fails with ENOENT if a variable has no name, *missing is set to it if not
+/// NULL.
+bool ast_bind(struct AstBinding *binding, struct AstNode *expr, const char *const names[], size_t name_count, const struct Symbol **missing);
+/// values[index] is the value of names[index] of ast_bind(). expr has to be
+/// bound, optimized copies of a bound tree keep its slots.
+int ast_execute_with_slots(const struct AstNode *expr, const int values[]);
+void ast_binding_free(struct AstBinding *binding);
+/// Gives every variable of expr a slot, replacing the slots of an earlier
+/// ast_bind() or ast_environ_snapshot(), and reads their current values.
+bool ast_environ_snapshot(struct AstEnviron *env, struct AstNode *expr);
+/// expr has to be the tree of the snapshot or an optimized copy of it. Later
+/// changes of the environment aren't seen until the snapshot is taken again.
+int ast_execute_with_snapshot(const struct AstNode *expr, const struct AstEnviron *env);
+void ast_environ_free(struct AstEnviron *env);
+
 void params_sort(struct Param params[], size_t param_count);
 int params_get(const struct Param params[], size_t param_count, const char *name);
+/// returns NULL if there is no parameter of that name, params need to be sorted
+const struct Param *params_find(const struct Param params[], size_t param_count, const char *name);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,361 @@
+#include <errno.h>
+#include <limits.h>
+
+#include "batch_kernels.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(MINMATH_NO_SIMD)
+#   define MINMATH_BATCH_X86
+#   include <immintrin.h>
+#endif
+
+// ==== scalar kernels ====
+
+#define SCALAR_BINARY(NAME, OP) \
+    static void scalar_##NAME(int *restrict lhs, const int *restrict rhs, size_t count) { \
+        for (size_t index = 0; index < count; ++ index) { \
+            lhs[index] = lhs[index] OP rhs[index]; \
+        } \
+    }
+
+#define SCALAR_UNARY(NAME, OP) \
+    static void scalar_##NAME(int *values, size_t count) { \
+        for (size_t index = 0; index < count; ++ index) { \
+            values[index] = OP values[index]; \
+        } \
+    }
+
+SCALAR_BINARY(add,     +)
+SCALAR_BINARY(sub,     -)
+SCALAR_BINARY(mul,     *)
+SCALAR_BINARY(div,     /)
+SCALAR_BINARY(mod,     %)
+SCALAR_BINARY(bit_and, &)
+SCALAR_BINARY(bit_xor, ^)
+SCALAR_BINARY(bit_or,  |)
+SCALAR_BINARY(lt,      <)
+SCALAR_BINARY(le,      <=)
+SCALAR_BINARY(gt,      >)
+SCALAR_BINARY(ge,      >=)
+SCALAR_BINARY(eq,      ==)
+SCALAR_BINARY(ne,      !=)
+SCALAR_BINARY(lshift,  <<)
+SCALAR_BINARY(rshift,  >>)
+SCALAR_UNARY(neg,      -)
+SCALAR_UNARY(bit_neg,  ~)
+SCALAR_UNARY(not,      !)
+SCALAR_UNARY(bool,     !!)
+
+static size_t scalar_count_zeros(const int *values, size_t count) {
+    size_t zeros = 0;
+    for (size_t index = 0; index < count; ++ index) {
+        zeros += values[index] == 0;
+    }
+    return zeros;
+}
+
+#define KERNELS_TABLE(TYPE, NAME, PREFIX) { \
+    .type = (TYPE), \
+    .name = (NAME), \
+    .binary = { \
+        [INSTR_ADD]     = PREFIX##_add,     \
+        [INSTR_SUB]     = PREFIX##_sub,     \
+        [INSTR_MUL]     = PREFIX##_mul,     \
+        [INSTR_DIV]     = PREFIX##_div,     \
+        [INSTR_MOD]     = PREFIX##_mod,     \
+        [INSTR_BIT_AND] = PREFIX##_bit_and, \
+        [INSTR_BIT_XOR] = PREFIX##_bit_xor, \
+        [INSTR_BIT_OR]  = PREFIX##_bit_or,  \
+        [INSTR_LT]      = PREFIX##_lt,      \
+        [INSTR_LE]      = PREFIX##_le,      \
+        [INSTR_GT]      = PREFIX##_gt,      \
+        [INSTR_GE]      = PREFIX##_ge,      \
+        [INSTR_EQ]      = PREFIX##_eq,      \
+        [INSTR_NE]      = PREFIX##_ne,      \
+        [INSTR_LSHIFT]  = PREFIX##_lshift,  \
+        [INSTR_RSHIFT]  = PREFIX##_rshift,  \
+    }, \
+    .unary = { \
+        [INSTR_NEG]     = PREFIX##_neg,     \
+        [INSTR_BIT_NEG] = PREFIX##_bit_neg, \
+        [INSTR_NOT]     = PREFIX##_not,     \
+        [INSTR_BOOL]    = PREFIX##_bool,    \
+    }, \
+    .count_zeros = PREFIX##_count_zeros, \
+}
+
+static const struct BatchKernels SCALAR_KERNELS = KERNELS_TABLE(BATCH_KERNELS_SCALAR, "scalar", scalar);
+
+#ifdef MINMATH_BATCH_X86
+
+// The SIMD kernels process as many full vectors as possible and hand the rest
+// to the scalar kernel. Shift counts are masked with 31, which is what the
+// scalar shift instructions of x86 do. Division is done in double precision,
+// which is exact for 32-bit integers. Vectors with a zero divisor or with
+// INT_MIN / -1 are handed to the scalar kernel so that these overflow the same
+// way as in bytecode_execute().
+
+// ==== SSE4.1 kernels ====
+
+#define SSE41_BINARY(NAME, EXPR) \
+    __attribute__((target("sse4.1"))) \
+    static void sse41_##NAME(int *restrict lhs, const int *restrict rhs, size_t count) { \
+        const __m128i one = _mm_set1_epi32(1); (void)one; \
+        size_t index = 0; \
+        for (; index + 4 <= count; index += 4) { \
+            const __m128i a = _mm_loadu_si128((const __m128i*)(lhs + index)); \
+            const __m128i b = _mm_loadu_si128((const __m128i*)(rhs + index)); \
+            _mm_storeu_si128((__m128i*)(lhs + index), (EXPR)); \
+        } \
+        scalar_##NAME(lhs + index, rhs + index, count - index); \
+    }
+
+#define SSE41_UNARY(NAME, EXPR) \
+    __attribute__((target("sse4.1"))) \
+    static void sse41_##NAME(int *values, size_t count) { \
+        const __m128i one  = _mm_set1_epi32(1);  (void)one; \
+        const __m128i zero = _mm_setzero_si128(); (void)zero; \
+        size_t index = 0; \
+        for (; index + 4 <= count; index += 4) { \
+            const __m128i a = _mm_loadu_si128((const __m128i*)(values + index)); \
+            _mm_storeu_si128((__m128i*)(values + index), (EXPR)); \
+        } \
+        scalar_##NAME(values + index, count - index); \
+    }
+
+// a / b, two lanes at a time in double precision
+__attribute__((target("sse4.1")))
+static inline __m128i sse41_quotient(__m128i a, __m128i b) {
+    const __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b)));
+    const __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(
+        _mm_cvtepi32_pd(_mm_shuffle_epi32(a, 0xEE)),
+        _mm_cvtepi32_pd(_mm_shuffle_epi32(b, 0xEE))));
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+#define SSE41_DIVISION(NAME, EXPR) \
+    __attribute__((target("sse4.1"))) \
+    static void sse41_##NAME(int *restrict lhs, const int *restrict rhs, size_t count) { \
+        const __m128i zero    = _mm_setzero_si128(); \
+        const __m128i minus   = _mm_set1_epi32(-1); \
+        const __m128i int_min = _mm_set1_epi32(INT_MIN); \
+        size_t index = 0; \
+        for (; index + 4 <= count; index += 4) { \
+            const __m128i a = _mm_loadu_si128((const __m128i*)(lhs + index)); \
+            const __m128i b = _mm_loadu_si128((const __m128i*)(rhs + index)); \
+            const __m128i overflow = _mm_or_si128(_mm_cmpeq_epi32(b, zero), \
+                _mm_and_si128(_mm_cmpeq_epi32(a, int_min), _mm_cmpeq_epi32(b, minus))); \
+            if (!_mm_testz_si128(overflow, overflow)) { \
+                scalar_##NAME(lhs + index, rhs + index, 4); \
+            } else { \
+                const __m128i q = sse41_quotient(a, b); (void)q; \
+                _mm_storeu_si128((__m128i*)(lhs + index), (EXPR)); \
+            } \
+        } \
+        scalar_##NAME(lhs + index, rhs + index, count - index); \
+    }
+
+SSE41_BINARY(add,     _mm_add_epi32(a, b))
+SSE41_BINARY(sub,     _mm_sub_epi32(a, b))
+SSE41_BINARY(mul,     _mm_mullo_epi32(a, b))
+SSE41_DIVISION(div,   q)
+SSE41_DIVISION(mod,   _mm_sub_epi32(a, _mm_mullo_epi32(q, b)))
+SSE41_BINARY(bit_and, _mm_and_si128(a, b))
+SSE41_BINARY(bit_xor, _mm_xor_si128(a, b))
+SSE41_BINARY(bit_or,  _mm_or_si128(a, b))
+SSE41_BINARY(lt,      _mm_and_si128(_mm_cmplt_epi32(a, b), one))
+SSE41_BINARY(le,      _mm_andnot_si128(_mm_cmpgt_epi32(a, b), one))
+SSE41_BINARY(gt,      _mm_and_si128(_mm_cmpgt_epi32(a, b), one))
+SSE41_BINARY(ge,      _mm_andnot_si128(_mm_cmplt_epi32(a, b), one))
+SSE41_BINARY(eq,      _mm_and_si128(_mm_cmpeq_epi32(a, b), one))
+SSE41_BINARY(ne,      _mm_andnot_si128(_mm_cmpeq_epi32(a, b), one))
+SSE41_UNARY(neg,      _mm_sub_epi32(zero, a))
+SSE41_UNARY(bit_neg,  _mm_xor_si128(a, _mm_set1_epi32(-1)))
+SSE41_UNARY(not,      _mm_and_si128(_mm_cmpeq_epi32(a, zero), one))
+SSE41_UNARY(bool,     _mm_andnot_si128(_mm_cmpeq_epi32(a, zero), one))
+
+// SSE4.1 only shifts all lanes by the same count, so every lane is shifted
+// separately and the results are blended together
+#define SSE41_SHIFT(NAME, SHIFT) \
+    __attribute__((target("sse4.1"))) \
+    static inline __m128i sse41_##NAME##v(__m128i a, __m128i b) { \
+        const __m128i n = _mm_and_si128(b, _mm_set1_epi32(31)); \
+        const __m128i r0 = SHIFT(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 0))); \
+        const __m128i r1 = SHIFT(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 1))); \
+        const __m128i r2 = SHIFT(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 2))); \
+        const __m128i r3 = SHIFT(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 3))); \
+        return _mm_blend_epi16(_mm_blend_epi16(r0, r1, 0x0C), _mm_blend_epi16(r2, r3, 0xC0), 0xF0); \
+    }
+
+SSE41_SHIFT(lshift, _mm_sll_epi32)
+SSE41_SHIFT(rshift, _mm_sra_epi32)
+
+SSE41_BINARY(lshift,  sse41_lshiftv(a, b))
+SSE41_BINARY(rshift,  sse41_rshiftv(a, b))
+
+__attribute__((target("sse4.1")))
+static size_t sse41_count_zeros(const int *values, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t zeros = 0;
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(values + index));
+        zeros += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, zero))));
+    }
+    return zeros + scalar_count_zeros(values + index, count - index);
+}
+
+static const struct BatchKernels SSE41_KERNELS = KERNELS_TABLE(BATCH_KERNELS_SSE41, "SSE4.1", sse41);
+
+// ==== AVX2 kernels ====
+
+#define AVX2_BINARY(NAME, EXPR) \
+    __attribute__((target("avx2"))) \
+    static void avx2_##NAME(int *restrict lhs, const int *restrict rhs, size_t count) { \
+        const __m256i one = _mm256_set1_epi32(1); (void)one; \
+        size_t index = 0; \
+        for (; index + 8 <= count; index += 8) { \
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(lhs + index)); \
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(rhs + index)); \
+            _mm256_storeu_si256((__m256i*)(lhs + index), (EXPR)); \
+        } \
+        scalar_##NAME(lhs + index, rhs + index, count - index); \
+    }
+
+#define AVX2_UNARY(NAME, EXPR) \
+    __attribute__((target("avx2"))) \
+    static void avx2_##NAME(int *values, size_t count) { \
+        const __m256i one  = _mm256_set1_epi32(1);     (void)one; \
+        const __m256i zero = _mm256_setzero_si256(); (void)zero; \
+        size_t index = 0; \
+        for (; index + 8 <= count; index += 8) { \
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(values + index)); \
+            _mm256_storeu_si256((__m256i*)(values + index), (EXPR)); \
+        } \
+        scalar_##NAME(values + index, count - index); \
+    }
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_quotient(__m256i a, __m256i b) {
+    const __m128i lo = _mm256_cvttpd_epi32(_mm256_div_pd(
+        _mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+        _mm256_cvtepi32_pd(_mm256_castsi256_si128(b))));
+    const __m128i hi = _mm256_cvttpd_epi32(_mm256_div_pd(
+        _mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+        _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1))));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+#define AVX2_DIVISION(NAME, EXPR) \
+    __attribute__((target("avx2"))) \
+    static void avx2_##NAME(int *restrict lhs, const int *restrict rhs, size_t count) { \
+        const __m256i zero    = _mm256_setzero_si256(); \
+        const __m256i minus   = _mm256_set1_epi32(-1); \
+        const __m256i int_min = _mm256_set1_epi32(INT_MIN); \
+        size_t index = 0; \
+        for (; index + 8 <= count; index += 8) { \
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(lhs + index)); \
+            const __m256i b = _mm256_loadu_si256((const __m256i*)(rhs + index)); \
+            const __m256i overflow = _mm256_or_si256(_mm256_cmpeq_epi32(b, zero), \
+                _mm256_and_si256(_mm256_cmpeq_epi32(a, int_min), _mm256_cmpeq_epi32(b, minus))); \
+            if (!_mm256_testz_si256(overflow, overflow)) { \
+                scalar_##NAME(lhs + index, rhs + index, 8); \
+            } else { \
+                const __m256i q = avx2_quotient(a, b); (void)q; \
+                _mm256_storeu_si256((__m256i*)(lhs + index), (EXPR)); \
+            } \
+        } \
+        scalar_##NAME(lhs + index, rhs + index, count - index); \
+    }
+
+AVX2_BINARY(add,     _mm256_add_epi32(a, b))
+AVX2_BINARY(sub,     _mm256_sub_epi32(a, b))
+AVX2_BINARY(mul,     _mm256_mullo_epi32(a, b))
+AVX2_DIVISION(div,   q)
+AVX2_DIVISION(mod,   _mm256_sub_epi32(a, _mm256_mullo_epi32(q, b)))
+AVX2_BINARY(bit_and, _mm256_and_si256(a, b))
+AVX2_BINARY(bit_xor, _mm256_xor_si256(a, b))
+AVX2_BINARY(bit_or,  _mm256_or_si256(a, b))
+AVX2_BINARY(lt,      _mm256_and_si256(_mm256_cmpgt_epi32(b, a), one))
+AVX2_BINARY(le,      _mm256_andnot_si256(_mm256_cmpgt_epi32(a, b), one))
+AVX2_BINARY(gt,      _mm256_and_si256(_mm256_cmpgt_epi32(a, b), one))
+AVX2_BINARY(ge,      _mm256_andnot_si256(_mm256_cmpgt_epi32(b, a), one))
+AVX2_BINARY(eq,      _mm256_and_si256(_mm256_cmpeq_epi32(a, b), one))
+AVX2_BINARY(ne,      _mm256_andnot_si256(_mm256_cmpeq_epi32(a, b), one))
+AVX2_BINARY(lshift,  _mm256_sllv_epi32(a, _mm256_and_si256(b, _mm256_set1_epi32(31))))
+AVX2_BINARY(rshift,  _mm256_srav_epi32(a, _mm256_and_si256(b, _mm256_set1_epi32(31))))
+AVX2_UNARY(neg,      _mm256_sub_epi32(zero, a))
+AVX2_UNARY(bit_neg,  _mm256_xor_si256(a, _mm256_set1_epi32(-1)))
+AVX2_UNARY(not,      _mm256_and_si256(_mm256_cmpeq_epi32(a, zero), one))
+AVX2_UNARY(bool,     _mm256_andnot_si256(_mm256_cmpeq_epi32(a, zero), one))
+
+__attribute__((target("avx2")))
+static size_t avx2_count_zeros(const int *values, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t zeros = 0;
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(values + index));
+        zeros += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, zero))));
+    }
+    return zeros + scalar_count_zeros(values + index, count - index);
+}
+
+static const struct BatchKernels AVX2_KERNELS = KERNELS_TABLE(BATCH_KERNELS_AVX2, "AVX2", avx2);
+
+#endif
+
+static const struct BatchKernels *batch_kernels = NULL;
+
+const struct BatchKernels *batch_kernels_get_type(enum BatchKernelsType type) {
+    switch (type) {
+        case BATCH_KERNELS_SCALAR:
+            return &SCALAR_KERNELS;
+
+#ifdef MINMATH_BATCH_X86
+        case BATCH_KERNELS_SSE41:
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse4.1")) {
+                return &SSE41_KERNELS;
+            }
+            break;
+
+        case BATCH_KERNELS_AVX2:
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return &AVX2_KERNELS;
+            }
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    errno = ENOTSUP;
+    return NULL;
+}
+
+const struct BatchKernels *batch_kernels_get(void) {
+    if (batch_kernels == NULL) {
+        const struct BatchKernels *kernels = batch_kernels_get_type(BATCH_KERNELS_AVX2);
+        if (kernels == NULL) {
+            kernels = batch_kernels_get_type(BATCH_KERNELS_SSE41);
+        }
+        if (kernels == NULL) {
+            kernels = &SCALAR_KERNELS;
+        }
+        batch_kernels = kernels;
+    }
+
+    return batch_kernels;
+}
+
+bool batch_kernels_select(enum BatchKernelsType type) {
+    const struct BatchKernels *kernels = batch_kernels_get_type(type);
+    if (kernels == NULL) {
+        return false;
+    }
+
+    batch_kernels = kernels;
+    return true;
+}
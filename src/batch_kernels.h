@@ -0,0 +1,52 @@
+#ifndef MINMATH_BATCH_KERNELS_H__
+#define MINMATH_BATCH_KERNELS_H__
+#pragma once
+
+#include "bytecode.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Column kernels used by bytecode_execute_batch(). Binary kernels compute
+// lhs[i] = lhs[i] OP rhs[i] and unary kernels values[i] = OP values[i].
+typedef void (*BatchBinaryKernel)(int *restrict lhs, const int *restrict rhs, size_t count);
+typedef void (*BatchUnaryKernel)(int *values, size_t count);
+
+// Returns the number of values that are 0.
+typedef size_t (*BatchCountZerosKernel)(const int *values, size_t count);
+
+enum BatchKernelsType {
+    BATCH_KERNELS_SCALAR,
+    BATCH_KERNELS_SSE41,
+    BATCH_KERNELS_AVX2,
+};
+
+#define BATCH_KERNELS_TYPE_COUNT 3
+
+struct BatchKernels {
+    enum BatchKernelsType type;
+    const char *name;
+    // indexed by enum Instr, NULL for non-arithmetic instructions
+    BatchBinaryKernel binary[INSTR_RET + 1];
+    BatchUnaryKernel  unary[INSTR_RET + 1];
+    BatchCountZerosKernel count_zeros;
+};
+
+// The kernels used by bytecode_execute_batch(). Defaults to the best kernels
+// the CPU supports.
+const struct BatchKernels *batch_kernels_get(void);
+
+// Returns NULL and sets errno to ENOTSUP if the CPU doesn't support type.
+const struct BatchKernels *batch_kernels_get_type(enum BatchKernelsType type);
+
+bool batch_kernels_select(enum BatchKernelsType type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,6 +5,8 @@
 #include <inttypes.h>
 
 #include "bytecode.h"
+#include "optimizer.h"
+#include "fast_parser.h"
 
 union InstrArg {
     int value;
@@ -13,43 +15,75 @@ union InstrArg {
 
 #define ZERO_ARG (union InstrArg){ .value = 0 }
 
-#define INSTR_SIZE(INSTR) (                      \
-    (INSTR) == INSTR_INT ? 1 + sizeof(int) :     \
-    (INSTR) == INSTR_VAR ? 1 + sizeof(size_t) :  \
-    (INSTR) == INSTR_JEZ ||                      \
-    (INSTR) == INSTR_JNZ ||                      \
-    (INSTR) == INSTR_JMP ||                      \
-    (INSTR) == INSTR_JZP ? 1 + sizeof(size_t) :  \
-    1                                            \
+#define IS_INT_INSTR(INSTR) (                                    \
+    (INSTR) == INSTR_INT || (INSTR) == INSTR_RET_INT ||          \
+    ((INSTR) >= INSTR_ADD_INT && (INSTR) <= INSTR_RSHIFT_INT)    \
 )
 
+#define IS_VAR_INSTR(INSTR) (                                    \
+    (INSTR) == INSTR_VAR || (INSTR) == INSTR_RET_VAR ||          \
+    ((INSTR) >= INSTR_ADD_VAR && (INSTR) <= INSTR_RSHIFT_VAR)    \
+)
+
+#define IS_JUMP_INSTR(INSTR) (                                   \
+    (INSTR) == INSTR_JEZ ||                                      \
+    (INSTR) == INSTR_JNZ ||                                      \
+    (INSTR) == INSTR_JMP ||                                      \
+    (INSTR) == INSTR_JZP ||                                      \
+    ((INSTR) >= INSTR_JZP_LT && (INSTR) <= INSTR_JZP_NE) ||      \
+    IS_WIDE_JUMP_INSTR(INSTR)                                    \
+)
+
+#define IS_WIDE_JUMP_INSTR(INSTR) ((INSTR) >= INSTR_JMP_WIDE && (INSTR) <= INSTR_JZP_WIDE)
+
+// INSTR_JMP ... INSTR_JZP and their wide forms are in the same order
+#define WIDE_JUMP_INSTR(INSTR)   ((enum Instr)(INSTR_JMP_WIDE + ((INSTR) - INSTR_JMP)))
+#define NARROW_JUMP_INSTR(INSTR) ((enum Instr)(INSTR_JMP + ((INSTR) - INSTR_JMP_WIDE)))
+
+// jumps with the offset in the second word
+#define HAS_WIDE_OFFSET(INSTR) ((INSTR) == INSTR_JZP_VAR || IS_WIDE_JUMP_INSTR(INSTR))
+
+// instructions with an index into the results or the temporaries
+#define IS_INDEX_INSTR(INSTR) ((INSTR) == INSTR_OUT || (INSTR) == INSTR_LOAD || (INSTR) == INSTR_STORE)
+
+#define IS_INT_WIDE_INSTR(INSTR) ((INSTR) >= INSTR_INT_WIDE && (INSTR) <= INSTR_RET_INT_WIDE)
+
+#define INSTR_SIZE(INSTR) (IS_INT_WIDE_INSTR(INSTR) || (INSTR) == INSTR_VAR_WIDE || HAS_WIDE_OFFSET(INSTR) ? 2 : 1)
+
+#define ARG_FITS(VALUE) ((VALUE) >= BYTECODE_ARG_MIN && (VALUE) <= BYTECODE_ARG_MAX)
+
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
+static bool bytecode_binary_op(enum Instr instr, int lhs, int rhs, int *result);
 
+// Jump instructions are added with an offset of 0 and patched by
+// bytecode_set_jump_target() once the target is known.
 static bool bytecode_add_instr(struct Bytecode *bytecode, enum Instr instr, union InstrArg arg) {
     size_t instr_size = INSTR_SIZE(instr);
 
     if (bytecode->instrs_capacity - bytecode->instrs_size < instr_size) {
         size_t new_capacity;
         if (bytecode->instrs_capacity == 0) {
-            new_capacity = sizeof(union InstrArg) * 2;
-        } else if (bytecode->instrs_capacity > PTRDIFF_MAX / 2) {
+            new_capacity = 16;
+        } else if (bytecode->instrs_capacity > PTRDIFF_MAX / 2 / sizeof(uint32_t)) {
             errno = ENOMEM;
             return false;
         } else {
             new_capacity = bytecode->instrs_capacity * 2;
         }
         assert(new_capacity - bytecode->instrs_size >= instr_size);
-        uint8_t *instrs = realloc(bytecode->instrs, new_capacity);
+        uint32_t *instrs = realloc(bytecode->instrs, new_capacity * sizeof(uint32_t));
         if (instrs == NULL) {
             return false;
         }
 
 #ifndef NDEBUG
-        // make it clear if some of the bytes aren't initialized correctly
+        // make it clear if some of the words aren't initialized correctly
         memset(
             instrs + bytecode->instrs_size,
             0xFF,
-            new_capacity - bytecode->instrs_size
+            (new_capacity - bytecode->instrs_size) * sizeof(uint32_t)
         );
 #endif
 
@@ -57,37 +91,275 @@ static bool bytecode_add_instr(struct Bytecode *bytecode, enum Instr instr, unio
         bytecode->instrs_capacity = new_capacity;
     }
 
-    bytecode->instrs[bytecode->instrs_size] = instr;
+    uint32_t *words = bytecode->instrs + bytecode->instrs_size;
 
-    if (instr == INSTR_INT) {
-        memcpy(bytecode->instrs + bytecode->instrs_size + 1, &arg.value, sizeof(arg.value));
-    } else if (instr == INSTR_VAR) {
-        memcpy(bytecode->instrs + bytecode->instrs_size + 1, &arg.index, sizeof(arg.index));
-    } else if (instr == INSTR_JEZ || instr == INSTR_JNZ || instr == INSTR_JMP || instr == INSTR_JZP) {
-        memcpy(bytecode->instrs + bytecode->instrs_size + 1, &arg.index, sizeof(arg.index));
+    if (IS_INT_INSTR(instr)) {
+        assert(ARG_FITS(arg.value));
+        words[0] = BYTECODE_WORD(instr, arg.value);
+    } else if (IS_VAR_INSTR(instr) || instr == INSTR_JZP_VAR || IS_INDEX_INSTR(instr)) {
+        if (arg.index > BYTECODE_UARG_MAX) {
+            errno = ERANGE;
+            return false;
+        }
+        words[0] = BYTECODE_WORD(instr, arg.index);
+        if (instr == INSTR_JZP_VAR) {
+            words[1] = 0;
+        }
+    } else if (instr == INSTR_VAR_WIDE) {
+        if (arg.index > UINT32_MAX) {
+            errno = ERANGE;
+            return false;
+        }
+        words[0] = BYTECODE_WORD(instr, 0);
+        words[1] = (uint32_t)arg.index;
+    } else if (IS_INT_WIDE_INSTR(instr)) {
+        words[0] = BYTECODE_WORD(instr, 0);
+        words[1] = (uint32_t)arg.value;
+    } else {
+        words[0] = BYTECODE_WORD(instr, 0);
+        if (IS_WIDE_JUMP_INSTR(instr)) {
+            words[1] = 0;
+        }
     }
 
     bytecode->instrs_size += instr_size;
+    bytecode->verified = false;
     return true;
 }
 
-static ptrdiff_t bytecode_add_param(struct Bytecode *bytecode, const char *name) {
-    ptrdiff_t index = bytecode_get_param_index(bytecode, name);
-    if (index >= 0) {
-        return index;
+// Pushes the parameter, indices that don't fit into the argument need
+// INSTR_VAR_WIDE.
+static bool bytecode_add_var(struct Bytecode *bytecode, size_t index) {
+    const enum Instr instr = index > BYTECODE_UARG_MAX ? INSTR_VAR_WIDE : INSTR_VAR;
+    return bytecode_add_instr(bytecode, instr, (union InstrArg){ .index = index });
+}
+
+static bool bytecode_jump_offset_fits(enum Instr instr, ptrdiff_t offset) {
+    if (HAS_WIDE_OFFSET(instr)) {
+        return offset >= INT32_MIN && offset <= INT32_MAX;
+    }
+    return ARG_FITS(offset);
+}
+
+// Fails with ERANGE if the jump offset can't be encoded.
+static bool bytecode_set_jump_target(struct Bytecode *bytecode, size_t index, size_t target) {
+    enum Instr instr = BYTECODE_INSTR(bytecode->instrs[index]);
+    ptrdiff_t offset = (ptrdiff_t)target - (ptrdiff_t)index;
+
+    assert(IS_JUMP_INSTR(instr) || instr == INSTR_JZP_VAR);
+
+    if (!bytecode_jump_offset_fits(instr, offset)) {
+        errno = ERANGE;
+        return false;
+    }
+
+    if (HAS_WIDE_OFFSET(instr)) {
+        bytecode->instrs[index + 1] = (uint32_t)(int32_t)offset;
+    } else {
+        bytecode->instrs[index] = BYTECODE_WORD(instr, offset);
+    }
+    return true;
+}
+
+struct BinaryInstrs {
+    enum Instr stack;
+    enum Instr int_rhs;
+    enum Instr int_wide_rhs;
+    enum Instr var_rhs;
+};
+
+// INSTR_JZP_<cmp> instructions are chosen in bytecode_compile_cond()
+static const struct BinaryInstrs BINARY_INSTRS[] = {
+    [NODE_ADD]     = { INSTR_ADD,     INSTR_ADD_INT,     INSTR_ADD_INT_WIDE,     INSTR_ADD_VAR     },
+    [NODE_SUB]     = { INSTR_SUB,     INSTR_SUB_INT,     INSTR_SUB_INT_WIDE,     INSTR_SUB_VAR     },
+    [NODE_MUL]     = { INSTR_MUL,     INSTR_MUL_INT,     INSTR_MUL_INT_WIDE,     INSTR_MUL_VAR     },
+    [NODE_DIV]     = { INSTR_DIV,     INSTR_DIV_INT,     INSTR_DIV_INT_WIDE,     INSTR_DIV_VAR     },
+    [NODE_MOD]     = { INSTR_MOD,     INSTR_MOD_INT,     INSTR_MOD_INT_WIDE,     INSTR_MOD_VAR     },
+    [NODE_LT]      = { INSTR_LT,      INSTR_LT_INT,      INSTR_LT_INT_WIDE,      INSTR_LT_VAR      },
+    [NODE_GT]      = { INSTR_GT,      INSTR_GT_INT,      INSTR_GT_INT_WIDE,      INSTR_GT_VAR      },
+    [NODE_LE]      = { INSTR_LE,      INSTR_LE_INT,      INSTR_LE_INT_WIDE,      INSTR_LE_VAR      },
+    [NODE_GE]      = { INSTR_GE,      INSTR_GE_INT,      INSTR_GE_INT_WIDE,      INSTR_GE_VAR      },
+    [NODE_EQ]      = { INSTR_EQ,      INSTR_EQ_INT,      INSTR_EQ_INT_WIDE,      INSTR_EQ_VAR      },
+    [NODE_NE]      = { INSTR_NE,      INSTR_NE_INT,      INSTR_NE_INT_WIDE,      INSTR_NE_VAR      },
+    [NODE_BIT_AND] = { INSTR_BIT_AND, INSTR_BIT_AND_INT, INSTR_BIT_AND_INT_WIDE, INSTR_BIT_AND_VAR },
+    [NODE_BIT_OR]  = { INSTR_BIT_OR,  INSTR_BIT_OR_INT,  INSTR_BIT_OR_INT_WIDE,  INSTR_BIT_OR_VAR  },
+    [NODE_BIT_XOR] = { INSTR_BIT_XOR, INSTR_BIT_XOR_INT, INSTR_BIT_XOR_INT_WIDE, INSTR_BIT_XOR_VAR },
+    [NODE_LSHIFT]  = { INSTR_LSHIFT,  INSTR_LSHIFT_INT,  INSTR_LSHIFT_INT_WIDE,  INSTR_LSHIFT_VAR  },
+    [NODE_RSHIFT]  = { INSTR_RSHIFT,  INSTR_RSHIFT_INT,  INSTR_RSHIFT_INT_WIDE,  INSTR_RSHIFT_VAR  },
+};
+
+// State of one compilation. Subtrees that are evaluated more than once (see
+// ast_cse_build()) are stored in a temporary when they are first calculated
+// and loaded from it afterwards, as long as the temporary is set on every
+// path to the current instruction.
+//
+// Jumps are first compiled with 24-bit offsets. If one doesn't fit the code is
+// compiled again with the wide jumps.
+struct BytecodeCompiler {
+    struct Bytecode *bytecode;
+    struct AstCse cse;
+    size_t *temps;     // temporary of each CSE class, SIZE_MAX if none yet
+    bool *available;   // if the temporary of each CSE class is set
+    size_t *available_classes; // classes in the order they became available
+    size_t available_size;
+    size_t temps_size;
+    bool wide_jumps;
+    bool jump_out_of_range;
+};
+
+#define BYTECODE_COMPILER_INIT(BYTECODE) { \
+    .bytecode = (BYTECODE),                \
+    .cse = AST_CSE_INIT(),                 \
+    .temps = NULL,                         \
+    .available = NULL,                     \
+    .available_classes = NULL,             \
+    .available_size = 0,                   \
+    .temps_size = 0,                       \
+    .wide_jumps = false,                   \
+    .jump_out_of_range = false,            \
+}
+
+static void bytecode_compiler_free(struct BytecodeCompiler *compiler) {
+    ast_cse_free(&compiler->cse);
+    free(compiler->temps);
+    free(compiler->available);
+    free(compiler->available_classes);
+    compiler->temps = NULL;
+    compiler->available = NULL;
+    compiler->available_classes = NULL;
+}
+
+static bool bytecode_compiler_init(struct BytecodeCompiler *compiler, const struct AstNode *const exprs[], size_t count) {
+    if (!ast_cse_build(&compiler->cse, exprs, count)) {
+        return false;
+    }
+
+    const size_t capacity = compiler->cse.capacity;
+    compiler->temps = malloc(capacity * sizeof(size_t));
+    compiler->available = calloc(capacity, sizeof(bool));
+    compiler->available_classes = malloc(capacity * sizeof(size_t));
+
+    if (compiler->temps == NULL || compiler->available == NULL || compiler->available_classes == NULL) {
+        bytecode_compiler_free(compiler);
+        return false;
+    }
+
+    for (size_t index = 0; index < capacity; ++ index) {
+        compiler->temps[index] = SIZE_MAX;
+    }
+
+    return true;
+}
+
+// Clears the bytecode for another attempt with the wide jumps, if the last
+// one failed because of a jump offset.
+static bool bytecode_compiler_retry(struct BytecodeCompiler *compiler) {
+    if (compiler->wide_jumps || !compiler->jump_out_of_range) {
+        return false;
+    }
+
+    bytecode_clear(compiler->bytecode);
+
+    for (size_t index = 0; index < compiler->cse.capacity; ++ index) {
+        compiler->temps[index] = SIZE_MAX;
+        compiler->available[index] = false;
+    }
+    compiler->available_size = 0;
+    compiler->temps_size = 0;
+    compiler->wide_jumps = true;
+
+    return true;
+}
+
+static bool bytecode_compiler_add_jump(struct BytecodeCompiler *compiler, enum Instr instr) {
+    return bytecode_add_instr(compiler->bytecode, compiler->wide_jumps ? WIDE_JUMP_INSTR(instr) : instr, ZERO_ARG);
+}
+
+static bool bytecode_compiler_set_jump_target(struct BytecodeCompiler *compiler, size_t index, size_t target) {
+    if (!bytecode_set_jump_target(compiler->bytecode, index, target)) {
+        compiler->jump_out_of_range = true;
+        return false;
+    }
+    return true;
+}
+
+// Finds the slot of the parameter named name in the parameter index, or the
+// empty slot where it belongs. hash is symbol_hash(name, length). The index
+// has to have a free slot.
+static size_t bytecode_param_slot(const struct Bytecode *bytecode, uint32_t hash, const char *name, size_t length) {
+    const size_t mask = bytecode->param_index_capacity - 1;
+    // Fibonacci hashing: the top log2(capacity) bits of the product depend on
+    // all bits of the hash. The capacity is at least 16 and parameter indices
+    // have 24 bits, so the shift is in 7 ... 28.
+    const int shift = 32 - __builtin_ctzll(bytecode->param_index_capacity);
+    size_t slot = (uint32_t)(hash * UINT32_C(2654435769)) >> shift;
+
+    for (;;) {
+        const struct ParamIndexEntry *entry = &bytecode->param_index[slot];
+        if (entry->index == 0) {
+            return slot;
+        }
+        if (entry->hash == hash) {
+            const struct Symbol *param = bytecode->params[entry->index - 1];
+            if (param->length == length && memcmp(param->name, name, length) == 0) {
+                return slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static bool bytecode_grow_param_index(struct Bytecode *bytecode) {
+    size_t new_capacity;
+    if (bytecode->param_index_capacity == 0) {
+        new_capacity = 16;
+    } else if (bytecode->param_index_capacity > SIZE_MAX / 2 / sizeof(struct ParamIndexEntry)) {
+        errno = ENOMEM;
+        return false;
+    } else {
+        new_capacity = bytecode->param_index_capacity * 2;
+    }
+
+    struct ParamIndexEntry *param_index = calloc(new_capacity, sizeof(struct ParamIndexEntry));
+    if (param_index == NULL) {
+        return false;
+    }
+
+    free(bytecode->param_index);
+    bytecode->param_index = param_index;
+    bytecode->param_index_capacity = new_capacity;
+
+    for (size_t index = 0; index < bytecode->params_size; ++ index) {
+        const struct Symbol *param = bytecode->params[index];
+        const size_t slot = bytecode_param_slot(bytecode, param->hash, param->name, param->length);
+        param_index[slot] = (struct ParamIndexEntry){ .hash = param->hash, .index = index + 1 };
+    }
+
+    return true;
+}
+
+static ptrdiff_t bytecode_add_param(struct Bytecode *bytecode, const struct Symbol *symbol) {
+    // at most half full
+    if (bytecode->params_size >= bytecode->param_index_capacity / 2 && !bytecode_grow_param_index(bytecode)) {
+        return -1;
+    }
+
+    const size_t slot = bytecode_param_slot(bytecode, symbol->hash, symbol->name, symbol->length);
+    if (bytecode->param_index[slot].index != 0) {
+        return bytecode->param_index[slot].index - 1;
     }
 
     if (bytecode->params_size == bytecode->params_capacity) {
         size_t new_capacity;
         if (bytecode->params_capacity == 0) {
             new_capacity = 4;
-        } else if (bytecode->params_capacity > PTRDIFF_MAX / 2 / sizeof(char*)) {
+        } else if (bytecode->params_capacity > PTRDIFF_MAX / 2 / sizeof(struct Symbol*)) {
             errno = ENOMEM;
             return -1;
         } else {
             new_capacity = bytecode->params_capacity * 2;
         }
-        char **params = realloc(bytecode->params, new_capacity * sizeof(char*));
+        const struct Symbol **params = realloc(bytecode->params, new_capacity * sizeof(struct Symbol*));
         if (params == NULL) {
             return -1;
         }
@@ -95,180 +367,234 @@ static ptrdiff_t bytecode_add_param(struct Bytecode *bytecode, const char *name)
         bytecode->params_capacity = new_capacity;
     }
 
-    index = bytecode->params_size;
-    char *new_name = strdup(name);
-    if (new_name == NULL) {
+    const size_t index = bytecode->params_size ++;
+    bytecode->params[index] = symbol;
+    bytecode->param_index[slot] = (struct ParamIndexEntry){ .hash = symbol->hash, .index = index + 1 };
+
+    return index;
+}
+
+// Code after a conditional jump doesn't run on every path, temporaries set
+// there are forgotten once the conditional code ends.
+static void bytecode_compiler_forget(struct BytecodeCompiler *compiler, size_t available_size) {
+    while (compiler->available_size > available_size) {
+        -- compiler->available_size;
+        compiler->available[compiler->available_classes[compiler->available_size]] = false;
+    }
+}
+
+// Parameters and constants are cheaper to push again than to load.
+static size_t bytecode_compiler_shared_class(const struct BytecodeCompiler *compiler, const struct AstNode *expr) {
+    if (expr->type == NODE_INT || expr->type == NODE_VAR) {
+        return SIZE_MAX;
+    }
+
+    size_t class_index = ast_cse_class(&compiler->cse, expr);
+    assert(class_index != SIZE_MAX);
+
+    return compiler->cse.classes[class_index].uses > 1 ? class_index : SIZE_MAX;
+}
+
+static ptrdiff_t bytecode_compile_ast(struct BytecodeCompiler *compiler, const struct AstNode *expr);
+
+static ptrdiff_t bytecode_compile_cond_value(struct BytecodeCompiler *compiler, const struct AstNode *cond, size_t *jmp_index) {
+    ptrdiff_t cond_stack = bytecode_compile_ast(compiler, cond);
+    if (cond_stack < 0) {
+        return cond_stack;
+    }
+    *jmp_index = compiler->bytecode->instrs_size;
+    if (!bytecode_compiler_add_jump(compiler, INSTR_JZP)) {
         return -1;
     }
-    bytecode->params[index] = new_name;
-    ++ bytecode->params_size;
+    return cond_stack;
+}
+
+// Compiles the condition of an if expression including the jump to the else
+// branch. The jump target is left for the caller to fill in.
+static ptrdiff_t bytecode_compile_cond(struct BytecodeCompiler *compiler, const struct AstNode *cond, size_t *jmp_index) {
+    struct Bytecode *bytecode = compiler->bytecode;
+    enum Instr jmp_instr;
+
+    // the value of a shared comparison is needed for its temporary
+    if (bytecode_compiler_shared_class(compiler, cond) != SIZE_MAX) {
+        return bytecode_compile_cond_value(compiler, cond, jmp_index);
+    }
 
-    return index;
+    switch (cond->type) {
+        case NODE_VAR:
+        {
+            ptrdiff_t index = bytecode_add_param(compiler->bytecode, cond->data.symbol);
+            if (index < 0) {
+                return -1;
+            }
+            if ((size_t)index > BYTECODE_UARG_MAX) {
+                return bytecode_compile_cond_value(compiler, cond, jmp_index);
+            }
+            *jmp_index = bytecode->instrs_size;
+            if (!bytecode_add_instr(bytecode, INSTR_JZP_VAR, (union InstrArg){ .index = index })) {
+                return -1;
+            }
+            return 0;
+        }
+        case NODE_LT: jmp_instr = INSTR_JZP_LT; break;
+        case NODE_LE: jmp_instr = INSTR_JZP_LE; break;
+        case NODE_GT: jmp_instr = INSTR_JZP_GT; break;
+        case NODE_GE: jmp_instr = INSTR_JZP_GE; break;
+        case NODE_EQ: jmp_instr = INSTR_JZP_EQ; break;
+        case NODE_NE: jmp_instr = INSTR_JZP_NE; break;
+
+        default:
+            return bytecode_compile_cond_value(compiler, cond, jmp_index);
+    }
+
+    // the fused comparisons have no wide forms
+    if (compiler->wide_jumps) {
+        return bytecode_compile_cond_value(compiler, cond, jmp_index);
+    }
+
+    ptrdiff_t lhs_stack = bytecode_compile_ast(compiler, cond->data.binary.lhs);
+    if (lhs_stack < 0) {
+        return lhs_stack;
+    }
+
+    ptrdiff_t rhs_stack = bytecode_compile_ast(compiler, cond->data.binary.rhs);
+    if (rhs_stack < 0) {
+        return rhs_stack;
+    }
+
+    *jmp_index = bytecode->instrs_size;
+    if (!bytecode_add_instr(bytecode, jmp_instr, ZERO_ARG)) {
+        return -1;
+    }
+
+    if (rhs_stack >= PTRDIFF_MAX) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ++ rhs_stack;
+
+    return MAX(lhs_stack, rhs_stack);
+}
+
+// values that are always 0 or 1 don't need INSTR_BOOL
+static bool bytecode_is_boolean(const struct AstNode *expr) {
+    switch (expr->type) {
+        case NODE_NOT:
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_LT:
+        case NODE_GT:
+        case NODE_LE:
+        case NODE_GE:
+        case NODE_EQ:
+        case NODE_NE:
+            return true;
+
+        case NODE_INT:
+            return expr->data.value == 0 || expr->data.value == 1;
+
+        default:
+            return false;
+    }
 }
 
-static ptrdiff_t bytecode_compile_ast(struct Bytecode *bytecode, const struct AstNode *expr) {
+static ptrdiff_t bytecode_compile_node(struct BytecodeCompiler *compiler, const struct AstNode *expr) {
+    struct Bytecode *bytecode = compiler->bytecode;
+
     if (expr->type == NODE_AND) {
-        ptrdiff_t lhs_stack = bytecode_compile_ast(bytecode, expr->data.binary.lhs);
+        ptrdiff_t lhs_stack = bytecode_compile_ast(compiler, expr->data.binary.lhs);
         if (lhs_stack < 0) {
             return lhs_stack;
         }
 
-        size_t jmp_arg_index = bytecode->instrs_size + 1;
+        size_t jmp_index = bytecode->instrs_size;
 
-        if (!bytecode_add_instr(bytecode, INSTR_JEZ, ZERO_ARG)) {
+        if (!bytecode_compiler_add_jump(compiler, INSTR_JEZ)) {
             return -1;
         }
 
-        ptrdiff_t rhs_stack = bytecode_compile_ast(bytecode, expr->data.binary.rhs);
+        const size_t available_size = compiler->available_size;
+        ptrdiff_t rhs_stack = bytecode_compile_ast(compiler, expr->data.binary.rhs);
         if (rhs_stack < 0) {
             return rhs_stack;
         }
+        bytecode_compiler_forget(compiler, available_size);
 
-        if (!bytecode_add_instr(bytecode, INSTR_BOOL, ZERO_ARG)) {
+        if (!bytecode_is_boolean(expr->data.binary.rhs) && !bytecode_add_instr(bytecode, INSTR_BOOL, ZERO_ARG)) {
             return -1;
         }
 
-        size_t jmp_target = bytecode->instrs_size;
-        memcpy(bytecode->instrs + jmp_arg_index, &jmp_target, sizeof(jmp_target));
+        if (!bytecode_compiler_set_jump_target(compiler, jmp_index, bytecode->instrs_size)) {
+            return -1;
+        }
 
         return MAX(lhs_stack, rhs_stack);
     } else if (expr->type == NODE_OR) {
-        ptrdiff_t lhs_stack = bytecode_compile_ast(bytecode, expr->data.binary.lhs);
+        ptrdiff_t lhs_stack = bytecode_compile_ast(compiler, expr->data.binary.lhs);
         if (lhs_stack < 0) {
             return lhs_stack;
         }
 
-        size_t jmp_arg_index = bytecode->instrs_size + 1;
+        size_t jmp_index = bytecode->instrs_size;
 
-        if (!bytecode_add_instr(bytecode, INSTR_JNZ, ZERO_ARG)) {
+        if (!bytecode_compiler_add_jump(compiler, INSTR_JNZ)) {
             return -1;
         }
 
-        ptrdiff_t rhs_stack = bytecode_compile_ast(bytecode, expr->data.binary.rhs);
+        const size_t available_size = compiler->available_size;
+        ptrdiff_t rhs_stack = bytecode_compile_ast(compiler, expr->data.binary.rhs);
         if (rhs_stack < 0) {
             return rhs_stack;
         }
+        bytecode_compiler_forget(compiler, available_size);
 
-        if (!bytecode_add_instr(bytecode, INSTR_BOOL, ZERO_ARG)) {
+        if (!bytecode_is_boolean(expr->data.binary.rhs) && !bytecode_add_instr(bytecode, INSTR_BOOL, ZERO_ARG)) {
             return -1;
         }
 
-        size_t jmp_target = bytecode->instrs_size;
-        memcpy(bytecode->instrs + jmp_arg_index, &jmp_target, sizeof(jmp_target));
+        if (!bytecode_compiler_set_jump_target(compiler, jmp_index, bytecode->instrs_size)) {
+            return -1;
+        }
 
         return MAX(lhs_stack, rhs_stack);
     } else if (ast_is_binary(expr)) {
-        ptrdiff_t lhs_stack = bytecode_compile_ast(bytecode, expr->data.binary.lhs);
+        ptrdiff_t lhs_stack = bytecode_compile_ast(compiler, expr->data.binary.lhs);
         if (lhs_stack < 0) {
             return lhs_stack;
         }
 
-        ptrdiff_t rhs_stack = bytecode_compile_ast(bytecode, expr->data.binary.rhs);
-        if (rhs_stack < 0) {
-            return rhs_stack;
-        }
-
-        switch (expr->type) {
-            case NODE_ADD:
-                if (!bytecode_add_instr(bytecode, INSTR_ADD, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_SUB:
-                if (!bytecode_add_instr(bytecode, INSTR_SUB, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_MUL:
-                if (!bytecode_add_instr(bytecode, INSTR_MUL, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_DIV:
-                if (!bytecode_add_instr(bytecode, INSTR_DIV, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_MOD:
-                if (!bytecode_add_instr(bytecode, INSTR_MOD, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_LT:
-                if (!bytecode_add_instr(bytecode, INSTR_LT, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_GT:
-                if (!bytecode_add_instr(bytecode, INSTR_GT, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_LE:
-                if (!bytecode_add_instr(bytecode, INSTR_LE, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_GE:
-                if (!bytecode_add_instr(bytecode, INSTR_GE, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_EQ:
-                if (!bytecode_add_instr(bytecode, INSTR_EQ, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_NE:
-                if (!bytecode_add_instr(bytecode, INSTR_NE, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_BIT_AND:
-                if (!bytecode_add_instr(bytecode, INSTR_BIT_AND, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_BIT_OR:
-                if (!bytecode_add_instr(bytecode, INSTR_BIT_OR, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
-
-            case NODE_BIT_XOR:
-                if (!bytecode_add_instr(bytecode, INSTR_BIT_XOR, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
+        const struct AstNode *rhs = expr->data.binary.rhs;
+        const struct BinaryInstrs *instrs = &BINARY_INSTRS[expr->type];
 
-            case NODE_LSHIFT:
-                if (!bytecode_add_instr(bytecode, INSTR_LSHIFT, ZERO_ARG)) {
+        // a constant or parameter on the right hand side becomes the argument
+        // of the instruction
+        if (rhs->type == NODE_INT) {
+            enum Instr instr = ARG_FITS(rhs->data.value) ? instrs->int_rhs : instrs->int_wide_rhs;
+            if (!bytecode_add_instr(bytecode, instr, (union InstrArg){ .value = rhs->data.value })) {
+                return -1;
+            }
+            return lhs_stack;
+        } else if (rhs->type == NODE_VAR) {
+            ptrdiff_t index = bytecode_add_param(compiler->bytecode, rhs->data.symbol);
+            if (index < 0) {
+                return -1;
+            }
+            // otherwise pushed by INSTR_VAR_WIDE below
+            if ((size_t)index <= BYTECODE_UARG_MAX) {
+                if (!bytecode_add_instr(bytecode, instrs->var_rhs, (union InstrArg){ .index = index })) {
                     return -1;
                 }
-                break;
+                return lhs_stack;
+            }
+        }
 
-            case NODE_RSHIFT:
-                if (!bytecode_add_instr(bytecode, INSTR_RSHIFT, ZERO_ARG)) {
-                    return -1;
-                }
-                break;
+        ptrdiff_t rhs_stack = bytecode_compile_ast(compiler, rhs);
+        if (rhs_stack < 0) {
+            return rhs_stack;
+        }
 
-            default:
-                assert(false);
-                errno = EINVAL;
-                return -1;
+        if (!bytecode_add_instr(bytecode, instrs->stack, ZERO_ARG)) {
+            return -1;
         }
 
         if (rhs_stack >= PTRDIFF_MAX) {
@@ -280,7 +606,7 @@ static ptrdiff_t bytecode_compile_ast(struct Bytecode *bytecode, const struct As
 
         return MAX(lhs_stack, rhs_stack);
     } else if (ast_is_unary(expr)) {
-        ptrdiff_t stack_size = bytecode_compile_ast(bytecode, expr->data.child);
+        ptrdiff_t stack_size = bytecode_compile_ast(compiler, expr->data.child);
         if (stack_size < 0) {
             return stack_size;
         }
@@ -312,52 +638,50 @@ static ptrdiff_t bytecode_compile_ast(struct Bytecode *bytecode, const struct As
 
         return stack_size;
     } else if (expr->type == NODE_IF) {
-        ptrdiff_t cond_stack = bytecode_compile_ast(bytecode, expr->data.terneary.cond);
+        size_t cond_jmp_index = 0;
+        ptrdiff_t cond_stack = bytecode_compile_cond(compiler, expr->data.terneary.cond, &cond_jmp_index);
         if (cond_stack < 0) {
             return cond_stack;
         }
 
-        size_t cond_jmp_arg_index = bytecode->instrs_size + 1;
-
-        if (!bytecode_add_instr(bytecode, INSTR_JZP, ZERO_ARG)) {
-            return -1;
-        }
-
-        ptrdiff_t then_stack = bytecode_compile_ast(bytecode, expr->data.terneary.then_expr);
+        const size_t available_size = compiler->available_size;
+        ptrdiff_t then_stack = bytecode_compile_ast(compiler, expr->data.terneary.then_expr);
         if (then_stack < 0) {
             return then_stack;
         }
+        bytecode_compiler_forget(compiler, available_size);
 
-        size_t then_jmp_arg_index = bytecode->instrs_size + 1;
+        size_t then_jmp_index = bytecode->instrs_size;
 
-        if (!bytecode_add_instr(bytecode, INSTR_JMP, ZERO_ARG)) {
+        if (!bytecode_compiler_add_jump(compiler, INSTR_JMP)) {
             return -1;
         }
 
-        size_t jmp_target = bytecode->instrs_size;
-        memcpy(bytecode->instrs + cond_jmp_arg_index, &jmp_target, sizeof(jmp_target));
+        if (!bytecode_compiler_set_jump_target(compiler, cond_jmp_index, bytecode->instrs_size)) {
+            return -1;
+        }
 
-        int32_t else_stack = bytecode_compile_ast(bytecode, expr->data.terneary.else_expr);
+        ptrdiff_t else_stack = bytecode_compile_ast(compiler, expr->data.terneary.else_expr);
         if (else_stack < 0) {
             return else_stack;
         }
+        bytecode_compiler_forget(compiler, available_size);
 
-        jmp_target = bytecode->instrs_size;
-        memcpy(bytecode->instrs + then_jmp_arg_index, &jmp_target, sizeof(jmp_target));
+        if (!bytecode_compiler_set_jump_target(compiler, then_jmp_index, bytecode->instrs_size)) {
+            return -1;
+        }
 
         ptrdiff_t stack_size = MAX(cond_stack, then_stack);
         return MAX(stack_size, else_stack);
     } else if (expr->type == NODE_INT) {
-        if (!bytecode_add_instr(bytecode, INSTR_INT, (union InstrArg){ .value = expr->data.value })) {
+        enum Instr instr = ARG_FITS(expr->data.value) ? INSTR_INT : INSTR_INT_WIDE;
+        if (!bytecode_add_instr(bytecode, instr, (union InstrArg){ .value = expr->data.value })) {
             return -1;
         }
         return 1;
     } else if (expr->type == NODE_VAR) {
-        ptrdiff_t index = bytecode_add_param(bytecode, expr->data.ident);
-        if (index < 0) {
-            return -1;
-        }
-        if (!bytecode_add_instr(bytecode, INSTR_VAR, (union InstrArg){ .index = index })) {
+        ptrdiff_t index = bytecode_add_param(compiler->bytecode, expr->data.symbol);
+        if (index < 0 || !bytecode_add_var(bytecode, index)) {
             return -1;
         }
         return 1;
@@ -368,80 +692,108 @@ static ptrdiff_t bytecode_compile_ast(struct Bytecode *bytecode, const struct As
     }
 }
 
-static ptrdiff_t bytecode_optimize_jump_target(struct Bytecode *bytecode, size_t index) {
-    enum Instr instr = bytecode->instrs[index];
-    if (instr == INSTR_JMP) {
-        size_t target = 0;
-        memcpy(&target, bytecode->instrs + index + 1, sizeof(target));
-        if (index >= bytecode->instrs_size) {
-            errno = EINVAL;
+static ptrdiff_t bytecode_compile_ast(struct BytecodeCompiler *compiler, const struct AstNode *expr) {
+    const size_t class_index = bytecode_compiler_shared_class(compiler, expr);
+
+    if (class_index == SIZE_MAX) {
+        return bytecode_compile_node(compiler, expr);
+    }
+
+    size_t temp = compiler->temps[class_index];
+
+    if (compiler->available[class_index]) {
+        if (!bytecode_add_instr(compiler->bytecode, INSTR_LOAD, (union InstrArg){ .index = temp })) {
             return -1;
         }
-        ptrdiff_t res = bytecode_optimize_jump_target(bytecode, target);
-        if (res >= 0) {
-            target = res;
-            if (bytecode->instrs[target] == INSTR_RET) {
-                memset(bytecode->instrs + index, INSTR_RET, 1 + sizeof(target));
-            } else {
-                memcpy(bytecode->instrs + index + 1, &target, sizeof(target));
-            }
-        }
-        return res;
-    } else {
-        return index;
+        return 1;
+    }
+
+    ptrdiff_t stack_size = bytecode_compile_node(compiler, expr);
+    if (stack_size < 0) {
+        return stack_size;
+    }
+
+    if (temp == SIZE_MAX) {
+        temp = compiler->temps[class_index] = compiler->temps_size ++;
+    }
+
+    if (!bytecode_add_instr(compiler->bytecode, INSTR_STORE, (union InstrArg){ .index = temp })) {
+        return -1;
+    }
+
+    compiler->available[class_index] = true;
+    compiler->available_classes[compiler->available_size ++] = class_index;
+
+    return stack_size;
+}
+
+// Replaces an unconditional jump by INSTR_RET. The second word of
+// INSTR_JMP_WIDE becomes an unreachable INSTR_RET too.
+static void bytecode_set_ret(struct Bytecode *bytecode, size_t index) {
+    if (BYTECODE_INSTR(bytecode->instrs[index]) == INSTR_JMP_WIDE) {
+        bytecode->instrs[index + 1] = BYTECODE_WORD(INSTR_RET, 0);
+    }
+    bytecode->instrs[index] = BYTECODE_WORD(INSTR_RET, 0);
+}
+
+static ptrdiff_t bytecode_optimize_jump_target(struct Bytecode *bytecode, size_t index) {
+    const enum Instr instr = BYTECODE_INSTR(bytecode->instrs[index]);
+    if (instr == INSTR_JMP || instr == INSTR_JMP_WIDE) {
+        size_t target = 0;
+        if (INSTR_SIZE(instr) > bytecode->instrs_size - index) {
+            errno = EINVAL;
+            return -1;
+        }
+        bytecode_get_jump_target(bytecode, index, &target);
+        if (target >= bytecode->instrs_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        ptrdiff_t res = bytecode_optimize_jump_target(bytecode, target);
+        if (res >= 0) {
+            target = res;
+            if (BYTECODE_INSTR(bytecode->instrs[target]) == INSTR_RET) {
+                bytecode_set_ret(bytecode, index);
+            } else if (!bytecode_set_jump_target(bytecode, index, target)) {
+                // out of range, keep the jump to the jump
+                return index;
+            }
+        }
+        return res;
+    } else {
+        return index;
     }
 }
 
 // Bytecode-optimizer that fixes jump targes that land on INSTR_JMP to the target
-// of that instruction (transitively).
+// of that instruction (transitively). Afterwards an INSTR_INT, INSTR_INT_WIDE or
+// INSTR_VAR that is followed by INSTR_RET is turned into the matching INSTR_RET_*
+// instruction. The
+// arguments are the same so this is done in place, the following INSTR_RET
+// stays for any jumps that target it.
 bool bytecode_optimize(struct Bytecode *bytecode) {
-    for (size_t index = 0; index < bytecode->instrs_size;) {
-        enum Instr instr = bytecode->instrs[index];
-        switch (instr) {
-        case INSTR_INT:
-            index += 1 + sizeof(int);
-            break;
+    bytecode->verified = false;
 
-        case INSTR_VAR:
-            index += 1 + sizeof(size_t);
-            break;
+    for (size_t index = 0; index < bytecode->instrs_size;) {
+        enum Instr instr = BYTECODE_INSTR(bytecode->instrs[index]);
+        if (instr >= INSTR_COUNT) {
+            assert(false);
+            errno = EINVAL;
+            return false;
+        }
 
-        case INSTR_ADD:
-        case INSTR_SUB:
-        case INSTR_MUL:
-        case INSTR_DIV:
-        case INSTR_MOD:
-        case INSTR_BIT_AND:
-        case INSTR_BIT_XOR:
-        case INSTR_BIT_OR:
-        case INSTR_LT:
-        case INSTR_LE:
-        case INSTR_GT:
-        case INSTR_GE:
-        case INSTR_EQ:
-        case INSTR_NE:
-        case INSTR_NEG:
-        case INSTR_BIT_NEG:
-        case INSTR_NOT:
-        case INSTR_BOOL:
-        case INSTR_LSHIFT:
-        case INSTR_RSHIFT:
-        case INSTR_RET:
-            ++ index;
-            break;
+        size_t instr_size = INSTR_SIZE(instr);
+        if (instr_size > bytecode->instrs_size - index) {
+            errno = EINVAL;
+            return false;
+        }
 
-        case INSTR_JMP:
-        case INSTR_JEZ:
-        case INSTR_JNZ:
-        case INSTR_JZP:
-        {
-            ++ index;
-            if (index >= bytecode->instrs_size) {
+        size_t target = 0;
+        if (bytecode_get_jump_target(bytecode, index, &target)) {
+            if (target >= bytecode->instrs_size) {
                 errno = EINVAL;
                 return false;
             }
-            size_t target;
-            memcpy(&target, bytecode->instrs + index, sizeof(target));
 
             ptrdiff_t res = bytecode_optimize_jump_target(bytecode, target);
 
@@ -450,40 +802,887 @@ bool bytecode_optimize(struct Bytecode *bytecode) {
             }
 
             target = res;
-            if (instr == INSTR_JMP && bytecode->instrs[target] == INSTR_RET) {
-                memset(bytecode->instrs + index - 1, INSTR_RET, 1 + sizeof(target));
+            if ((instr == INSTR_JMP || instr == INSTR_JMP_WIDE) && BYTECODE_INSTR(bytecode->instrs[target]) == INSTR_RET) {
+                bytecode_set_ret(bytecode, index);
+            } else if (bytecode_jump_offset_fits(instr, (ptrdiff_t)target - (ptrdiff_t)index)) {
+                bytecode_set_jump_target(bytecode, index, target);
+            }
+        }
+
+        index += instr_size;
+    }
+
+    for (size_t index = 0; index < bytecode->instrs_size;) {
+        uint32_t word = bytecode->instrs[index];
+        size_t next_index = index + INSTR_SIZE(BYTECODE_INSTR(word));
+
+        if (next_index < bytecode->instrs_size && BYTECODE_INSTR(bytecode->instrs[next_index]) == INSTR_RET) {
+            if (BYTECODE_INSTR(word) == INSTR_INT) {
+                bytecode->instrs[index] = BYTECODE_WORD(INSTR_RET_INT, BYTECODE_ARG(word));
+            } else if (BYTECODE_INSTR(word) == INSTR_INT_WIDE) {
+                bytecode->instrs[index] = BYTECODE_WORD(INSTR_RET_INT_WIDE, 0);
+            } else if (BYTECODE_INSTR(word) == INSTR_VAR) {
+                bytecode->instrs[index] = BYTECODE_WORD(INSTR_RET_VAR, BYTECODE_UARG(word));
+            }
+        }
+
+        index = next_index;
+    }
+
+    return true;
+}
+
+bool bytecode_shrink_to_fit(struct Bytecode *bytecode) {
+    if (bytecode->instrs_size > 0 && bytecode->instrs_capacity > bytecode->instrs_size) {
+        uint32_t *instrs = realloc(bytecode->instrs, bytecode->instrs_size * sizeof(uint32_t));
+        if (instrs == NULL) {
+            return false;
+        }
+        bytecode->instrs = instrs;
+        bytecode->instrs_capacity = bytecode->instrs_size;
+    }
+
+    if (bytecode->params_size > 0 && bytecode->params_capacity > bytecode->params_size) {
+        const struct Symbol **params = realloc(bytecode->params, bytecode->params_size * sizeof(struct Symbol*));
+        if (params == NULL) {
+            return false;
+        }
+        bytecode->params = params;
+        bytecode->params_capacity = bytecode->params_size;
+    }
+
+    return true;
+}
+
+bool bytecode_compile_multi(struct Bytecode *bytecode, const struct AstNode *const exprs[], size_t count) {
+    if (count == 0 || count - 1 > BYTECODE_UARG_MAX) {
+        errno = count == 0 ? EINVAL : ERANGE;
+        return false;
+    }
+
+    // subexpressions are shared across all expressions
+    struct BytecodeCompiler compiler = BYTECODE_COMPILER_INIT(bytecode);
+    if (!bytecode_compiler_init(&compiler, exprs, count)) {
+        return false;
+    }
+
+    size_t stack_size;
+
+retry:
+    stack_size = 0;
+    for (size_t index = 0; index < count; ++ index) {
+        ptrdiff_t expr_stack_size = bytecode_compile_ast(&compiler, exprs[index]);
+
+        if (expr_stack_size < 0 ||
+            !bytecode_add_instr(bytecode, INSTR_OUT, (union InstrArg){ .index = index })) {
+            if (bytecode_compiler_retry(&compiler)) {
+                goto retry;
+            }
+            goto error;
+        }
+
+        stack_size = MAX(stack_size, (size_t)expr_stack_size);
+    }
+
+    // the return value is ignored
+    if (!bytecode_add_instr(bytecode, INSTR_RET_INT, ZERO_ARG)) {
+        goto error;
+    }
+
+    bytecode->stack_size   = stack_size + compiler.temps_size;
+    bytecode->temps_size   = compiler.temps_size;
+    bytecode->results_size = count;
+
+    bytecode_compiler_free(&compiler);
+    return true;
+
+error:
+    bytecode_compiler_free(&compiler);
+    bytecode_clear(bytecode);
+    return false;
+}
+
+// Records the stack depth at a jump target or the following instruction.
+// All paths have to arrive with the same depth.
+static bool bytecode_verify_merge(ptrdiff_t *depths, size_t index, ptrdiff_t depth) {
+    if (depths[index] < 0) {
+        depths[index] = depth;
+    } else if (depths[index] != depth) {
+        return false;
+    }
+    return true;
+}
+
+// Jumps only go forward, so all paths to an instruction are known by the
+// time it is reached and one pass over the code suffices. Unreachable code
+// needs to be encoded correctly, but its stack effects are ignored.
+bool bytecode_verify(struct Bytecode *bytecode) {
+    const uint32_t *instrs = bytecode->instrs;
+    const size_t instrs_size = bytecode->instrs_size;
+    const size_t eval_size = bytecode->stack_size - bytecode->temps_size;
+    const ptrdiff_t stack_size = eval_size > PTRDIFF_MAX ? PTRDIFF_MAX : (ptrdiff_t)eval_size;
+
+    bytecode->verified = false;
+
+    if (instrs_size == 0 || bytecode->temps_size > bytecode->stack_size) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // stack depth before each instruction, -1 if not reached (yet)
+    ptrdiff_t *depths = malloc(instrs_size * sizeof(ptrdiff_t));
+    if (depths == NULL) {
+        return false;
+    }
+
+    for (size_t index = 0; index < instrs_size; ++ index) {
+        depths[index] = -1;
+    }
+    depths[0] = 0;
+
+    for (size_t index = 0; index < instrs_size;) {
+        const uint32_t word = instrs[index];
+        enum Instr instr = BYTECODE_INSTR(word);
+
+        if (instr >= INSTR_COUNT || INSTR_SIZE(instr) > instrs_size - index) {
+            goto error;
+        }
+
+        if ((IS_VAR_INSTR(instr) || instr == INSTR_JZP_VAR) && BYTECODE_UARG(word) >= bytecode->params_size) {
+            goto error;
+        }
+
+        if (instr == INSTR_VAR_WIDE && instrs[index + 1] >= bytecode->params_size) {
+            goto error;
+        }
+
+        if (instr == INSTR_OUT && BYTECODE_UARG(word) >= bytecode->results_size) {
+            goto error;
+        }
+
+        if ((instr == INSTR_LOAD || instr == INSTR_STORE) && BYTECODE_UARG(word) >= bytecode->temps_size) {
+            goto error;
+        }
+
+        const size_t next_index = index + INSTR_SIZE(instr);
+        const ptrdiff_t depth = depths[index];
+
+        // the wide jumps only differ in the encoding of the offset
+        if (IS_WIDE_JUMP_INSTR(instr)) {
+            instr = NARROW_JUMP_INSTR(instr);
+        }
+
+        if (depth >= 0) {
+            ptrdiff_t pops = 0;
+            ptrdiff_t pushes = 0;
+            ptrdiff_t jump_depth = -1;
+            ptrdiff_t ret_depth = -1;
+
+            switch (instr) {
+                case INSTR_INT:
+                case INSTR_INT_WIDE:
+                case INSTR_VAR:
+                case INSTR_VAR_WIDE:
+                case INSTR_LOAD:
+                    pushes = 1;
+                    break;
+
+                case INSTR_NEG:
+                case INSTR_BIT_NEG:
+                case INSTR_NOT:
+                case INSTR_BOOL:
+                case INSTR_STORE:
+                    pops = pushes = 1;
+                    break;
+
+                case INSTR_JMP:
+                    jump_depth = depth;
+                    break;
+
+                case INSTR_JEZ:
+                case INSTR_JNZ:
+                    pops = 1;
+                    jump_depth = depth;
+                    break;
+
+                case INSTR_JZP:
+                    pops = 1;
+                    jump_depth = depth - 1;
+                    break;
+
+                case INSTR_JZP_LT:
+                case INSTR_JZP_LE:
+                case INSTR_JZP_GT:
+                case INSTR_JZP_GE:
+                case INSTR_JZP_EQ:
+                case INSTR_JZP_NE:
+                    pops = 2;
+                    jump_depth = depth - 2;
+                    break;
+
+                case INSTR_JZP_VAR:
+                    jump_depth = depth;
+                    break;
+
+                case INSTR_OUT:
+                    pops = 1;
+                    break;
+
+                case INSTR_RET:
+                    ret_depth = 1;
+                    break;
+
+                case INSTR_RET_INT:
+                case INSTR_RET_INT_WIDE:
+                case INSTR_RET_VAR:
+                    ret_depth = 0;
+                    break;
+
+                default:
+                    // binary operations, the <op>_INT, <op>_INT_WIDE and
+                    // <op>_VAR forms take only one operand from the stack
+                    pops = instr < INSTR_ADD_INT ? 2 : 1;
+                    pushes = 1;
+                    break;
+            }
+
+            if (ret_depth >= 0) {
+                if (depth != ret_depth) {
+                    goto error;
+                }
             } else {
-                memcpy(bytecode->instrs + index, &target, sizeof(target));
+                if (depth < pops || depth - pops + pushes > stack_size) {
+                    goto error;
+                }
+
+                if (jump_depth >= 0) {
+                    size_t target = 0;
+                    bytecode_get_jump_target(bytecode, index, &target);
+                    if (target <= index || target >= instrs_size || !bytecode_verify_merge(depths, target, jump_depth)) {
+                        goto error;
+                    }
+                }
+
+                if (instr != INSTR_JMP) {
+                    if (next_index >= instrs_size || !bytecode_verify_merge(depths, next_index, depth - pops + pushes)) {
+                        goto error;
+                    }
+                }
             }
+        }
 
-            index += sizeof(target);
-            break;
+        // a jump into the argument word of the instruction
+        if (next_index - index > 1 && depths[index + 1] >= 0) {
+            goto error;
+        }
+
+        index = next_index;
+    }
+
+    free(depths);
+    bytecode->verified = true;
+    return true;
+
+error:
+    free(depths);
+    errno = EINVAL;
+    return false;
+}
+
+bool bytecode_compile(struct Bytecode *bytecode, const struct AstNode *expr) {
+    struct BytecodeCompiler compiler = BYTECODE_COMPILER_INIT(bytecode);
+    if (!bytecode_compiler_init(&compiler, &expr, 1)) {
+        return false;
+    }
+
+    ptrdiff_t stack_size;
+    while ((stack_size = bytecode_compile_ast(&compiler, expr)) < 0) {
+        if (!bytecode_compiler_retry(&compiler)) {
+            goto error;
+        }
+    }
+
+    bytecode->stack_size = stack_size + compiler.temps_size;
+    bytecode->temps_size = compiler.temps_size;
+
+    if (!bytecode_add_instr(bytecode, INSTR_RET, ZERO_ARG)) {
+        goto error;
+    }
+
+    bytecode_compiler_free(&compiler);
+    return true;
+
+error:
+    bytecode_compiler_free(&compiler);
+    bytecode_clear(bytecode);
+    return false;
+}
+
+bool bytecode_specialize(struct Bytecode *bytecode, const struct AstNode *expr, const struct Param params[], size_t param_count) {
+    struct AstNode *spec_expr = ast_specialize(expr, params, param_count);
+    if (spec_expr == NULL) {
+        return false;
+    }
+
+    bool ok = bytecode_compile(bytecode, spec_expr);
+    ast_free(spec_expr);
+
+    return ok;
+}
+
+// Single pass compiler. The values of the parsed subexpressions are kept on a
+// small value stack that mirrors the runtime stack. Constants and parameters
+// are only emitted once they are needed on the runtime stack, until then they
+// can still be folded or become the argument of a superinstruction. All values
+// below emitted are on the runtime stack, because code is emitted in the order
+// of evaluation.
+enum SourceValueKind {
+    SOURCE_INT,
+    SOURCE_VAR,
+    SOURCE_CODE,
+};
+
+struct SourceValue {
+    enum SourceValueKind kind;
+    int value;    // SOURCE_INT
+    size_t index; // SOURCE_VAR: parameter index, SOURCE_CODE: index of the stack comparison that computed it or SIZE_MAX
+};
+
+struct SourceCompiler {
+    struct Bytecode *bytecode;
+    struct SymbolTable *symbols;
+    struct Tokenizer tokenizer;
+    struct ErrorInfo error;
+    struct SourceValue *values;
+    size_t values_size;
+    size_t values_capacity;
+    size_t emitted;
+    size_t stack_size;
+    bool wide_jumps; // same as in struct BytecodeCompiler
+    bool jump_out_of_range;
+};
+
+#define SOURCE_COMPILER_INIT(BYTECODE, SYMBOLS, INPUT) { \
+    .bytecode  = (BYTECODE),                             \
+    .symbols   = (SYMBOLS),                              \
+    .tokenizer = TOKENIZER_INIT(INPUT),                  \
+    .error = {                                           \
+        .error  = PARSER_ERROR_OK,                       \
+        .offset = 0,                                     \
+        .context_offset = 0,                             \
+        .token  = TOK_EOF,                               \
+    },                                                   \
+    .values = NULL,                                      \
+    .values_size = 0,                                    \
+    .values_capacity = 0,                                \
+    .emitted = 0,                                        \
+    .stack_size = 0,                                     \
+    .wide_jumps = false,                                 \
+    .jump_out_of_range = false,                          \
+}
+
+static bool source_compile_expression(struct SourceCompiler *source, int min_precedence);
+
+static bool source_memory_error(struct SourceCompiler *source) {
+    source->error.error  = PARSER_ERROR_MEMORY;
+    source->error.offset = source->error.context_offset = source->tokenizer.token_pos;
+    return false;
+}
+
+static bool source_push_value(struct SourceCompiler *source, struct SourceValue value) {
+    if (source->values_size == source->values_capacity) {
+        size_t new_capacity = source->values_capacity == 0 ? 16 : source->values_capacity * 2;
+        struct SourceValue *values = realloc(source->values, new_capacity * sizeof(struct SourceValue));
+        if (values == NULL) {
+            return source_memory_error(source);
+        }
+        source->values = values;
+        source->values_capacity = new_capacity;
+    }
+    source->values[source->values_size ++] = value;
+    return true;
+}
+
+static bool source_add_instr(struct SourceCompiler *source, enum Instr instr, union InstrArg arg) {
+    if (!bytecode_add_instr(source->bytecode, instr, arg)) {
+        return source_memory_error(source);
+    }
+    return true;
+}
+
+static bool source_add_var(struct SourceCompiler *source, size_t index) {
+    if (!bytecode_add_var(source->bytecode, index)) {
+        return source_memory_error(source);
+    }
+    return true;
+}
+
+static bool source_add_jump(struct SourceCompiler *source, enum Instr instr) {
+    return source_add_instr(source, source->wide_jumps ? WIDE_JUMP_INSTR(instr) : instr, ZERO_ARG);
+}
+
+static bool source_set_jump_target(struct SourceCompiler *source, size_t index, size_t target) {
+    if (!bytecode_set_jump_target(source->bytecode, index, target)) {
+        source->jump_out_of_range = true;
+        return source_memory_error(source);
+    }
+    return true;
+}
+
+// pushes the pending values below end onto the runtime stack
+static bool source_emit_values(struct SourceCompiler *source, size_t end) {
+    for (size_t index = source->emitted; index < end; ++ index) {
+        const struct SourceValue *value = &source->values[index];
+        bool ok;
+        if (value->kind == SOURCE_INT) {
+            ok = source_add_instr(source, ARG_FITS(value->value) ? INSTR_INT : INSTR_INT_WIDE,
+                (union InstrArg){ .value = value->value });
+        } else {
+            assert(value->kind == SOURCE_VAR);
+            ok = source_add_var(source, value->index);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    if (end > source->emitted) {
+        source->emitted = end;
+        source->stack_size = MAX(source->stack_size, end);
+    }
+    return true;
+}
+
+static inline bool source_is_pending(const struct SourceCompiler *source, size_t index) {
+    return index >= source->emitted;
+}
+
+// replaces the value on top of the stack by the result of an instruction
+static void source_set_code(struct SourceCompiler *source, size_t cmp_index) {
+    source->values[source->values_size - 1] = (struct SourceValue){
+        .kind  = SOURCE_CODE,
+        .value = 0,
+        .index = cmp_index,
+    };
+    source->emitted = source->values_size;
+    source->stack_size = MAX(source->stack_size, source->emitted);
+}
+
+static bool source_compile_unary(struct SourceCompiler *source, enum NodeType type) {
+    struct SourceValue *value = &source->values[source->values_size - 1];
+
+    if (source_is_pending(source, source->values_size - 1) && value->kind == SOURCE_INT) {
+        value->value =
+            type == NODE_NEG     ? -value->value :
+            type == NODE_BIT_NEG ? ~value->value : !value->value;
+        return true;
+    }
+
+    enum Instr instr = type == NODE_NEG ? INSTR_NEG : type == NODE_BIT_NEG ? INSTR_BIT_NEG : INSTR_NOT;
+    if (!source_emit_values(source, source->values_size) || !source_add_instr(source, instr, ZERO_ARG)) {
+        return false;
+    }
+    source_set_code(source, SIZE_MAX);
+    return true;
+}
+
+// the same folding as ast_optimize(), divisions that would trap are left to the runtime
+static bool source_fold_binary(enum NodeType type, int lhs, int rhs, int *result) {
+    return bytecode_binary_op(BINARY_INSTRS[type].stack, lhs, rhs, result);
+}
+
+static bool source_compile_binary(struct SourceCompiler *source, enum NodeType type) {
+    assert(source->values_size >= 2);
+    const size_t rhs_index = source->values_size - 1;
+    struct SourceValue *lhs = &source->values[rhs_index - 1];
+    const struct SourceValue rhs = source->values[rhs_index];
+    const struct BinaryInstrs *instrs = &BINARY_INSTRS[type];
+
+    if (source_is_pending(source, rhs_index - 1) && lhs->kind == SOURCE_INT && rhs.kind == SOURCE_INT &&
+        source_fold_binary(type, lhs->value, rhs.value, &lhs->value)) {
+        -- source->values_size;
+        return true;
+    }
+
+    // a parameter index that doesn't fit into the argument is pushed by
+    // INSTR_VAR_WIDE
+    if (source_is_pending(source, rhs_index) && (rhs.kind == SOURCE_INT || rhs.index <= BYTECODE_UARG_MAX)) {
+        // a constant or parameter on the right hand side becomes the argument
+        // of the instruction
+        if (!source_emit_values(source, rhs_index)) {
+            return false;
+        }
+        bool ok;
+        if (rhs.kind == SOURCE_INT) {
+            ok = source_add_instr(source, ARG_FITS(rhs.value) ? instrs->int_rhs : instrs->int_wide_rhs,
+                (union InstrArg){ .value = rhs.value });
+        } else {
+            ok = source_add_instr(source, instrs->var_rhs, (union InstrArg){ .index = rhs.index });
+        }
+        if (!ok) {
+            return false;
+        }
+        -- source->values_size;
+        source_set_code(source, SIZE_MAX);
+        return true;
+    }
+
+    if (!source_emit_values(source, source->values_size)) {
+        return false;
+    }
+
+    const size_t instr_index = source->bytecode->instrs_size;
+    if (!source_add_instr(source, instrs->stack, ZERO_ARG)) {
+        return false;
+    }
+    -- source->values_size;
+
+    const bool is_cmp = instrs->stack >= INSTR_LT && instrs->stack <= INSTR_NE;
+    source_set_code(source, is_cmp ? instr_index : SIZE_MAX);
+    return true;
+}
+
+// Compiles an operand whose code is thrown away again, only its syntax is
+// checked. The parameters it adds are kept.
+static bool source_compile_discarded(struct SourceCompiler *source, int min_precedence) {
+    struct Bytecode *bytecode = source->bytecode;
+    const size_t instrs_size = bytecode->instrs_size;
+    const size_t emitted = source->emitted;
+
+    if (!source_compile_expression(source, min_precedence)) {
+        return false;
+    }
+
+    -- source->values_size;
+    source->emitted = emitted;
+    bytecode->instrs_size = instrs_size;
+    return true;
+}
+
+// Same as bytecode_compile_node() for NODE_AND and NODE_OR. A constant left
+// hand side decides the result or leaves only the right hand side.
+static bool source_compile_logical(struct SourceCompiler *source, enum NodeType type, int precedence) {
+    struct Bytecode *bytecode = source->bytecode;
+    const size_t lhs_index = source->values_size - 1;
+    const struct SourceValue lhs = source->values[lhs_index];
+
+    if (source_is_pending(source, lhs_index) && lhs.kind == SOURCE_INT) {
+        -- source->values_size;
+        if ((type == NODE_AND) != (lhs.value != 0)) {
+            return (
+                source_compile_discarded(source, precedence) &&
+                source_push_value(source, (struct SourceValue){ .kind = SOURCE_INT, .value = type == NODE_OR, .index = 0 })
+            );
+        }
+
+        if (!source_compile_expression(source, precedence)) {
+            return false;
         }
+
+        struct SourceValue *rhs = &source->values[lhs_index];
+        if (source_is_pending(source, lhs_index) && rhs->kind == SOURCE_INT) {
+            rhs->value = rhs->value != 0;
+            return true;
+        }
+
+        if (!source_emit_values(source, source->values_size) || !source_add_instr(source, INSTR_BOOL, ZERO_ARG)) {
+            return false;
+        }
+        source_set_code(source, SIZE_MAX);
+        return true;
+    }
+
+    if (!source_emit_values(source, source->values_size)) {
+        return false;
+    }
+
+    const size_t jmp_index = bytecode->instrs_size;
+    if (!source_add_jump(source, type == NODE_AND ? INSTR_JEZ : INSTR_JNZ)) {
+        return false;
+    }
+    // the right hand side replaces the left hand side on the stack
+    -- source->values_size;
+    -- source->emitted;
+
+    if (!source_compile_expression(source, precedence) ||
+        !source_emit_values(source, source->values_size) ||
+        !source_add_instr(source, INSTR_BOOL, ZERO_ARG)) {
+        return false;
+    }
+
+    if (!source_set_jump_target(source, jmp_index, bytecode->instrs_size)) {
+        return false;
+    }
+
+    source_set_code(source, SIZE_MAX);
+    return true;
+}
+
+static bool source_expect_colon(struct SourceCompiler *source, size_t start_offset) {
+    if (next_token(&source->tokenizer) != TOK_COLON) {
+        source->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+        source->error.offset = source->tokenizer.token_pos;
+        source->error.context_offset = start_offset;
+        return false;
+    }
+    return true;
+}
+
+// Same as bytecode_compile_node() for NODE_IF, the '?' is already consumed.
+// A constant condition only keeps the code of one branch.
+static bool source_compile_if(struct SourceCompiler *source) {
+    struct Bytecode *bytecode = source->bytecode;
+    const size_t start_offset = source->tokenizer.token_pos;
+    const size_t cond_index = source->values_size - 1;
+    const struct SourceValue cond = source->values[cond_index];
+
+    if (source_is_pending(source, cond_index) && cond.kind == SOURCE_INT) {
+        -- source->values_size;
+        if (cond.value != 0) {
+            return (
+                source_compile_expression(source, 0) &&
+                source_expect_colon(source, start_offset) &&
+                source_compile_discarded(source, 0)
+            );
+        }
+        return (
+            source_compile_discarded(source, 0) &&
+            source_expect_colon(source, start_offset) &&
+            source_compile_expression(source, 0)
+        );
+    }
+
+    size_t cond_jmp_index;
+    if (source_is_pending(source, cond_index) && cond.index <= BYTECODE_UARG_MAX) {
+        // a parameter is tested without pushing it
+        assert(cond.kind == SOURCE_VAR);
+        if (!source_emit_values(source, cond_index)) {
+            return false;
+        }
+        cond_jmp_index = bytecode->instrs_size;
+        if (!source_add_instr(source, INSTR_JZP_VAR, (union InstrArg){ .index = cond.index })) {
+            return false;
+        }
+    } else if (!source->wide_jumps && cond.kind == SOURCE_CODE && cond.index == bytecode->instrs_size - 1) {
+        // a comparison that was just emitted is fused with the jump
+        static const enum Instr JZP_CMP_INSTRS[] = {
+            [INSTR_LT] = INSTR_JZP_LT,
+            [INSTR_LE] = INSTR_JZP_LE,
+            [INSTR_GT] = INSTR_JZP_GT,
+            [INSTR_GE] = INSTR_JZP_GE,
+            [INSTR_EQ] = INSTR_JZP_EQ,
+            [INSTR_NE] = INSTR_JZP_NE,
+        };
+        cond_jmp_index = cond.index;
+        bytecode->instrs[cond_jmp_index] = BYTECODE_WORD(JZP_CMP_INSTRS[BYTECODE_INSTR(bytecode->instrs[cond_jmp_index])], 0);
+    } else {
+        if (!source_emit_values(source, source->values_size)) {
+            return false;
+        }
+        cond_jmp_index = bytecode->instrs_size;
+        if (!source_add_jump(source, INSTR_JZP)) {
+            return false;
+        }
+    }
+
+    -- source->values_size;
+    source->emitted = MIN(source->emitted, source->values_size);
+
+    if (!source_compile_expression(source, 0) || !source_emit_values(source, source->values_size)) {
+        return false;
+    }
+
+    const size_t then_jmp_index = bytecode->instrs_size;
+    if (!source_add_jump(source, INSTR_JMP)) {
+        return false;
+    }
+    // the else branch replaces the value of the then branch on the stack
+    -- source->values_size;
+    -- source->emitted;
+
+    if (!source_set_jump_target(source, cond_jmp_index, bytecode->instrs_size)) {
+        return false;
+    }
+
+    if (!source_expect_colon(source, start_offset) ||
+        !source_compile_expression(source, 0) ||
+        !source_emit_values(source, source->values_size)) {
+        return false;
+    }
+
+    if (!source_set_jump_target(source, then_jmp_index, bytecode->instrs_size)) {
+        return false;
+    }
+
+    source_set_code(source, SIZE_MAX);
+    return true;
+}
+
+// Same as fast_parse_leaf(), prefix operators are applied once their operand
+// is compiled.
+static bool source_compile_leaf(struct SourceCompiler *source) {
+    enum TokenType token = next_token(&source->tokenizer);
+    while (token == TOK_PLUS) {
+        token = next_token(&source->tokenizer);
+    }
+
+    switch (token) {
+        case TOK_MINUS:
+            return source_compile_leaf(source) && source_compile_unary(source, NODE_NEG);
+
+        case TOK_BIT_NEG:
+            return source_compile_leaf(source) && source_compile_unary(source, NODE_BIT_NEG);
+
+        case TOK_NOT:
+            return source_compile_leaf(source) && source_compile_unary(source, NODE_NOT);
+
+        case TOK_INT:
+            return source_push_value(source, (struct SourceValue){
+                .kind  = SOURCE_INT,
+                .value = source->tokenizer.value,
+                .index = 0,
+            });
+
+        case TOK_IDENT:
+        {
+            const struct Symbol *symbol = tokenizer_get_symbol(&source->tokenizer, source->symbols);
+            if (symbol == NULL) {
+                return source_memory_error(source);
+            }
+            ptrdiff_t index = bytecode_add_param(source->bytecode, symbol);
+            if (index < 0) {
+                return source_memory_error(source);
+            }
+            return source_push_value(source, (struct SourceValue){
+                .kind  = SOURCE_VAR,
+                .value = 0,
+                .index = index,
+            });
+        }
+        case TOK_LPAREN:
+        {
+            size_t start_offset = source->tokenizer.token_pos;
+            if (!source_compile_expression(source, 0)) {
+                return false;
+            }
+
+            if (next_token(&source->tokenizer) != TOK_RPAREN) {
+                if (token_is_error(source->tokenizer.token)) {
+                    source->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+                    source->error.offset = source->error.context_offset = source->tokenizer.token_pos;
+                } else {
+                    source->error.error  = PARSER_ERROR_EXPECTED_TOKEN;
+                    source->error.token  = TOK_RPAREN;
+                    source->error.offset = source->tokenizer.token_pos;
+                    source->error.context_offset = start_offset;
+                }
+                return false;
+            }
+            return true;
+        }
+        case TOK_EOF:
+            source->error.error  = PARSER_ERROR_UNEXPECTED_EOF;
+            source->error.offset = source->error.context_offset = source->tokenizer.token_pos;
+            return false;
+
         default:
-            assert(false);
-            errno = EINVAL;
+            source->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+            source->error.offset = source->error.context_offset = source->tokenizer.token_pos;
             return false;
+    }
+}
+
+// Same as fast_parse_expression() and fast_parse_increasing_precedence(),
+// leaves the value of the expression on the value stack.
+bool source_compile_expression(struct SourceCompiler *source, int min_precedence) {
+    if (!source_compile_leaf(source)) {
+        return false;
+    }
+
+    for (;;) {
+        enum TokenType token = peek_token(&source->tokenizer);
+
+        if (token == TOK_QUEST) {
+            if (get_precedence(NODE_IF) <= min_precedence) {
+                return true;
+            }
+            next_token(&source->tokenizer);
+            if (!source_compile_if(source)) {
+                return false;
+            }
+            continue;
         }
+
+        if (!is_binary_operation(token)) {
+            return true;
+        }
+
+        enum NodeType type = get_binary_node_type(token);
+        int precedence = get_precedence(type);
+
+        if (precedence <= min_precedence) {
+            return true;
+        }
+
+        next_token(&source->tokenizer);
+
+        if (type == NODE_AND || type == NODE_OR) {
+            if (!source_compile_logical(source, type, precedence)) {
+                return false;
+            }
+        } else if (!source_compile_expression(source, precedence) || !source_compile_binary(source, type)) {
+            return false;
+        }
+    }
+}
+
+static bool source_compile(struct SourceCompiler *source) {
+    if (!source_compile_expression(source, 0)) {
+        return false;
     }
+
+    if (next_token(&source->tokenizer) != TOK_EOF) {
+        source->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+        source->error.offset = source->error.context_offset = source->tokenizer.token_pos;
+        return false;
+    }
+
+    assert(source->values_size == 1);
+    if (!source_emit_values(source, 1) || !source_add_instr(source, INSTR_RET, ZERO_ARG)) {
+        return false;
+    }
+
+    source->bytecode->stack_size = source->stack_size;
+    source->bytecode->temps_size = 0;
     return true;
 }
 
-bool bytecode_compile(struct Bytecode *bytecode, const struct AstNode *expr) {
-    ptrdiff_t stack_size = bytecode_compile_ast(bytecode, expr);
+bool bytecode_compile_source(struct Bytecode *bytecode, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    struct SourceCompiler source = SOURCE_COMPILER_INIT(bytecode, symbols, input);
+    bool ok = source_compile(&source);
+
+    if (!ok && source.jump_out_of_range) {
+        // start over with the wide jumps
+        bytecode_clear(bytecode);
+        tokenizer_free(&source.tokenizer);
+        free(source.values);
+
+        source = (struct SourceCompiler)SOURCE_COMPILER_INIT(bytecode, symbols, input);
+        source.wide_jumps = true;
+        ok = source_compile(&source);
+    }
 
-    if (stack_size < 0) {
+    if (!ok) {
         bytecode_clear(bytecode);
-        return false;
     }
 
-    bytecode->stack_size = stack_size;
-
-    if (!bytecode_add_instr(bytecode, INSTR_RET, ZERO_ARG)) {
-        bytecode_clear(bytecode);
-        return false;
+    if (error != NULL) {
+        *error = source.error;
     }
 
-    return true;
+    tokenizer_free(&source.tokenizer);
+    free(source.values);
+    return ok;
 }
 
 #if (defined(__GNUC__) || defined(__clang__)) && !defined(MINMATH_ADDRESS_FROM_LABEL)
@@ -493,7 +1692,8 @@ bool bytecode_compile(struct Bytecode *bytecode, const struct AstNode *expr) {
 #ifdef MINMATH_ADDRESS_FROM_LABEL
 #   define DISPATCH_INSTR \
         assert(instr_ptr < bytecode->instrs_size); \
-        goto *(jmptbl[instrs[instr_ptr]]);
+        word = instrs[instr_ptr]; \
+        goto *(jmptbl[BYTECODE_INSTR(word)]);
 #   define BEGIN_EXEC DISPATCH_INSTR
 #   define JMP_LABEL(NAME) DO_ ## NAME:
 #   define NEXT_INSTR DISPATCH_INSTR
@@ -502,13 +1702,15 @@ bool bytecode_compile(struct Bytecode *bytecode, const struct AstNode *expr) {
 #   define BEGIN_EXEC \
         const size_t instrs_size = bytecode->instrs_size; \
         while (instr_ptr < instrs_size) { \
-            switch (instrs[instr_ptr]) {
+            word = instrs[instr_ptr]; \
+            switch (BYTECODE_INSTR(word)) {
 #   define JMP_LABEL(NAME) case INSTR_ ## NAME:
 #   define NEXT_INSTR break;
 #   define END_EXEC } }
 #endif
 
-int bytecode_execute(const struct Bytecode *bytecode, const int *params, int *stack) {
+// results are only written by INSTR_OUT
+static int bytecode_run(const struct Bytecode *bytecode, const int *params, int *stack, int *results) {
 #ifdef MINMATH_ADDRESS_FROM_LABEL
     static const void *jmptbl[] = {
         [INSTR_INT]     = &&DO_INT,
@@ -538,185 +1740,387 @@ int bytecode_execute(const struct Bytecode *bytecode, const int *params, int *st
         [INSTR_LSHIFT]  = &&DO_LSHIFT,
         [INSTR_RSHIFT]  = &&DO_RSHIFT,
         [INSTR_RET]     = &&DO_RET,
+
+        [INSTR_ADD_INT]     = &&DO_ADD_INT,
+        [INSTR_SUB_INT]     = &&DO_SUB_INT,
+        [INSTR_MUL_INT]     = &&DO_MUL_INT,
+        [INSTR_DIV_INT]     = &&DO_DIV_INT,
+        [INSTR_MOD_INT]     = &&DO_MOD_INT,
+        [INSTR_BIT_AND_INT] = &&DO_BIT_AND_INT,
+        [INSTR_BIT_XOR_INT] = &&DO_BIT_XOR_INT,
+        [INSTR_BIT_OR_INT]  = &&DO_BIT_OR_INT,
+        [INSTR_LT_INT]      = &&DO_LT_INT,
+        [INSTR_LE_INT]      = &&DO_LE_INT,
+        [INSTR_GT_INT]      = &&DO_GT_INT,
+        [INSTR_GE_INT]      = &&DO_GE_INT,
+        [INSTR_EQ_INT]      = &&DO_EQ_INT,
+        [INSTR_NE_INT]      = &&DO_NE_INT,
+        [INSTR_LSHIFT_INT]  = &&DO_LSHIFT_INT,
+        [INSTR_RSHIFT_INT]  = &&DO_RSHIFT_INT,
+
+        [INSTR_ADD_VAR]     = &&DO_ADD_VAR,
+        [INSTR_SUB_VAR]     = &&DO_SUB_VAR,
+        [INSTR_MUL_VAR]     = &&DO_MUL_VAR,
+        [INSTR_DIV_VAR]     = &&DO_DIV_VAR,
+        [INSTR_MOD_VAR]     = &&DO_MOD_VAR,
+        [INSTR_BIT_AND_VAR] = &&DO_BIT_AND_VAR,
+        [INSTR_BIT_XOR_VAR] = &&DO_BIT_XOR_VAR,
+        [INSTR_BIT_OR_VAR]  = &&DO_BIT_OR_VAR,
+        [INSTR_LT_VAR]      = &&DO_LT_VAR,
+        [INSTR_LE_VAR]      = &&DO_LE_VAR,
+        [INSTR_GT_VAR]      = &&DO_GT_VAR,
+        [INSTR_GE_VAR]      = &&DO_GE_VAR,
+        [INSTR_EQ_VAR]      = &&DO_EQ_VAR,
+        [INSTR_NE_VAR]      = &&DO_NE_VAR,
+        [INSTR_LSHIFT_VAR]  = &&DO_LSHIFT_VAR,
+        [INSTR_RSHIFT_VAR]  = &&DO_RSHIFT_VAR,
+
+        [INSTR_JZP_LT]  = &&DO_JZP_LT,
+        [INSTR_JZP_LE]  = &&DO_JZP_LE,
+        [INSTR_JZP_GT]  = &&DO_JZP_GT,
+        [INSTR_JZP_GE]  = &&DO_JZP_GE,
+        [INSTR_JZP_EQ]  = &&DO_JZP_EQ,
+        [INSTR_JZP_NE]  = &&DO_JZP_NE,
+        [INSTR_JZP_VAR] = &&DO_JZP_VAR,
+        [INSTR_RET_INT] = &&DO_RET_INT,
+        [INSTR_RET_VAR] = &&DO_RET_VAR,
+
+        [INSTR_INT_WIDE]         = &&DO_INT_WIDE,
+        [INSTR_ADD_INT_WIDE]     = &&DO_ADD_INT_WIDE,
+        [INSTR_SUB_INT_WIDE]     = &&DO_SUB_INT_WIDE,
+        [INSTR_MUL_INT_WIDE]     = &&DO_MUL_INT_WIDE,
+        [INSTR_DIV_INT_WIDE]     = &&DO_DIV_INT_WIDE,
+        [INSTR_MOD_INT_WIDE]     = &&DO_MOD_INT_WIDE,
+        [INSTR_BIT_AND_INT_WIDE] = &&DO_BIT_AND_INT_WIDE,
+        [INSTR_BIT_XOR_INT_WIDE] = &&DO_BIT_XOR_INT_WIDE,
+        [INSTR_BIT_OR_INT_WIDE]  = &&DO_BIT_OR_INT_WIDE,
+        [INSTR_LT_INT_WIDE]      = &&DO_LT_INT_WIDE,
+        [INSTR_LE_INT_WIDE]      = &&DO_LE_INT_WIDE,
+        [INSTR_GT_INT_WIDE]      = &&DO_GT_INT_WIDE,
+        [INSTR_GE_INT_WIDE]      = &&DO_GE_INT_WIDE,
+        [INSTR_EQ_INT_WIDE]      = &&DO_EQ_INT_WIDE,
+        [INSTR_NE_INT_WIDE]      = &&DO_NE_INT_WIDE,
+        [INSTR_LSHIFT_INT_WIDE]  = &&DO_LSHIFT_INT_WIDE,
+        [INSTR_RSHIFT_INT_WIDE]  = &&DO_RSHIFT_INT_WIDE,
+        [INSTR_RET_INT_WIDE]     = &&DO_RET_INT_WIDE,
+
+        [INSTR_VAR_WIDE] = &&DO_VAR_WIDE,
+        [INSTR_JMP_WIDE] = &&DO_JMP_WIDE,
+        [INSTR_JEZ_WIDE] = &&DO_JEZ_WIDE,
+        [INSTR_JNZ_WIDE] = &&DO_JNZ_WIDE,
+        [INSTR_JZP_WIDE] = &&DO_JZP_WIDE,
+
+        [INSTR_OUT] = &&DO_OUT,
+
+        [INSTR_LOAD]  = &&DO_LOAD,
+        [INSTR_STORE] = &&DO_STORE,
     };
 #endif
 
-    const uint8_t *instrs = bytecode->instrs;
+    const uint32_t *instrs = bytecode->instrs;
+    int *temps = stack + (bytecode->stack_size - bytecode->temps_size);
     size_t instr_ptr = 0;
     size_t stack_ptr = 0;
-    size_t addr;
+    uint32_t word;
+
+    // The top of the stack is cached in tos and only spilled to the stack
+    // when a value is pushed. stack_ptr counts the spilled values, the value
+    // spilled by the first push is the initial garbage of tos. That way the
+    // cache is always full and the stack needs no more slots than without
+    // caching.
+    int tos = 0;
 
     BEGIN_EXEC
 
     JMP_LABEL(INT)
     ++ instr_ptr;
-    memcpy(stack + stack_ptr, instrs + instr_ptr, sizeof(int));
-    ++ stack_ptr;
-    instr_ptr += sizeof(int);
+    stack[stack_ptr ++] = tos;
+    tos = BYTECODE_ARG(word);
+    NEXT_INSTR
+
+    JMP_LABEL(INT_WIDE)
+    stack[stack_ptr ++] = tos;
+    tos = (int32_t)instrs[instr_ptr + 1];
+    instr_ptr += 2;
     NEXT_INSTR
 
     JMP_LABEL(VAR)
     ++ instr_ptr;
-    memcpy(&addr, instrs + instr_ptr, sizeof(addr));
-    instr_ptr += sizeof(addr);
-    stack[stack_ptr] = params[addr];
-    ++ stack_ptr;
+    stack[stack_ptr ++] = tos;
+    tos = params[BYTECODE_UARG(word)];
     NEXT_INSTR
 
     JMP_LABEL(ADD)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] += stack[stack_ptr];
+    tos = stack[-- stack_ptr] + tos;
     NEXT_INSTR
 
     JMP_LABEL(SUB)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] -= stack[stack_ptr];
+    tos = stack[-- stack_ptr] - tos;
     NEXT_INSTR
 
     JMP_LABEL(MUL)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] *= stack[stack_ptr];
+    tos = stack[-- stack_ptr] * tos;
     NEXT_INSTR
 
     JMP_LABEL(DIV)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] /= stack[stack_ptr];
+    tos = stack[-- stack_ptr] / tos;
     NEXT_INSTR
 
     JMP_LABEL(MOD)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] %= stack[stack_ptr];
+    tos = stack[-- stack_ptr] % tos;
     NEXT_INSTR
 
     JMP_LABEL(BIT_AND)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] &= stack[stack_ptr];
+    tos = stack[-- stack_ptr] & tos;
     NEXT_INSTR
 
     JMP_LABEL(BIT_XOR)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] ^= stack[stack_ptr];
+    tos = stack[-- stack_ptr] ^ tos;
     NEXT_INSTR
 
     JMP_LABEL(BIT_OR)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] |= stack[stack_ptr];
+    tos = stack[-- stack_ptr] | tos;
     NEXT_INSTR
 
     JMP_LABEL(LT)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] < stack[stack_ptr];
+    tos = stack[-- stack_ptr] < tos;
     NEXT_INSTR
 
     JMP_LABEL(LE)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] <= stack[stack_ptr];
+    tos = stack[-- stack_ptr] <= tos;
     NEXT_INSTR
 
     JMP_LABEL(GT)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] > stack[stack_ptr];
+    tos = stack[-- stack_ptr] > tos;
     NEXT_INSTR
 
     JMP_LABEL(GE)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] >= stack[stack_ptr];
+    tos = stack[-- stack_ptr] >= tos;
     NEXT_INSTR
 
     JMP_LABEL(EQ)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] == stack[stack_ptr];
+    tos = stack[-- stack_ptr] == tos;
     NEXT_INSTR
 
     JMP_LABEL(NE)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] != stack[stack_ptr];
+    tos = stack[-- stack_ptr] != tos;
     NEXT_INSTR
 
     JMP_LABEL(NEG)
     ++ instr_ptr;
-    stack[stack_ptr - 1] = -stack[stack_ptr - 1];
+    tos = -tos;
     NEXT_INSTR
 
     JMP_LABEL(BIT_NEG)
     ++ instr_ptr;
-    stack[stack_ptr - 1] = ~stack[stack_ptr - 1];
+    tos = ~tos;
     NEXT_INSTR
 
     JMP_LABEL(NOT)
     ++ instr_ptr;
-    stack[stack_ptr - 1] = !stack[stack_ptr - 1];
+    tos = !tos;
     NEXT_INSTR
 
     JMP_LABEL(JMP)
-    ++ instr_ptr;
-    memcpy(&instr_ptr, instrs + instr_ptr, sizeof(instr_ptr));
+    instr_ptr += BYTECODE_ARG(word);
     NEXT_INSTR
 
     JMP_LABEL(JEZ)
-    if (stack[stack_ptr - 1]) {
-        instr_ptr += 1 + sizeof(instr_ptr);
-        -- stack_ptr;
+    if (tos) {
+        ++ instr_ptr;
+        tos = stack[-- stack_ptr];
     } else {
-        memcpy(&instr_ptr, instrs + instr_ptr + 1, sizeof(instr_ptr));
-        stack[stack_ptr - 1] = 0;
+        instr_ptr += BYTECODE_ARG(word);
     }
     NEXT_INSTR
 
     JMP_LABEL(JNZ)
-    if (stack[stack_ptr - 1]) {
-        memcpy(&instr_ptr, instrs + instr_ptr + 1, sizeof(instr_ptr));
-        stack[stack_ptr - 1] = 1;
+    if (tos) {
+        instr_ptr += BYTECODE_ARG(word);
+        tos = 1;
     } else {
-        instr_ptr += 1 + sizeof(instr_ptr);
-        -- stack_ptr;
+        ++ instr_ptr;
+        tos = stack[-- stack_ptr];
     }
     NEXT_INSTR
 
     JMP_LABEL(JZP)
-    -- stack_ptr;
-    if (stack[stack_ptr]) {
-        instr_ptr += 1 + sizeof(instr_ptr);
+    if (tos) {
+        ++ instr_ptr;
     } else {
-        memcpy(&instr_ptr, instrs + instr_ptr + 1, sizeof(instr_ptr));
+        instr_ptr += BYTECODE_ARG(word);
     }
+    tos = stack[-- stack_ptr];
     NEXT_INSTR
 
     JMP_LABEL(BOOL)
-    stack[stack_ptr - 1] = stack[stack_ptr - 1] != 0;
+    tos = tos != 0;
     ++ instr_ptr;
     NEXT_INSTR
 
     JMP_LABEL(LSHIFT)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] <<= stack[stack_ptr];
+    tos = stack[-- stack_ptr] << tos;
     NEXT_INSTR
 
     JMP_LABEL(RSHIFT)
     ++ instr_ptr;
-    -- stack_ptr;
-    stack[stack_ptr - 1] >>= stack[stack_ptr];
+    tos = stack[-- stack_ptr] >> tos;
     NEXT_INSTR
 
     JMP_LABEL(RET)
     assert(stack_ptr == 1);
-    -- stack_ptr;
-    return stack[stack_ptr];
+    return tos;
+    NEXT_INSTR
+
+// lhs is the top of the stack, rhs the argument
+#define EXEC_BINARY_ARG(NAME, EXPR)                                     \
+    JMP_LABEL(NAME ## _INT)                                             \
+    ++ instr_ptr;                                                       \
+    { int lhs = tos; int rhs = BYTECODE_ARG(word); tos = (EXPR); }      \
+    NEXT_INSTR                                                          \
+                                                                        \
+    JMP_LABEL(NAME ## _INT_WIDE)                                        \
+    { int lhs = tos; int rhs = (int32_t)instrs[instr_ptr + 1]; tos = (EXPR); } \
+    instr_ptr += 2;                                                     \
+    NEXT_INSTR                                                          \
+                                                                        \
+    JMP_LABEL(NAME ## _VAR)                                             \
+    ++ instr_ptr;                                                       \
+    { int lhs = tos; int rhs = params[BYTECODE_UARG(word)]; tos = (EXPR); } \
+    NEXT_INSTR
+
+    EXEC_BINARY_ARG(ADD,     lhs +  rhs)
+    EXEC_BINARY_ARG(SUB,     lhs -  rhs)
+    EXEC_BINARY_ARG(MUL,     lhs *  rhs)
+    EXEC_BINARY_ARG(DIV,     lhs /  rhs)
+    EXEC_BINARY_ARG(MOD,     lhs %  rhs)
+    EXEC_BINARY_ARG(BIT_AND, lhs &  rhs)
+    EXEC_BINARY_ARG(BIT_XOR, lhs ^  rhs)
+    EXEC_BINARY_ARG(BIT_OR,  lhs |  rhs)
+    EXEC_BINARY_ARG(LT,      lhs <  rhs)
+    EXEC_BINARY_ARG(LE,      lhs <= rhs)
+    EXEC_BINARY_ARG(GT,      lhs >  rhs)
+    EXEC_BINARY_ARG(GE,      lhs >= rhs)
+    EXEC_BINARY_ARG(EQ,      lhs == rhs)
+    EXEC_BINARY_ARG(NE,      lhs != rhs)
+    EXEC_BINARY_ARG(LSHIFT,  lhs << rhs)
+    EXEC_BINARY_ARG(RSHIFT,  lhs >> rhs)
+
+#undef EXEC_BINARY_ARG
+
+// lhs is the spilled value, rhs the top of the stack
+#define EXEC_JZP_CMP(NAME, OP)                                          \
+    JMP_LABEL(JZP_ ## NAME)                                             \
+    if (stack[stack_ptr - 1] OP tos) {                                  \
+        ++ instr_ptr;                                                   \
+    } else {                                                            \
+        instr_ptr += BYTECODE_ARG(word);                                \
+    }                                                                   \
+    stack_ptr -= 2;                                                     \
+    tos = stack[stack_ptr];                                             \
+    NEXT_INSTR
+
+    EXEC_JZP_CMP(LT, <)
+    EXEC_JZP_CMP(LE, <=)
+    EXEC_JZP_CMP(GT, >)
+    EXEC_JZP_CMP(GE, >=)
+    EXEC_JZP_CMP(EQ, ==)
+    EXEC_JZP_CMP(NE, !=)
+
+#undef EXEC_JZP_CMP
+
+    JMP_LABEL(JZP_VAR)
+    if (params[BYTECODE_UARG(word)]) {
+        instr_ptr += 2;
+    } else {
+        instr_ptr += (int32_t)instrs[instr_ptr + 1];
+    }
+    NEXT_INSTR
+
+    JMP_LABEL(RET_INT)
+    assert(stack_ptr == 0);
+    return BYTECODE_ARG(word);
+    NEXT_INSTR
+
+    JMP_LABEL(RET_VAR)
+    assert(stack_ptr == 0);
+    return params[BYTECODE_UARG(word)];
+    NEXT_INSTR
+
+    JMP_LABEL(RET_INT_WIDE)
+    assert(stack_ptr == 0);
+    return (int32_t)instrs[instr_ptr + 1];
+    NEXT_INSTR
+
+    JMP_LABEL(VAR_WIDE)
+    stack[stack_ptr ++] = tos;
+    tos = params[instrs[instr_ptr + 1]];
+    instr_ptr += 2;
+    NEXT_INSTR
+
+    JMP_LABEL(JMP_WIDE)
+    instr_ptr += (int32_t)instrs[instr_ptr + 1];
+    NEXT_INSTR
+
+    JMP_LABEL(JEZ_WIDE)
+    if (tos) {
+        instr_ptr += 2;
+        tos = stack[-- stack_ptr];
+    } else {
+        instr_ptr += (int32_t)instrs[instr_ptr + 1];
+    }
+    NEXT_INSTR
+
+    JMP_LABEL(JNZ_WIDE)
+    if (tos) {
+        instr_ptr += (int32_t)instrs[instr_ptr + 1];
+        tos = 1;
+    } else {
+        instr_ptr += 2;
+        tos = stack[-- stack_ptr];
+    }
+    NEXT_INSTR
+
+    JMP_LABEL(JZP_WIDE)
+    if (tos) {
+        instr_ptr += 2;
+    } else {
+        instr_ptr += (int32_t)instrs[instr_ptr + 1];
+    }
+    tos = stack[-- stack_ptr];
+    NEXT_INSTR
+
+    JMP_LABEL(OUT)
+    assert(results != NULL);
+    ++ instr_ptr;
+    results[BYTECODE_UARG(word)] = tos;
+    tos = stack[-- stack_ptr];
+    NEXT_INSTR
+
+    JMP_LABEL(LOAD)
+    ++ instr_ptr;
+    stack[stack_ptr ++] = tos;
+    tos = temps[BYTECODE_UARG(word)];
+    NEXT_INSTR
+
+    JMP_LABEL(STORE)
+    ++ instr_ptr;
+    temps[BYTECODE_UARG(word)] = tos;
     NEXT_INSTR
 
     END_EXEC
@@ -726,37 +2130,309 @@ int bytecode_execute(const struct Bytecode *bytecode, const int *params, int *st
     return -1;
 }
 
+int bytecode_execute(const struct Bytecode *bytecode, const int *params, int *stack) {
+    return bytecode_run(bytecode, params, stack, NULL);
+}
+
+bool bytecode_execute_multi(const struct Bytecode *bytecode, const int *params, int *stack, int *results) {
+    if (bytecode->results_size == 0) {
+        errno = EINVAL;
+        return false;
+    }
+    bytecode_run(bytecode, params, stack, results);
+    return true;
+}
+
+// INSTR_<op> for the INSTR_<op>_INT, INSTR_<op>_INT_WIDE and INSTR_<op>_VAR
+// instructions, indexed by the offset from INSTR_ADD_<form>
+static const enum Instr ARG_BASE_INSTRS[] = {
+    INSTR_ADD, INSTR_SUB, INSTR_MUL, INSTR_DIV, INSTR_MOD,
+    INSTR_BIT_AND, INSTR_BIT_XOR, INSTR_BIT_OR,
+    INSTR_LT, INSTR_LE, INSTR_GT, INSTR_GE, INSTR_EQ, INSTR_NE,
+    INSTR_LSHIFT, INSTR_RSHIFT,
+};
+
+// Fails with EDOM instead of trapping for a division by 0 or INT_MIN / -1.
+static bool bytecode_binary_op(enum Instr instr, int lhs, int rhs, int *result) {
+    if ((instr == INSTR_DIV || instr == INSTR_MOD) && (rhs == 0 || (lhs == INT32_MIN && rhs == -1))) {
+        errno = EDOM;
+        return false;
+    }
+
+    switch (instr) {
+        case INSTR_ADD:     *result = lhs +  rhs; break;
+        case INSTR_SUB:     *result = lhs -  rhs; break;
+        case INSTR_MUL:     *result = lhs *  rhs; break;
+        case INSTR_DIV:     *result = lhs /  rhs; break;
+        case INSTR_MOD:     *result = lhs %  rhs; break;
+        case INSTR_BIT_AND: *result = lhs &  rhs; break;
+        case INSTR_BIT_XOR: *result = lhs ^  rhs; break;
+        case INSTR_BIT_OR:  *result = lhs |  rhs; break;
+        case INSTR_LT:      *result = lhs <  rhs; break;
+        case INSTR_LE:      *result = lhs <= rhs; break;
+        case INSTR_GT:      *result = lhs >  rhs; break;
+        case INSTR_GE:      *result = lhs >= rhs; break;
+        case INSTR_EQ:      *result = lhs == rhs; break;
+        case INSTR_NE:      *result = lhs != rhs; break;
+        case INSTR_LSHIFT:  *result = lhs << rhs; break;
+        case INSTR_RSHIFT:  *result = lhs >> rhs; break;
+        default:
+            assert(false);
+            *result = 0;
+            break;
+    }
+    return true;
+}
+
+// Interpreter for unverified bytecode. Every instruction is checked before it
+// is executed: instruction pointer, encoding, parameter index, stack bounds
+// and jump targets. Only forward jumps are allowed so the execution always
+// terminates. Arithmetic is the same as in bytecode_execute(), except that
+// divisions which would trap fail with EDOM.
+static bool bytecode_execute_unverified(const struct Bytecode *bytecode, const int *params, int *stack, int *result) {
+    const uint32_t *instrs = bytecode->instrs;
+    const size_t instrs_size = bytecode->instrs_size;
+    const size_t temps_size = bytecode->temps_size;
+    size_t instr_ptr = 0;
+    size_t stack_ptr = 0;
+
+    if (temps_size > bytecode->stack_size) {
+        errno = EINVAL;
+        return false;
+    }
+
+    const size_t stack_size = bytecode->stack_size - temps_size;
+    int *temps = stack + stack_size;
+
+    while (instr_ptr < instrs_size) {
+        const uint32_t word = instrs[instr_ptr];
+        enum Instr instr = BYTECODE_INSTR(word);
+
+        if (instr >= INSTR_COUNT || INSTR_SIZE(instr) > instrs_size - instr_ptr) {
+            break;
+        }
+
+        int arg;
+        if (IS_VAR_INSTR(instr) || instr == INSTR_JZP_VAR) {
+            if (BYTECODE_UARG(word) >= bytecode->params_size) {
+                break;
+            }
+            arg = params[BYTECODE_UARG(word)];
+        } else if (instr == INSTR_VAR_WIDE) {
+            if (instrs[instr_ptr + 1] >= bytecode->params_size) {
+                break;
+            }
+            arg = params[instrs[instr_ptr + 1]];
+        } else if (instr == INSTR_LOAD || instr == INSTR_STORE) {
+            if (BYTECODE_UARG(word) >= temps_size) {
+                break;
+            }
+            arg = BYTECODE_UARG(word);
+        } else if (IS_INT_WIDE_INSTR(instr)) {
+            arg = (int32_t)instrs[instr_ptr + 1];
+        } else {
+            arg = BYTECODE_ARG(word);
+        }
+
+        size_t target = 0;
+        if (bytecode_get_jump_target(bytecode, instr_ptr, &target) && (target <= instr_ptr || target >= instrs_size)) {
+            break;
+        }
+
+        size_t next_instr_ptr = instr_ptr + INSTR_SIZE(instr);
+
+        // the wide jumps only differ in the encoding of the offset
+        if (IS_WIDE_JUMP_INSTR(instr)) {
+            instr = NARROW_JUMP_INSTR(instr);
+        }
+
+        switch (instr) {
+            case INSTR_INT:
+            case INSTR_INT_WIDE:
+            case INSTR_VAR:
+            case INSTR_VAR_WIDE:
+                if (stack_ptr >= stack_size) {
+                    goto error;
+                }
+                stack[stack_ptr ++] = arg;
+                break;
+
+            case INSTR_NEG:
+            case INSTR_BIT_NEG:
+            case INSTR_NOT:
+            case INSTR_BOOL:
+                if (stack_ptr < 1) {
+                    goto error;
+                }
+                stack[stack_ptr - 1] =
+                    instr == INSTR_NEG     ? -stack[stack_ptr - 1] :
+                    instr == INSTR_BIT_NEG ? ~stack[stack_ptr - 1] :
+                    instr == INSTR_NOT     ? !stack[stack_ptr - 1] :
+                                             stack[stack_ptr - 1] != 0;
+                break;
+
+            case INSTR_JMP:
+                next_instr_ptr = target;
+                break;
+
+            case INSTR_JEZ:
+            case INSTR_JNZ:
+                if (stack_ptr < 1) {
+                    goto error;
+                }
+                if ((stack[stack_ptr - 1] != 0) == (instr == INSTR_JNZ)) {
+                    stack[stack_ptr - 1] = instr == INSTR_JNZ;
+                    next_instr_ptr = target;
+                } else {
+                    -- stack_ptr;
+                }
+                break;
+
+            case INSTR_JZP:
+                if (stack_ptr < 1) {
+                    goto error;
+                }
+                -- stack_ptr;
+                if (!stack[stack_ptr]) {
+                    next_instr_ptr = target;
+                }
+                break;
+
+            case INSTR_JZP_LT:
+            case INSTR_JZP_LE:
+            case INSTR_JZP_GT:
+            case INSTR_JZP_GE:
+            case INSTR_JZP_EQ:
+            case INSTR_JZP_NE:
+                if (stack_ptr < 2) {
+                    goto error;
+                }
+                stack_ptr -= 2;
+                // comparisons don't fail, the popped slot takes the condition
+                bytecode_binary_op(INSTR_LT + (instr - INSTR_JZP_LT), stack[stack_ptr], stack[stack_ptr + 1], &stack[stack_ptr]);
+                if (!stack[stack_ptr]) {
+                    next_instr_ptr = target;
+                }
+                break;
+
+            case INSTR_JZP_VAR:
+                if (!arg) {
+                    next_instr_ptr = target;
+                }
+                break;
+
+            case INSTR_RET:
+                if (stack_ptr != 1) {
+                    goto error;
+                }
+                *result = stack[0];
+                return true;
+
+            case INSTR_RET_INT:
+            case INSTR_RET_INT_WIDE:
+            case INSTR_RET_VAR:
+                if (stack_ptr != 0) {
+                    goto error;
+                }
+                *result = arg;
+                return true;
+
+            case INSTR_OUT:
+                goto error;
+
+            case INSTR_LOAD:
+                if (stack_ptr >= stack_size) {
+                    goto error;
+                }
+                stack[stack_ptr ++] = temps[arg];
+                break;
+
+            case INSTR_STORE:
+                if (stack_ptr < 1) {
+                    goto error;
+                }
+                temps[arg] = stack[stack_ptr - 1];
+                break;
+
+            default:
+                if (instr < INSTR_ADD_INT) {
+                    if (stack_ptr < 2) {
+                        goto error;
+                    }
+                    -- stack_ptr;
+                    if (!bytecode_binary_op(instr, stack[stack_ptr - 1], stack[stack_ptr], &stack[stack_ptr - 1])) {
+                        return false;
+                    }
+                } else {
+                    if (stack_ptr < 1) {
+                        goto error;
+                    }
+                    size_t offset =
+                        instr >= INSTR_ADD_INT_WIDE ? instr - INSTR_ADD_INT_WIDE :
+                        instr >= INSTR_ADD_VAR      ? instr - INSTR_ADD_VAR :
+                                                      instr - INSTR_ADD_INT;
+                    if (!bytecode_binary_op(ARG_BASE_INSTRS[offset], stack[stack_ptr - 1], arg, &stack[stack_ptr - 1])) {
+                        return false;
+                    }
+                }
+                break;
+        }
+
+        instr_ptr = next_instr_ptr;
+    }
+
+error:
+    errno = EINVAL;
+    return false;
+}
+
+bool bytecode_execute_checked(const struct Bytecode *bytecode, const int *params, int *stack, int *result) {
+    if (bytecode->results_size > 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    if (bytecode->verified) {
+        *result = bytecode_execute(bytecode, params, stack);
+        return true;
+    }
+    return bytecode_execute_unverified(bytecode, params, stack, result);
+}
+
 bool bytecode_clone(const struct Bytecode *src, struct Bytecode *dest) {
-    uint8_t *instrs = malloc(src->instrs_capacity);
+    uint32_t *instrs = malloc(src->instrs_capacity * sizeof(uint32_t));
 
-    if (instrs == NULL) {
+    if (instrs == NULL && src->instrs_capacity > 0) {
         return false;
     }
 
-    memcpy(instrs, src->instrs, src->instrs_size);
+    // memcpy() and memset() need valid pointers even for a size of 0
+    if (src->instrs_size > 0) {
+        memcpy(instrs, src->instrs, src->instrs_size * sizeof(uint32_t));
+    }
 
 #ifndef NDEBUG
     // mark rest as illegal instructions
-    memset(instrs + src->instrs_size, 0xFF, src->instrs_capacity - src->instrs_size);
+    if (src->instrs_capacity > src->instrs_size) {
+        memset(instrs + src->instrs_size, 0xFF, (src->instrs_capacity - src->instrs_size) * sizeof(uint32_t));
+    }
 #endif
 
-    char **params = calloc(src->params_capacity, sizeof(char*));
+    const struct Symbol **params = calloc(src->params_capacity, sizeof(struct Symbol*));
+    struct ParamIndexEntry *param_index = calloc(src->param_index_capacity, sizeof(struct ParamIndexEntry));
 
-    if (params == NULL) {
+    if ((params == NULL && src->params_capacity > 0) || (param_index == NULL && src->param_index_capacity > 0)) {
         free(instrs);
-        return NULL;
+        free(params);
+        free(param_index);
+        return false;
     }
 
-    for (size_t index = 0; index < src->params_size; ++ index) {
-        char *param = params[index] = strdup(src->params[index]);
-        if (param == NULL) {
-            while (index > 0) {
-                free(params[-- index]);
-            }
-            free(params);
-            free(instrs);
-            return NULL;
-        }
+    if (src->params_size > 0) {
+        memcpy(params, src->params, src->params_size * sizeof(struct Symbol*));
+    }
+    if (src->param_index_capacity > 0) {
+        memcpy(param_index, src->param_index, src->param_index_capacity * sizeof(struct ParamIndexEntry));
     }
 
     dest->instrs          = instrs;
@@ -767,32 +2443,43 @@ bool bytecode_clone(const struct Bytecode *src, struct Bytecode *dest) {
     dest->params_size     = src->params_size;
     dest->params_capacity = src->params_capacity;
 
-    dest->stack_size = src->stack_size;
+    dest->param_index          = param_index;
+    dest->param_index_capacity = src->param_index_capacity;
+
+    dest->stack_size   = src->stack_size;
+    dest->temps_size   = src->temps_size;
+    dest->results_size = src->results_size;
+    dest->verified     = src->verified;
 
     return true;
 }
 
 void bytecode_clear(struct Bytecode *bytecode) {
-    for (size_t index = 0; index < bytecode->params_size; ++ index) {
-        free(bytecode->params[index]);
-    }
-
 #ifndef NDEBUG
-    memset(bytecode->params, 0x00, bytecode->params_capacity * sizeof(*bytecode->params));
-    memset(bytecode->instrs, 0xFF, bytecode->instrs_capacity * sizeof(*bytecode->instrs));
+    if (bytecode->params_capacity > 0) {
+        memset(bytecode->params, 0x00, bytecode->params_capacity * sizeof(*bytecode->params));
+    }
+    if (bytecode->instrs_capacity > 0) {
+        memset(bytecode->instrs, 0xFF, bytecode->instrs_capacity * sizeof(*bytecode->instrs));
+    }
 #endif
 
-    bytecode->instrs_size = 0;
-    bytecode->params_size = 0;
-    bytecode->stack_size  = 0;
+    if (bytecode->params_size > 0) {
+        memset(bytecode->param_index, 0x00, bytecode->param_index_capacity * sizeof(*bytecode->param_index));
+    }
+
+    bytecode->instrs_size  = 0;
+    bytecode->params_size  = 0;
+    bytecode->stack_size   = 0;
+    bytecode->temps_size   = 0;
+    bytecode->results_size = 0;
+    bytecode->verified     = false;
 }
 
 void bytecode_free(struct Bytecode *bytecode) {
     free(bytecode->instrs);
-    for (size_t index = 0; index < bytecode->params_size; ++ index) {
-        free(bytecode->params[index]);
-    }
     free(bytecode->params);
+    free(bytecode->param_index);
 
     *bytecode = (struct Bytecode)BYTECODE_INIT();
 }
@@ -806,12 +2493,13 @@ int *bytecode_alloc_stack(const struct Bytecode *bytecode) {
 }
 
 ptrdiff_t bytecode_get_param_index(const struct Bytecode *bytecode, const char *name) {
-    for (size_t index = 0; index < bytecode->params_size; ++ index) {
-        if (strcmp(bytecode->params[index], name) == 0) {
-            return index;
-        }
+    if (bytecode->param_index_capacity == 0) {
+        return -1;
     }
-    return -1;
+
+    const size_t length = strlen(name);
+    const size_t slot = bytecode_param_slot(bytecode, symbol_hash(name, length), name, length);
+    return (ptrdiff_t)bytecode->param_index[slot].index - 1;
 }
 
 bool bytecode_set_param(const struct Bytecode *bytecode, int *params, const char *name, int value) {
@@ -824,166 +2512,285 @@ bool bytecode_set_param(const struct Bytecode *bytecode, int *params, const char
 }
 
 void bytecode_print(const struct Bytecode *bytecode, FILE *stream) {
-    int value;
-    size_t addr;
-    const uint8_t *instrs = bytecode->instrs;
+    const uint32_t *instrs = bytecode->instrs;
     fprintf(stream, "stack_size: %" PRIuPTR "\n", bytecode->stack_size);
+    fprintf(stream, "temps_size: %" PRIuPTR "\n", bytecode->temps_size);
 
     fprintf(stream, "parameters:\n");
     for (size_t param_index = 0; param_index < bytecode->params_size; ++ param_index) {
-        fprintf(stream, "%6" PRIuPTR ": %s\n", param_index, bytecode->params[param_index]);
+        fprintf(stream, "%6" PRIuPTR ": %s\n", param_index, bytecode->params[param_index]->name);
     }
 
     fprintf(stream, "instructions:\n");
     for (size_t instr_ptr = 0; instr_ptr < bytecode->instrs_size;) {
-        switch (instrs[instr_ptr]) {
+        const uint32_t word = instrs[instr_ptr];
+        const char *name = bytecode_instr_name(BYTECODE_INSTR(word));
+        size_t target = 0;
+
+        switch (BYTECODE_INSTR(word)) {
         case INSTR_INT:
-            memcpy(&value, instrs + instr_ptr + 1, sizeof(int));
-            fprintf(stream, "%6" PRIuPTR ": int %d\n", instr_ptr, value);
+        case INSTR_ADD_INT:
+        case INSTR_SUB_INT:
+        case INSTR_MUL_INT:
+        case INSTR_DIV_INT:
+        case INSTR_MOD_INT:
+        case INSTR_BIT_AND_INT:
+        case INSTR_BIT_XOR_INT:
+        case INSTR_BIT_OR_INT:
+        case INSTR_LT_INT:
+        case INSTR_LE_INT:
+        case INSTR_GT_INT:
+        case INSTR_GE_INT:
+        case INSTR_EQ_INT:
+        case INSTR_NE_INT:
+        case INSTR_LSHIFT_INT:
+        case INSTR_RSHIFT_INT:
+        case INSTR_RET_INT:
+            fprintf(stream, "%6" PRIuPTR ": %s %d\n", instr_ptr, name, BYTECODE_ARG(word));
             ++ instr_ptr;
-            instr_ptr += sizeof(int);
             break;
 
-        case INSTR_VAR:
-            memcpy(&addr, instrs + instr_ptr + 1, sizeof(addr));
-            fprintf(stream, "%6" PRIuPTR ": var %s\n", instr_ptr, bytecode->params[addr]);
-            ++ instr_ptr;
-            instr_ptr += sizeof(addr);
+        case INSTR_INT_WIDE:
+        case INSTR_ADD_INT_WIDE:
+        case INSTR_SUB_INT_WIDE:
+        case INSTR_MUL_INT_WIDE:
+        case INSTR_DIV_INT_WIDE:
+        case INSTR_MOD_INT_WIDE:
+        case INSTR_BIT_AND_INT_WIDE:
+        case INSTR_BIT_XOR_INT_WIDE:
+        case INSTR_BIT_OR_INT_WIDE:
+        case INSTR_LT_INT_WIDE:
+        case INSTR_LE_INT_WIDE:
+        case INSTR_GT_INT_WIDE:
+        case INSTR_GE_INT_WIDE:
+        case INSTR_EQ_INT_WIDE:
+        case INSTR_NE_INT_WIDE:
+        case INSTR_LSHIFT_INT_WIDE:
+        case INSTR_RSHIFT_INT_WIDE:
+        case INSTR_RET_INT_WIDE:
+            fprintf(stream, "%6" PRIuPTR ": %s %d\n", instr_ptr, name, (int32_t)instrs[instr_ptr + 1]);
+            instr_ptr += 2;
             break;
 
-        case INSTR_ADD:
-            fprintf(stream, "%6" PRIuPTR ": add\n", instr_ptr);
+        case INSTR_VAR:
+        case INSTR_ADD_VAR:
+        case INSTR_SUB_VAR:
+        case INSTR_MUL_VAR:
+        case INSTR_DIV_VAR:
+        case INSTR_MOD_VAR:
+        case INSTR_BIT_AND_VAR:
+        case INSTR_BIT_XOR_VAR:
+        case INSTR_BIT_OR_VAR:
+        case INSTR_LT_VAR:
+        case INSTR_LE_VAR:
+        case INSTR_GT_VAR:
+        case INSTR_GE_VAR:
+        case INSTR_EQ_VAR:
+        case INSTR_NE_VAR:
+        case INSTR_LSHIFT_VAR:
+        case INSTR_RSHIFT_VAR:
+        case INSTR_RET_VAR:
+            fprintf(stream, "%6" PRIuPTR ": %s %s\n", instr_ptr, name, bytecode->params[BYTECODE_UARG(word)]->name);
             ++ instr_ptr;
             break;
 
-        case INSTR_SUB:
-            fprintf(stream, "%6" PRIuPTR ": sub\n", instr_ptr);
-            ++ instr_ptr;
+        case INSTR_VAR_WIDE:
+            fprintf(stream, "%6" PRIuPTR ": %s %s\n", instr_ptr, name, bytecode->params[instrs[instr_ptr + 1]]->name);
+            instr_ptr += 2;
             break;
 
+        case INSTR_ADD:
+        case INSTR_SUB:
         case INSTR_MUL:
-            fprintf(stream, "%6" PRIuPTR ": mul\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_DIV:
-            fprintf(stream, "%6" PRIuPTR ": div\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_MOD:
-            fprintf(stream, "%6" PRIuPTR ": mod\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_BIT_AND:
-            fprintf(stream, "%6" PRIuPTR ": bit_and\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_BIT_XOR:
-            fprintf(stream, "%6" PRIuPTR ": bit_xor\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_BIT_OR:
-            fprintf(stream, "%6" PRIuPTR ": bit_or\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_LT:
-            fprintf(stream, "%6" PRIuPTR ": lt\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_LE:
-            fprintf(stream, "%6" PRIuPTR ": le\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_GT:
-            fprintf(stream, "%6" PRIuPTR ": gt\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_GE:
-            fprintf(stream, "%6" PRIuPTR ": ge\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_EQ:
-            fprintf(stream, "%6" PRIuPTR ": eq\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_NE:
-            fprintf(stream, "%6" PRIuPTR ": ne\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_NEG:
-            fprintf(stream, "%6" PRIuPTR ": neg\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_BIT_NEG:
-            fprintf(stream, "%6" PRIuPTR ": bit_neg\n", instr_ptr);
-            ++ instr_ptr;
-            break;
-
         case INSTR_NOT:
-            fprintf(stream, "%6" PRIuPTR ": not\n", instr_ptr);
+        case INSTR_BOOL:
+        case INSTR_LSHIFT:
+        case INSTR_RSHIFT:
+        case INSTR_RET:
+            fprintf(stream, "%6" PRIuPTR ": %s\n", instr_ptr, name);
             ++ instr_ptr;
             break;
 
         case INSTR_JMP:
-            memcpy(&addr, instrs + instr_ptr + 1, sizeof(instr_ptr));
-            fprintf(stream, "%6" PRIuPTR ": jmp %" PRIuPTR "\n", instr_ptr, addr);
-            instr_ptr += 1 + sizeof(addr);
-            break;
-
         case INSTR_JEZ:
-            memcpy(&addr, instrs + instr_ptr + 1, sizeof(instr_ptr));
-            fprintf(stream, "%6" PRIuPTR ": jez %" PRIuPTR "\n", instr_ptr, addr);
-            instr_ptr += 1 + sizeof(addr);
-            break;
-
         case INSTR_JNZ:
-            memcpy(&addr, instrs + instr_ptr + 1, sizeof(instr_ptr));
-            fprintf(stream, "%6" PRIuPTR ": jnz %" PRIuPTR "\n", instr_ptr, addr);
-            instr_ptr += 1 + sizeof(addr);
-            break;
-
         case INSTR_JZP:
-            memcpy(&addr, instrs + instr_ptr + 1, sizeof(instr_ptr));
-            fprintf(stream, "%6" PRIuPTR ": jzp %" PRIuPTR "\n", instr_ptr, addr);
-            instr_ptr += 1 + sizeof(addr);
-            break;
-
-        case INSTR_BOOL:
-            fprintf(stream, "%6" PRIuPTR ": bool\n", instr_ptr);
+        case INSTR_JZP_LT:
+        case INSTR_JZP_LE:
+        case INSTR_JZP_GT:
+        case INSTR_JZP_GE:
+        case INSTR_JZP_EQ:
+        case INSTR_JZP_NE:
+            bytecode_get_jump_target(bytecode, instr_ptr, &target);
+            fprintf(stream, "%6" PRIuPTR ": %s %" PRIuPTR "\n", instr_ptr, name, target);
             ++ instr_ptr;
             break;
 
-        case INSTR_LSHIFT:
-            fprintf(stream, "%6" PRIuPTR ": lshift\n", instr_ptr);
-            ++ instr_ptr;
+        case INSTR_JMP_WIDE:
+        case INSTR_JEZ_WIDE:
+        case INSTR_JNZ_WIDE:
+        case INSTR_JZP_WIDE:
+            bytecode_get_jump_target(bytecode, instr_ptr, &target);
+            fprintf(stream, "%6" PRIuPTR ": %s %" PRIuPTR "\n", instr_ptr, name, target);
+            instr_ptr += 2;
             break;
 
-        case INSTR_RSHIFT:
-            fprintf(stream, "%6" PRIuPTR ": rshift\n", instr_ptr);
-            ++ instr_ptr;
+        case INSTR_JZP_VAR:
+            bytecode_get_jump_target(bytecode, instr_ptr, &target);
+            fprintf(stream, "%6" PRIuPTR ": %s %s %" PRIuPTR "\n", instr_ptr, name, bytecode->params[BYTECODE_UARG(word)]->name, target);
+            instr_ptr += 2;
             break;
 
-        case INSTR_RET:
-            fprintf(stream, "%6" PRIuPTR ": ret\n", instr_ptr);
+        case INSTR_OUT:
+        case INSTR_LOAD:
+        case INSTR_STORE:
+            fprintf(stream, "%6" PRIuPTR ": %s %" PRIu32 "\n", instr_ptr, name, BYTECODE_UARG(word));
             ++ instr_ptr;
             break;
 
         default:
-            fprintf(stream, "%6" PRIuPTR ": illegal instruction %d\n", instr_ptr, instrs[instr_ptr]);
+            fprintf(stream, "%6" PRIuPTR ": illegal instruction 0x%08" PRIx32 "\n", instr_ptr, word);
             ++ instr_ptr;
             break;
         }
     }
 }
+
+size_t bytecode_instr_size(enum Instr instr) {
+    return INSTR_SIZE(instr);
+}
+
+static const char *INSTR_NAMES[INSTR_COUNT] = {
+    [INSTR_INT]     = "int",
+    [INSTR_VAR]     = "var",
+    [INSTR_ADD]     = "add",
+    [INSTR_SUB]     = "sub",
+    [INSTR_MUL]     = "mul",
+    [INSTR_DIV]     = "div",
+    [INSTR_MOD]     = "mod",
+    [INSTR_BIT_AND] = "bit_and",
+    [INSTR_BIT_XOR] = "bit_xor",
+    [INSTR_BIT_OR]  = "bit_or",
+    [INSTR_LT]      = "lt",
+    [INSTR_LE]      = "le",
+    [INSTR_GT]      = "gt",
+    [INSTR_GE]      = "ge",
+    [INSTR_EQ]      = "eq",
+    [INSTR_NE]      = "ne",
+    [INSTR_NEG]     = "neg",
+    [INSTR_BIT_NEG] = "bit_neg",
+    [INSTR_NOT]     = "not",
+    [INSTR_JMP]     = "jmp",
+    [INSTR_JEZ]     = "jez",
+    [INSTR_JNZ]     = "jnz",
+    [INSTR_JZP]     = "jzp",
+    [INSTR_BOOL]    = "bool",
+    [INSTR_LSHIFT]  = "lshift",
+    [INSTR_RSHIFT]  = "rshift",
+    [INSTR_RET]     = "ret",
+
+    [INSTR_ADD_INT] = "add_int",
+    [INSTR_SUB_INT] = "sub_int",
+    [INSTR_MUL_INT] = "mul_int",
+    [INSTR_DIV_INT] = "div_int",
+    [INSTR_MOD_INT] = "mod_int",
+    [INSTR_BIT_AND_INT] = "bit_and_int",
+    [INSTR_BIT_XOR_INT] = "bit_xor_int",
+    [INSTR_BIT_OR_INT] = "bit_or_int",
+    [INSTR_LT_INT] = "lt_int",
+    [INSTR_LE_INT] = "le_int",
+    [INSTR_GT_INT] = "gt_int",
+    [INSTR_GE_INT] = "ge_int",
+    [INSTR_EQ_INT] = "eq_int",
+    [INSTR_NE_INT] = "ne_int",
+    [INSTR_LSHIFT_INT] = "lshift_int",
+    [INSTR_RSHIFT_INT] = "rshift_int",
+    [INSTR_ADD_VAR] = "add_var",
+    [INSTR_SUB_VAR] = "sub_var",
+    [INSTR_MUL_VAR] = "mul_var",
+    [INSTR_DIV_VAR] = "div_var",
+    [INSTR_MOD_VAR] = "mod_var",
+    [INSTR_BIT_AND_VAR] = "bit_and_var",
+    [INSTR_BIT_XOR_VAR] = "bit_xor_var",
+    [INSTR_BIT_OR_VAR] = "bit_or_var",
+    [INSTR_LT_VAR] = "lt_var",
+    [INSTR_LE_VAR] = "le_var",
+    [INSTR_GT_VAR] = "gt_var",
+    [INSTR_GE_VAR] = "ge_var",
+    [INSTR_EQ_VAR] = "eq_var",
+    [INSTR_NE_VAR] = "ne_var",
+    [INSTR_LSHIFT_VAR] = "lshift_var",
+    [INSTR_RSHIFT_VAR] = "rshift_var",
+    [INSTR_JZP_LT]  = "jzp_lt",
+    [INSTR_JZP_LE]  = "jzp_le",
+    [INSTR_JZP_GT]  = "jzp_gt",
+    [INSTR_JZP_GE]  = "jzp_ge",
+    [INSTR_JZP_EQ]  = "jzp_eq",
+    [INSTR_JZP_NE]  = "jzp_ne",
+    [INSTR_JZP_VAR] = "jzp_var",
+    [INSTR_RET_INT] = "ret_int",
+    [INSTR_RET_VAR] = "ret_var",
+
+    [INSTR_INT_WIDE] = "int_wide",
+    [INSTR_ADD_INT_WIDE] = "add_int_wide",
+    [INSTR_SUB_INT_WIDE] = "sub_int_wide",
+    [INSTR_MUL_INT_WIDE] = "mul_int_wide",
+    [INSTR_DIV_INT_WIDE] = "div_int_wide",
+    [INSTR_MOD_INT_WIDE] = "mod_int_wide",
+    [INSTR_BIT_AND_INT_WIDE] = "bit_and_int_wide",
+    [INSTR_BIT_XOR_INT_WIDE] = "bit_xor_int_wide",
+    [INSTR_BIT_OR_INT_WIDE] = "bit_or_int_wide",
+    [INSTR_LT_INT_WIDE] = "lt_int_wide",
+    [INSTR_LE_INT_WIDE] = "le_int_wide",
+    [INSTR_GT_INT_WIDE] = "gt_int_wide",
+    [INSTR_GE_INT_WIDE] = "ge_int_wide",
+    [INSTR_EQ_INT_WIDE] = "eq_int_wide",
+    [INSTR_NE_INT_WIDE] = "ne_int_wide",
+    [INSTR_LSHIFT_INT_WIDE] = "lshift_int_wide",
+    [INSTR_RSHIFT_INT_WIDE] = "rshift_int_wide",
+    [INSTR_RET_INT_WIDE] = "ret_int_wide",
+
+    [INSTR_VAR_WIDE] = "var_wide",
+    [INSTR_JMP_WIDE] = "jmp_wide",
+    [INSTR_JEZ_WIDE] = "jez_wide",
+    [INSTR_JNZ_WIDE] = "jnz_wide",
+    [INSTR_JZP_WIDE] = "jzp_wide",
+
+    [INSTR_OUT] = "out",
+
+    [INSTR_LOAD]  = "load",
+    [INSTR_STORE] = "store",
+};
+
+const char *bytecode_instr_name(enum Instr instr) {
+    if ((size_t)instr >= INSTR_COUNT || INSTR_NAMES[instr] == NULL) {
+        return "(illegal)";
+    }
+    return INSTR_NAMES[instr];
+}
+
+bool bytecode_get_jump_target(const struct Bytecode *bytecode, size_t instr_ptr, size_t *target) {
+    uint32_t word = bytecode->instrs[instr_ptr];
+    enum Instr instr = BYTECODE_INSTR(word);
+    if (HAS_WIDE_OFFSET(instr)) {
+        *target = instr_ptr + (int32_t)bytecode->instrs[instr_ptr + 1];
+        return true;
+    } else if (IS_JUMP_INSTR(instr)) {
+        *target = instr_ptr + BYTECODE_ARG(word);
+        return true;
+    }
+    return false;
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ast.h"
+#include "parser_error.h"
 
 #include <stddef.h>
 #include <stdio.h>
@@ -13,6 +14,11 @@
 extern "C" {
 #endif
 
+// Instructions are encoded as 32-bit words with the opcode in the low 8 bits
+// and a signed or unsigned 24-bit argument (constant, parameter index or jump
+// offset) in the upper 24 bits. Jump offsets are relative to the index of the
+// jump instruction and counted in words. Only the *_INT_WIDE and *_WIDE jump
+// instructions, INSTR_VAR_WIDE and INSTR_JZP_VAR use a second word.
 enum Instr {
     INSTR_INT,
     INSTR_VAR,
@@ -41,41 +47,205 @@ enum Instr {
     INSTR_LSHIFT,
     INSTR_RSHIFT,
     INSTR_RET,
+
+    // Superinstructions. The <op>_INT and <op>_VAR forms take their right hand
+    // side operand from the instruction instead of the stack.
+    INSTR_ADD_INT,
+    INSTR_SUB_INT,
+    INSTR_MUL_INT,
+    INSTR_DIV_INT,
+    INSTR_MOD_INT,
+    INSTR_BIT_AND_INT,
+    INSTR_BIT_XOR_INT,
+    INSTR_BIT_OR_INT,
+    INSTR_LT_INT,
+    INSTR_LE_INT,
+    INSTR_GT_INT,
+    INSTR_GE_INT,
+    INSTR_EQ_INT,
+    INSTR_NE_INT,
+    INSTR_LSHIFT_INT,
+    INSTR_RSHIFT_INT,
+
+    INSTR_ADD_VAR,
+    INSTR_SUB_VAR,
+    INSTR_MUL_VAR,
+    INSTR_DIV_VAR,
+    INSTR_MOD_VAR,
+    INSTR_BIT_AND_VAR,
+    INSTR_BIT_XOR_VAR,
+    INSTR_BIT_OR_VAR,
+    INSTR_LT_VAR,
+    INSTR_LE_VAR,
+    INSTR_GT_VAR,
+    INSTR_GE_VAR,
+    INSTR_EQ_VAR,
+    INSTR_NE_VAR,
+    INSTR_LSHIFT_VAR,
+    INSTR_RSHIFT_VAR,
+
+    // compare the two values on top of the stack, pop both and jump if the
+    // comparison is false
+    INSTR_JZP_LT,
+    INSTR_JZP_LE,
+    INSTR_JZP_GT,
+    INSTR_JZP_GE,
+    INSTR_JZP_EQ,
+    INSTR_JZP_NE,
+
+    INSTR_JZP_VAR, // jump if parameter equals zero, arguments: parameter index, jump target
+    INSTR_RET_INT, // return the argument, the stack is empty
+    INSTR_RET_VAR, // return the parameter, the stack is empty
+
+    // The *_INT_WIDE forms take the constant from the following word, they
+    // are used for constants that don't fit into 24 bits.
+    INSTR_INT_WIDE,
+    INSTR_ADD_INT_WIDE,
+    INSTR_SUB_INT_WIDE,
+    INSTR_MUL_INT_WIDE,
+    INSTR_DIV_INT_WIDE,
+    INSTR_MOD_INT_WIDE,
+    INSTR_BIT_AND_INT_WIDE,
+    INSTR_BIT_XOR_INT_WIDE,
+    INSTR_BIT_OR_INT_WIDE,
+    INSTR_LT_INT_WIDE,
+    INSTR_LE_INT_WIDE,
+    INSTR_GT_INT_WIDE,
+    INSTR_GE_INT_WIDE,
+    INSTR_EQ_INT_WIDE,
+    INSTR_NE_INT_WIDE,
+    INSTR_LSHIFT_INT_WIDE,
+    INSTR_RSHIFT_INT_WIDE,
+    INSTR_RET_INT_WIDE,
+
+    // Same as INSTR_VAR and the jumps, but the parameter index or the jump
+    // offset is the following word. Used for parameter indices that don't fit
+    // into 24 bits and for code too long for 24-bit jump offsets.
+    INSTR_VAR_WIDE,
+    INSTR_JMP_WIDE,
+    INSTR_JEZ_WIDE,
+    INSTR_JNZ_WIDE,
+    INSTR_JZP_WIDE,
+
+    INSTR_OUT, // pop the stack into the result with the index of the argument, only for bytecode_execute_multi()
+
+    // Temporaries hold the values of common subexpressions, the argument is the
+    // index of the temporary.
+    INSTR_LOAD,  // push the temporary
+    INSTR_STORE, // copy the top of the stack into the temporary, the stack is unchanged
+};
+
+#define INSTR_COUNT (INSTR_STORE + 1)
+
+#define BYTECODE_INSTR(WORD) ((enum Instr)((WORD) & 0xFF))
+#define BYTECODE_ARG(WORD)   ((int32_t)(WORD) >> 8)
+#define BYTECODE_UARG(WORD)  ((uint32_t)(WORD) >> 8)
+#define BYTECODE_WORD(INSTR, ARG) ((uint32_t)(INSTR) | ((uint32_t)(ARG) << 8))
+
+#define BYTECODE_ARG_MIN  (-(INT32_C(1) << 23))
+#define BYTECODE_ARG_MAX  ((INT32_C(1) << 23) - 1)
+#define BYTECODE_UARG_MAX ((UINT32_C(1) << 24) - 1)
+
+struct ParamIndexEntry {
+    uint32_t hash;  // of the symbol
+    uint32_t index; // parameter index + 1, 0 for a free slot
 };
 
 struct Bytecode {
-    uint8_t *instrs;
-    size_t instrs_size;
-    size_t instrs_capacity;
+    uint32_t *instrs;
+    size_t instrs_size;     // in words
+    size_t instrs_capacity; // in words
 
-    char **params;
+    const struct Symbol **params;
     size_t params_size;
     size_t params_capacity;
 
+    // Parameters by the hash of their name, so they can be looked up by name
+    // without a symbol table. Open addressing with linear probing, the
+    // capacity is a power of two and the table is at most half full. Only
+    // maintained for compiled parameters.
+    struct ParamIndexEntry *param_index;
+    size_t param_index_capacity;
+
+    // includes the temporaries, which are the last temps_size entries
     size_t stack_size;
+    size_t temps_size;
+
+    // number of results of a program compiled with bytecode_compile_multi(),
+    // 0 for a single expression
+    size_t results_size;
+
+    // set by bytecode_verify(), reset by everything that changes the code
+    bool verified;
 };
 
-#define BYTECODE_INIT() {  \
-    .instrs = NULL,        \
-    .instrs_size = 0,      \
-    .instrs_capacity = 0,  \
-    .params = NULL,        \
-    .params_size = 0,      \
-    .params_capacity = 0,  \
-    .stack_size = 0,       \
+#define BYTECODE_INIT() {      \
+    .instrs = NULL,            \
+    .instrs_size = 0,          \
+    .instrs_capacity = 0,      \
+    .params = NULL,            \
+    .params_size = 0,          \
+    .params_capacity = 0,      \
+    .param_index = NULL,       \
+    .param_index_capacity = 0, \
+    .stack_size = 0,           \
+    .temps_size = 0,           \
+    .results_size = 0,         \
+    .verified = false,         \
 }
 
+// Rows per block of bytecode_execute_batch() and the number of stack frames
+// needed when splitting blocks (log2(BYTECODE_BATCH_SIZE) + 1).
+#define BYTECODE_BATCH_SIZE   256
+#define BYTECODE_BATCH_FRAMES   9
+
 bool bytecode_compile(struct Bytecode *bytecode, const struct AstNode *expr);
+/// Compiles expr with the parameters in params (sorted) fixed to their values,
+/// see ast_specialize(). Only the other variables remain parameters.
+bool bytecode_specialize(struct Bytecode *bytecode, const struct AstNode *expr, const struct Param params[], size_t param_count);
+/// Compiles count expressions into one program that shares the parameters of
+/// all expressions. Run it with bytecode_execute_multi().
+bool bytecode_compile_multi(struct Bytecode *bytecode, const struct AstNode *const exprs[], size_t count);
+/// Compiles the expression in a single pass while parsing it with the grammar
+/// of fast_parse(), without building an AST. Constants are folded, but common
+/// subexpressions are not shared. Sets error and returns false on error.
+/// The parameters are interned into symbols, which has to outlive bytecode.
+bool bytecode_compile_source(struct Bytecode *bytecode, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
 bool bytecode_clone(const struct Bytecode *src, struct Bytecode *dest);
 bool bytecode_optimize(struct Bytecode *bytecode);
+/// releases unused capacity, use after compiling bytecode that is kept around
+bool bytecode_shrink_to_fit(struct Bytecode *bytecode);
+/// Proves that the bytecode can be run by bytecode_execute(): all instructions
+/// are valid, jumps go forward to instruction boundaries, parameter indices
+/// are below params_size, temporaries are below temps_size, the stack depth is the same on all paths and never
+/// exceeds stack_size - temps_size and every path ends in a return. Marks the bytecode as
+/// verified, fails with EINVAL otherwise.
+bool bytecode_verify(struct Bytecode *bytecode);
+/// bytecode has to be well formed (compiled or verified), there are no checks
 int  bytecode_execute(const struct Bytecode *bytecode, const int *params, int *stack);
+/// Runs a program of bytecode_compile_multi() and writes results_size results.
+bool bytecode_execute_multi(const struct Bytecode *bytecode, const int *params, int *stack, int *results);
+/// Runs verified bytecode with bytecode_execute(), other bytecode with checks
+/// on every instruction. Fails with EINVAL for malformed bytecode and programs
+/// of bytecode_compile_multi(), and for unverified bytecode with EDOM on a
+/// division by 0 or INT_MIN / -1.
+bool bytecode_execute_checked(const struct Bytecode *bytecode, const int *params, int *stack, int *result);
+/// same as bytecode_execute(), but dispatches by tail calls between per instruction functions
+int  bytecode_execute_tailcall(const struct Bytecode *bytecode, const int *params, int *stack);
+/// params are columns, one per parameter, each with count values
+bool bytecode_execute_batch(const struct Bytecode *bytecode, const int *const params[], size_t count, int *results, int *stack);
 void bytecode_free(struct Bytecode *bytecode);
 void bytecode_clear(struct Bytecode *bytecode);
 ptrdiff_t bytecode_get_param_index(const struct Bytecode *bytecode, const char *name);
 bool bytecode_set_param(const struct Bytecode *bytecode, int *params, const char *name, int value);
 int *bytecode_alloc_params(const struct Bytecode *bytecode);
 int *bytecode_alloc_stack(const struct Bytecode *bytecode);
+int *bytecode_alloc_batch_stack(const struct Bytecode *bytecode);
 void bytecode_print(const struct Bytecode *bytecode, FILE *stream);
+size_t bytecode_instr_size(enum Instr instr);
+const char *bytecode_instr_name(enum Instr instr);
+/// returns false if the instruction at instr_ptr is no jump
+bool bytecode_get_jump_target(const struct Bytecode *bytecode, size_t instr_ptr, size_t *target);
 
 #ifdef __cplusplus
 }
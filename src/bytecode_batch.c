@@ -0,0 +1,459 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "bytecode.h"
+#include "batch_kernels.h"
+
+// Block-at-a-time bytecode interpreter.
+//
+// Each instruction is dispatched once for a whole block of rows. The stack
+// holds one column of BYTECODE_BATCH_SIZE values per stack slot and the
+// instruction handlers are simple loops over these columns.
+//
+// When the rows of a block disagree on a conditional jump the block is split:
+// the smaller group of rows is copied (compacted) into the next stack frame and
+// executed to completion, while the bigger group is compacted in place and
+// continues in the current frame. Because the smaller group is always at most
+// half of the rows no more than BYTECODE_BATCH_FRAMES frames are ever needed.
+// The rows of a compacted group are always dense, only VAR and RET need to map
+// lanes back to the original row indices. The temporaries are the last slots
+// of a frame and are compacted together with the stack.
+//
+// The arithmetic is done by the column kernels of batch_kernels.h, which are
+// selected at runtime depending on the CPU.
+
+struct BatchContext {
+    const struct Bytecode *bytecode;
+    const struct BatchKernels *kernels;
+    const int *const *params;
+    int *results;
+    int *stack;
+    size_t offset;
+    size_t frame_size;
+};
+
+#define SLOT(FRAME, INDEX) ((FRAME) + (INDEX) * BYTECODE_BATCH_SIZE)
+
+#define BATCH_BINARY(INSTR) \
+    ctx->kernels->binary[INSTR](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); \
+    -- stack_ptr; \
+    ++ instr_ptr;
+
+// right hand side operand from the instruction argument
+#define BATCH_BINARY_ARG(INSTR) \
+    batch_load_arg(ctx, instrs + instr_ptr, rows, count, operand); \
+    ctx->kernels->binary[INSTR](SLOT(frame, stack_ptr - 1), operand, count); \
+    instr_ptr += bytecode_instr_size(BYTECODE_INSTR(instrs[instr_ptr]));
+
+#define BATCH_UNARY(INSTR) \
+    ctx->kernels->unary[INSTR](SLOT(frame, stack_ptr - 1), count); \
+    ++ instr_ptr;
+
+static bool bytecode_execute_block(const struct BatchContext *ctx, size_t frame_index,
+                                   const uint16_t *rows, size_t count,
+                                   size_t instr_ptr, size_t stack_ptr);
+
+static void batch_load_var(const struct BatchContext *ctx, size_t addr, const uint16_t *rows, size_t count, int *dest) {
+    const int *column = ctx->params[addr] + ctx->offset;
+    if (rows == NULL) {
+        memcpy(dest, column, count * sizeof(int));
+    } else {
+        for (size_t lane = 0; lane < count; ++ lane) {
+            dest[lane] = column[rows[lane]];
+        }
+    }
+}
+
+// Loads the argument of an <op>_INT, <op>_INT_WIDE, <op>_VAR or INSTR_RET_*
+// instruction into a column.
+static void batch_load_arg(const struct BatchContext *ctx, const uint32_t *instr, const uint16_t *rows, size_t count, int *dest) {
+    const enum Instr opcode = BYTECODE_INSTR(*instr);
+    if (opcode == INSTR_RET_VAR || (opcode >= INSTR_ADD_VAR && opcode <= INSTR_RSHIFT_VAR)) {
+        batch_load_var(ctx, BYTECODE_UARG(*instr), rows, count, dest);
+    } else {
+        const int value = opcode >= INSTR_INT_WIDE && opcode <= INSTR_RET_INT_WIDE ?
+            (int32_t)instr[1] :
+            BYTECODE_ARG(*instr);
+        for (size_t lane = 0; lane < count; ++ lane) {
+            dest[lane] = value;
+        }
+    }
+}
+
+static void batch_compact_slot(int *dest_frame, const int *src_frame, size_t slot, const uint16_t *lanes, size_t lane_count) {
+    int *dest = SLOT(dest_frame, slot);
+    const int *src = SLOT(src_frame, slot);
+    // lanes are sorted, so this works in place too
+    for (size_t lane = 0; lane < lane_count; ++ lane) {
+        dest[lane] = src[lanes[lane]];
+    }
+}
+
+// Copies the lanes of the live stack slots and the temporaries, which are the
+// last temps_size slots of a frame.
+static void batch_compact(const struct BatchContext *ctx, int *dest_frame, const int *src_frame, size_t stack_ptr,
+                          const uint16_t *lanes, size_t lane_count) {
+    const size_t stack_size = ctx->bytecode->stack_size;
+
+    for (size_t slot = 0; slot < stack_ptr; ++ slot) {
+        batch_compact_slot(dest_frame, src_frame, slot, lanes, lane_count);
+    }
+
+    for (size_t slot = stack_size - ctx->bytecode->temps_size; slot < stack_size; ++ slot) {
+        batch_compact_slot(dest_frame, src_frame, slot, lanes, lane_count);
+    }
+}
+
+// Moves the lanes of a split into a dense group. Returns the row mapping of
+// the group, which is stored in lanes itself.
+static const uint16_t *batch_gather(const struct BatchContext *ctx, int *dest_frame, const int *src_frame, size_t stack_ptr,
+                                    const uint16_t *rows, uint16_t *lanes, size_t lane_count) {
+    batch_compact(ctx, dest_frame, src_frame, stack_ptr, lanes, lane_count);
+
+    if (rows != NULL) {
+        for (size_t lane = 0; lane < lane_count; ++ lane) {
+            lanes[lane] = rows[lanes[lane]];
+        }
+    }
+
+    return lanes;
+}
+
+// Splits the current group of rows into rows that take the jump and rows that
+// don't. Execution continues with the bigger group.
+static bool batch_split(const struct BatchContext *ctx, size_t frame_index, int *frame,
+                        const uint16_t **rows, uint16_t *rows_buf, size_t *count,
+                        uint16_t *jump_lanes, size_t jump_count, size_t jump_instr_ptr, size_t jump_stack_ptr,
+                        uint16_t *next_lanes, size_t next_count, size_t next_instr_ptr, size_t next_stack_ptr,
+                        size_t *instr_ptr, size_t *stack_ptr) {
+    uint16_t *small_lanes, *big_lanes;
+    size_t small_count, big_count;
+    size_t small_instr_ptr, big_instr_ptr;
+    size_t small_stack_ptr, big_stack_ptr;
+
+    if (jump_count < next_count) {
+        small_lanes = jump_lanes; small_count = jump_count; small_instr_ptr = jump_instr_ptr; small_stack_ptr = jump_stack_ptr;
+        big_lanes   = next_lanes; big_count   = next_count; big_instr_ptr   = next_instr_ptr; big_stack_ptr   = next_stack_ptr;
+    } else {
+        small_lanes = next_lanes; small_count = next_count; small_instr_ptr = next_instr_ptr; small_stack_ptr = next_stack_ptr;
+        big_lanes   = jump_lanes; big_count   = jump_count; big_instr_ptr   = jump_instr_ptr; big_stack_ptr   = jump_stack_ptr;
+    }
+
+    if (frame_index + 1 >= BYTECODE_BATCH_FRAMES) {
+        assert(false);
+        errno = EINVAL;
+        return false;
+    }
+
+    int *next_frame = frame + ctx->frame_size;
+    const uint16_t *small_rows = batch_gather(ctx, next_frame, frame, small_stack_ptr, *rows, small_lanes, small_count);
+
+    if (!bytecode_execute_block(ctx, frame_index + 1, small_rows, small_count, small_instr_ptr, small_stack_ptr)) {
+        return false;
+    }
+
+    // in place compaction of the bigger group
+    batch_compact(ctx, frame, frame, big_stack_ptr, big_lanes, big_count);
+
+    const uint16_t *old_rows = *rows;
+    for (size_t lane = 0; lane < big_count; ++ lane) {
+        rows_buf[lane] = old_rows != NULL ? old_rows[big_lanes[lane]] : big_lanes[lane];
+    }
+
+    *rows = rows_buf;
+    *count = big_count;
+    *instr_ptr = big_instr_ptr;
+    *stack_ptr = big_stack_ptr;
+
+    return true;
+}
+
+bool bytecode_execute_block(const struct BatchContext *ctx, size_t frame_index,
+                            const uint16_t *rows, size_t count,
+                            size_t instr_ptr, size_t stack_ptr) {
+    const struct Bytecode *bytecode = ctx->bytecode;
+    const uint32_t *instrs = bytecode->instrs;
+    int *frame = ctx->stack + frame_index * ctx->frame_size;
+    int *temps = SLOT(frame, bytecode->stack_size - bytecode->temps_size);
+    uint16_t rows_buf[BYTECODE_BATCH_SIZE];
+    uint16_t lanes[2][BYTECODE_BATCH_SIZE];
+    int operand[BYTECODE_BATCH_SIZE];
+    size_t addr;
+    int value;
+
+    while (instr_ptr < bytecode->instrs_size) {
+        switch (BYTECODE_INSTR(instrs[instr_ptr])) {
+            case INSTR_INT:
+            case INSTR_INT_WIDE:
+            {
+                value = BYTECODE_INSTR(instrs[instr_ptr]) == INSTR_INT ?
+                    BYTECODE_ARG(instrs[instr_ptr]) :
+                    (int32_t)instrs[instr_ptr + 1];
+                int *top = SLOT(frame, stack_ptr);
+                for (size_t lane = 0; lane < count; ++ lane) {
+                    top[lane] = value;
+                }
+                ++ stack_ptr;
+                instr_ptr += bytecode_instr_size(BYTECODE_INSTR(instrs[instr_ptr]));
+                break;
+            }
+            case INSTR_VAR:
+            {
+                batch_load_var(ctx, BYTECODE_UARG(instrs[instr_ptr]), rows, count, SLOT(frame, stack_ptr));
+                ++ stack_ptr;
+                ++ instr_ptr;
+                break;
+            }
+            case INSTR_VAR_WIDE:
+            {
+                batch_load_var(ctx, instrs[instr_ptr + 1], rows, count, SLOT(frame, stack_ptr));
+                ++ stack_ptr;
+                instr_ptr += 2;
+                break;
+            }
+            case INSTR_LOAD:
+                memcpy(SLOT(frame, stack_ptr), SLOT(temps, BYTECODE_UARG(instrs[instr_ptr])), count * sizeof(int));
+                ++ stack_ptr;
+                ++ instr_ptr;
+                break;
+
+            case INSTR_STORE:
+                memcpy(SLOT(temps, BYTECODE_UARG(instrs[instr_ptr])), SLOT(frame, stack_ptr - 1), count * sizeof(int));
+                ++ instr_ptr;
+                break;
+
+            case INSTR_ADD:      BATCH_BINARY(INSTR_ADD);      break;
+            case INSTR_SUB:      BATCH_BINARY(INSTR_SUB);      break;
+            case INSTR_MUL:      BATCH_BINARY(INSTR_MUL);      break;
+            case INSTR_DIV:      BATCH_BINARY(INSTR_DIV);      break;
+            case INSTR_MOD:      BATCH_BINARY(INSTR_MOD);      break;
+            case INSTR_BIT_AND:  BATCH_BINARY(INSTR_BIT_AND);  break;
+            case INSTR_BIT_XOR:  BATCH_BINARY(INSTR_BIT_XOR);  break;
+            case INSTR_BIT_OR:   BATCH_BINARY(INSTR_BIT_OR);   break;
+            case INSTR_LT:       BATCH_BINARY(INSTR_LT);       break;
+            case INSTR_LE:       BATCH_BINARY(INSTR_LE);       break;
+            case INSTR_GT:       BATCH_BINARY(INSTR_GT);       break;
+            case INSTR_GE:       BATCH_BINARY(INSTR_GE);       break;
+            case INSTR_EQ:       BATCH_BINARY(INSTR_EQ);       break;
+            case INSTR_NE:       BATCH_BINARY(INSTR_NE);       break;
+            case INSTR_LSHIFT:   BATCH_BINARY(INSTR_LSHIFT);   break;
+            case INSTR_RSHIFT:   BATCH_BINARY(INSTR_RSHIFT);   break;
+            case INSTR_NEG:      BATCH_UNARY(INSTR_NEG);       break;
+            case INSTR_BIT_NEG:  BATCH_UNARY(INSTR_BIT_NEG);   break;
+            case INSTR_NOT:      BATCH_UNARY(INSTR_NOT);       break;
+            case INSTR_BOOL:     BATCH_UNARY(INSTR_BOOL);      break;
+
+            case INSTR_ADD_INT:
+            case INSTR_ADD_INT_WIDE:
+            case INSTR_ADD_VAR:      BATCH_BINARY_ARG(INSTR_ADD); break;
+            case INSTR_SUB_INT:
+            case INSTR_SUB_INT_WIDE:
+            case INSTR_SUB_VAR:      BATCH_BINARY_ARG(INSTR_SUB); break;
+            case INSTR_MUL_INT:
+            case INSTR_MUL_INT_WIDE:
+            case INSTR_MUL_VAR:      BATCH_BINARY_ARG(INSTR_MUL); break;
+            case INSTR_DIV_INT:
+            case INSTR_DIV_INT_WIDE:
+            case INSTR_DIV_VAR:      BATCH_BINARY_ARG(INSTR_DIV); break;
+            case INSTR_MOD_INT:
+            case INSTR_MOD_INT_WIDE:
+            case INSTR_MOD_VAR:      BATCH_BINARY_ARG(INSTR_MOD); break;
+            case INSTR_BIT_AND_INT:
+            case INSTR_BIT_AND_INT_WIDE:
+            case INSTR_BIT_AND_VAR:  BATCH_BINARY_ARG(INSTR_BIT_AND); break;
+            case INSTR_BIT_XOR_INT:
+            case INSTR_BIT_XOR_INT_WIDE:
+            case INSTR_BIT_XOR_VAR:  BATCH_BINARY_ARG(INSTR_BIT_XOR); break;
+            case INSTR_BIT_OR_INT:
+            case INSTR_BIT_OR_INT_WIDE:
+            case INSTR_BIT_OR_VAR:   BATCH_BINARY_ARG(INSTR_BIT_OR); break;
+            case INSTR_LT_INT:
+            case INSTR_LT_INT_WIDE:
+            case INSTR_LT_VAR:       BATCH_BINARY_ARG(INSTR_LT); break;
+            case INSTR_LE_INT:
+            case INSTR_LE_INT_WIDE:
+            case INSTR_LE_VAR:       BATCH_BINARY_ARG(INSTR_LE); break;
+            case INSTR_GT_INT:
+            case INSTR_GT_INT_WIDE:
+            case INSTR_GT_VAR:       BATCH_BINARY_ARG(INSTR_GT); break;
+            case INSTR_GE_INT:
+            case INSTR_GE_INT_WIDE:
+            case INSTR_GE_VAR:       BATCH_BINARY_ARG(INSTR_GE); break;
+            case INSTR_EQ_INT:
+            case INSTR_EQ_INT_WIDE:
+            case INSTR_EQ_VAR:       BATCH_BINARY_ARG(INSTR_EQ); break;
+            case INSTR_NE_INT:
+            case INSTR_NE_INT_WIDE:
+            case INSTR_NE_VAR:       BATCH_BINARY_ARG(INSTR_NE); break;
+            case INSTR_LSHIFT_INT:
+            case INSTR_LSHIFT_INT_WIDE:
+            case INSTR_LSHIFT_VAR:   BATCH_BINARY_ARG(INSTR_LSHIFT); break;
+            case INSTR_RSHIFT_INT:
+            case INSTR_RSHIFT_INT_WIDE:
+            case INSTR_RSHIFT_VAR:   BATCH_BINARY_ARG(INSTR_RSHIFT); break;
+
+            case INSTR_JMP:
+            case INSTR_JMP_WIDE:
+                bytecode_get_jump_target(bytecode, instr_ptr, &instr_ptr);
+                break;
+
+            case INSTR_JEZ:
+            case INSTR_JNZ:
+            case INSTR_JZP:
+            case INSTR_JEZ_WIDE:
+            case INSTR_JNZ_WIDE:
+            case INSTR_JZP_WIDE:
+            case INSTR_JZP_LT:
+            case INSTR_JZP_LE:
+            case INSTR_JZP_GT:
+            case INSTR_JZP_GE:
+            case INSTR_JZP_EQ:
+            case INSTR_JZP_NE:
+            case INSTR_JZP_VAR:
+            {
+                enum Instr instr = BYTECODE_INSTR(instrs[instr_ptr]);
+                size_t next_instr_ptr = instr_ptr + bytecode_instr_size(instr);
+                // the wide jumps only differ in the encoding of the offset
+                if (instr >= INSTR_JEZ_WIDE && instr <= INSTR_JZP_WIDE) {
+                    instr = INSTR_JMP + (instr - INSTR_JMP_WIDE);
+                }
+                const bool jump_if_zero = instr != INSTR_JNZ;
+                size_t next_stack_ptr, jump_stack_ptr;
+                int *top;
+
+                switch (instr) {
+                    case INSTR_JZP_LT: ctx->kernels->binary[INSTR_LT](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); -- stack_ptr; break;
+                    case INSTR_JZP_LE: ctx->kernels->binary[INSTR_LE](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); -- stack_ptr; break;
+                    case INSTR_JZP_GT: ctx->kernels->binary[INSTR_GT](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); -- stack_ptr; break;
+                    case INSTR_JZP_GE: ctx->kernels->binary[INSTR_GE](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); -- stack_ptr; break;
+                    case INSTR_JZP_EQ: ctx->kernels->binary[INSTR_EQ](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); -- stack_ptr; break;
+                    case INSTR_JZP_NE: ctx->kernels->binary[INSTR_NE](SLOT(frame, stack_ptr - 2), SLOT(frame, stack_ptr - 1), count); -- stack_ptr; break;
+                    default: break;
+                }
+
+                if (instr == INSTR_JZP_VAR) {
+                    // the condition doesn't live on the stack
+                    batch_load_var(ctx, BYTECODE_UARG(instrs[instr_ptr]), rows, count, operand);
+                    top = operand;
+                    next_stack_ptr = jump_stack_ptr = stack_ptr;
+                } else {
+                    top = SLOT(frame, stack_ptr - 1);
+                    next_stack_ptr = stack_ptr - 1;
+                    jump_stack_ptr = instr == INSTR_JEZ || instr == INSTR_JNZ ? stack_ptr : stack_ptr - 1;
+                }
+
+                if (instr == INSTR_JNZ) {
+                    // jumping lanes need a 1 on top of the stack, the others
+                    // pop it anyway
+                    ctx->kernels->unary[INSTR_BOOL](top, count);
+                }
+
+                size_t jump_count = 0;
+                size_t next_count = 0;
+
+                // most blocks don't diverge, only partition lanes if they do
+                const size_t zeros = ctx->kernels->count_zeros(top, count);
+                if (zeros == 0 || zeros == count) {
+                    jump_count = (zeros == count) == jump_if_zero ? count : 0;
+                    next_count = count - jump_count;
+                } else {
+                    for (size_t lane = 0; lane < count; ++ lane) {
+                        if ((top[lane] == 0) == jump_if_zero) {
+                            lanes[0][jump_count ++] = lane;
+                        } else {
+                            lanes[1][next_count ++] = lane;
+                        }
+                    }
+                }
+
+                bytecode_get_jump_target(bytecode, instr_ptr, &addr);
+
+                if (next_count == 0) {
+                    instr_ptr = addr;
+                    stack_ptr = jump_stack_ptr;
+                } else if (jump_count == 0) {
+                    instr_ptr = next_instr_ptr;
+                    stack_ptr = next_stack_ptr;
+                } else if (!batch_split(
+                        ctx, frame_index, frame, &rows, rows_buf, &count,
+                        lanes[0], jump_count, addr, jump_stack_ptr,
+                        lanes[1], next_count, next_instr_ptr, next_stack_ptr,
+                        &instr_ptr, &stack_ptr)) {
+                    return false;
+                }
+                break;
+            }
+            case INSTR_RET:
+            {
+                assert(stack_ptr == 1);
+                const int *top = SLOT(frame, stack_ptr - 1);
+                int *results = ctx->results + ctx->offset;
+                if (rows == NULL) {
+                    memcpy(results, top, count * sizeof(int));
+                } else {
+                    for (size_t lane = 0; lane < count; ++ lane) {
+                        results[rows[lane]] = top[lane];
+                    }
+                }
+                return true;
+            }
+            case INSTR_RET_INT:
+            case INSTR_RET_INT_WIDE:
+            case INSTR_RET_VAR:
+            {
+                assert(stack_ptr == 0);
+                int *results = ctx->results + ctx->offset;
+                batch_load_arg(ctx, instrs + instr_ptr, rows, count, operand);
+                if (rows == NULL) {
+                    memcpy(results, operand, count * sizeof(int));
+                } else {
+                    for (size_t lane = 0; lane < count; ++ lane) {
+                        results[rows[lane]] = operand[lane];
+                    }
+                }
+                return true;
+            }
+            default:
+                assert(false);
+                errno = EINVAL;
+                return false;
+        }
+    }
+
+    assert(false);
+    errno = EINVAL;
+    return false;
+}
+
+bool bytecode_execute_batch(const struct Bytecode *bytecode, const int *const params[], size_t count, int *results, int *stack) {
+    struct BatchContext ctx = {
+        .bytecode   = bytecode,
+        .kernels    = batch_kernels_get(),
+        .params     = params,
+        .results    = results,
+        .stack      = stack,
+        .offset     = 0,
+        .frame_size = bytecode->stack_size * BYTECODE_BATCH_SIZE,
+    };
+
+    while (ctx.offset < count) {
+        size_t block_size = count - ctx.offset;
+        if (block_size > BYTECODE_BATCH_SIZE) {
+            block_size = BYTECODE_BATCH_SIZE;
+        }
+
+        if (!bytecode_execute_block(&ctx, 0, NULL, block_size, 0, 0)) {
+            return false;
+        }
+
+        ctx.offset += block_size;
+    }
+
+    return true;
+}
+
+int *bytecode_alloc_batch_stack(const struct Bytecode *bytecode) {
+    return calloc(bytecode->stack_size * BYTECODE_BATCH_SIZE * BYTECODE_BATCH_FRAMES, sizeof(int));
+}
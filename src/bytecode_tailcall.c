@@ -0,0 +1,443 @@
+#include <errno.h>
+#include <assert.h>
+
+#include "bytecode.h"
+
+// Tail-call dispatched bytecode interpreter.
+//
+// Every instruction is a small function that ends with a tail call to the
+// handler of the next instruction. The interpreter state (instruction pointer,
+// stack pointer and the cached top of stack) is passed in argument registers,
+// so each handler gets its own register allocation instead of sharing the one
+// of a huge interpreter function.
+//
+// The temporaries (INSTR_LOAD, INSTR_STORE) are at the end of the stack, their
+// address is passed along like params.
+//
+// The top of the stack is never stored on the stack. sp points behind the
+// last spilled value, a push spills the old top of stack. The value spilled
+// by the first push is garbage, so the stack needs the same number of slots
+// as for bytecode_execute().
+//
+// Tail calls are guaranteed with musttail (clang, gcc >= 15). Without it
+// nothing guarantees that the optimizer turns them into jumps (gcc doesn't
+// below -O2 or with sanitizers), and a long program would overflow the C
+// stack with a frame per executed instruction. In that case the handlers
+// return to a trampoline loop in bytecode_execute_tailcall() instead, passing
+// the interpreter state in a struct TailState.
+
+#if defined(__has_attribute)
+#   if __has_attribute(musttail)
+#       define MUSTTAIL __attribute__((musttail))
+#   endif
+#endif
+
+#ifdef MUSTTAIL
+
+#define TAIL_PARAMS const uint32_t *ip, const int *params, int *sp, int tos, int *temps
+
+#define TAIL_DISPATCH \
+    MUSTTAIL return TAIL_HANDLERS[BYTECODE_INSTR(*ip)](ip, params, sp, tos, temps);
+
+#else
+
+// ip is NULL after a handler that returned the result
+struct TailState {
+    const uint32_t *ip;
+    int *sp;
+    int tos;
+};
+
+#define TAIL_PARAMS const uint32_t *ip, const int *params, int *sp, int tos, int *temps, struct TailState *state
+
+#define TAIL_DISPATCH \
+    state->ip  = ip;  \
+    state->sp  = sp;  \
+    state->tos = tos; \
+    return 0;
+
+#endif
+
+typedef int (*TailHandler)(TAIL_PARAMS);
+
+static const TailHandler TAIL_HANDLERS[INSTR_COUNT];
+
+#define TAIL_HANDLER(NAME) \
+    static int tail_ ## NAME(TAIL_PARAMS)
+
+#define TAIL_PUSH(VALUE) \
+    *sp ++ = tos; \
+    tos = (VALUE);
+
+TAIL_HANDLER(int) {
+    TAIL_PUSH(BYTECODE_ARG(*ip));
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(int_wide) {
+    TAIL_PUSH((int32_t)ip[1]);
+    ip += 2;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(var) {
+    TAIL_PUSH(params[BYTECODE_UARG(*ip)]);
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(var_wide) {
+    TAIL_PUSH(params[ip[1]]);
+    ip += 2;
+    TAIL_DISPATCH
+}
+
+// lhs is the spilled value below the top of stack or the top of stack for the
+// argument forms, rhs is the top of stack or the argument
+#define TAIL_BINARY(NAME, EXPR)                                     \
+    TAIL_HANDLER(NAME) {                                            \
+        int lhs = *-- sp; int rhs = tos;                            \
+        tos = (EXPR);                                               \
+        ++ ip;                                                      \
+        TAIL_DISPATCH                                               \
+    }                                                               \
+                                                                    \
+    TAIL_HANDLER(NAME ## _int) {                                    \
+        int lhs = tos; int rhs = BYTECODE_ARG(*ip);                 \
+        tos = (EXPR);                                               \
+        ++ ip;                                                      \
+        TAIL_DISPATCH                                               \
+    }                                                               \
+                                                                    \
+    TAIL_HANDLER(NAME ## _int_wide) {                               \
+        int lhs = tos; int rhs = (int32_t)ip[1];                    \
+        tos = (EXPR);                                               \
+        ip += 2;                                                    \
+        TAIL_DISPATCH                                               \
+    }                                                               \
+                                                                    \
+    TAIL_HANDLER(NAME ## _var) {                                    \
+        int lhs = tos; int rhs = params[BYTECODE_UARG(*ip)];        \
+        tos = (EXPR);                                               \
+        ++ ip;                                                      \
+        TAIL_DISPATCH                                               \
+    }
+
+TAIL_BINARY(add,     lhs +  rhs)
+TAIL_BINARY(sub,     lhs -  rhs)
+TAIL_BINARY(mul,     lhs *  rhs)
+TAIL_BINARY(div,     lhs /  rhs)
+TAIL_BINARY(mod,     lhs %  rhs)
+TAIL_BINARY(bit_and, lhs &  rhs)
+TAIL_BINARY(bit_xor, lhs ^  rhs)
+TAIL_BINARY(bit_or,  lhs |  rhs)
+TAIL_BINARY(lt,      lhs <  rhs)
+TAIL_BINARY(le,      lhs <= rhs)
+TAIL_BINARY(gt,      lhs >  rhs)
+TAIL_BINARY(ge,      lhs >= rhs)
+TAIL_BINARY(eq,      lhs == rhs)
+TAIL_BINARY(ne,      lhs != rhs)
+TAIL_BINARY(lshift,  lhs << rhs)
+TAIL_BINARY(rshift,  lhs >> rhs)
+
+#undef TAIL_BINARY
+
+TAIL_HANDLER(neg) {
+    tos = -tos;
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(bit_neg) {
+    tos = ~tos;
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(not) {
+    tos = !tos;
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(bool) {
+    tos = tos != 0;
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jmp) {
+    ip += BYTECODE_ARG(*ip);
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jez) {
+    if (tos) {
+        tos = *-- sp;
+        ++ ip;
+    } else {
+        ip += BYTECODE_ARG(*ip);
+    }
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jnz) {
+    if (tos) {
+        tos = 1;
+        ip += BYTECODE_ARG(*ip);
+    } else {
+        tos = *-- sp;
+        ++ ip;
+    }
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jzp) {
+    const int cond = tos;
+    tos = *-- sp;
+    ip = cond ? ip + 1 : ip + BYTECODE_ARG(*ip);
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jmp_wide) {
+    ip += (int32_t)ip[1];
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jez_wide) {
+    if (tos) {
+        tos = *-- sp;
+        ip += 2;
+    } else {
+        ip += (int32_t)ip[1];
+    }
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jnz_wide) {
+    if (tos) {
+        tos = 1;
+        ip += (int32_t)ip[1];
+    } else {
+        tos = *-- sp;
+        ip += 2;
+    }
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(jzp_wide) {
+    const int cond = tos;
+    tos = *-- sp;
+    ip = cond ? ip + 2 : ip + (int32_t)ip[1];
+    TAIL_DISPATCH
+}
+
+#define TAIL_JZP_CMP(NAME, OP)                                      \
+    TAIL_HANDLER(jzp_ ## NAME) {                                    \
+        const int rhs = tos;                                        \
+        const int lhs = *-- sp;                                     \
+        tos = *-- sp;                                               \
+        ip = lhs OP rhs ? ip + 1 : ip + BYTECODE_ARG(*ip);          \
+        TAIL_DISPATCH                                               \
+    }
+
+TAIL_JZP_CMP(lt, <)
+TAIL_JZP_CMP(le, <=)
+TAIL_JZP_CMP(gt, >)
+TAIL_JZP_CMP(ge, >=)
+TAIL_JZP_CMP(eq, ==)
+TAIL_JZP_CMP(ne, !=)
+
+#undef TAIL_JZP_CMP
+
+TAIL_HANDLER(jzp_var) {
+    ip = params[BYTECODE_UARG(*ip)] ? ip + 2 : ip + (int32_t)ip[1];
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(ret) {
+    (void)temps;
+    (void)ip;
+    (void)params;
+    (void)sp;
+    return tos;
+}
+
+TAIL_HANDLER(ret_int) {
+    (void)temps;
+    (void)params;
+    (void)sp;
+    (void)tos;
+    return BYTECODE_ARG(*ip);
+}
+
+TAIL_HANDLER(ret_int_wide) {
+    (void)temps;
+    (void)params;
+    (void)sp;
+    (void)tos;
+    return (int32_t)ip[1];
+}
+
+TAIL_HANDLER(ret_var) {
+    (void)temps;
+    (void)sp;
+    (void)tos;
+    return params[BYTECODE_UARG(*ip)];
+}
+
+// bytecode_execute_tailcall() has no results for programs of
+// bytecode_compile_multi()
+TAIL_HANDLER(out) {
+    (void)temps;
+    (void)ip;
+    (void)params;
+    (void)sp;
+    (void)tos;
+    assert(false);
+    errno = EINVAL;
+    return -1;
+}
+
+TAIL_HANDLER(load) {
+    TAIL_PUSH(temps[BYTECODE_UARG(*ip)]);
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+TAIL_HANDLER(store) {
+    temps[BYTECODE_UARG(*ip)] = tos;
+    ++ ip;
+    TAIL_DISPATCH
+}
+
+static const TailHandler TAIL_HANDLERS[INSTR_COUNT] = {
+    [INSTR_INT]             = tail_int,
+    [INSTR_VAR]             = tail_var,
+    [INSTR_ADD]             = tail_add,
+    [INSTR_SUB]             = tail_sub,
+    [INSTR_MUL]             = tail_mul,
+    [INSTR_DIV]             = tail_div,
+    [INSTR_MOD]             = tail_mod,
+    [INSTR_BIT_AND]         = tail_bit_and,
+    [INSTR_BIT_XOR]         = tail_bit_xor,
+    [INSTR_BIT_OR]          = tail_bit_or,
+    [INSTR_LT]              = tail_lt,
+    [INSTR_LE]              = tail_le,
+    [INSTR_GT]              = tail_gt,
+    [INSTR_GE]              = tail_ge,
+    [INSTR_EQ]              = tail_eq,
+    [INSTR_NE]              = tail_ne,
+    [INSTR_NEG]             = tail_neg,
+    [INSTR_BIT_NEG]         = tail_bit_neg,
+    [INSTR_NOT]             = tail_not,
+    [INSTR_JMP]             = tail_jmp,
+    [INSTR_JEZ]             = tail_jez,
+    [INSTR_JNZ]             = tail_jnz,
+    [INSTR_JZP]             = tail_jzp,
+    [INSTR_BOOL]            = tail_bool,
+    [INSTR_LSHIFT]          = tail_lshift,
+    [INSTR_RSHIFT]          = tail_rshift,
+    [INSTR_RET]             = tail_ret,
+
+    [INSTR_ADD_INT]         = tail_add_int,
+    [INSTR_SUB_INT]         = tail_sub_int,
+    [INSTR_MUL_INT]         = tail_mul_int,
+    [INSTR_DIV_INT]         = tail_div_int,
+    [INSTR_MOD_INT]         = tail_mod_int,
+    [INSTR_BIT_AND_INT]     = tail_bit_and_int,
+    [INSTR_BIT_XOR_INT]     = tail_bit_xor_int,
+    [INSTR_BIT_OR_INT]      = tail_bit_or_int,
+    [INSTR_LT_INT]          = tail_lt_int,
+    [INSTR_LE_INT]          = tail_le_int,
+    [INSTR_GT_INT]          = tail_gt_int,
+    [INSTR_GE_INT]          = tail_ge_int,
+    [INSTR_EQ_INT]          = tail_eq_int,
+    [INSTR_NE_INT]          = tail_ne_int,
+    [INSTR_LSHIFT_INT]      = tail_lshift_int,
+    [INSTR_RSHIFT_INT]      = tail_rshift_int,
+
+    [INSTR_ADD_VAR]         = tail_add_var,
+    [INSTR_SUB_VAR]         = tail_sub_var,
+    [INSTR_MUL_VAR]         = tail_mul_var,
+    [INSTR_DIV_VAR]         = tail_div_var,
+    [INSTR_MOD_VAR]         = tail_mod_var,
+    [INSTR_BIT_AND_VAR]     = tail_bit_and_var,
+    [INSTR_BIT_XOR_VAR]     = tail_bit_xor_var,
+    [INSTR_BIT_OR_VAR]      = tail_bit_or_var,
+    [INSTR_LT_VAR]          = tail_lt_var,
+    [INSTR_LE_VAR]          = tail_le_var,
+    [INSTR_GT_VAR]          = tail_gt_var,
+    [INSTR_GE_VAR]          = tail_ge_var,
+    [INSTR_EQ_VAR]          = tail_eq_var,
+    [INSTR_NE_VAR]          = tail_ne_var,
+    [INSTR_LSHIFT_VAR]      = tail_lshift_var,
+    [INSTR_RSHIFT_VAR]      = tail_rshift_var,
+
+    [INSTR_JZP_LT]          = tail_jzp_lt,
+    [INSTR_JZP_LE]          = tail_jzp_le,
+    [INSTR_JZP_GT]          = tail_jzp_gt,
+    [INSTR_JZP_GE]          = tail_jzp_ge,
+    [INSTR_JZP_EQ]          = tail_jzp_eq,
+    [INSTR_JZP_NE]          = tail_jzp_ne,
+    [INSTR_JZP_VAR]         = tail_jzp_var,
+    [INSTR_RET_INT]         = tail_ret_int,
+    [INSTR_RET_VAR]         = tail_ret_var,
+
+    [INSTR_INT_WIDE]        = tail_int_wide,
+    [INSTR_ADD_INT_WIDE]    = tail_add_int_wide,
+    [INSTR_SUB_INT_WIDE]    = tail_sub_int_wide,
+    [INSTR_MUL_INT_WIDE]    = tail_mul_int_wide,
+    [INSTR_DIV_INT_WIDE]    = tail_div_int_wide,
+    [INSTR_MOD_INT_WIDE]    = tail_mod_int_wide,
+    [INSTR_BIT_AND_INT_WIDE]= tail_bit_and_int_wide,
+    [INSTR_BIT_XOR_INT_WIDE]= tail_bit_xor_int_wide,
+    [INSTR_BIT_OR_INT_WIDE] = tail_bit_or_int_wide,
+    [INSTR_LT_INT_WIDE]     = tail_lt_int_wide,
+    [INSTR_LE_INT_WIDE]     = tail_le_int_wide,
+    [INSTR_GT_INT_WIDE]     = tail_gt_int_wide,
+    [INSTR_GE_INT_WIDE]     = tail_ge_int_wide,
+    [INSTR_EQ_INT_WIDE]     = tail_eq_int_wide,
+    [INSTR_NE_INT_WIDE]     = tail_ne_int_wide,
+    [INSTR_LSHIFT_INT_WIDE] = tail_lshift_int_wide,
+    [INSTR_RSHIFT_INT_WIDE] = tail_rshift_int_wide,
+    [INSTR_RET_INT_WIDE]    = tail_ret_int_wide,
+
+    [INSTR_VAR_WIDE]        = tail_var_wide,
+    [INSTR_JMP_WIDE]        = tail_jmp_wide,
+    [INSTR_JEZ_WIDE]        = tail_jez_wide,
+    [INSTR_JNZ_WIDE]        = tail_jnz_wide,
+    [INSTR_JZP_WIDE]        = tail_jzp_wide,
+
+    [INSTR_OUT]             = tail_out,
+
+    [INSTR_LOAD]            = tail_load,
+    [INSTR_STORE]           = tail_store,
+};
+
+int bytecode_execute_tailcall(const struct Bytecode *bytecode, const int *params, int *stack) {
+    const uint32_t *ip = bytecode->instrs;
+
+    if (bytecode->instrs_size == 0) {
+        assert(false);
+        errno = EINVAL;
+        return -1;
+    }
+
+    int *temps = stack + (bytecode->stack_size - bytecode->temps_size);
+
+#ifdef MUSTTAIL
+    return TAIL_HANDLERS[BYTECODE_INSTR(*ip)](ip, params, stack, 0, temps);
+#else
+    struct TailState state = { .ip = ip, .sp = stack, .tos = 0 };
+    for (;;) {
+        ip = state.ip;
+        state.ip = NULL;
+        const int result = TAIL_HANDLERS[BYTECODE_INSTR(*ip)](ip, params, state.sp, state.tos, temps, &state);
+        if (state.ip == NULL) {
+            return result;
+        }
+    }
+#endif
+}
@@ -0,0 +1,366 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "closure.h"
+
+// Every node is evaluated by a function that is specialized for its operation
+// and for the kinds of its operands: N (another node), V (a parameter) or
+// I (a constant). Leaves of the expression therefore don't need nodes of their
+// own and evaluation never switches on the node type.
+
+enum OperandKind {
+    OPERAND_N,
+    OPERAND_V,
+    OPERAND_I,
+};
+
+#define OPERAND_KIND_COUNT 3
+
+#define EVAL_N(OPERAND) ((OPERAND).node->func((OPERAND).node, params))
+#define EVAL_V(OPERAND) (params[(OPERAND).param])
+#define EVAL_I(OPERAND) ((OPERAND).value)
+
+#define CLOSURE_BINARY(NAME, OP, L, R) \
+    static int closure_##NAME##_##L##R(const struct ClosureNode *node, const int *params) { \
+        (void)params; \
+        return EVAL_##L(node->operands[0]) OP EVAL_##R(node->operands[1]); \
+    }
+
+#define CLOSURE_BINARY_ALL(NAME, OP) \
+    CLOSURE_BINARY(NAME, OP, N, N) \
+    CLOSURE_BINARY(NAME, OP, N, V) \
+    CLOSURE_BINARY(NAME, OP, N, I) \
+    CLOSURE_BINARY(NAME, OP, V, N) \
+    CLOSURE_BINARY(NAME, OP, V, V) \
+    CLOSURE_BINARY(NAME, OP, V, I) \
+    CLOSURE_BINARY(NAME, OP, I, N) \
+    CLOSURE_BINARY(NAME, OP, I, V) \
+    CLOSURE_BINARY(NAME, OP, I, I)
+
+#define CLOSURE_BINARY_TABLE(NAME) { \
+        { closure_##NAME##_NN, closure_##NAME##_NV, closure_##NAME##_NI }, \
+        { closure_##NAME##_VN, closure_##NAME##_VV, closure_##NAME##_VI }, \
+        { closure_##NAME##_IN, closure_##NAME##_IV, closure_##NAME##_II }, \
+    }
+
+#define CLOSURE_UNARY(NAME, OP, C) \
+    static int closure_##NAME##_##C(const struct ClosureNode *node, const int *params) { \
+        (void)params; \
+        return OP EVAL_##C(node->operands[0]); \
+    }
+
+#define CLOSURE_UNARY_ALL(NAME, OP) \
+    CLOSURE_UNARY(NAME, OP, N) \
+    CLOSURE_UNARY(NAME, OP, V) \
+    CLOSURE_UNARY(NAME, OP, I)
+
+#define CLOSURE_UNARY_TABLE(NAME) { closure_##NAME##_N, closure_##NAME##_V, closure_##NAME##_I }
+
+// the condition of a terneary expression is never a constant, that case is
+// resolved while compiling
+#define CLOSURE_IF(C, T, E) \
+    static int closure_if_##C##T##E(const struct ClosureNode *node, const int *params) { \
+        return EVAL_##C(node->operands[0]) ? EVAL_##T(node->operands[1]) : EVAL_##E(node->operands[2]); \
+    }
+
+#define CLOSURE_IF_ALL(C) \
+    CLOSURE_IF(C, N, N) \
+    CLOSURE_IF(C, N, V) \
+    CLOSURE_IF(C, N, I) \
+    CLOSURE_IF(C, V, N) \
+    CLOSURE_IF(C, V, V) \
+    CLOSURE_IF(C, V, I) \
+    CLOSURE_IF(C, I, N) \
+    CLOSURE_IF(C, I, V) \
+    CLOSURE_IF(C, I, I)
+
+#define CLOSURE_IF_TABLE(C) { \
+        { closure_if_##C##NN, closure_if_##C##NV, closure_if_##C##NI }, \
+        { closure_if_##C##VN, closure_if_##C##VV, closure_if_##C##VI }, \
+        { closure_if_##C##IN, closure_if_##C##IV, closure_if_##C##II }, \
+    }
+
+CLOSURE_BINARY_ALL(add,     +)
+CLOSURE_BINARY_ALL(sub,     -)
+CLOSURE_BINARY_ALL(mul,     *)
+CLOSURE_BINARY_ALL(div,     /)
+CLOSURE_BINARY_ALL(mod,     %)
+CLOSURE_BINARY_ALL(and,     &&)
+CLOSURE_BINARY_ALL(or,      ||)
+CLOSURE_BINARY_ALL(lt,      <)
+CLOSURE_BINARY_ALL(gt,      >)
+CLOSURE_BINARY_ALL(le,      <=)
+CLOSURE_BINARY_ALL(ge,      >=)
+CLOSURE_BINARY_ALL(eq,      ==)
+CLOSURE_BINARY_ALL(ne,      !=)
+CLOSURE_BINARY_ALL(bit_or,  |)
+CLOSURE_BINARY_ALL(bit_xor, ^)
+CLOSURE_BINARY_ALL(bit_and, &)
+CLOSURE_BINARY_ALL(lshift,  <<)
+CLOSURE_BINARY_ALL(rshift,  >>)
+
+CLOSURE_UNARY_ALL(neg,     -)
+CLOSURE_UNARY_ALL(not,     !)
+CLOSURE_UNARY_ALL(bit_neg, ~)
+
+CLOSURE_IF_ALL(N)
+CLOSURE_IF_ALL(V)
+
+// only used if the whole expression is a leaf
+static int closure_leaf_V(const struct ClosureNode *node, const int *params) {
+    return EVAL_V(node->operands[0]);
+}
+
+static int closure_leaf_I(const struct ClosureNode *node, const int *params) {
+    (void)params;
+    return EVAL_I(node->operands[0]);
+}
+
+static const ClosureFunc CLOSURE_BINARY_FUNCS[NODE_RSHIFT + 1][OPERAND_KIND_COUNT][OPERAND_KIND_COUNT] = {
+    [NODE_ADD]     = CLOSURE_BINARY_TABLE(add),
+    [NODE_SUB]     = CLOSURE_BINARY_TABLE(sub),
+    [NODE_MUL]     = CLOSURE_BINARY_TABLE(mul),
+    [NODE_DIV]     = CLOSURE_BINARY_TABLE(div),
+    [NODE_MOD]     = CLOSURE_BINARY_TABLE(mod),
+    [NODE_AND]     = CLOSURE_BINARY_TABLE(and),
+    [NODE_OR]      = CLOSURE_BINARY_TABLE(or),
+    [NODE_LT]      = CLOSURE_BINARY_TABLE(lt),
+    [NODE_GT]      = CLOSURE_BINARY_TABLE(gt),
+    [NODE_LE]      = CLOSURE_BINARY_TABLE(le),
+    [NODE_GE]      = CLOSURE_BINARY_TABLE(ge),
+    [NODE_EQ]      = CLOSURE_BINARY_TABLE(eq),
+    [NODE_NE]      = CLOSURE_BINARY_TABLE(ne),
+    [NODE_BIT_OR]  = CLOSURE_BINARY_TABLE(bit_or),
+    [NODE_BIT_XOR] = CLOSURE_BINARY_TABLE(bit_xor),
+    [NODE_BIT_AND] = CLOSURE_BINARY_TABLE(bit_and),
+    [NODE_LSHIFT]  = CLOSURE_BINARY_TABLE(lshift),
+    [NODE_RSHIFT]  = CLOSURE_BINARY_TABLE(rshift),
+};
+
+static const ClosureFunc CLOSURE_UNARY_FUNCS[NODE_RSHIFT + 1][OPERAND_KIND_COUNT] = {
+    [NODE_NEG]     = CLOSURE_UNARY_TABLE(neg),
+    [NODE_NOT]     = CLOSURE_UNARY_TABLE(not),
+    [NODE_BIT_NEG] = CLOSURE_UNARY_TABLE(bit_neg),
+};
+
+static const ClosureFunc CLOSURE_IF_FUNCS[2][OPERAND_KIND_COUNT][OPERAND_KIND_COUNT] = {
+    [OPERAND_N] = CLOSURE_IF_TABLE(N),
+    [OPERAND_V] = CLOSURE_IF_TABLE(V),
+};
+
+static ptrdiff_t closure_find_param(const struct Closure *closure, const struct Symbol *symbol) {
+    return symbol_map_get(&closure->param_map, symbol);
+}
+
+static ptrdiff_t closure_add_param(struct Closure *closure, const struct Symbol *symbol) {
+    ptrdiff_t index = closure_find_param(closure, symbol);
+    if (index >= 0) {
+        return index;
+    }
+
+    if (closure->params_size == closure->params_capacity) {
+        size_t new_capacity;
+        if (closure->params_capacity == 0) {
+            new_capacity = 4;
+        } else if (closure->params_capacity > PTRDIFF_MAX / 2 / sizeof(struct Symbol*)) {
+            errno = ENOMEM;
+            return -1;
+        } else {
+            new_capacity = closure->params_capacity * 2;
+        }
+        const struct Symbol **params = realloc(closure->params, new_capacity * sizeof(struct Symbol*));
+        if (params == NULL) {
+            return -1;
+        }
+        closure->params = params;
+        closure->params_capacity = new_capacity;
+    }
+
+    if (closure->params_size >= UINT32_MAX) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (!symbol_map_put(&closure->param_map, symbol, (uint32_t)closure->params_size)) {
+        return -1;
+    }
+
+    index = closure->params_size ++;
+    closure->params[index] = symbol;
+
+    return index;
+}
+
+static size_t closure_count_nodes(const struct AstNode *expr) {
+    if (ast_is_binary(expr)) {
+        return 1 + closure_count_nodes(expr->data.binary.lhs) + closure_count_nodes(expr->data.binary.rhs);
+    } else if (ast_is_unary(expr)) {
+        return 1 + closure_count_nodes(expr->data.child);
+    } else if (expr->type == NODE_IF) {
+        return 1 +
+            closure_count_nodes(expr->data.terneary.cond) +
+            closure_count_nodes(expr->data.terneary.then_expr) +
+            closure_count_nodes(expr->data.terneary.else_expr);
+    }
+    return 1;
+}
+
+static struct ClosureNode *closure_new_node(struct Closure *closure) {
+    // capacity is reserved up front so that node pointers stay valid
+    assert(closure->nodes_size < closure->nodes_capacity);
+    return &closure->nodes[closure->nodes_size ++];
+}
+
+static bool closure_compile_node(struct Closure *closure, const struct AstNode *expr, struct ClosureNode *node);
+
+static bool closure_compile_operand(struct Closure *closure, const struct AstNode *expr, union ClosureOperand *operand, enum OperandKind *kind) {
+    switch (expr->type) {
+        case NODE_VAR:
+        {
+            ptrdiff_t index = closure_add_param(closure, expr->data.symbol);
+            if (index < 0) {
+                return false;
+            }
+            operand->param = index;
+            *kind = OPERAND_V;
+            return true;
+        }
+        case NODE_INT:
+            operand->value = expr->data.value;
+            *kind = OPERAND_I;
+            return true;
+
+        default:
+        {
+            struct ClosureNode *node = closure_new_node(closure);
+            operand->node = node;
+            *kind = OPERAND_N;
+            return closure_compile_node(closure, expr, node);
+        }
+    }
+}
+
+bool closure_compile_node(struct Closure *closure, const struct AstNode *expr, struct ClosureNode *node) {
+    enum OperandKind kinds[3];
+
+    if (ast_is_binary(expr)) {
+        if (!closure_compile_operand(closure, expr->data.binary.lhs, &node->operands[0], &kinds[0]) ||
+            !closure_compile_operand(closure, expr->data.binary.rhs, &node->operands[1], &kinds[1])) {
+            return false;
+        }
+        node->func = CLOSURE_BINARY_FUNCS[expr->type][kinds[0]][kinds[1]];
+    } else if (ast_is_unary(expr)) {
+        if (!closure_compile_operand(closure, expr->data.child, &node->operands[0], &kinds[0])) {
+            return false;
+        }
+        node->func = CLOSURE_UNARY_FUNCS[expr->type][kinds[0]];
+    } else if (expr->type == NODE_IF) {
+        const struct AstNode *cond = expr->data.terneary.cond;
+        if (cond->type == NODE_INT) {
+            return closure_compile_node(closure, cond->data.value ? expr->data.terneary.then_expr : expr->data.terneary.else_expr, node);
+        }
+
+        if (!closure_compile_operand(closure, cond, &node->operands[0], &kinds[0]) ||
+            !closure_compile_operand(closure, expr->data.terneary.then_expr, &node->operands[1], &kinds[1]) ||
+            !closure_compile_operand(closure, expr->data.terneary.else_expr, &node->operands[2], &kinds[2])) {
+            return false;
+        }
+        node->func = CLOSURE_IF_FUNCS[kinds[0]][kinds[1]][kinds[2]];
+    } else if (expr->type == NODE_VAR || expr->type == NODE_INT) {
+        if (!closure_compile_operand(closure, expr, &node->operands[0], &kinds[0])) {
+            return false;
+        }
+        node->func = kinds[0] == OPERAND_V ? closure_leaf_V : closure_leaf_I;
+    } else {
+        assert(false);
+        errno = EINVAL;
+        return false;
+    }
+
+    if (node->func == NULL) {
+        errno = EINVAL;
+        return false;
+    }
+
+    return true;
+}
+
+bool closure_compile(struct Closure *closure, const struct AstNode *expr) {
+    closure_clear(closure);
+
+    const size_t node_count = closure_count_nodes(expr);
+    if (node_count > closure->nodes_capacity) {
+        if (node_count > PTRDIFF_MAX / sizeof(struct ClosureNode)) {
+            errno = ENOMEM;
+            return false;
+        }
+        struct ClosureNode *nodes = realloc(closure->nodes, node_count * sizeof(struct ClosureNode));
+        if (nodes == NULL) {
+            return false;
+        }
+        closure->nodes = nodes;
+        closure->nodes_capacity = node_count;
+    }
+
+    struct ClosureNode *root = closure_new_node(closure);
+    if (!closure_compile_node(closure, expr, root)) {
+        closure_clear(closure);
+        return false;
+    }
+
+    return true;
+}
+
+int closure_execute(const struct Closure *closure, const int *params) {
+    assert(closure->nodes_size > 0);
+    const struct ClosureNode *root = &closure->nodes[0];
+    return root->func(root, params);
+}
+
+void closure_clear(struct Closure *closure) {
+#ifndef NDEBUG
+    if (closure->params_capacity > 0) {
+        memset(closure->params, 0x00, closure->params_capacity * sizeof(*closure->params));
+    }
+    if (closure->nodes_capacity > 0) {
+        memset(closure->nodes, 0xFF, closure->nodes_capacity * sizeof(*closure->nodes));
+    }
+#endif
+
+    closure->nodes_size  = 0;
+    closure->params_size = 0;
+    symbol_map_clear(&closure->param_map);
+}
+
+void closure_free(struct Closure *closure) {
+    free(closure->nodes);
+    free(closure->params);
+    symbol_map_free(&closure->param_map);
+
+    *closure = (struct Closure)CLOSURE_INIT();
+}
+
+int *closure_alloc_params(const struct Closure *closure) {
+    return calloc(closure->params_size, sizeof(int));
+}
+
+ptrdiff_t closure_get_param_index(const struct Closure *closure, const char *name) {
+    for (size_t index = 0; index < closure->params_size; ++ index) {
+        if (strcmp(closure->params[index]->name, name) == 0) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+bool closure_set_param(const struct Closure *closure, int *params, const char *name, int value) {
+    ptrdiff_t index = closure_get_param_index(closure, name);
+    if (index < 0) {
+        return false;
+    }
+    params[index] = value;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef MINMATH_CLOSURE_H__
+#define MINMATH_CLOSURE_H__
+#pragma once
+
+#include "ast.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ClosureNode;
+
+typedef int (*ClosureFunc)(const struct ClosureNode *node, const int *params);
+
+// An operand is either another closure, the index of a parameter or a
+// constant. Which one is encoded in the function of the node.
+union ClosureOperand {
+    const struct ClosureNode *node;
+    size_t param;
+    int value;
+};
+
+// Binary nodes use operands[0] and operands[1], terneary nodes use
+// operands[0] as the condition.
+struct ClosureNode {
+    ClosureFunc func;
+    union ClosureOperand operands[3];
+};
+
+struct Closure {
+    struct ClosureNode *nodes;
+    size_t nodes_size;
+    size_t nodes_capacity;
+
+    const struct Symbol **params;
+    size_t params_size;
+    size_t params_capacity;
+    struct SymbolMap param_map; // index of each symbol in params
+};
+
+#define CLOSURE_INIT() {            \
+    .nodes = NULL,                  \
+    .nodes_size = 0,                \
+    .nodes_capacity = 0,            \
+    .params = NULL,                 \
+    .params_size = 0,               \
+    .params_capacity = 0,           \
+    .param_map = SYMBOL_MAP_INIT(), \
+}
+
+bool closure_compile(struct Closure *closure, const struct AstNode *expr);
+int  closure_execute(const struct Closure *closure, const int *params);
+void closure_free(struct Closure *closure);
+void closure_clear(struct Closure *closure);
+ptrdiff_t closure_get_param_index(const struct Closure *closure, const char *name);
+bool closure_set_param(const struct Closure *closure, int *params, const char *name, int value);
+int *closure_alloc_params(const struct Closure *closure);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,9 +7,83 @@
 static struct AstNode *fast_parse_expression(struct FastParser *parser, int min_precedence);
 static struct AstNode *fast_parse_increasing_precedence(struct FastParser *parser, struct AstNode *left, int min_precedence);
 static struct AstNode *fast_parse_leaf(struct FastParser *parser);
-static inline int get_precedence(enum NodeType type);
-static inline bool is_binary_operation(enum TokenType token);
-static inline enum NodeType get_binary_node_type(enum TokenType token);
+
+// Emits the nodes into a flat AST instead of building a tree. Prefix operators
+// are emitted after their operand, until then they are kept in prefix_ops.
+struct FastFlatParser {
+    struct Tokenizer tokenizer;
+    struct ErrorInfo error;
+    struct FlatAst *ast;
+    struct SymbolTable *symbols;
+    uint8_t *prefix_ops;
+    size_t prefix_ops_size;
+    size_t prefix_ops_capacity;
+};
+
+#define FAST_FLAT_PARSER_INIT(INPUT, AST, SYMBOLS) { \
+    .tokenizer = TOKENIZER_INIT(INPUT),              \
+    .error = {                                       \
+        .error  = PARSER_ERROR_OK,                   \
+        .offset = 0,                                 \
+        .context_offset = 0,                         \
+        .token  = TOK_EOF,                           \
+    },                                               \
+    .ast = (AST),                                    \
+    .symbols = (SYMBOLS),                            \
+    .prefix_ops = NULL,                              \
+    .prefix_ops_size = 0,                            \
+    .prefix_ops_capacity = 0,                        \
+}
+
+static bool fast_parse_flat_expression(struct FastFlatParser *parser, int min_precedence);
+static int  fast_parse_flat_increasing_precedence(struct FastFlatParser *parser, int min_precedence);
+static bool fast_parse_flat_leaf(struct FastFlatParser *parser);
+
+// Besides the node types of binary and prefix operators the operator stack of
+// the iterative parser holds markers for unfinished parentheses and ifs.
+enum IterativeMarker {
+    MARKER_PAREN = NODE_RSHIFT + 1, // waiting for ')'
+    MARKER_QUEST, // waiting for the ':' of an if
+    MARKER_COLON, // parsing the else branch of an if
+};
+
+struct IterativeOp {
+    uint8_t op;    // enum NodeType or enum IterativeMarker
+    size_t offset; // of the '(' or '?' for error messages
+};
+
+struct IterativeParser {
+    struct Tokenizer tokenizer;
+    struct ErrorInfo error;
+    struct Arena *arena;
+    struct SymbolTable *symbols;
+    struct AstNode **operands;
+    size_t operands_size;
+    size_t operands_capacity;
+    struct IterativeOp *ops;
+    size_t ops_size;
+    size_t ops_capacity;
+};
+
+#define ITERATIVE_PARSER_INIT(INPUT, ARENA, SYMBOLS) { \
+    .tokenizer = TOKENIZER_INIT(INPUT),                \
+    .error = {                                         \
+        .error  = PARSER_ERROR_OK,                     \
+        .offset = 0,                                   \
+        .context_offset = 0,                           \
+        .token  = TOK_EOF,                             \
+    },                                                 \
+    .arena = (ARENA),                                  \
+    .symbols = (SYMBOLS),                              \
+    .operands = NULL,                                  \
+    .operands_size = 0,                                \
+    .operands_capacity = 0,                            \
+    .ops = NULL,                                       \
+    .ops_size = 0,                                     \
+    .ops_capacity = 0,                                 \
+}
+
+static struct AstNode *fast_parse_iterative_expression(struct IterativeParser *parser);
 
 // This parser is not a simple 1:1 translation from the BNF, but it is a tiny
 // bit faster, has less redundant code, and is more flexible in regards of
@@ -25,26 +99,101 @@ void fast_parser_free(struct FastParser *parser) {
     tokenizer_free(&parser->tokenizer);
 }
 
-struct AstNode *fast_parse(const char *input, struct ErrorInfo *error) {
-    struct FastParser parser = FAST_PARSER_INIT(input);
-    struct AstNode *expr = fast_parse_expression(&parser, 0);
+struct AstNode *fast_parse(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    return fast_parse_in(NULL, symbols, input, error);
+}
+
+// parses the whole input, the tokenizer of parser may read a token array
+static struct AstNode *fast_parse_all(struct FastParser *parser, struct ErrorInfo *error) {
+    struct AstNode *expr = fast_parse_expression(parser, 0);
     if (expr != NULL) {
-        if (next_token(&parser.tokenizer) != TOK_EOF) {
-            parser.error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
-            parser.error.offset = parser.error.context_offset = parser.tokenizer.token_pos;
-            ast_free(expr);
+        if (next_token(&parser->tokenizer) != TOK_EOF) {
+            parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            ast_free_in(parser->arena, expr);
             expr = NULL;
         }
     }
 
+    if (error != NULL) {
+        *error = parser->error;
+    }
+
+    fast_parser_free(parser);
+    return expr;
+}
+
+struct AstNode *fast_parse_in(struct Arena *arena, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    struct FastParser parser = FAST_PARSER_INIT(input);
+    parser.arena = arena;
+    parser.symbols = symbols;
+    return fast_parse_all(&parser, error);
+}
+
+struct AstNode *fast_parse_tokens(struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error) {
+    return fast_parse_tokens_in(NULL, symbols, tokens, error);
+}
+
+struct AstNode *fast_parse_tokens_in(struct Arena *arena, struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error) {
+    struct FastParser parser = FAST_PARSER_INIT_TOKENS(tokens);
+    parser.arena = arena;
+    parser.symbols = symbols;
+    return fast_parse_all(&parser, error);
+}
+
+struct AstNode *fast_parse_iterative(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    return fast_parse_iterative_in(NULL, symbols, input, error);
+}
+
+struct AstNode *fast_parse_iterative_in(struct Arena *arena, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    struct IterativeParser parser = ITERATIVE_PARSER_INIT(input, arena, symbols);
+    struct AstNode *expr = fast_parse_iterative_expression(&parser);
+
+    if (expr == NULL) {
+        for (size_t index = 0; index < parser.operands_size; ++ index) {
+            ast_free_in(arena, parser.operands[index]);
+        }
+    }
+
     if (error != NULL) {
         *error = parser.error;
     }
 
-    fast_parser_free(&parser);
+    free(parser.operands);
+    free(parser.ops);
+    tokenizer_free(&parser.tokenizer);
     return expr;
 }
 
+bool fast_parse_flat(struct SymbolTable *symbols, const char *input, struct FlatAst *ast, struct ErrorInfo *error) {
+    struct FastFlatParser parser = FAST_FLAT_PARSER_INIT(input, ast, symbols);
+    const size_t nodes_size = ast->nodes_size;
+    const size_t vars_size = ast->vars_size;
+    const size_t stack_depth = ast->stack_depth;
+    const size_t stack_size = ast->stack_size;
+
+    bool ok = fast_parse_flat_expression(&parser, 0);
+    if (ok && next_token(&parser.tokenizer) != TOK_EOF) {
+        parser.error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+        parser.error.offset = parser.error.context_offset = parser.tokenizer.token_pos;
+        ok = false;
+    }
+
+    if (!ok) {
+        ast->nodes_size = nodes_size;
+        ast->vars_size = vars_size;
+        ast->stack_depth = stack_depth;
+        ast->stack_size = stack_size;
+    }
+
+    if (error != NULL) {
+        *error = parser.error;
+    }
+
+    free(parser.prefix_ops);
+    tokenizer_free(&parser.tokenizer);
+    return ok;
+}
 
 struct AstNode *fast_parse_increasing_precedence(struct FastParser *parser, struct AstNode *left, int min_precedence) {
     enum TokenType token = peek_token(&parser->tokenizer);
@@ -58,7 +207,7 @@ struct AstNode *fast_parse_increasing_precedence(struct FastParser *parser, stru
         size_t start_offset = parser->tokenizer.token_pos;
         struct AstNode *then_expr = fast_parse_expression(parser, 0);
         if (then_expr == NULL) {
-            ast_free(left);
+            ast_free_in(parser->arena, left);
             return NULL;
         }
 
@@ -66,24 +215,24 @@ struct AstNode *fast_parse_increasing_precedence(struct FastParser *parser, stru
             parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
             parser->error.offset = parser->tokenizer.token_pos;
             parser->error.context_offset = start_offset;
-            ast_free(left);
+            ast_free_in(parser->arena, left);
             return NULL;
         }
 
         struct AstNode *else_expr = fast_parse_expression(parser, 0);
         if (else_expr == NULL) {
-            ast_free(left);
-            ast_free(then_expr);
+            ast_free_in(parser->arena, left);
+            ast_free_in(parser->arena, then_expr);
             return NULL;
         }
 
-        struct AstNode *if_expr = ast_create_terneary(left, then_expr, else_expr);
+        struct AstNode *if_expr = ast_create_terneary_in(parser->arena, left, then_expr, else_expr);
         if (if_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(left);
-            ast_free(then_expr);
-            ast_free(else_expr);
+            ast_free_in(parser->arena, left);
+            ast_free_in(parser->arena, then_expr);
+            ast_free_in(parser->arena, else_expr);
             return NULL;
         }
 
@@ -106,14 +255,14 @@ struct AstNode *fast_parse_increasing_precedence(struct FastParser *parser, stru
 
     struct AstNode *right = fast_parse_expression(parser, precedence);
     if (right == NULL) {
-        ast_free(left);
+        ast_free_in(parser->arena, left);
         return NULL;
     }
 
-    struct AstNode *expr = ast_create_binary(type, left, right);
+    struct AstNode *expr = ast_create_binary_in(parser->arena, type, left, right);
     if (expr == NULL) {
-        ast_free(left);
-        ast_free(right);
+        ast_free_in(parser->arena, left);
+        ast_free_in(parser->arena, right);
         return NULL;
     }
 
@@ -155,11 +304,11 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
 
         struct AstNode *child;
         if (token == TOK_MINUS) {
-            child = ast_create_unary(NODE_NEG, NULL);
+            child = ast_create_unary_in(parser->arena, NODE_NEG, NULL);
         } else if (token == TOK_BIT_NEG) {
-            child = ast_create_unary(NODE_BIT_NEG, NULL);
+            child = ast_create_unary_in(parser->arena, NODE_BIT_NEG, NULL);
         } else if (token == TOK_NOT) {
-            child = ast_create_unary(NODE_NOT, NULL);
+            child = ast_create_unary_in(parser->arena, NODE_NOT, NULL);
         } else {
             break;
         }
@@ -167,7 +316,7 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
         if (child == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(top);
+            ast_free_in(parser->arena, top);
             return NULL;
         }
 
@@ -184,9 +333,9 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
     struct AstNode *child = NULL;
     switch (token) {
         case TOK_INT:
-            child = ast_create_int(parser->tokenizer.value);
+            child = ast_create_int_in(parser->arena, parser->tokenizer.value);
             if (child == NULL) {
-                ast_free(top);
+                ast_free_in(parser->arena, top);
                 parser->error.error  = PARSER_ERROR_MEMORY;
                 parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
                 return NULL;
@@ -195,16 +344,16 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
 
         case TOK_IDENT:
         {
-            char *name = tokenizer_get_ident(&parser->tokenizer);
-            if (name == NULL) {
+            const struct Symbol *symbol = tokenizer_get_symbol(&parser->tokenizer, parser->symbols);
+            if (symbol == NULL) {
+                ast_free_in(parser->arena, top);
                 parser->error.error  = PARSER_ERROR_MEMORY;
                 parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
                 return NULL;
             }
-            child = ast_create_var(name);
+            child = ast_create_var_in(parser->arena, symbol);
             if (child == NULL) {
-                free(name);
-                ast_free(top);
+                ast_free_in(parser->arena, top);
                 parser->error.error  = PARSER_ERROR_MEMORY;
                 parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
                 return NULL;
@@ -216,7 +365,7 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
             size_t start_offset = parser->tokenizer.token_pos;
             child = fast_parse_expression(parser, 0);
             if (child == NULL) {
-                ast_free(top);
+                ast_free_in(parser->arena, top);
                 return NULL;
             }
 
@@ -227,8 +376,8 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
                     parser->error.offset = parser->tokenizer.token_pos;
                     parser->error.context_offset = start_offset;
                 }
-                ast_free(child);
-                ast_free(top);
+                ast_free_in(parser->arena, child);
+                ast_free_in(parser->arena, top);
                 return NULL;
             }
             break;
@@ -252,6 +401,415 @@ struct AstNode *fast_parse_leaf(struct FastParser *parser) {
     return child;
 }
 
+// Returns 1 if an operator was parsed, 0 if there is none with a precedence
+// above min_precedence and -1 on error.
+int fast_parse_flat_increasing_precedence(struct FastFlatParser *parser, int min_precedence) {
+    enum TokenType token = peek_token(&parser->tokenizer);
+
+    if (token == TOK_QUEST) {
+        if (get_precedence(NODE_IF) <= min_precedence) {
+            return 0;
+        }
+        next_token(&parser->tokenizer);
+
+        size_t start_offset = parser->tokenizer.token_pos;
+        if (!fast_parse_flat_expression(parser, 0)) {
+            return -1;
+        }
+
+        if (next_token(&parser->tokenizer) != TOK_COLON) {
+            parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+            parser->error.offset = parser->tokenizer.token_pos;
+            parser->error.context_offset = start_offset;
+            return -1;
+        }
+
+        if (!fast_parse_flat_expression(parser, 0)) {
+            return -1;
+        }
+
+        if (!flat_ast_push(parser->ast, NODE_IF)) {
+            parser->error.error  = PARSER_ERROR_MEMORY;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            return -1;
+        }
+
+        return 1;
+    }
+
+    if (!is_binary_operation(token)) {
+        return 0;
+    }
+
+    enum NodeType type = get_binary_node_type(token);
+    int precedence = get_precedence(type);
+
+    if (precedence <= min_precedence) {
+        return 0;
+    }
+
+    // eat the peeked token
+    next_token(&parser->tokenizer);
+
+    if (!fast_parse_flat_expression(parser, precedence)) {
+        return -1;
+    }
+
+    if (!flat_ast_push(parser->ast, type)) {
+        parser->error.error  = PARSER_ERROR_MEMORY;
+        parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+        return -1;
+    }
+
+    return 1;
+}
+
+bool fast_parse_flat_expression(struct FastFlatParser *parser, int min_precedence) {
+    if (!fast_parse_flat_leaf(parser)) {
+        return false;
+    }
+
+    for (;;) {
+        int res = fast_parse_flat_increasing_precedence(parser, min_precedence);
+        if (res < 0) {
+            return false;
+        }
+
+        if (res == 0) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool fast_parse_flat_leaf(struct FastFlatParser *parser) {
+    enum TokenType token = next_token(&parser->tokenizer);
+    // prefix operators of enclosing leafs stay below this
+    const size_t prefix_base = parser->prefix_ops_size;
+
+    for (;;) {
+        if (token == TOK_PLUS) {
+            token = next_token(&parser->tokenizer);
+            continue;
+        }
+
+        enum NodeType type;
+        if (token == TOK_MINUS) {
+            type = NODE_NEG;
+        } else if (token == TOK_BIT_NEG) {
+            type = NODE_BIT_NEG;
+        } else if (token == TOK_NOT) {
+            type = NODE_NOT;
+        } else {
+            break;
+        }
+
+        if (parser->prefix_ops_size == parser->prefix_ops_capacity) {
+            size_t new_capacity = parser->prefix_ops_capacity == 0 ? 16 : parser->prefix_ops_capacity * 2;
+            uint8_t *prefix_ops = realloc(parser->prefix_ops, new_capacity * sizeof(uint8_t));
+            if (prefix_ops == NULL) {
+                parser->error.error  = PARSER_ERROR_MEMORY;
+                parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                return false;
+            }
+            parser->prefix_ops = prefix_ops;
+            parser->prefix_ops_capacity = new_capacity;
+        }
+        parser->prefix_ops[parser->prefix_ops_size ++] = type;
+
+        token = next_token(&parser->tokenizer);
+    }
+
+    switch (token) {
+        case TOK_INT:
+            if (!flat_ast_push_int(parser->ast, parser->tokenizer.value)) {
+                parser->error.error  = PARSER_ERROR_MEMORY;
+                parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                return false;
+            }
+            break;
+
+        case TOK_IDENT:
+        {
+            const struct Symbol *symbol = tokenizer_get_symbol(&parser->tokenizer, parser->symbols);
+            if (symbol == NULL || !flat_ast_push_var(parser->ast, symbol)) {
+                parser->error.error  = PARSER_ERROR_MEMORY;
+                parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                return false;
+            }
+            break;
+        }
+
+        case TOK_LPAREN:
+        {
+            size_t start_offset = parser->tokenizer.token_pos;
+            if (!fast_parse_flat_expression(parser, 0)) {
+                return false;
+            }
+
+            if (next_token(&parser->tokenizer) != TOK_RPAREN) {
+                if (!token_is_error(parser->tokenizer.token)) {
+                    parser->error.error  = PARSER_ERROR_EXPECTED_TOKEN;
+                    parser->error.token  = TOK_RPAREN;
+                    parser->error.offset = parser->tokenizer.token_pos;
+                    parser->error.context_offset = start_offset;
+                }
+                return false;
+            }
+            break;
+        }
+        case TOK_EOF:
+            parser->error.error  = PARSER_ERROR_UNEXPECTED_EOF;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            return false;
+
+        default:
+            parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            return false;
+    }
+
+    // the innermost operator comes first
+    while (parser->prefix_ops_size > prefix_base) {
+        if (!flat_ast_push(parser->ast, parser->prefix_ops[-- parser->prefix_ops_size])) {
+            parser->error.error  = PARSER_ERROR_MEMORY;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool iterative_push_operand(struct IterativeParser *parser, struct AstNode *expr) {
+    if (parser->operands_size == parser->operands_capacity) {
+        size_t new_capacity = parser->operands_capacity == 0 ? 32 : parser->operands_capacity * 2;
+        struct AstNode **operands = realloc(parser->operands, new_capacity * sizeof(struct AstNode*));
+        if (operands == NULL) {
+            return false;
+        }
+        parser->operands = operands;
+        parser->operands_capacity = new_capacity;
+    }
+    parser->operands[parser->operands_size ++] = expr;
+    return true;
+}
+
+static bool iterative_push_op(struct IterativeParser *parser, uint8_t op, size_t offset) {
+    if (parser->ops_size == parser->ops_capacity) {
+        size_t new_capacity = parser->ops_capacity == 0 ? 32 : parser->ops_capacity * 2;
+        struct IterativeOp *ops = realloc(parser->ops, new_capacity * sizeof(struct IterativeOp));
+        if (ops == NULL) {
+            return false;
+        }
+        parser->ops = ops;
+        parser->ops_capacity = new_capacity;
+    }
+    parser->ops[parser->ops_size ++] = (struct IterativeOp){ .op = op, .offset = offset };
+    return true;
+}
+
+static inline bool iterative_is_unary(uint8_t op) {
+    return op == NODE_NEG || op == NODE_BIT_NEG || op == NODE_NOT;
+}
+
+static inline bool iterative_is_binary(uint8_t op) {
+    return op < MARKER_PAREN && !iterative_is_unary(op);
+}
+
+// Replaces the operands of the operator on top of the stack by its node. An if
+// is reduced from its MARKER_COLON.
+static bool iterative_reduce(struct IterativeParser *parser) {
+    assert(parser->ops_size > 0);
+    const uint8_t op = parser->ops[-- parser->ops_size].op;
+    struct AstNode **operands = parser->operands;
+    struct AstNode *expr;
+
+    if (op == MARKER_COLON) {
+        assert(parser->operands_size >= 3);
+        parser->operands_size -= 3;
+        struct AstNode **args = operands + parser->operands_size;
+        expr = ast_create_terneary_in(parser->arena, args[0], args[1], args[2]);
+    } else if (iterative_is_unary(op)) {
+        assert(parser->operands_size >= 1);
+        expr = ast_create_unary_in(parser->arena, op, operands[-- parser->operands_size]);
+    } else {
+        assert(iterative_is_binary(op) && parser->operands_size >= 2);
+        parser->operands_size -= 2;
+        struct AstNode **args = operands + parser->operands_size;
+        expr = ast_create_binary_in(parser->arena, op, args[0], args[1]);
+    }
+
+    if (expr == NULL) {
+        // the operands are still in the array and are freed with the others
+        parser->operands_size += op == MARKER_COLON ? 3 : iterative_is_unary(op) ? 1 : 2;
+        parser->error.error  = PARSER_ERROR_MEMORY;
+        parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+        return false;
+    }
+
+    operands[parser->operands_size ++] = expr;
+    return true;
+}
+
+// An operand position is expected at the start of the loop, an operator
+// position after each complete operand. Operators of higher or equal
+// precedence are reduced before a binary operator is pushed, which gives the
+// same left associative trees as fast_parse_increasing_precedence(). A token
+// that is no operator closes the innermost parenthesis or then branch, or ends
+// the expression.
+struct AstNode *fast_parse_iterative_expression(struct IterativeParser *parser) {
+    for (;;) {
+        enum TokenType token = next_token(&parser->tokenizer);
+        struct AstNode *expr = NULL;
+
+        switch (token) {
+            case TOK_PLUS:
+                continue;
+
+            case TOK_MINUS:
+            case TOK_BIT_NEG:
+            case TOK_NOT:
+            case TOK_LPAREN:
+            {
+                uint8_t op =
+                    token == TOK_MINUS   ? NODE_NEG :
+                    token == TOK_BIT_NEG ? NODE_BIT_NEG :
+                    token == TOK_NOT     ? NODE_NOT : MARKER_PAREN;
+                if (!iterative_push_op(parser, op, parser->tokenizer.token_pos)) {
+                    parser->error.error  = PARSER_ERROR_MEMORY;
+                    parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                    return NULL;
+                }
+                continue;
+            }
+            case TOK_INT:
+                expr = ast_create_int_in(parser->arena, parser->tokenizer.value);
+                break;
+
+            case TOK_IDENT:
+            {
+                const struct Symbol *symbol = tokenizer_get_symbol(&parser->tokenizer, parser->symbols);
+                if (symbol != NULL) {
+                    expr = ast_create_var_in(parser->arena, symbol);
+                }
+                break;
+            }
+            case TOK_EOF:
+                parser->error.error  = PARSER_ERROR_UNEXPECTED_EOF;
+                parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                return NULL;
+
+            default:
+                parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+                parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                return NULL;
+        }
+
+        if (expr == NULL || !iterative_push_operand(parser, expr)) {
+            ast_free_in(parser->arena, expr);
+            parser->error.error  = PARSER_ERROR_MEMORY;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            return NULL;
+        }
+
+        // operator position, the loop continues for every closed parenthesis
+        for (;;) {
+            // prefix operators only apply to the operand
+            while (parser->ops_size > 0 && iterative_is_unary(parser->ops[parser->ops_size - 1].op)) {
+                if (!iterative_reduce(parser)) {
+                    return NULL;
+                }
+            }
+
+            token = peek_token(&parser->tokenizer);
+
+            if (is_binary_operation(token)) {
+                enum NodeType type = get_binary_node_type(token);
+                int precedence = get_precedence(type);
+
+                while (parser->ops_size > 0) {
+                    uint8_t top = parser->ops[parser->ops_size - 1].op;
+                    if (!iterative_is_binary(top) || get_precedence(top) < precedence) {
+                        break;
+                    }
+                    if (!iterative_reduce(parser)) {
+                        return NULL;
+                    }
+                }
+
+                next_token(&parser->tokenizer);
+                if (!iterative_push_op(parser, type, parser->tokenizer.token_pos)) {
+                    parser->error.error  = PARSER_ERROR_MEMORY;
+                    parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                    return NULL;
+                }
+                break;
+            }
+
+            // all binary operators bind stronger than '?', ifs in the else
+            // branch stay open, so nested ifs are right associative
+            while (parser->ops_size > 0 && (
+                    iterative_is_binary(parser->ops[parser->ops_size - 1].op) || (
+                    token != TOK_QUEST && parser->ops[parser->ops_size - 1].op == MARKER_COLON))) {
+                if (!iterative_reduce(parser)) {
+                    return NULL;
+                }
+            }
+
+            next_token(&parser->tokenizer);
+
+            if (token == TOK_QUEST) {
+                if (!iterative_push_op(parser, MARKER_QUEST, parser->tokenizer.token_pos)) {
+                    parser->error.error  = PARSER_ERROR_MEMORY;
+                    parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                    return NULL;
+                }
+                break;
+            }
+
+            if (parser->ops_size == 0) {
+                if (token != TOK_EOF) {
+                    parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+                    parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                    return NULL;
+                }
+                assert(parser->operands_size == 1);
+                return parser->operands[0];
+            }
+
+            struct IterativeOp *top = &parser->ops[parser->ops_size - 1];
+
+            if (top->op == MARKER_QUEST) {
+                if (token != TOK_COLON) {
+                    parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+                    parser->error.offset = parser->tokenizer.token_pos;
+                    parser->error.context_offset = top->offset;
+                    return NULL;
+                }
+                top->op = MARKER_COLON;
+                break;
+            }
+
+            assert(top->op == MARKER_PAREN);
+            if (token != TOK_RPAREN) {
+                if (token_is_error(token)) {
+                    parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+                    parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+                } else {
+                    parser->error.error  = PARSER_ERROR_EXPECTED_TOKEN;
+                    parser->error.token  = TOK_RPAREN;
+                    parser->error.offset = parser->tokenizer.token_pos;
+                    parser->error.context_offset = top->offset;
+                }
+                return NULL;
+            }
+            -- parser->ops_size;
+        }
+    }
+}
+
 bool is_binary_operation(enum TokenType token) {
     switch (token) {
         case TOK_PLUS:
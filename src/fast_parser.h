@@ -4,6 +4,7 @@
 
 #include "tokenizer.h"
 #include "ast.h"
+#include "flat_ast.h"
 #include "parser_error.h"
 
 #ifdef __cplusplus
@@ -13,6 +14,8 @@ extern "C" {
 struct FastParser {
     struct Tokenizer tokenizer;
     struct ErrorInfo error;
+    struct Arena *arena; // NULL to allocate nodes with malloc()
+    struct SymbolTable *symbols; // the variables are interned here, has to be set
 };
 
 #define FAST_PARSER_INIT(INPUT) {        \
@@ -23,11 +26,45 @@ struct FastParser {
         .context_offset = 0,             \
         .token  = TOK_EOF,               \
     },                                   \
+    .arena = NULL,                       \
+    .symbols = NULL,                     \
 }
 
-struct AstNode *fast_parse(const char *input, struct ErrorInfo *error);
+#define FAST_PARSER_INIT_TOKENS(TOKENS) {       \
+    .tokenizer = TOKENIZER_INIT_TOKENS(TOKENS), \
+    .error = {                                  \
+        .error  = PARSER_ERROR_OK,              \
+        .offset = 0,                            \
+        .context_offset = 0,                    \
+        .token  = TOK_EOF,                      \
+    },                                          \
+    .arena = NULL,                              \
+    .symbols = NULL,                            \
+}
+
+/// the variables of the tree are interned into symbols, which has to outlive it
+struct AstNode *fast_parse(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+/// allocates the tree from the arena, release it with the arena
+struct AstNode *fast_parse_in(struct Arena *arena, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+/// parses tokens produced by token_array_tokenize(), same results as fast_parse()
+struct AstNode *fast_parse_tokens(struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error);
+struct AstNode *fast_parse_tokens_in(struct Arena *arena, struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error);
+/// Same grammar and trees as fast_parse(), but with explicit heap allocated
+/// stacks instead of recursion, so the nesting depth is only limited by memory.
+/// Release deep trees with an arena, ast_free() is still recursive.
+struct AstNode *fast_parse_iterative(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+struct AstNode *fast_parse_iterative_in(struct Arena *arena, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+/// Appends the expression in post-order to a flat AST without building a tree.
+/// Nothing is appended on error.
+bool fast_parse_flat(struct SymbolTable *symbols, const char *input, struct FlatAst *ast, struct ErrorInfo *error);
 void fast_parser_free(struct FastParser *parser);
 
+/// binding power of binary operators and NODE_IF, higher binds stronger
+int get_precedence(enum NodeType type);
+bool is_binary_operation(enum TokenType token);
+/// token has to be a binary operation
+enum NodeType get_binary_node_type(enum TokenType token);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,336 @@
+#include "flat_ast.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+
+// number of children of nodes of type
+static inline int flat_ast_arity(enum NodeType type) {
+    switch (type) {
+        case NODE_INT:
+        case NODE_VAR:
+            return 0;
+
+        case NODE_NEG:
+        case NODE_BIT_NEG:
+        case NODE_NOT:
+            return 1;
+
+        case NODE_IF:
+            return 3;
+
+        default:
+            return 2;
+    }
+}
+
+static inline uint32_t flat_ast_first_intern(const struct FlatAst *ast, uint32_t node) {
+    const enum NodeType type = ast->types[node];
+    return type == NODE_INT || type == NODE_VAR ? node : ast->args[node].first;
+}
+
+uint32_t flat_ast_first(const struct FlatAst *ast, uint32_t node) {
+    assert(node < ast->nodes_size);
+    return flat_ast_first_intern(ast, node);
+}
+
+static bool flat_ast_add_node(struct FlatAst *ast, enum NodeType type, union FlatAstArg arg) {
+    if (ast->nodes_size == ast->nodes_capacity) {
+        size_t new_capacity;
+        if (ast->nodes_capacity == 0) {
+            new_capacity = 16;
+        } else if (ast->nodes_capacity > UINT32_MAX / 2) {
+            // node indices have to fit into 32 bits
+            errno = ERANGE;
+            return false;
+        } else {
+            new_capacity = ast->nodes_capacity * 2;
+        }
+
+        uint8_t *types = realloc(ast->types, new_capacity * sizeof(uint8_t));
+        if (types == NULL) {
+            return false;
+        }
+        ast->types = types;
+
+        union FlatAstArg *args = realloc(ast->args, new_capacity * sizeof(union FlatAstArg));
+        if (args == NULL) {
+            return false;
+        }
+        ast->args = args;
+
+        uint8_t *flows = realloc(ast->flows, new_capacity * sizeof(uint8_t));
+        if (flows == NULL) {
+            return false;
+        }
+        ast->flows = flows;
+
+        uint32_t *jumps = realloc(ast->jumps, new_capacity * sizeof(uint32_t));
+        if (jumps == NULL) {
+            return false;
+        }
+        ast->jumps = jumps;
+        ast->nodes_capacity = new_capacity;
+    }
+
+    ast->types[ast->nodes_size] = type;
+    ast->args[ast->nodes_size] = arg;
+    ast->flows[ast->nodes_size] = FLAT_AST_NEXT;
+    ast->jumps[ast->nodes_size] = 0;
+    ++ ast->nodes_size;
+
+    // the children are replaced by the value of the node
+    ast->stack_depth = ast->stack_depth + 1 - (size_t)flat_ast_arity(type);
+    if (ast->stack_depth > ast->stack_size) {
+        ast->stack_size = ast->stack_depth;
+    }
+
+    return true;
+}
+
+bool flat_ast_push_int(struct FlatAst *ast, int value) {
+    return flat_ast_add_node(ast, NODE_INT, (union FlatAstArg){ .value = value });
+}
+
+bool flat_ast_push_var(struct FlatAst *ast, const struct Symbol *symbol) {
+    // entries of variables dropped by a failed fast_parse_flat() are stale
+    const ptrdiff_t index = symbol_map_get(&ast->var_map, symbol);
+    uint32_t var;
+    if (index >= 0 && (size_t)index < ast->vars_size && ast->vars[index] == symbol) {
+        var = (uint32_t)index;
+    } else {
+        if (ast->vars_size >= UINT32_MAX) {
+            errno = ENOMEM;
+            return false;
+        }
+
+        if (ast->vars_size == ast->vars_capacity) {
+            const size_t new_capacity = ast->vars_capacity == 0 ? 8 : ast->vars_capacity * 2;
+            const struct Symbol **vars = realloc(ast->vars, new_capacity * sizeof(struct Symbol*));
+            if (vars == NULL) {
+                return false;
+            }
+            ast->vars = vars;
+            ast->vars_capacity = new_capacity;
+        }
+        var = (uint32_t)ast->vars_size;
+        if (!symbol_map_put(&ast->var_map, symbol, var)) {
+            return false;
+        }
+        ast->vars[ast->vars_size ++] = symbol;
+    }
+
+    return flat_ast_add_node(ast, NODE_VAR, (union FlatAstArg){ .var = var });
+}
+
+bool flat_ast_push(struct FlatAst *ast, enum NodeType type) {
+    const int arity = flat_ast_arity(type);
+    if (arity == 0 || ast->nodes_size == 0) {
+        errno = EINVAL;
+        return false;
+    }
+
+    // walk from the last child back to the first, each ends right before the
+    // first node of the next one
+    uint32_t roots[3];
+    roots[arity - 1] = (uint32_t)ast->nodes_size - 1;
+    for (int child = arity - 1; child > 0; -- child) {
+        const uint32_t first = flat_ast_first_intern(ast, roots[child]);
+        if (first == 0) {
+            errno = EINVAL;
+            return false;
+        }
+        roots[child - 1] = first - 1;
+    }
+
+    const uint32_t node = (uint32_t)ast->nodes_size;
+    const uint32_t first = flat_ast_first_intern(ast, roots[0]);
+    if (!flat_ast_add_node(ast, type, (union FlatAstArg){ .first = first })) {
+        return false;
+    }
+
+    switch (type) {
+        case NODE_IF:
+            ast->flows[roots[0]] = FLAT_AST_IF_COND;
+            ast->jumps[roots[0]] = roots[1] + 1;
+            ast->flows[roots[1]] = FLAT_AST_IF_THEN;
+            ast->jumps[roots[1]] = node;
+            break;
+
+        case NODE_AND:
+            ast->flows[roots[0]] = FLAT_AST_AND_LHS;
+            ast->jumps[roots[0]] = node;
+            break;
+
+        case NODE_OR:
+            ast->flows[roots[0]] = FLAT_AST_OR_LHS;
+            ast->jumps[roots[0]] = node;
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+bool flat_ast_from_ast(struct FlatAst *ast, const struct AstNode *expr) {
+    switch (expr->type) {
+        case NODE_INT:
+            return flat_ast_push_int(ast, expr->data.value);
+
+        case NODE_VAR:
+            return flat_ast_push_var(ast, expr->data.symbol);
+
+        case NODE_NEG:
+        case NODE_BIT_NEG:
+        case NODE_NOT:
+            return (
+                flat_ast_from_ast(ast, expr->data.child) &&
+                flat_ast_push(ast, expr->type)
+            );
+
+        case NODE_IF:
+            return (
+                flat_ast_from_ast(ast, expr->data.terneary.cond) &&
+                flat_ast_from_ast(ast, expr->data.terneary.then_expr) &&
+                flat_ast_from_ast(ast, expr->data.terneary.else_expr) &&
+                flat_ast_push(ast, expr->type)
+            );
+
+        default:
+            return (
+                flat_ast_from_ast(ast, expr->data.binary.lhs) &&
+                flat_ast_from_ast(ast, expr->data.binary.rhs) &&
+                flat_ast_push(ast, expr->type)
+            );
+    }
+}
+
+#define BINARY_OP(OP)                                  \
+    -- top;                                            \
+    stack[top - 1] = stack[top - 1] OP stack[top];     \
+    break;
+
+int flat_ast_execute(const struct FlatAst *ast, const int values[], int *stack) {
+    assert(ast->nodes_size > 0 && ast->stack_depth == 1);
+
+    const uint8_t *types = ast->types;
+    const union FlatAstArg *args = ast->args;
+    const uint8_t *flows = ast->flows;
+    const uint32_t nodes_size = (uint32_t)ast->nodes_size;
+
+    size_t top = 0; // number of values on the stack
+    for (uint32_t node = 0; node < nodes_size; ++ node) {
+        switch (types[node]) {
+            case NODE_INT:
+                stack[top ++] = args[node].value;
+                break;
+
+            case NODE_VAR:
+                stack[top ++] = values[args[node].var];
+                break;
+
+            case NODE_NEG:
+                stack[top - 1] = -stack[top - 1];
+                break;
+
+            case NODE_BIT_NEG:
+                stack[top - 1] = ~stack[top - 1];
+                break;
+
+            case NODE_NOT:
+                stack[top - 1] = !stack[top - 1];
+                break;
+
+            case NODE_IF:
+                // the value of the taken branch is already on the stack
+                break;
+
+            case NODE_AND:
+            case NODE_OR:
+                // the right hand side, or the left hand side if it decided
+                stack[top - 1] = stack[top - 1] != 0;
+                break;
+
+            case NODE_ADD:    BINARY_OP(+)
+            case NODE_SUB:    BINARY_OP(-)
+            case NODE_MUL:    BINARY_OP(*)
+            case NODE_DIV:    BINARY_OP(/)
+            case NODE_MOD:    BINARY_OP(%)
+            case NODE_LT:     BINARY_OP(<)
+            case NODE_GT:     BINARY_OP(>)
+            case NODE_LE:     BINARY_OP(<=)
+            case NODE_GE:     BINARY_OP(>=)
+            case NODE_EQ:     BINARY_OP(==)
+            case NODE_NE:     BINARY_OP(!=)
+            case NODE_BIT_AND: BINARY_OP(&)
+            case NODE_BIT_OR:  BINARY_OP(|)
+            case NODE_BIT_XOR: BINARY_OP(^)
+            case NODE_LSHIFT:  BINARY_OP(<<)
+            case NODE_RSHIFT:  BINARY_OP(>>)
+
+            default:
+                assert(false);
+                return 0;
+        }
+
+        // only the roots of a few branches have a flow, jumps go to the node
+        // before the target because of ++ node
+        const uint8_t flow = flows[node];
+        if (__builtin_expect(flow != FLAT_AST_NEXT, 0)) {
+            const int value = stack[top - 1];
+            if (flow == FLAT_AST_IF_THEN) {
+                node = ast->jumps[node] - 1;
+            } else if (flow == FLAT_AST_IF_COND) {
+                -- top;
+                if (value == 0) {
+                    node = ast->jumps[node] - 1;
+                }
+            } else if ((value != 0) == (flow == FLAT_AST_OR_LHS)) {
+                // && with a false or || with a true left hand side
+                node = ast->jumps[node] - 1;
+            } else {
+                -- top;
+            }
+        }
+    }
+
+    assert(top == 1);
+    return stack[0];
+}
+
+int *flat_ast_alloc_scratch(const struct FlatAst *ast) {
+    return calloc(ast->vars_size + ast->stack_size, sizeof(int));
+}
+
+int flat_ast_execute_with_params(const struct FlatAst *ast, const struct Param params[], size_t param_count, int *scratch) {
+    assert(ast->nodes_size > 0);
+
+    // the values of the variables followed by the stack
+    for (size_t var = 0; var < ast->vars_size; ++ var) {
+        scratch[var] = params_get(params, param_count, ast->vars[var]->name);
+    }
+
+    return flat_ast_execute(ast, scratch, scratch + ast->vars_size);
+}
+
+void flat_ast_clear(struct FlatAst *ast) {
+    ast->nodes_size = 0;
+    ast->vars_size = 0;
+    symbol_map_clear(&ast->var_map);
+    ast->stack_depth = 0;
+    ast->stack_size = 0;
+}
+
+void flat_ast_free(struct FlatAst *ast) {
+    flat_ast_clear(ast);
+    free(ast->types);
+    free(ast->args);
+    free(ast->flows);
+    free(ast->jumps);
+    free(ast->vars);
+    symbol_map_free(&ast->var_map);
+
+    *ast = (struct FlatAst)FLAT_AST_INIT();
+}
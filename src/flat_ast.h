@@ -0,0 +1,103 @@
+#ifndef MINMATH_FLAT_AST_H__
+#define MINMATH_FLAT_AST_H__
+#pragma once
+
+#include "ast.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Flat AST: the nodes of a tree in post-order (children before their parent,
+// the root is the last node) in parallel arrays. The right hand side of a
+// binary node, the child of a unary node and the else branch of an if directly
+// precede their parent. Every other child directly precedes the first node of
+// its next sibling, so an index of the first node of the subtree per inner node
+// is all that's needed to find the children.
+//
+// flat_ast_execute() visits the nodes in the order they are stored with a
+// value stack. The roots of the condition and the then branch of an if and
+// of the left hand side of && and || have a flow that skips the nodes of the
+// branch that isn't taken. A node takes 10 bytes instead of the 32 bytes of a
+// struct AstNode.
+union FlatAstArg {
+    uint32_t first; // inner nodes: index of the first node of the subtree
+    uint32_t var; // NODE_VAR: index into vars
+    int32_t  value; // NODE_INT
+};
+
+// what to do after a node is evaluated, depends on its place in its parent
+enum FlatAstFlow {
+    FLAT_AST_NEXT,    // continue with the next node
+    FLAT_AST_IF_COND, // pop the value, if it is 0 jump to the else branch
+    FLAT_AST_IF_THEN, // jump to the if node, skipping the else branch
+    FLAT_AST_AND_LHS, // if the value is 0 jump to the && node, else pop it
+    FLAT_AST_OR_LHS,  // if the value isn't 0 jump to the || node, else pop it
+};
+
+struct FlatAst {
+    uint8_t *types; // enum NodeType
+    union FlatAstArg *args;
+    uint8_t *flows; // enum FlatAstFlow
+    uint32_t *jumps; // index of the node a flow jumps to, else 0
+    size_t nodes_size;
+    size_t nodes_capacity;
+
+    // the variables in order of their first use
+    const struct Symbol **vars;
+    size_t vars_size;
+    size_t vars_capacity;
+    struct SymbolMap var_map; // index of each symbol in vars
+
+    size_t stack_depth; // number of values after evaluating all the nodes
+    size_t stack_size; // maximal stack depth
+};
+
+#define FLAT_AST_INIT() {         \
+    .types = NULL,                \
+    .args  = NULL,                \
+    .flows = NULL,                \
+    .jumps = NULL,                \
+    .nodes_size = 0,              \
+    .nodes_capacity = 0,          \
+    .vars = NULL,                 \
+    .vars_size = 0,               \
+    .vars_capacity = 0,           \
+    .var_map = SYMBOL_MAP_INIT(), \
+    .stack_depth = 0,             \
+    .stack_size = 0,              \
+}
+
+#define FLAT_AST_ROOT(AST) ((uint32_t)(AST)->nodes_size - 1)
+
+// The flat_ast_push_*() functions append a node, the children of inner nodes
+// have to be pushed before. They return false and set errno on error.
+bool flat_ast_push_int(struct FlatAst *ast, int value);
+bool flat_ast_push_var(struct FlatAst *ast, const struct Symbol *symbol);
+bool flat_ast_push(struct FlatAst *ast, enum NodeType type);
+
+/// appends the nodes of expr, its root becomes the last node
+bool flat_ast_from_ast(struct FlatAst *ast, const struct AstNode *expr);
+/// index of the first node of the subtree of node
+uint32_t flat_ast_first(const struct FlatAst *ast, uint32_t node);
+/// values[index] is the value of vars[index], stack needs to have stack_size
+/// entries
+int  flat_ast_execute(const struct FlatAst *ast, const int values[], int *stack);
+/// scratch buffer of flat_ast_execute_with_params(), NULL on error
+int *flat_ast_alloc_scratch(const struct FlatAst *ast);
+/// params need to be sorted, same as ast_execute_with_params(). Looks up each
+/// variable once. scratch needs vars_size + stack_size entries, e.g. from
+/// flat_ast_alloc_scratch().
+int  flat_ast_execute_with_params(const struct FlatAst *ast, const struct Param params[], size_t param_count, int *scratch);
+void flat_ast_clear(struct FlatAst *ast);
+void flat_ast_free(struct FlatAst *ast);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
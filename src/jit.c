@@ -0,0 +1,639 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "jit.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#   define MINMATH_JIT_X86_64
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+#ifdef MINMATH_JIT_X86_64
+
+// Code generation scheme (System V ABI, params are in rdi):
+//
+// The top of the bytecode stack is cached in eax, the rest of the stack lives
+// on the native stack. INT and VAR push eax before loading the new value, so
+// the very first push is a garbage value that RET pops again. Binary
+// instructions move the right hand side into ecx, pop the left hand side into
+// eax and compute eax = eax OP ecx. If an INT or VAR is directly followed by a
+// binary instruction (and the latter is no jump target) the operand is loaded
+// into ecx directly instead, which saves the push/pop pair.
+//
+// The <op>_INT and <op>_VAR superinstructions load their operand into ecx
+// the same way. INSTR_JZP_<cmp> compares and branches without materializing
+// the boolean.
+//
+// Jumps always use rel32 displacements, which are patched once all code has
+// been emitted.
+//
+// Bytecode with temporaries gets a frame (push rbp; mov rbp, rsp) with the
+// temporaries below rbp and returns with leave, which also drops whatever is
+// left on the native stack. LOAD is fused with a following binary instruction
+// like INT and VAR.
+
+#define IS_BINARY(INSTR) ( \
+    ((INSTR) >= INSTR_ADD && (INSTR) <= INSTR_NE) || \
+    (INSTR) == INSTR_LSHIFT || (INSTR) == INSTR_RSHIFT)
+
+#define JIT_STAGGER (3 * 64)
+
+// the instruction of an <op>_INT, <op>_INT_WIDE or <op>_VAR superinstruction,
+// in enum order
+static const enum Instr ARG_BINARY_INSTRS[] = {
+    INSTR_ADD, INSTR_SUB, INSTR_MUL, INSTR_DIV, INSTR_MOD,
+    INSTR_BIT_AND, INSTR_BIT_XOR, INSTR_BIT_OR,
+    INSTR_LT, INSTR_LE, INSTR_GT, INSTR_GE, INSTR_EQ, INSTR_NE,
+    INSTR_LSHIFT, INSTR_RSHIFT,
+};
+
+struct JitBuffer {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+struct JitFixup {
+    size_t code_offset;
+    size_t target;
+};
+
+static bool jit_emit(struct JitBuffer *buf, const uint8_t *bytes, size_t count) {
+    if (buf->capacity - buf->size < count) {
+        size_t new_capacity = buf->capacity == 0 ? 256 : buf->capacity;
+        while (new_capacity - buf->size < count) {
+            if (new_capacity > PTRDIFF_MAX / 2) {
+                errno = ENOMEM;
+                return false;
+            }
+            new_capacity *= 2;
+        }
+
+        uint8_t *data = realloc(buf->data, new_capacity);
+        if (data == NULL) {
+            return false;
+        }
+
+        buf->data = data;
+        buf->capacity = new_capacity;
+    }
+
+    memcpy(buf->data + buf->size, bytes, count);
+    buf->size += count;
+
+    return true;
+}
+
+#define EMIT(BUF, ...) \
+    jit_emit((BUF), (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ }))
+
+static bool jit_emit_u32(struct JitBuffer *buf, uint32_t value) {
+    const uint8_t bytes[4] = {
+        value & 0xFF,
+        (value >> 8) & 0xFF,
+        (value >> 16) & 0xFF,
+        (value >> 24) & 0xFF,
+    };
+    return jit_emit(buf, bytes, sizeof(bytes));
+}
+
+// emits eax = eax OP ecx
+static bool jit_emit_binary(struct JitBuffer *buf, enum Instr instr) {
+    switch (instr) {
+        case INSTR_ADD:     return EMIT(buf, 0x01, 0xC8);             // add eax, ecx
+        case INSTR_SUB:     return EMIT(buf, 0x29, 0xC8);             // sub eax, ecx
+        case INSTR_MUL:     return EMIT(buf, 0x0F, 0xAF, 0xC1);       // imul eax, ecx
+        case INSTR_DIV:     return EMIT(buf, 0x99, 0xF7, 0xF9);       // cdq; idiv ecx
+        case INSTR_MOD:     return EMIT(buf, 0x99, 0xF7, 0xF9,        // cdq; idiv ecx
+                                             0x89, 0xD0);             // mov eax, edx
+        case INSTR_BIT_AND: return EMIT(buf, 0x21, 0xC8);             // and eax, ecx
+        case INSTR_BIT_XOR: return EMIT(buf, 0x31, 0xC8);             // xor eax, ecx
+        case INSTR_BIT_OR:  return EMIT(buf, 0x09, 0xC8);             // or eax, ecx
+        case INSTR_LSHIFT:  return EMIT(buf, 0xD3, 0xE0);             // shl eax, cl
+        case INSTR_RSHIFT:  return EMIT(buf, 0xD3, 0xF8);             // sar eax, cl
+
+        case INSTR_LT:
+        case INSTR_LE:
+        case INSTR_GT:
+        case INSTR_GE:
+        case INSTR_EQ:
+        case INSTR_NE:
+        {
+            const uint8_t setcc =
+                instr == INSTR_LT ? 0x9C :
+                instr == INSTR_LE ? 0x9E :
+                instr == INSTR_GT ? 0x9F :
+                instr == INSTR_GE ? 0x9D :
+                instr == INSTR_EQ ? 0x94 :
+                                    0x95;
+            return EMIT(buf,
+                0x39, 0xC8,        // cmp eax, ecx
+                0x0F, setcc, 0xC0, // setcc al
+                0x0F, 0xB6, 0xC0); // movzx eax, al
+        }
+
+        default:
+            assert(false);
+            errno = EINVAL;
+            return false;
+    }
+}
+
+// checks and emits the displacement of a parameter
+static bool jit_emit_param_disp(struct JitBuffer *buf, const struct Bytecode *bytecode, size_t addr) {
+    if (addr >= bytecode->params_size || addr > INT32_MAX / sizeof(int)) {
+        errno = ERANGE;
+        return false;
+    }
+    return jit_emit_u32(buf, (uint32_t)(addr * sizeof(int)));
+}
+
+// checks and emits the displacement of a temporary relative to rbp
+static bool jit_emit_temp_disp(struct JitBuffer *buf, const struct Bytecode *bytecode, size_t temp) {
+    if (temp >= bytecode->temps_size || temp >= INT32_MAX / sizeof(int)) {
+        errno = ERANGE;
+        return false;
+    }
+    return jit_emit_u32(buf, (uint32_t)-(int32_t)((temp + 1) * sizeof(int)));
+}
+
+// emits the return of eax for RET_* instructions, the native stack holds no
+// values of the bytecode stack
+static bool jit_emit_ret(struct JitBuffer *buf, bool frame) {
+    return frame ?
+        EMIT(buf, 0xC9, 0xC3) : // leave; ret
+        EMIT(buf, 0xC3);        // ret
+}
+
+static bool jit_emit_jump(struct JitBuffer *buf, struct JitFixup *fixups, size_t *fixups_size, size_t target) {
+    fixups[*fixups_size].code_offset = buf->size;
+    fixups[*fixups_size].target = target;
+    ++ *fixups_size;
+    return jit_emit_u32(buf, 0);
+}
+
+static bool jit_emit_code(struct JitBuffer *buf, const struct Bytecode *bytecode,
+                          const bool *is_target, size_t *offsets,
+                          struct JitFixup *fixups, size_t *fixups_size) {
+    const uint32_t *instrs = bytecode->instrs;
+    const bool frame = bytecode->temps_size > 0;
+    size_t addr;
+    int value;
+
+    if (frame) {
+        if (bytecode->temps_size > INT32_MAX / sizeof(int)) {
+            errno = ERANGE;
+            return false;
+        }
+        if (!EMIT(buf,
+                0x55,                // push rbp
+                0x48, 0x89, 0xE5,    // mov rbp, rsp
+                0x48, 0x81, 0xEC) || // sub rsp, imm32
+            !jit_emit_u32(buf, (uint32_t)(bytecode->temps_size * sizeof(int)))) {
+            return false;
+        }
+    }
+
+    for (size_t index = 0; index < bytecode->instrs_size;) {
+        const uint32_t word = instrs[index];
+        const enum Instr instr = BYTECODE_INSTR(word);
+        offsets[index] = buf->size;
+
+        switch (instr) {
+            case INSTR_INT:
+            case INSTR_INT_WIDE:
+            case INSTR_VAR:
+            case INSTR_VAR_WIDE:
+            case INSTR_LOAD:
+            {
+                const size_t next = index + bytecode_instr_size(instr);
+                const bool fuse = next < bytecode->instrs_size && !is_target[next] && IS_BINARY(BYTECODE_INSTR(instrs[next]));
+
+                if (instr == INSTR_LOAD) {
+                    if (!(fuse ?
+                            EMIT(buf, 0x8B, 0x8D) :      // mov ecx, [rbp + disp32]
+                            EMIT(buf, 0x50, 0x8B, 0x85)) // push rax; mov eax, [rbp + disp32]
+                            || !jit_emit_temp_disp(buf, bytecode, BYTECODE_UARG(word))) {
+                        return false;
+                    }
+                } else if (instr != INSTR_VAR && instr != INSTR_VAR_WIDE) {
+                    value = instr == INSTR_INT ? BYTECODE_ARG(word) : (int32_t)instrs[index + 1];
+                    if (!(fuse ?
+                            EMIT(buf, 0xB9) :        // mov ecx, imm32
+                            EMIT(buf, 0x50, 0xB8))   // push rax; mov eax, imm32
+                            || !jit_emit_u32(buf, (uint32_t)value)) {
+                        return false;
+                    }
+                } else {
+                    addr = instr == INSTR_VAR ? BYTECODE_UARG(word) : instrs[index + 1];
+                    if (!(fuse ?
+                            EMIT(buf, 0x8B, 0x8F) :      // mov ecx, [rdi + disp32]
+                            EMIT(buf, 0x50, 0x8B, 0x87)) // push rax; mov eax, [rdi + disp32]
+                            || !jit_emit_param_disp(buf, bytecode, addr)) {
+                        return false;
+                    }
+                }
+
+                if (fuse) {
+                    if (!jit_emit_binary(buf, BYTECODE_INSTR(instrs[next]))) {
+                        return false;
+                    }
+                    index = next + 1;
+                } else {
+                    index = next;
+                }
+                break;
+            }
+            case INSTR_ADD:
+            case INSTR_SUB:
+            case INSTR_MUL:
+            case INSTR_DIV:
+            case INSTR_MOD:
+            case INSTR_BIT_AND:
+            case INSTR_BIT_XOR:
+            case INSTR_BIT_OR:
+            case INSTR_LT:
+            case INSTR_LE:
+            case INSTR_GT:
+            case INSTR_GE:
+            case INSTR_EQ:
+            case INSTR_NE:
+            case INSTR_LSHIFT:
+            case INSTR_RSHIFT:
+                if (!EMIT(buf, 0x89, 0xC1, 0x58) || // mov ecx, eax; pop rax
+                    !jit_emit_binary(buf, instr)) {
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_NEG:
+                if (!EMIT(buf, 0xF7, 0xD8)) { // neg eax
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_BIT_NEG:
+                if (!EMIT(buf, 0xF7, 0xD0)) { // not eax
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_NOT:
+            case INSTR_BOOL:
+                if (!EMIT(buf,
+                        0x85, 0xC0,                                   // test eax, eax
+                        0x0F, instr == INSTR_NOT ? 0x94 : 0x95, 0xC0, // sete/setne al
+                        0x0F, 0xB6, 0xC0)) {                          // movzx eax, al
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_JMP:
+            case INSTR_JEZ:
+            case INSTR_JNZ:
+            case INSTR_JZP:
+            case INSTR_JMP_WIDE:
+            case INSTR_JEZ_WIDE:
+            case INSTR_JNZ_WIDE:
+            case INSTR_JZP_WIDE:
+            {
+                bytecode_get_jump_target(bytecode, index, &addr);
+
+                // the wide jumps only differ in the encoding of the offset
+                const enum Instr jump = instr >= INSTR_JMP_WIDE ? INSTR_JMP + (instr - INSTR_JMP_WIDE) : instr;
+
+                bool ok;
+                switch (jump) {
+                    case INSTR_JMP:
+                        ok = EMIT(buf, 0xE9); // jmp rel32
+                        break;
+
+                    case INSTR_JEZ:
+                        ok = EMIT(buf, 0x85, 0xC0, 0x0F, 0x84); // test eax, eax; jz rel32
+                        break;
+
+                    case INSTR_JNZ:
+                        ok = EMIT(buf,
+                            0x85, 0xC0,                   // test eax, eax
+                            0x74, 0x0A,                   // jz +10
+                            0xB8, 0x01, 0x00, 0x00, 0x00, // mov eax, 1
+                            0xE9);                        // jmp rel32
+                        break;
+
+                    default:
+                        ok = EMIT(buf, 0x85, 0xC0, 0x58, 0x0F, 0x84); // test eax, eax; pop rax; jz rel32
+                        break;
+                }
+
+                if (!ok || !jit_emit_jump(buf, fixups, fixups_size, addr)) {
+                    return false;
+                }
+
+                if ((jump == INSTR_JEZ || jump == INSTR_JNZ) && !EMIT(buf, 0x58)) { // pop rax
+                    return false;
+                }
+
+                index += bytecode_instr_size(instr);
+                break;
+            }
+            case INSTR_RET:
+                if (!(frame ?
+                        EMIT(buf, 0xC9, 0xC3) :  // leave; ret
+                        EMIT(buf, 0x59, 0xC3))) { // pop rcx; ret
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_STORE:
+                if (!EMIT(buf, 0x89, 0x85) || // mov [rbp + disp32], eax
+                    !jit_emit_temp_disp(buf, bytecode, BYTECODE_UARG(word))) {
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_ADD_INT:
+            case INSTR_SUB_INT:
+            case INSTR_MUL_INT:
+            case INSTR_DIV_INT:
+            case INSTR_MOD_INT:
+            case INSTR_BIT_AND_INT:
+            case INSTR_BIT_XOR_INT:
+            case INSTR_BIT_OR_INT:
+            case INSTR_LT_INT:
+            case INSTR_LE_INT:
+            case INSTR_GT_INT:
+            case INSTR_GE_INT:
+            case INSTR_EQ_INT:
+            case INSTR_NE_INT:
+            case INSTR_LSHIFT_INT:
+            case INSTR_RSHIFT_INT:
+                value = BYTECODE_ARG(word);
+                if (!EMIT(buf, 0xB9) || // mov ecx, imm32
+                    !jit_emit_u32(buf, (uint32_t)value) ||
+                    !jit_emit_binary(buf, ARG_BINARY_INSTRS[instr - INSTR_ADD_INT])) {
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_ADD_VAR:
+            case INSTR_SUB_VAR:
+            case INSTR_MUL_VAR:
+            case INSTR_DIV_VAR:
+            case INSTR_MOD_VAR:
+            case INSTR_BIT_AND_VAR:
+            case INSTR_BIT_XOR_VAR:
+            case INSTR_BIT_OR_VAR:
+            case INSTR_LT_VAR:
+            case INSTR_LE_VAR:
+            case INSTR_GT_VAR:
+            case INSTR_GE_VAR:
+            case INSTR_EQ_VAR:
+            case INSTR_NE_VAR:
+            case INSTR_LSHIFT_VAR:
+            case INSTR_RSHIFT_VAR:
+                addr = BYTECODE_UARG(word);
+                if (!EMIT(buf, 0x8B, 0x8F) || // mov ecx, [rdi + disp32]
+                    !jit_emit_param_disp(buf, bytecode, addr) ||
+                    !jit_emit_binary(buf, ARG_BINARY_INSTRS[instr - INSTR_ADD_VAR])) {
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_ADD_INT_WIDE:
+            case INSTR_SUB_INT_WIDE:
+            case INSTR_MUL_INT_WIDE:
+            case INSTR_DIV_INT_WIDE:
+            case INSTR_MOD_INT_WIDE:
+            case INSTR_BIT_AND_INT_WIDE:
+            case INSTR_BIT_XOR_INT_WIDE:
+            case INSTR_BIT_OR_INT_WIDE:
+            case INSTR_LT_INT_WIDE:
+            case INSTR_LE_INT_WIDE:
+            case INSTR_GT_INT_WIDE:
+            case INSTR_GE_INT_WIDE:
+            case INSTR_EQ_INT_WIDE:
+            case INSTR_NE_INT_WIDE:
+            case INSTR_LSHIFT_INT_WIDE:
+            case INSTR_RSHIFT_INT_WIDE:
+                if (!EMIT(buf, 0xB9) || // mov ecx, imm32
+                    !jit_emit_u32(buf, instrs[index + 1]) ||
+                    !jit_emit_binary(buf, ARG_BINARY_INSTRS[instr - INSTR_ADD_INT_WIDE])) {
+                    return false;
+                }
+                index += 2;
+                break;
+
+            case INSTR_JZP_LT:
+            case INSTR_JZP_LE:
+            case INSTR_JZP_GT:
+            case INSTR_JZP_GE:
+            case INSTR_JZP_EQ:
+            case INSTR_JZP_NE:
+            {
+                // jump if the comparison is false
+                const uint8_t jcc =
+                    instr == INSTR_JZP_LT ? 0x8D : // jge
+                    instr == INSTR_JZP_LE ? 0x8F : // jg
+                    instr == INSTR_JZP_GT ? 0x8E : // jle
+                    instr == INSTR_JZP_GE ? 0x8C : // jl
+                    instr == INSTR_JZP_EQ ? 0x85 : // jne
+                                            0x84;  // je
+                bytecode_get_jump_target(bytecode, index, &addr);
+                if (!EMIT(buf,
+                        0x89, 0xC1,   // mov ecx, eax
+                        0x5A,         // pop rdx
+                        0x39, 0xCA,   // cmp edx, ecx
+                        0x58,         // pop rax
+                        0x0F, jcc) || // jcc rel32
+                    !jit_emit_jump(buf, fixups, fixups_size, addr)) {
+                    return false;
+                }
+                ++ index;
+                break;
+            }
+            case INSTR_JZP_VAR:
+            {
+                size_t target;
+                addr = BYTECODE_UARG(word);
+                bytecode_get_jump_target(bytecode, index, &target);
+                if (!EMIT(buf, 0x83, 0xBF) ||                 // cmp dword [rdi + disp32], imm8
+                    !jit_emit_param_disp(buf, bytecode, addr) ||
+                    !EMIT(buf, 0x00, 0x0F, 0x84) ||           // 0; jz rel32
+                    !jit_emit_jump(buf, fixups, fixups_size, target)) {
+                    return false;
+                }
+                index += 2;
+                break;
+            }
+            case INSTR_RET_INT:
+                if (!EMIT(buf, 0xB8) ||                // mov eax, imm32
+                    !jit_emit_u32(buf, (uint32_t)BYTECODE_ARG(word)) ||
+                    !jit_emit_ret(buf, frame)) {
+                    return false;
+                }
+                ++ index;
+                break;
+
+            case INSTR_RET_INT_WIDE:
+                if (!EMIT(buf, 0xB8) ||                // mov eax, imm32
+                    !jit_emit_u32(buf, instrs[index + 1]) ||
+                    !jit_emit_ret(buf, frame)) {
+                    return false;
+                }
+                index += 2;
+                break;
+
+            case INSTR_RET_VAR:
+                if (!EMIT(buf, 0x8B, 0x87) ||          // mov eax, [rdi + disp32]
+                    !jit_emit_param_disp(buf, bytecode, BYTECODE_UARG(word)) ||
+                    !jit_emit_ret(buf, frame)) {
+                    return false;
+                }
+                ++ index;
+                break;
+
+            default:
+                assert(false);
+                errno = EINVAL;
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool jit_compile(struct JitCode *jit, const struct Bytecode *bytecode) {
+    const size_t instrs_size = bytecode->instrs_size;
+    struct JitBuffer buf = { .data = NULL, .size = 0, .capacity = 0 };
+    bool *is_target = calloc(instrs_size + 1, sizeof(bool));
+    size_t *offsets = calloc(instrs_size + 1, sizeof(size_t));
+    struct JitFixup *fixups = NULL;
+    size_t fixups_size = 0;
+    size_t jump_count = 0;
+    bool ok = false;
+
+    if (is_target == NULL || offsets == NULL) {
+        goto cleanup;
+    }
+
+    // find jump targets, they can't be fused with their preceding instruction
+    for (size_t index = 0; index < instrs_size;) {
+        const enum Instr instr = BYTECODE_INSTR(bytecode->instrs[index]);
+        if (instr >= INSTR_COUNT || bytecode_instr_size(instr) > instrs_size - index) {
+            errno = EINVAL;
+            goto cleanup;
+        }
+
+        size_t addr;
+        if (bytecode_get_jump_target(bytecode, index, &addr)) {
+            if (addr >= instrs_size) {
+                errno = EINVAL;
+                goto cleanup;
+            }
+            is_target[addr] = true;
+            ++ jump_count;
+        }
+
+        index += bytecode_instr_size(instr);
+    }
+
+    fixups = calloc(jump_count + 1, sizeof(struct JitFixup));
+    if (fixups == NULL) {
+        goto cleanup;
+    }
+
+    if (!jit_emit_code(&buf, bytecode, is_target, offsets, fixups, &fixups_size)) {
+        goto cleanup;
+    }
+
+    for (size_t index = 0; index < fixups_size; ++ index) {
+        const struct JitFixup *fixup = &fixups[index];
+        const ptrdiff_t rel = (ptrdiff_t)offsets[fixup->target] - (ptrdiff_t)(fixup->code_offset + 4);
+        if (rel < INT32_MIN || rel > INT32_MAX) {
+            errno = ERANGE;
+            goto cleanup;
+        }
+        const uint32_t rel32 = (uint32_t)(int32_t)rel;
+        buf.data[fixup->code_offset    ] =  rel32        & 0xFF;
+        buf.data[fixup->code_offset + 1] = (rel32 >>  8) & 0xFF;
+        buf.data[fixup->code_offset + 2] = (rel32 >> 16) & 0xFF;
+        buf.data[fixup->code_offset + 3] = (rel32 >> 24) & 0xFF;
+    }
+
+    // Every function gets its own pages so that W^X can be kept without
+    // touching other functions. Page aligned entry points would all map to
+    // the same L1i cache sets, though, so the start is staggered in steps of
+    // a few cache lines. (A data race on the counter is harmless.)
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    static size_t jit_counter = 0;
+    const size_t code_offset = (jit_counter ++ * JIT_STAGGER) % (page_size / 2);
+    const size_t code_size = (code_offset + buf.size + page_size - 1) / page_size * page_size;
+    void *code = mmap(NULL, code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        goto cleanup;
+    }
+
+    memcpy((uint8_t*)code + code_offset, buf.data, buf.size);
+
+    if (mprotect(code, code_size, PROT_READ | PROT_EXEC) != 0) {
+        const int errnum = errno;
+        munmap(code, code_size);
+        errno = errnum;
+        goto cleanup;
+    }
+
+    jit_free(jit);
+    jit->code = code;
+    jit->code_size = code_size;
+    jit->func = (JitFunc)((uint8_t*)code + code_offset);
+    ok = true;
+
+cleanup:
+    free(buf.data);
+    free(is_target);
+    free(offsets);
+    free(fixups);
+
+    return ok;
+}
+
+void jit_free(struct JitCode *jit) {
+    if (jit->code != NULL) {
+        munmap(jit->code, jit->code_size);
+    }
+    jit->func = NULL;
+    jit->code = NULL;
+    jit->code_size = 0;
+}
+
+#else
+
+bool jit_compile(struct JitCode *jit, const struct Bytecode *bytecode) {
+    (void)jit;
+    (void)bytecode;
+    errno = ENOSYS;
+    return false;
+}
+
+void jit_free(struct JitCode *jit) {
+    jit->func = NULL;
+    jit->code = NULL;
+    jit->code_size = 0;
+}
+
+#endif
+
+int jit_execute(const struct JitCode *jit, const int *params) {
+    return jit->func(params);
+}
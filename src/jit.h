@@ -0,0 +1,41 @@
+#ifndef MINMATH_JIT_H__
+#define MINMATH_JIT_H__
+#pragma once
+
+#include "bytecode.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Takes the same params as bytecode_execute() for the bytecode it was compiled
+// from.
+typedef int (*JitFunc)(const int *params);
+
+struct JitCode {
+    JitFunc func;
+    void *code;
+    size_t code_size;
+};
+
+#define JIT_CODE_INIT() { \
+    .func = NULL,         \
+    .code = NULL,         \
+    .code_size = 0,       \
+}
+
+// Compiles bytecode to x86-64 machine code. Fails with ENOSYS on other
+// platforms and with the errno of mmap()/mprotect() if executable memory is
+// not available.
+bool jit_compile(struct JitCode *jit, const struct Bytecode *bytecode);
+int  jit_execute(const struct JitCode *jit, const int *params);
+void jit_free(struct JitCode *jit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,6 +12,8 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     int status = 0;
+    struct AstEnviron env = AST_ENVIRON_INIT();
+    struct SymbolTable symbols = SYMBOL_TABLE_INIT();
     for (int argind = 1; argind < argc; ++ argind) {
         struct AstNode *expr;
         struct ErrorInfo error;
@@ -29,15 +31,23 @@ int main(int argc, char *argv[]) {
         }
 #endif
 
-        expr = fast_parse(source, &error);
+        expr = fast_parse(&symbols, source, &error);
         if (expr != NULL) {
-            int value = ast_execute_with_environ(expr);
+            // one snapshot for both trees, the optimized tree keeps the slots
+            // of the parsed tree and sees the same values
+            if (!ast_environ_snapshot(&env, expr)) {
+                perror(source);
+                ast_free(expr);
+                status = 1;
+                continue;
+            }
+            int value = ast_execute_with_snapshot(expr, &env);
             printf("%s = %d\n", source, value);
 
             struct AstNode *opt_expr = ast_optimize(expr);
             if (opt_expr != NULL) {
-                int value = ast_execute_with_environ(opt_expr);
                 ast_print(stdout, opt_expr);
+                value = ast_execute_with_snapshot(opt_expr, &env);
                 printf(" = %d\n", value);
                 ast_free(opt_expr);
             } else {
@@ -51,5 +61,7 @@ int main(int argc, char *argv[]) {
             status = 1;
         }
     }
+    ast_environ_free(&env);
+    symbol_table_free(&symbols);
     return status;
 }
@@ -1,4 +1,6 @@
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
@@ -22,26 +24,28 @@ static inline bool ast_is_boolean(const struct AstNode *expr) {
     }
 }
 
-static inline struct AstNode *ast_create_bool(struct AstNode *child) {
+static inline struct AstNode *ast_create_bool(struct Arena *arena, struct AstNode *child) {
     if (ast_is_boolean(child)) {
         return child;
     }
 
-    struct AstNode *bool1 = ast_create_unary(NODE_NOT, child);
+    struct AstNode *bool1 = ast_create_unary_in(arena, NODE_NOT, child);
     if (bool1 == NULL) {
-        ast_free(child);
+        ast_free_in(arena, child);
         return NULL;
     }
 
-    struct AstNode *bool2 = ast_create_unary(NODE_NOT, bool1);
+    struct AstNode *bool2 = ast_create_unary_in(arena, NODE_NOT, bool1);
     if (bool2 == NULL) {
-        ast_free(bool1);
+        ast_free_in(arena, bool1);
         return NULL;
     }
 
     return bool2;
 }
 
+static struct AstNode *ast_fold(struct Arena *arena, const struct AstNode *expr, const struct Param params[], size_t param_count);
+
 static inline int factor_to_shift_count(int factor) {
     for (int bit_pos = 0; bit_pos < 32; ++ bit_pos) {
         if (factor & (1 << bit_pos)) {
@@ -55,17 +59,34 @@ static inline int factor_to_shift_count(int factor) {
     return 0;
 }
 
-// This optimizer just does simple constant folding.
 struct AstNode *ast_optimize(const struct AstNode *expr) {
+    return ast_optimize_in(NULL, expr);
+}
+
+struct AstNode *ast_optimize_in(struct Arena *arena, const struct AstNode *expr) {
+    return ast_fold(arena, expr, NULL, 0);
+}
+
+struct AstNode *ast_specialize(const struct AstNode *expr, const struct Param params[], size_t param_count) {
+    return ast_specialize_in(NULL, expr, params, param_count);
+}
+
+struct AstNode *ast_specialize_in(struct Arena *arena, const struct AstNode *expr, const struct Param params[], size_t param_count) {
+    return ast_fold(arena, expr, params, param_count);
+}
+
+// This optimizer just does simple constant folding. Variables that are in
+// params are folded as constants, which makes branches on them go away.
+static struct AstNode *ast_fold(struct Arena *arena, const struct AstNode *expr, const struct Param params[], size_t param_count) {
     assert(expr != NULL);
 
     if (ast_is_binary(expr)) {
-        struct AstNode *lhs = ast_optimize(expr->data.binary.lhs);
-        struct AstNode *rhs = ast_optimize(expr->data.binary.rhs);
+        struct AstNode *lhs = ast_fold(arena, expr->data.binary.lhs, params, param_count);
+        struct AstNode *rhs = ast_fold(arena, expr->data.binary.rhs, params, param_count);
 
         if (lhs == NULL || rhs == NULL) {
-            ast_free(lhs);
-            ast_free(rhs);
+            ast_free_in(arena, lhs);
+            ast_free_in(arena, rhs);
             return NULL;
         }
 
@@ -85,11 +106,11 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
 
                 case NODE_DIV:
                     if (rhs->data.value == 0) {
-                        struct AstNode *opt_expr = ast_create_binary(expr->type, lhs, rhs);
+                        struct AstNode *opt_expr = ast_create_binary_in(arena, expr->type, lhs, rhs);
 
                         if (opt_expr == NULL) {
-                            ast_free(lhs);
-                            ast_free(rhs);
+                            ast_free_in(arena, lhs);
+                            ast_free_in(arena, rhs);
                             return NULL;
                         }
 
@@ -100,11 +121,11 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
 
                 case NODE_MOD:
                     if (rhs->data.value == 0) {
-                        struct AstNode *opt_expr = ast_create_binary(expr->type, lhs, rhs);
+                        struct AstNode *opt_expr = ast_create_binary_in(arena, expr->type, lhs, rhs);
 
                         if (opt_expr == NULL) {
-                            ast_free(lhs);
-                            ast_free(rhs);
+                            ast_free_in(arena, lhs);
+                            ast_free_in(arena, rhs);
                             return NULL;
                         }
 
@@ -167,13 +188,13 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
 
                 default:
                     assert(false);
-                    ast_free(lhs);
-                    ast_free(rhs);
+                    ast_free_in(arena, lhs);
+                    ast_free_in(arena, rhs);
                     errno = EINVAL;
                     return NULL;
             }
 
-            ast_free(rhs);
+            ast_free_in(arena, rhs);
             return lhs;
         } else {
             if (expr->type == NODE_AND || expr->type == NODE_OR) {
@@ -181,14 +202,14 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
                 if (lhs->type == NODE_NOT && lhs->data.child->type == NODE_NOT) {
                     tmp = lhs->data.child;
                     lhs->data.child = NULL;
-                    ast_free(lhs);
+                    ast_free_in(arena, lhs);
                     lhs = tmp;
                 }
 
                 if (rhs->type == NODE_NOT && rhs->data.child->type == NODE_NOT) {
                     tmp = rhs->data.child;
                     rhs->data.child = NULL;
-                    ast_free(rhs);
+                    ast_free_in(arena, rhs);
                     rhs = tmp;
                 }
             }
@@ -203,7 +224,7 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
                     expr->type == NODE_RSHIFT
                 ) && rhs->type == NODE_INT && rhs->data.value == 0
             ) {
-                ast_free(rhs);
+                ast_free_in(arena, rhs);
                 return lhs;
             } else if (
                 (
@@ -211,44 +232,44 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
                     expr->type == NODE_BIT_OR
                 ) && lhs->type == NODE_INT && lhs->data.value == 0
             ) {
-                ast_free(lhs);
+                ast_free_in(arena, lhs);
                 return rhs;
             } else if (
                 expr->type == NODE_OR && rhs->type == NODE_INT && rhs->data.value == 0
             ) {
-                ast_free(rhs);
-                return ast_create_bool(lhs);
+                ast_free_in(arena, rhs);
+                return ast_create_bool(arena, lhs);
             } else if (
                 expr->type == NODE_OR && lhs->type == NODE_INT && lhs->data.value == 0
             ) {
-                ast_free(lhs);
-                return ast_create_bool(rhs);
+                ast_free_in(arena, lhs);
+                return ast_create_bool(arena, rhs);
             } else if (
                 expr->type == NODE_OR && (
                     (rhs->type == NODE_INT && rhs->data.value != 0) ||
                     (lhs->type == NODE_INT && lhs->data.value != 0)
                 )
             ) {
-                ast_free(rhs);
-                ast_free(lhs);
-                return ast_create_int(1);
+                ast_free_in(arena, rhs);
+                ast_free_in(arena, lhs);
+                return ast_create_int_in(arena, 1);
             } else if (
                 expr->type == NODE_AND && rhs->type == NODE_INT && rhs->data.value != 0
             ) {
-                ast_free(rhs);
-                return ast_create_bool(lhs);
+                ast_free_in(arena, rhs);
+                return ast_create_bool(arena, lhs);
             } else if (
                 expr->type == NODE_AND && lhs->type == NODE_INT && lhs->data.value != 0
             ) {
-                ast_free(lhs);
-                return ast_create_bool(rhs);
+                ast_free_in(arena, lhs);
+                return ast_create_bool(arena, rhs);
             } else if (
                 expr->type == NODE_SUB && lhs->type == NODE_INT && lhs->data.value == 0
             ) {
-                ast_free(lhs);
-                struct AstNode *opt_expr = ast_create_unary(NODE_NEG, rhs);
+                ast_free_in(arena, lhs);
+                struct AstNode *opt_expr = ast_create_unary_in(arena, NODE_NEG, rhs);
                 if (opt_expr == NULL) {
-                    ast_free(rhs);
+                    ast_free_in(arena, rhs);
                     return NULL;
                 }
                 return opt_expr;
@@ -265,48 +286,48 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
                     expr->type == NODE_MOD
                 ) && lhs->type == NODE_INT && lhs->data.value == 0)
             ) {
-                ast_free(lhs);
-                ast_free(rhs);
-                return ast_create_int(0);
+                ast_free_in(arena, lhs);
+                ast_free_in(arena, rhs);
+                return ast_create_int_in(arena, 0);
             } else if (
                 expr->type == NODE_EQ && lhs->type == NODE_INT && lhs->data.value == 0
             ) {
-                ast_free(lhs);
-                struct AstNode *opt_expr = ast_create_unary(NODE_NOT, rhs);
+                ast_free_in(arena, lhs);
+                struct AstNode *opt_expr = ast_create_unary_in(arena, NODE_NOT, rhs);
                 if (opt_expr == NULL) {
-                    ast_free(rhs);
+                    ast_free_in(arena, rhs);
                     return NULL;
                 }
                 return opt_expr;
             } else if (
                 expr->type == NODE_EQ && rhs->type == NODE_INT && rhs->data.value == 0
             ) {
-                ast_free(rhs);
-                struct AstNode *opt_expr = ast_create_unary(NODE_NOT, lhs);
+                ast_free_in(arena, rhs);
+                struct AstNode *opt_expr = ast_create_unary_in(arena, NODE_NOT, lhs);
                 if (opt_expr == NULL) {
-                    ast_free(lhs);
+                    ast_free_in(arena, lhs);
                     return NULL;
                 }
                 return opt_expr;
             } else if (
                 (expr->type == NODE_MUL || expr->type == NODE_DIV) && rhs->type == NODE_INT && rhs->data.value == 1
             ) {
-                ast_free(rhs);
+                ast_free_in(arena, rhs);
                 return lhs;
             } else if (
                 expr->type == NODE_MUL && lhs->type == NODE_INT && lhs->data.value == 1
             ) {
-                ast_free(lhs);
+                ast_free_in(arena, lhs);
                 return rhs;
             } else if (
                 expr->type == NODE_MUL && rhs->type == NODE_INT && (bit_shift = factor_to_shift_count(rhs->data.value)) > 0
             ) {
                 rhs->data.value = bit_shift;
-                struct AstNode *opt_expr = ast_create_binary(NODE_LSHIFT, lhs, rhs);
+                struct AstNode *opt_expr = ast_create_binary_in(arena, NODE_LSHIFT, lhs, rhs);
 
                 if (opt_expr == NULL) {
-                    ast_free(lhs);
-                    ast_free(rhs);
+                    ast_free_in(arena, lhs);
+                    ast_free_in(arena, rhs);
                     return NULL;
                 }
 
@@ -315,11 +336,11 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
                 expr->type == NODE_MUL && lhs->type == NODE_INT && (bit_shift = factor_to_shift_count(lhs->data.value)) > 0
             ) {
                 lhs->data.value = bit_shift;
-                struct AstNode *opt_expr = ast_create_binary(NODE_LSHIFT, rhs, lhs);
+                struct AstNode *opt_expr = ast_create_binary_in(arena, NODE_LSHIFT, rhs, lhs);
 
                 if (opt_expr == NULL) {
-                    ast_free(lhs);
-                    ast_free(rhs);
+                    ast_free_in(arena, lhs);
+                    ast_free_in(arena, rhs);
                     return NULL;
                 }
 
@@ -328,21 +349,21 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
                 expr->type == NODE_DIV && rhs->type == NODE_INT && (bit_shift = factor_to_shift_count(rhs->data.value)) > 0
             ) {
                 rhs->data.value = bit_shift;
-                struct AstNode *opt_expr = ast_create_binary(NODE_RSHIFT, lhs, rhs);
+                struct AstNode *opt_expr = ast_create_binary_in(arena, NODE_RSHIFT, lhs, rhs);
 
                 if (opt_expr == NULL) {
-                    ast_free(lhs);
-                    ast_free(rhs);
+                    ast_free_in(arena, lhs);
+                    ast_free_in(arena, rhs);
                     return NULL;
                 }
 
                 return opt_expr;
             } else {
-                struct AstNode *opt_expr = ast_create_binary(expr->type, lhs, rhs);
+                struct AstNode *opt_expr = ast_create_binary_in(arena, expr->type, lhs, rhs);
 
                 if (opt_expr == NULL) {
-                    ast_free(lhs);
-                    ast_free(rhs);
+                    ast_free_in(arena, lhs);
+                    ast_free_in(arena, rhs);
                     return NULL;
                 }
 
@@ -350,7 +371,7 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
             }
         }
     } else if (expr->type == NODE_IF) {
-        struct AstNode *cond_expr = ast_optimize(expr->data.terneary.cond);
+        struct AstNode *cond_expr = ast_fold(arena, expr->data.terneary.cond, params, param_count);
 
         if (cond_expr == NULL) {
             return NULL;
@@ -358,26 +379,26 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
 
         if (cond_expr->type == NODE_INT) {
             int cond_value = cond_expr->data.value;
-            ast_free(cond_expr);
+            ast_free_in(arena, cond_expr);
             if (cond_value) {
-                return ast_optimize(expr->data.terneary.then_expr);
+                return ast_fold(arena, expr->data.terneary.then_expr, params, param_count);
             } else {
-                return ast_optimize(expr->data.terneary.else_expr);
+                return ast_fold(arena, expr->data.terneary.else_expr, params, param_count);
             }
         }
 
-        struct AstNode *then_expr = ast_optimize(expr->data.terneary.then_expr);
+        struct AstNode *then_expr = ast_fold(arena, expr->data.terneary.then_expr, params, param_count);
 
         if (then_expr == NULL) {
-            ast_free(cond_expr);
+            ast_free_in(arena, cond_expr);
             return NULL;
         }
 
-        struct AstNode *else_expr = ast_optimize(expr->data.terneary.else_expr);
+        struct AstNode *else_expr = ast_fold(arena, expr->data.terneary.else_expr, params, param_count);
 
         if (else_expr == NULL) {
-            ast_free(cond_expr);
-            ast_free(then_expr);
+            ast_free_in(arena, cond_expr);
+            ast_free_in(arena, then_expr);
             return NULL;
         }
 
@@ -387,26 +408,26 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
             ) {
                 struct AstNode *rhs = cond_expr->data.binary.rhs;
                 cond_expr->data.binary.rhs = NULL;
-                ast_free(cond_expr);
+                ast_free_in(arena, cond_expr);
                 cond_expr = rhs;
             } else if (
                 cond_expr->data.binary.rhs->type == NODE_INT && cond_expr->data.binary.rhs->data.value == 0
             ) {
                 struct AstNode *lhs = cond_expr->data.binary.lhs;
                 cond_expr->data.binary.lhs = NULL;
-                ast_free(cond_expr);
+                ast_free_in(arena, cond_expr);
                 cond_expr = lhs;
             }
         } else if (cond_expr->type == NODE_NOT) {
             if (cond_expr->data.child->type == NODE_NOT) {
                 struct AstNode *tmp = cond_expr->data.child->data.child;
                 cond_expr->data.child->data.child = NULL;
-                ast_free(cond_expr);
+                ast_free_in(arena, cond_expr);
                 cond_expr = tmp;
             } else {
                 struct AstNode *tmp = cond_expr->data.child;
                 cond_expr->data.child = NULL;
-                ast_free(cond_expr);
+                ast_free_in(arena, cond_expr);
                 cond_expr = tmp;
                 tmp = then_expr;
                 then_expr = else_expr;
@@ -414,18 +435,18 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
             }
         }
 
-        struct AstNode *if_expr = ast_create_terneary(cond_expr, then_expr, else_expr);
+        struct AstNode *if_expr = ast_create_terneary_in(arena, cond_expr, then_expr, else_expr);
 
         if (if_expr == NULL) {
-            ast_free(cond_expr);
-            ast_free(then_expr);
-            ast_free(else_expr);
+            ast_free_in(arena, cond_expr);
+            ast_free_in(arena, then_expr);
+            ast_free_in(arena, else_expr);
             return NULL;
         }
 
         return if_expr;
     } else if (ast_is_unary(expr)) {
-        struct AstNode *child = ast_optimize(expr->data.child);
+        struct AstNode *child = ast_fold(arena, expr->data.child, params, param_count);
 
         if (child == NULL) {
             return NULL;
@@ -447,7 +468,7 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
 
             default:
                 assert(false);
-                ast_free(child);
+                ast_free_in(arena, child);
                 errno = EINVAL;
                 return NULL;
             }
@@ -459,29 +480,639 @@ struct AstNode *ast_optimize(const struct AstNode *expr) {
         ) {
             struct AstNode *new_expr = child->data.child;
             child->data.child = NULL;
-            ast_free(child);
+            ast_free_in(arena, child);
             return new_expr;
         }
 
-        struct AstNode *unary_expr = ast_create_unary(expr->type, child);
+        struct AstNode *unary_expr = ast_create_unary_in(arena, expr->type, child);
 
         if (unary_expr == NULL) {
-            ast_free(child);
+            ast_free_in(arena, child);
             return NULL;
         }
 
         return unary_expr;
     } else if (expr->type == NODE_INT) {
-        return ast_create_int(expr->data.value);
+        return ast_create_int_in(arena, expr->data.value);
     } else if (expr->type == NODE_VAR) {
-        char *name = strdup(expr->data.ident);
-        if (name == NULL) {
-            return NULL;
+        const struct Param *param = params_find(params, param_count, expr->data.symbol->name);
+        if (param != NULL) {
+            return ast_create_int_in(arena, param->value);
+        }
+        // keeps the slot, so a copy of a bound tree is bound too
+        struct AstNode *var_expr = ast_create_var_in(arena, expr->data.symbol);
+        if (var_expr != NULL) {
+            var_expr->data.slot = expr->data.slot;
         }
-        return ast_create_var(name);
+        return var_expr;
     } else {
         assert(false);
         errno = EINVAL;
         return NULL;
     }
 }
+
+// Value ranges: an inclusive interval and the bits that are known to be 0 or 1
+// for all values of a subtree. Bounds are 64 bits wide, so results of
+// operations on them can be checked for overflow.
+struct AstRange {
+    int64_t min;
+    int64_t max;
+    uint32_t zeros;
+    uint32_t ones;
+};
+
+#define AST_RANGE_FULL (struct AstRange){ .min = INT32_MIN, .max = INT32_MAX, .zeros = 0, .ones = 0 }
+#define AST_RANGE_BOOL (struct AstRange){ .min = 0, .max = 1, .zeros = UINT32_MAX - 1, .ones = 0 }
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
+// Bits above the highest bit in which min and max differ are the same for all
+// values in between, if both have the same sign.
+static struct AstRange ast_range_make(int64_t min, int64_t max) {
+    if (min < INT32_MIN || max > INT32_MAX) {
+        // the operation overflows for some values, which wraps around
+        return AST_RANGE_FULL;
+    }
+
+    struct AstRange range = { .min = min, .max = max, .zeros = 0, .ones = 0 };
+    if ((min < 0) == (max < 0)) {
+        const uint32_t diff = (uint32_t)min ^ (uint32_t)max;
+        const uint32_t known = diff == 0 ? UINT32_MAX : ~(UINT32_MAX >> __builtin_clz(diff));
+        range.ones  =  (uint32_t)min & known;
+        range.zeros = ~(uint32_t)min & known;
+    }
+    return range;
+}
+
+// adds known bits to range and narrows its interval to the values that have them
+static struct AstRange ast_range_with_bits(struct AstRange range, uint32_t zeros, uint32_t ones) {
+    int64_t min = range.min;
+    int64_t max = range.max;
+    zeros |= range.zeros;
+    ones  |= range.ones;
+
+    if ((zeros | ones) & UINT32_C(0x80000000)) {
+        // with a known sign bit the signed and the unsigned order are the same
+        min = MAX(min, (int32_t)ones);
+        max = MIN(max, (int32_t)~zeros);
+    }
+
+    if (min > max) {
+        assert(false);
+        return range;
+    }
+
+    struct AstRange result = ast_range_make(min, max);
+    result.zeros |= zeros;
+    result.ones  |= ones;
+    return result;
+}
+
+static inline struct AstRange ast_range_const(int64_t value) {
+    return ast_range_make(value, value);
+}
+
+static inline bool ast_range_is_true(struct AstRange range) {
+    return range.min > 0 || range.max < 0 || range.ones != 0;
+}
+
+static inline bool ast_range_is_false(struct AstRange range) {
+    return range.min == 0 && range.max == 0;
+}
+
+static inline bool ast_range_is_bool(struct AstRange range) {
+    return range.min >= 0 && range.max <= 1;
+}
+
+static inline struct AstRange ast_range_truth(bool is_true, bool is_false) {
+    return is_true ? ast_range_const(1) : is_false ? ast_range_const(0) : AST_RANGE_BOOL;
+}
+
+static struct AstRange ast_range_union(struct AstRange lhs, struct AstRange rhs) {
+    struct AstRange range = ast_range_make(MIN(lhs.min, rhs.min), MAX(lhs.max, rhs.max));
+    return ast_range_with_bits(range, lhs.zeros & rhs.zeros, lhs.ones & rhs.ones);
+}
+
+static struct AstRange ast_range_corners(int64_t a, int64_t b, int64_t c, int64_t d) {
+    return ast_range_make(MIN(MIN(a, b), MIN(c, d)), MAX(MAX(a, b), MAX(c, d)));
+}
+
+// divisions by zero and INT32_MIN / -1 trap, only divisors that are proven to
+// not do that are analyzed
+static inline bool ast_range_is_divisor(struct AstRange lhs, struct AstRange rhs) {
+    return (rhs.min > 0 || rhs.max < 0) && !(lhs.min == INT32_MIN && rhs.min <= -1 && rhs.max >= -1);
+}
+
+// shift counts outside of 0 ... 31 are undefined
+static inline bool ast_range_is_shift_count(struct AstRange range) {
+    return range.min >= 0 && range.max <= 31;
+}
+
+static struct AstRange ast_range_unary(enum NodeType type, struct AstRange child) {
+    switch (type) {
+        case NODE_NEG:
+            return child.min == INT32_MIN ? AST_RANGE_FULL : ast_range_make(-child.max, -child.min);
+
+        case NODE_BIT_NEG:
+            return ast_range_with_bits(ast_range_make(-child.max - 1, -child.min - 1), child.ones, child.zeros);
+
+        case NODE_NOT:
+            return ast_range_truth(ast_range_is_false(child), ast_range_is_true(child));
+
+        default:
+            assert(false);
+            return AST_RANGE_FULL;
+    }
+}
+
+static struct AstRange ast_range_binary(enum NodeType type, struct AstRange lhs, struct AstRange rhs) {
+    switch (type) {
+        case NODE_ADD:
+            return ast_range_make(lhs.min + rhs.min, lhs.max + rhs.max);
+
+        case NODE_SUB:
+            return ast_range_make(lhs.min - rhs.max, lhs.max - rhs.min);
+
+        case NODE_MUL:
+            return ast_range_corners(lhs.min * rhs.min, lhs.min * rhs.max, lhs.max * rhs.min, lhs.max * rhs.max);
+
+        case NODE_DIV:
+            if (!ast_range_is_divisor(lhs, rhs)) {
+                return AST_RANGE_FULL;
+            }
+            return ast_range_corners(lhs.min / rhs.min, lhs.min / rhs.max, lhs.max / rhs.min, lhs.max / rhs.max);
+
+        case NODE_MOD:
+        {
+            if (!ast_range_is_divisor(lhs, rhs)) {
+                return AST_RANGE_FULL;
+            }
+            // the result has the sign of lhs and is smaller than rhs in magnitude
+            const int64_t limit = MAX(-rhs.min, rhs.max) - 1;
+            return ast_range_make(
+                lhs.min < 0 ? MAX(lhs.min, -limit) : 0,
+                lhs.max > 0 ? MIN(lhs.max, limit) : 0);
+        }
+
+        case NODE_LSHIFT:
+            if (!ast_range_is_shift_count(rhs)) {
+                return AST_RANGE_FULL;
+            }
+            return ast_range_corners(
+                lhs.min * (INT64_C(1) << rhs.min), lhs.min * (INT64_C(1) << rhs.max),
+                lhs.max * (INT64_C(1) << rhs.min), lhs.max * (INT64_C(1) << rhs.max));
+
+        case NODE_RSHIFT:
+            if (!ast_range_is_shift_count(rhs)) {
+                return AST_RANGE_FULL;
+            }
+            return ast_range_corners(lhs.min >> rhs.min, lhs.min >> rhs.max, lhs.max >> rhs.min, lhs.max >> rhs.max);
+
+        case NODE_BIT_AND:
+        {
+            // and with a non-negative value is in between 0 and that value
+            struct AstRange range = AST_RANGE_FULL;
+            if (lhs.min >= 0 || rhs.min >= 0) {
+                range = ast_range_make(0, MIN(lhs.min >= 0 ? lhs.max : INT32_MAX, rhs.min >= 0 ? rhs.max : INT32_MAX));
+            }
+            return ast_range_with_bits(range, lhs.zeros | rhs.zeros, lhs.ones & rhs.ones);
+        }
+
+        case NODE_BIT_OR:
+            return ast_range_with_bits(AST_RANGE_FULL, lhs.zeros & rhs.zeros, lhs.ones | rhs.ones);
+
+        case NODE_BIT_XOR:
+        {
+            const uint32_t known = (lhs.zeros | lhs.ones) & (rhs.zeros | rhs.ones);
+            const uint32_t ones  = (lhs.ones ^ rhs.ones) & known;
+            return ast_range_with_bits(AST_RANGE_FULL, known & ~ones, ones);
+        }
+
+        case NODE_LT:
+            return ast_range_truth(lhs.max < rhs.min, lhs.min >= rhs.max);
+
+        case NODE_GT:
+            return ast_range_truth(lhs.min > rhs.max, lhs.max <= rhs.min);
+
+        case NODE_LE:
+            return ast_range_truth(lhs.max <= rhs.min, lhs.min > rhs.max);
+
+        case NODE_GE:
+            return ast_range_truth(lhs.min >= rhs.max, lhs.max < rhs.min);
+
+        case NODE_EQ:
+        case NODE_NE:
+        {
+            const bool disjoint =
+                lhs.max < rhs.min || rhs.max < lhs.min ||
+                (lhs.ones & rhs.zeros) != 0 || (lhs.zeros & rhs.ones) != 0;
+            const bool same = lhs.min == lhs.max && rhs.min == rhs.max && lhs.min == rhs.min;
+            return type == NODE_EQ ? ast_range_truth(same, disjoint) : ast_range_truth(disjoint, same);
+        }
+
+        case NODE_AND:
+            return ast_range_truth(
+                ast_range_is_true(lhs) && ast_range_is_true(rhs),
+                ast_range_is_false(lhs) || ast_range_is_false(rhs));
+
+        case NODE_OR:
+            return ast_range_truth(
+                ast_range_is_true(lhs) || ast_range_is_true(rhs),
+                ast_range_is_false(lhs) && ast_range_is_false(rhs));
+
+        default:
+            assert(false);
+            return AST_RANGE_FULL;
+    }
+}
+
+static const struct ParamRange *param_ranges_find(const struct ParamRange ranges[], size_t range_count, const char *name) {
+    size_t left  = 0;
+    size_t right = range_count;
+
+    while (left != right) {
+        size_t mid = (left + right) / 2;
+        int cmp = strcmp(name, ranges[mid].name);
+
+        if (cmp == 0) {
+            return &ranges[mid];
+        }
+
+        if (cmp < 0) {
+            right = mid;
+        } else {
+            left = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+static int param_range_cmp(const void *lhs, const void *rhs) {
+    return strcmp(((const struct ParamRange*)lhs)->name, ((const struct ParamRange*)rhs)->name);
+}
+
+void param_ranges_sort(struct ParamRange ranges[], size_t range_count) {
+    qsort(ranges, range_count, sizeof(struct ParamRange), param_range_cmp);
+}
+
+// replaces expr by *child, the rest of expr is freed
+static struct AstNode *ast_narrow_replace(struct Arena *arena, struct AstNode *expr, struct AstNode **child, bool *changed) {
+    struct AstNode *node = *child;
+    *child = NULL;
+    ast_free_in(arena, expr);
+    *changed = true;
+    return node;
+}
+
+// turns expr into a constant if range has only one value
+static struct AstNode *ast_narrow_finish(struct Arena *arena, struct AstNode *expr, struct AstRange range, bool *changed) {
+    if (expr->type != NODE_INT && range.min == range.max) {
+        if (expr->type == NODE_IF) {
+            ast_free_in(arena, expr->data.terneary.cond);
+            ast_free_in(arena, expr->data.terneary.then_expr);
+            ast_free_in(arena, expr->data.terneary.else_expr);
+        } else if (ast_is_binary(expr)) {
+            ast_free_in(arena, expr->data.binary.lhs);
+            ast_free_in(arena, expr->data.binary.rhs);
+        } else if (ast_is_unary(expr)) {
+            ast_free_in(arena, expr->data.child);
+        }
+        expr->type = NODE_INT;
+        expr->data.value = (int)range.min;
+        *changed = true;
+    }
+    return expr;
+}
+
+// Rewrites the tree expr in place and sets *range to its values. Subtrees
+// with only one possible value become constants, branches that can't be
+// taken are dropped and !!x and x && y only normalize values that aren't
+// already 0 or 1.
+static struct AstNode *ast_narrow(struct Arena *arena, struct AstNode *expr, const struct ParamRange ranges[], size_t range_count, struct AstRange *range, bool *changed) {
+    switch (expr->type) {
+        case NODE_INT:
+            *range = ast_range_const(expr->data.value);
+            return expr;
+
+        case NODE_VAR:
+        {
+            const struct ParamRange *param = param_ranges_find(ranges, range_count, expr->data.symbol->name);
+            *range = param == NULL || param->min > param->max ? AST_RANGE_FULL : ast_range_make(param->min, param->max);
+            return ast_narrow_finish(arena, expr, *range, changed);
+        }
+
+        case NODE_IF:
+        {
+            struct AstRange cond;
+            expr->data.terneary.cond = ast_narrow(arena, expr->data.terneary.cond, ranges, range_count, &cond, changed);
+
+            if (ast_range_is_true(cond) || ast_range_is_false(cond)) {
+                struct AstNode *branch = ast_narrow_replace(arena, expr,
+                    ast_range_is_true(cond) ? &expr->data.terneary.then_expr : &expr->data.terneary.else_expr,
+                    changed);
+                return ast_narrow(arena, branch, ranges, range_count, range, changed);
+            }
+
+            struct AstRange then_range, else_range;
+            expr->data.terneary.then_expr = ast_narrow(arena, expr->data.terneary.then_expr, ranges, range_count, &then_range, changed);
+            expr->data.terneary.else_expr = ast_narrow(arena, expr->data.terneary.else_expr, ranges, range_count, &else_range, changed);
+            *range = ast_range_union(then_range, else_range);
+            return ast_narrow_finish(arena, expr, *range, changed);
+        }
+
+        case NODE_NOT:
+        {
+            struct AstNode *child = expr->data.child;
+            struct AstRange child_range;
+
+            if (child->type == NODE_NOT) {
+                struct AstRange inner;
+                child->data.child = ast_narrow(arena, child->data.child, ranges, range_count, &inner, changed);
+
+                if (ast_range_is_bool(inner)) {
+                    *range = inner;
+                    return ast_narrow_replace(arena, expr, &child->data.child, changed);
+                }
+
+                child_range = ast_range_unary(NODE_NOT, inner);
+                expr->data.child = ast_narrow_finish(arena, child, child_range, changed);
+            } else {
+                expr->data.child = ast_narrow(arena, child, ranges, range_count, &child_range, changed);
+            }
+
+            *range = ast_range_unary(NODE_NOT, child_range);
+            return ast_narrow_finish(arena, expr, *range, changed);
+        }
+
+        case NODE_NEG:
+        case NODE_BIT_NEG:
+        {
+            struct AstRange child_range;
+            expr->data.child = ast_narrow(arena, expr->data.child, ranges, range_count, &child_range, changed);
+            *range = ast_range_unary(expr->type, child_range);
+            return ast_narrow_finish(arena, expr, *range, changed);
+        }
+
+        case NODE_AND:
+        case NODE_OR:
+        {
+            const bool is_and = expr->type == NODE_AND;
+            struct AstRange lhs, rhs;
+            expr->data.binary.lhs = ast_narrow(arena, expr->data.binary.lhs, ranges, range_count, &lhs, changed);
+
+            // short circuit
+            if (is_and ? ast_range_is_false(lhs) : ast_range_is_true(lhs)) {
+                *range = ast_range_const(!is_and);
+                return ast_narrow_finish(arena, expr, *range, changed);
+            }
+
+            expr->data.binary.rhs = ast_narrow(arena, expr->data.binary.rhs, ranges, range_count, &rhs, changed);
+
+            // the result is the other operand normalized to 0 or 1
+            const bool lhs_neutral = is_and ? ast_range_is_true(lhs) : ast_range_is_false(lhs);
+            const bool rhs_neutral = is_and ? ast_range_is_true(rhs) : ast_range_is_false(rhs);
+            if (lhs_neutral && ast_range_is_bool(rhs)) {
+                *range = rhs;
+                return ast_narrow_replace(arena, expr, &expr->data.binary.rhs, changed);
+            } else if (rhs_neutral && ast_range_is_bool(lhs)) {
+                *range = lhs;
+                return ast_narrow_replace(arena, expr, &expr->data.binary.lhs, changed);
+            } else if (lhs_neutral && expr->data.binary.lhs->type != NODE_INT) {
+                // lets ast_optimize() drop the operand
+                expr->data.binary.lhs = ast_narrow_finish(arena, expr->data.binary.lhs, ast_range_const(is_and), changed);
+            }
+
+            *range = ast_range_binary(expr->type, lhs, rhs);
+            return ast_narrow_finish(arena, expr, *range, changed);
+        }
+
+        default:
+        {
+            struct AstRange lhs, rhs;
+            expr->data.binary.lhs = ast_narrow(arena, expr->data.binary.lhs, ranges, range_count, &lhs, changed);
+            expr->data.binary.rhs = ast_narrow(arena, expr->data.binary.rhs, ranges, range_count, &rhs, changed);
+
+            // smallest magnitude of a divisor that doesn't change sign
+            const int64_t divisor = rhs.min > 0 ? rhs.min : -rhs.max;
+
+            if (expr->type == NODE_MOD && ast_range_is_divisor(lhs, rhs) &&
+                -lhs.min < divisor && lhs.max < divisor) {
+                // x % y is x if x is smaller than y in magnitude
+                *range = lhs;
+                return ast_narrow_replace(arena, expr, &expr->data.binary.lhs, changed);
+            } else if (expr->type == NODE_BIT_AND && expr->data.binary.rhs->type == NODE_INT &&
+                       (~(uint32_t)expr->data.binary.rhs->data.value & ~lhs.zeros) == 0) {
+                // the mask only clears bits that are already 0
+                *range = lhs;
+                return ast_narrow_replace(arena, expr, &expr->data.binary.lhs, changed);
+            } else if (expr->type == NODE_BIT_AND && expr->data.binary.lhs->type == NODE_INT &&
+                       (~(uint32_t)expr->data.binary.lhs->data.value & ~rhs.zeros) == 0) {
+                *range = rhs;
+                return ast_narrow_replace(arena, expr, &expr->data.binary.rhs, changed);
+            }
+
+            *range = ast_range_binary(expr->type, lhs, rhs);
+            return ast_narrow_finish(arena, expr, *range, changed);
+        }
+    }
+}
+
+struct AstNode *ast_optimize_ranges(const struct AstNode *expr, const struct ParamRange ranges[], size_t range_count) {
+    return ast_optimize_ranges_in(NULL, expr, ranges, range_count);
+}
+
+// The range analysis works on the folded tree and folding again afterwards
+// simplifies what it made constant.
+struct AstNode *ast_optimize_ranges_in(struct Arena *arena, const struct AstNode *expr, const struct ParamRange ranges[], size_t range_count) {
+    struct AstNode *opt_expr = ast_fold(arena, expr, NULL, 0);
+    if (opt_expr == NULL) {
+        return NULL;
+    }
+
+    bool changed = false;
+    struct AstRange range;
+    opt_expr = ast_narrow(arena, opt_expr, ranges, range_count, &range, &changed);
+
+    if (!changed) {
+        return opt_expr;
+    }
+
+    struct AstNode *folded = ast_fold(arena, opt_expr, NULL, 0);
+    ast_free_in(arena, opt_expr);
+    return folded;
+}
+
+static size_t ast_count_nodes(const struct AstNode *expr) {
+    if (expr->type == NODE_IF) {
+        return 1 +
+            ast_count_nodes(expr->data.terneary.cond) +
+            ast_count_nodes(expr->data.terneary.then_expr) +
+            ast_count_nodes(expr->data.terneary.else_expr);
+    } else if (ast_is_binary(expr)) {
+        return 1 + ast_count_nodes(expr->data.binary.lhs) + ast_count_nodes(expr->data.binary.rhs);
+    } else if (ast_is_unary(expr)) {
+        return 1 + ast_count_nodes(expr->data.child);
+    } else {
+        return 1;
+    }
+}
+
+static inline size_t ast_cse_hash_mix(size_t hash, size_t value) {
+    return (hash ^ value) * (size_t)0x100000001b3;
+}
+
+static inline size_t ast_cse_hash_ptr(const void *ptr) {
+    uintptr_t value = (uintptr_t)ptr;
+    return (size_t)((value >> 4) ^ (value >> 16)) * (size_t)0x9E3779B97F4A7C15;
+}
+
+static size_t ast_cse_intern(struct AstCse *cse, const struct AstNode *expr) {
+    size_t children[3] = { SIZE_MAX, SIZE_MAX, SIZE_MAX };
+    size_t hash = ast_cse_hash_mix((size_t)0xcbf29ce484222325, expr->type);
+
+    if (expr->type == NODE_IF) {
+        children[0] = ast_cse_intern(cse, expr->data.terneary.cond);
+        children[1] = ast_cse_intern(cse, expr->data.terneary.then_expr);
+        children[2] = ast_cse_intern(cse, expr->data.terneary.else_expr);
+    } else if (ast_is_binary(expr)) {
+        children[0] = ast_cse_intern(cse, expr->data.binary.lhs);
+        children[1] = ast_cse_intern(cse, expr->data.binary.rhs);
+    } else if (ast_is_unary(expr)) {
+        children[0] = ast_cse_intern(cse, expr->data.child);
+    } else if (expr->type == NODE_INT) {
+        hash = ast_cse_hash_mix(hash, (unsigned int)expr->data.value);
+    } else {
+        hash = ast_cse_hash_mix(hash, expr->data.symbol->id);
+    }
+
+    for (size_t index = 0; index < 3; ++ index) {
+        hash = ast_cse_hash_mix(hash, children[index]);
+    }
+
+    const size_t mask = cse->capacity - 1;
+    size_t class_index = hash & mask;
+
+    for (;;) {
+        struct AstCseClass *cls = &cse->classes[class_index];
+
+        if (cls->repr == NULL) {
+            cls->repr = expr;
+            cls->hash = hash;
+            memcpy(cls->children, children, sizeof(children));
+            cls->uses = 0;
+            break;
+        }
+
+        if (cls->hash == hash && cls->repr->type == expr->type &&
+            memcmp(cls->children, children, sizeof(children)) == 0 && (
+                expr->type == NODE_INT ? cls->repr->data.value == expr->data.value :
+                expr->type == NODE_VAR ? cls->repr->data.symbol == expr->data.symbol :
+                true)) {
+            break;
+        }
+
+        class_index = (class_index + 1) & mask;
+    }
+
+    size_t node_index = ast_cse_hash_ptr(expr) & mask;
+    while (cse->nodes[node_index].node != NULL) {
+        node_index = (node_index + 1) & mask;
+    }
+    cse->nodes[node_index].node = expr;
+    cse->nodes[node_index].class_index = class_index;
+
+    return class_index;
+}
+
+static void ast_cse_count_uses(struct AstCse *cse, const struct AstNode *expr) {
+    struct AstCseClass *cls = &cse->classes[ast_cse_class(cse, expr)];
+
+    if (cls->uses ++ > 0) {
+        return;
+    }
+
+    if (expr->type == NODE_IF) {
+        ast_cse_count_uses(cse, expr->data.terneary.cond);
+        ast_cse_count_uses(cse, expr->data.terneary.then_expr);
+        ast_cse_count_uses(cse, expr->data.terneary.else_expr);
+    } else if (ast_is_binary(expr)) {
+        ast_cse_count_uses(cse, expr->data.binary.lhs);
+        ast_cse_count_uses(cse, expr->data.binary.rhs);
+    } else if (ast_is_unary(expr)) {
+        ast_cse_count_uses(cse, expr->data.child);
+    }
+}
+
+bool ast_cse_build(struct AstCse *cse, const struct AstNode *const exprs[], size_t count) {
+    size_t node_count = 0;
+    for (size_t index = 0; index < count; ++ index) {
+        node_count += ast_count_nodes(exprs[index]);
+    }
+
+    // load factor of at most 1/2
+    size_t capacity = 16;
+    while (capacity < node_count * 2) {
+        if (capacity > SIZE_MAX / 2 / sizeof(struct AstCseClass)) {
+            errno = ENOMEM;
+            return false;
+        }
+        capacity *= 2;
+    }
+
+    struct AstCseClass *classes = calloc(capacity, sizeof(struct AstCseClass));
+    if (classes == NULL) {
+        return false;
+    }
+
+    struct AstCseNode *nodes = calloc(capacity, sizeof(struct AstCseNode));
+    if (nodes == NULL) {
+        free(classes);
+        return false;
+    }
+
+    ast_cse_free(cse);
+    cse->classes  = classes;
+    cse->nodes    = nodes;
+    cse->capacity = capacity;
+
+    for (size_t index = 0; index < count; ++ index) {
+        ast_cse_intern(cse, exprs[index]);
+    }
+
+    for (size_t index = 0; index < count; ++ index) {
+        ast_cse_count_uses(cse, exprs[index]);
+    }
+
+    return true;
+}
+
+size_t ast_cse_class(const struct AstCse *cse, const struct AstNode *node) {
+    if (cse->capacity == 0) {
+        return SIZE_MAX;
+    }
+
+    const size_t mask = cse->capacity - 1;
+    size_t node_index = ast_cse_hash_ptr(node) & mask;
+
+    for (;;) {
+        const struct AstCseNode *entry = &cse->nodes[node_index];
+        if (entry->node == node) {
+            return entry->class_index;
+        }
+        if (entry->node == NULL) {
+            return SIZE_MAX;
+        }
+        node_index = (node_index + 1) & mask;
+    }
+}
+
+void ast_cse_free(struct AstCse *cse) {
+    free(cse->classes);
+    free(cse->nodes);
+    cse->classes  = NULL;
+    cse->nodes    = NULL;
+    cse->capacity = 0;
+}
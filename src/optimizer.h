@@ -4,11 +4,71 @@
 
 #include "ast.h"
 
+#include <stddef.h>
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct AstNode *ast_optimize(const struct AstNode *expr);
+/// allocates the optimized tree from the arena, release it with the arena
+struct AstNode *ast_optimize_in(struct Arena *arena, const struct AstNode *expr);
+/// Partial evaluation: the variables named in params (sorted) are replaced by
+/// their values before optimizing, the result only reads the other variables.
+struct AstNode *ast_specialize(const struct AstNode *expr, const struct Param params[], size_t param_count);
+struct AstNode *ast_specialize_in(struct Arena *arena, const struct AstNode *expr, const struct Param params[], size_t param_count);
+
+// Inclusive range of the values of a parameter.
+struct ParamRange {
+    const char *name;
+    int min;
+    int max;
+};
+
+/// Optimizes with an interval and known bits analysis, which assumes that the
+/// parameters in ranges (sorted by name) stay inside of their range. The result
+/// is only valid for such parameter values, parameters without range can have
+/// any value. Decided comparisons are folded, branches that can't be taken are
+/// dropped and already boolean values aren't normalized again.
+struct AstNode *ast_optimize_ranges(const struct AstNode *expr, const struct ParamRange ranges[], size_t range_count);
+struct AstNode *ast_optimize_ranges_in(struct Arena *arena, const struct AstNode *expr, const struct ParamRange ranges[], size_t range_count);
+void param_ranges_sort(struct ParamRange ranges[], size_t range_count);
+
+// A class of structurally identical subtrees, the children are class indices.
+struct AstCseClass {
+    const struct AstNode *repr; // first node of the class, NULL for empty entries
+    size_t hash;
+    size_t children[3];
+    // number of evaluations if every repetition reuses an earlier result,
+    // repetitions don't count their children
+    size_t uses;
+};
+
+struct AstCseNode {
+    const struct AstNode *node; // NULL for empty entries
+    size_t class_index;
+};
+
+// Hash-consing of one or more trees: every node is mapped to the class of
+// structurally identical subtrees, which gives a DAG view of the trees without
+// changing their ownership. Both tables use open addressing.
+struct AstCse {
+    struct AstCseClass *classes;
+    struct AstCseNode *nodes;
+    size_t capacity; // of both tables, a power of two
+};
+
+#define AST_CSE_INIT() { \
+    .classes = NULL,     \
+    .nodes = NULL,       \
+    .capacity = 0,       \
+}
+
+bool ast_cse_build(struct AstCse *cse, const struct AstNode *const exprs[], size_t count);
+/// returns SIZE_MAX for nodes that are not part of the trees
+size_t ast_cse_class(const struct AstCse *cse, const struct AstNode *node);
+void ast_cse_free(struct AstCse *cse);
 
 #ifdef __cplusplus
 }
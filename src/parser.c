@@ -20,26 +20,48 @@ void parser_free(struct Parser *parser) {
     tokenizer_free(&parser->tokenizer);
 }
 
-struct AstNode *parse(const char *input, struct ErrorInfo *error) {
-    struct Parser parser = PARSER_INIT(input);
-    struct AstNode *expr = parse_expression(&parser);
+struct AstNode *parse(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    return parse_in(NULL, symbols, input, error);
+}
+
+// parses the whole input, the tokenizer of parser may read a token array
+static struct AstNode *parse_all(struct Parser *parser, struct ErrorInfo *error) {
+    struct AstNode *expr = parse_expression(parser);
     if (expr != NULL) {
-        if (next_token(&parser.tokenizer) != TOK_EOF) {
-            parser.error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
-            parser.error.offset = parser.error.context_offset = parser.tokenizer.token_pos;
-            ast_free(expr);
+        if (next_token(&parser->tokenizer) != TOK_EOF) {
+            parser->error.error  = PARSER_ERROR_ILLEGAL_TOKEN;
+            parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
+            ast_free_in(parser->arena, expr);
             expr = NULL;
         }
     }
 
     if (error != NULL) {
-        *error = parser.error;
+        *error = parser->error;
     }
 
-    parser_free(&parser);
+    parser_free(parser);
     return expr;
 }
 
+struct AstNode *parse_in(struct Arena *arena, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    struct Parser parser = PARSER_INIT(input);
+    parser.arena = arena;
+    parser.symbols = symbols;
+    return parse_all(&parser, error);
+}
+
+struct AstNode *parse_tokens(struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error) {
+    return parse_tokens_in(NULL, symbols, tokens, error);
+}
+
+struct AstNode *parse_tokens_in(struct Arena *arena, struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error) {
+    struct Parser parser = PARSER_INIT_TOKENS(tokens);
+    parser.arena = arena;
+    parser.symbols = symbols;
+    return parse_all(&parser, error);
+}
+
 // The actual grammar parsing happens here:
 struct AstNode *parse_expression(struct Parser *parser) {
     return parse_condition(parser);
@@ -62,7 +84,7 @@ struct AstNode *parse_condition(struct Parser *parser) {
         size_t quest_offset = parser->tokenizer.token_pos;
         struct AstNode *then_expr = parse_expression(parser);
         if (then_expr == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
@@ -73,25 +95,25 @@ struct AstNode *parse_condition(struct Parser *parser) {
             parser->error.token = TOK_COLON;
             parser->error.offset = parser->tokenizer.token_pos;
             parser->error.context_offset = quest_offset;
-            ast_free(expr);
-            ast_free(then_expr);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, then_expr);
             return NULL;
         }
 
         struct AstNode *else_expr = parse_expression(parser);
         if (else_expr == NULL) {
-            ast_free(expr);
-            ast_free(then_expr);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, then_expr);
             return NULL;
         }
 
-        struct AstNode *if_expr = ast_create_terneary(expr, then_expr, else_expr);
+        struct AstNode *if_expr = ast_create_terneary_in(parser->arena, expr, then_expr, else_expr);
         if (if_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(then_expr);
-            ast_free(else_expr);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, then_expr);
+            ast_free_in(parser->arena, else_expr);
             return NULL;
         }
 
@@ -116,16 +138,16 @@ struct AstNode *parse_or(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_and(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(NODE_OR, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, NODE_OR, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -148,16 +170,16 @@ struct AstNode *parse_and(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_bit_or(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(NODE_AND, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, NODE_AND, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -180,16 +202,16 @@ struct AstNode *parse_bit_or(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_bit_xor(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(NODE_BIT_OR, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, NODE_BIT_OR, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -212,16 +234,16 @@ struct AstNode *parse_bit_xor(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_bit_and(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(NODE_BIT_XOR, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, NODE_BIT_XOR, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -244,16 +266,16 @@ struct AstNode *parse_bit_and(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_compare(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(NODE_BIT_AND, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, NODE_BIT_AND, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -280,16 +302,16 @@ struct AstNode *parse_compare(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_order(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(node_type, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, node_type, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -318,16 +340,16 @@ struct AstNode *parse_order(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_bit_shift(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(node_type, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, node_type, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -354,16 +376,16 @@ struct AstNode *parse_bit_shift(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_sum(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(node_type, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, node_type, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -390,16 +412,16 @@ struct AstNode *parse_sum(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_product(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(node_type, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, node_type, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -427,16 +449,16 @@ struct AstNode *parse_product(struct Parser *parser) {
         token = next_token(&parser->tokenizer);
         struct AstNode *rhs = parse_unary(parser);
         if (rhs == NULL) {
-            ast_free(expr);
+            ast_free_in(parser->arena, expr);
             return NULL;
         }
 
-        struct AstNode *new_expr = ast_create_binary(node_type, expr, rhs);
+        struct AstNode *new_expr = ast_create_binary_in(parser->arena, node_type, expr, rhs);
         if (new_expr == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(expr);
-            ast_free(rhs);
+            ast_free_in(parser->arena, expr);
+            ast_free_in(parser->arena, rhs);
             return NULL;
         }
         expr = new_expr;
@@ -458,11 +480,11 @@ struct AstNode *parse_unary(struct Parser *parser) {
 
         struct AstNode *child;
         if (token == TOK_MINUS) {
-            child = ast_create_unary(NODE_NEG, NULL);
+            child = ast_create_unary_in(parser->arena, NODE_NEG, NULL);
         } else if (token == TOK_BIT_NEG) {
-            child = ast_create_unary(NODE_BIT_NEG, NULL);
+            child = ast_create_unary_in(parser->arena, NODE_BIT_NEG, NULL);
         } else if (token == TOK_NOT) {
-            child = ast_create_unary(NODE_NOT, NULL);
+            child = ast_create_unary_in(parser->arena, NODE_NOT, NULL);
         } else {
             break;
         }
@@ -470,7 +492,7 @@ struct AstNode *parse_unary(struct Parser *parser) {
         if (child == NULL) {
             parser->error.error  = PARSER_ERROR_MEMORY;
             parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
-            ast_free(top);
+            ast_free_in(parser->arena, top);
             return NULL;
         }
 
@@ -487,7 +509,7 @@ struct AstNode *parse_unary(struct Parser *parser) {
 
     struct AstNode *child = parse_atom(parser);
     if (child == NULL) {
-        ast_free(top);
+        ast_free_in(parser->arena, top);
         return NULL;
     }
 
@@ -504,7 +526,7 @@ struct AstNode *parse_atom(struct Parser *parser) {
     switch (token) {
         case TOK_INT:
         {
-            struct AstNode *expr = ast_create_int(parser->tokenizer.value);
+            struct AstNode *expr = ast_create_int_in(parser->arena, parser->tokenizer.value);
             if (expr == NULL) {
                 parser->error.error  = PARSER_ERROR_MEMORY;
                 parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
@@ -514,15 +536,14 @@ struct AstNode *parse_atom(struct Parser *parser) {
         }
         case TOK_IDENT:
         {
-            char *name = tokenizer_get_ident(&parser->tokenizer);
-            if (name == NULL) {
+            const struct Symbol *symbol = tokenizer_get_symbol(&parser->tokenizer, parser->symbols);
+            if (symbol == NULL) {
                 parser->error.error  = PARSER_ERROR_MEMORY;
                 parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
                 return NULL;
             }
-            struct AstNode *expr = ast_create_var(name);
+            struct AstNode *expr = ast_create_var_in(parser->arena, symbol);
             if (expr == NULL) {
-                free(name);
                 parser->error.error  = PARSER_ERROR_MEMORY;
                 parser->error.offset = parser->error.context_offset = parser->tokenizer.token_pos;
                 return NULL;
@@ -544,7 +565,7 @@ struct AstNode *parse_atom(struct Parser *parser) {
                     parser->error.offset = parser->tokenizer.token_pos;
                     parser->error.context_offset = start_offset;
                 }
-                ast_free(expr);
+                ast_free_in(parser->arena, expr);
                 return NULL;
             }
             return expr;
@@ -13,6 +13,8 @@ extern "C" {
 struct Parser {
     struct Tokenizer tokenizer;
     struct ErrorInfo error;
+    struct Arena *arena; // NULL to allocate nodes with malloc()
+    struct SymbolTable *symbols; // the variables are interned here, has to be set
 };
 
 #define PARSER_INIT(INPUT) {             \
@@ -23,9 +25,29 @@ struct Parser {
         .context_offset = 0,             \
         .token  = TOK_EOF,               \
     },                                   \
+    .arena = NULL,                       \
+    .symbols = NULL,                     \
 }
 
-struct AstNode *parse(const char *input, struct ErrorInfo *error);
+#define PARSER_INIT_TOKENS(TOKENS) {            \
+    .tokenizer = TOKENIZER_INIT_TOKENS(TOKENS), \
+    .error = {                                  \
+        .error  = PARSER_ERROR_OK,              \
+        .offset = 0,                            \
+        .context_offset = 0,                    \
+        .token  = TOK_EOF,                      \
+    },                                          \
+    .arena = NULL,                              \
+    .symbols = NULL,                            \
+}
+
+/// the variables of the tree are interned into symbols, which has to outlive it
+struct AstNode *parse(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+/// allocates the tree from the arena, release it with the arena
+struct AstNode *parse_in(struct Arena *arena, struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+/// parses tokens produced by token_array_tokenize(), same results as parse()
+struct AstNode *parse_tokens(struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error);
+struct AstNode *parse_tokens_in(struct Arena *arena, struct SymbolTable *symbols, const struct TokenArray *tokens, struct ErrorInfo *error);
 struct AstNode *parse_expression(struct Parser *parser);
 void parser_free(struct Parser *parser);
 
@@ -0,0 +1,742 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+#include <inttypes.h>
+
+#include "regcode.h"
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Registers are allocated like a stack: temporaries of sub-expressions are
+// released as soon as the parent instruction has consumed them.
+struct RegAlloc {
+    size_t top;
+};
+
+static bool regcode_add_instr(struct Regcode *regcode, enum RegOpcode opcode, size_t dst, size_t lhs, size_t rhs) {
+    if (regcode->instrs_size == regcode->instrs_capacity) {
+        size_t new_capacity;
+        if (regcode->instrs_capacity == 0) {
+            new_capacity = 16;
+        } else if (regcode->instrs_capacity > REGCODE_MAX_INDEX / 2) {
+            new_capacity = (size_t)REGCODE_MAX_INDEX + 1;
+        } else {
+            new_capacity = regcode->instrs_capacity * 2;
+        }
+
+        if (new_capacity <= regcode->instrs_size) {
+            // instruction indices are used as jump targets
+            errno = ERANGE;
+            return false;
+        }
+
+        struct RegInstr *instrs = realloc(regcode->instrs, new_capacity * sizeof(struct RegInstr));
+        if (instrs == NULL) {
+            return false;
+        }
+
+        regcode->instrs = instrs;
+        regcode->instrs_capacity = new_capacity;
+    }
+
+    assert(dst <= REGCODE_MAX_INDEX && lhs <= REGCODE_MAX_INDEX && rhs <= REGCODE_MAX_INDEX);
+
+    regcode->instrs[regcode->instrs_size] = (struct RegInstr){
+        .opcode = opcode,
+        .dst    = dst,
+        .lhs    = lhs,
+        .rhs    = rhs,
+    };
+    ++ regcode->instrs_size;
+
+    return true;
+}
+
+static void regcode_patch_jump(struct Regcode *regcode, size_t instr_index) {
+    assert(instr_index < regcode->instrs_size);
+    regcode->instrs[instr_index].rhs = regcode->instrs_size;
+}
+
+static ptrdiff_t regcode_find_param(const struct Regcode *regcode, const struct Symbol *symbol) {
+    return symbol_map_get(&regcode->param_map, symbol);
+}
+
+static ptrdiff_t regcode_add_param(struct Regcode *regcode, const struct Symbol *symbol) {
+    ptrdiff_t index = regcode_find_param(regcode, symbol);
+    if (index >= 0) {
+        return index;
+    }
+
+    if (regcode->params_size == regcode->params_capacity) {
+        size_t new_capacity;
+        if (regcode->params_capacity == 0) {
+            new_capacity = 4;
+        } else if (regcode->params_capacity > PTRDIFF_MAX / 2 / sizeof(struct Symbol*)) {
+            errno = ENOMEM;
+            return -1;
+        } else {
+            new_capacity = regcode->params_capacity * 2;
+        }
+        const struct Symbol **params = realloc(regcode->params, new_capacity * sizeof(struct Symbol*));
+        if (params == NULL) {
+            return -1;
+        }
+        regcode->params = params;
+        regcode->params_capacity = new_capacity;
+    }
+
+    if (regcode->params_size >= UINT32_MAX) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (!symbol_map_put(&regcode->param_map, symbol, (uint32_t)regcode->params_size)) {
+        return -1;
+    }
+
+    index = regcode->params_size ++;
+    regcode->params[index] = symbol;
+
+    return index;
+}
+
+static ptrdiff_t regcode_get_const_index(const struct Regcode *regcode, int value) {
+    for (size_t index = 0; index < regcode->consts_size; ++ index) {
+        if (regcode->consts[index] == value) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+static ptrdiff_t regcode_add_const(struct Regcode *regcode, int value) {
+    ptrdiff_t index = regcode_get_const_index(regcode, value);
+    if (index >= 0) {
+        return index;
+    }
+
+    if (regcode->consts_size == regcode->consts_capacity) {
+        size_t new_capacity;
+        if (regcode->consts_capacity == 0) {
+            new_capacity = 4;
+        } else if (regcode->consts_capacity > PTRDIFF_MAX / 2 / sizeof(int)) {
+            errno = ENOMEM;
+            return -1;
+        } else {
+            new_capacity = regcode->consts_capacity * 2;
+        }
+        int *consts = realloc(regcode->consts, new_capacity * sizeof(int));
+        if (consts == NULL) {
+            return -1;
+        }
+        regcode->consts = consts;
+        regcode->consts_capacity = new_capacity;
+    }
+
+    index = regcode->consts_size;
+    regcode->consts[index] = value;
+    ++ regcode->consts_size;
+
+    return index;
+}
+
+// First pass: collect all parameters and constants, because they make up the
+// bottom of the register file and temporaries are allocated above them.
+static bool regcode_collect_leaves(struct Regcode *regcode, const struct AstNode *expr) {
+    if (ast_is_binary(expr)) {
+        return (
+            regcode_collect_leaves(regcode, expr->data.binary.lhs) &&
+            regcode_collect_leaves(regcode, expr->data.binary.rhs)
+        );
+    } else if (ast_is_unary(expr)) {
+        return regcode_collect_leaves(regcode, expr->data.child);
+    } else if (expr->type == NODE_IF) {
+        return (
+            regcode_collect_leaves(regcode, expr->data.terneary.cond) &&
+            regcode_collect_leaves(regcode, expr->data.terneary.then_expr) &&
+            regcode_collect_leaves(regcode, expr->data.terneary.else_expr)
+        );
+    } else if (expr->type == NODE_INT) {
+        return regcode_add_const(regcode, expr->data.value) >= 0;
+    } else if (expr->type == NODE_VAR) {
+        return regcode_add_param(regcode, expr->data.symbol) >= 0;
+    } else {
+        assert(false);
+        errno = EINVAL;
+        return false;
+    }
+}
+
+static ptrdiff_t regcode_alloc_temp(struct Regcode *regcode, struct RegAlloc *alloc) {
+    if (alloc->top > REGCODE_MAX_INDEX) {
+        errno = ERANGE;
+        return -1;
+    }
+
+    size_t reg = alloc->top ++;
+    regcode->regs_size = MAX(regcode->regs_size, alloc->top);
+
+    return reg;
+}
+
+static inline enum RegOpcode regcode_binary_opcode(enum NodeType type) {
+    switch (type) {
+        case NODE_ADD:     return REG_ADD;
+        case NODE_SUB:     return REG_SUB;
+        case NODE_MUL:     return REG_MUL;
+        case NODE_DIV:     return REG_DIV;
+        case NODE_MOD:     return REG_MOD;
+        case NODE_BIT_AND: return REG_BIT_AND;
+        case NODE_BIT_XOR: return REG_BIT_XOR;
+        case NODE_BIT_OR:  return REG_BIT_OR;
+        case NODE_LT:      return REG_LT;
+        case NODE_LE:      return REG_LE;
+        case NODE_GT:      return REG_GT;
+        case NODE_GE:      return REG_GE;
+        case NODE_EQ:      return REG_EQ;
+        case NODE_NE:      return REG_NE;
+        case NODE_LSHIFT:  return REG_LSHIFT;
+        case NODE_RSHIFT:  return REG_RSHIFT;
+
+        default:
+            assert(false);
+            return REG_RET;
+    }
+}
+
+// Returns the register that holds the result of expr. If dst is not negative
+// operations write their result into dst, but leaves still return the
+// register of the parameter or constant, so the caller might need a REG_MOV.
+static ptrdiff_t regcode_compile_ast(struct Regcode *regcode, struct RegAlloc *alloc, const struct AstNode *expr, ptrdiff_t dst) {
+    const size_t base = alloc->top;
+
+    if (expr->type == NODE_AND || expr->type == NODE_OR) {
+        ptrdiff_t lhs = regcode_compile_ast(regcode, alloc, expr->data.binary.lhs, -1);
+        if (lhs < 0) {
+            return -1;
+        }
+
+        alloc->top = base;
+        if (dst < 0 && (dst = regcode_alloc_temp(regcode, alloc)) < 0) {
+            return -1;
+        }
+
+        size_t jmp_index = regcode->instrs_size;
+        if (!regcode_add_instr(regcode, expr->type == NODE_AND ? REG_JEZ : REG_JNZ, dst, lhs, 0)) {
+            return -1;
+        }
+
+        ptrdiff_t rhs = regcode_compile_ast(regcode, alloc, expr->data.binary.rhs, -1);
+        if (rhs < 0) {
+            return -1;
+        }
+
+        if (!regcode_add_instr(regcode, REG_BOOL, dst, rhs, 0)) {
+            return -1;
+        }
+
+        regcode_patch_jump(regcode, jmp_index);
+        alloc->top = MAX(base, (size_t)dst + 1);
+
+        return dst;
+    } else if (ast_is_binary(expr)) {
+        ptrdiff_t lhs = regcode_compile_ast(regcode, alloc, expr->data.binary.lhs, -1);
+        if (lhs < 0) {
+            return -1;
+        }
+
+        ptrdiff_t rhs = regcode_compile_ast(regcode, alloc, expr->data.binary.rhs, -1);
+        if (rhs < 0) {
+            return -1;
+        }
+
+        // operands are read before the result is written, so the result may
+        // reuse the register of an operand
+        alloc->top = base;
+        if (dst < 0 && (dst = regcode_alloc_temp(regcode, alloc)) < 0) {
+            return -1;
+        }
+
+        if (!regcode_add_instr(regcode, regcode_binary_opcode(expr->type), dst, lhs, rhs)) {
+            return -1;
+        }
+
+        return dst;
+    } else if (ast_is_unary(expr)) {
+        ptrdiff_t child = regcode_compile_ast(regcode, alloc, expr->data.child, -1);
+        if (child < 0) {
+            return -1;
+        }
+
+        alloc->top = base;
+        if (dst < 0 && (dst = regcode_alloc_temp(regcode, alloc)) < 0) {
+            return -1;
+        }
+
+        enum RegOpcode opcode;
+        switch (expr->type) {
+            case NODE_NEG:     opcode = REG_NEG;     break;
+            case NODE_BIT_NEG: opcode = REG_BIT_NEG; break;
+            case NODE_NOT:     opcode = REG_NOT;     break;
+            default:
+                assert(false);
+                errno = EINVAL;
+                return -1;
+        }
+
+        if (!regcode_add_instr(regcode, opcode, dst, child, 0)) {
+            return -1;
+        }
+
+        return dst;
+    } else if (expr->type == NODE_IF) {
+        ptrdiff_t cond = regcode_compile_ast(regcode, alloc, expr->data.terneary.cond, -1);
+        if (cond < 0) {
+            return -1;
+        }
+
+        size_t cond_jmp_index = regcode->instrs_size;
+        if (!regcode_add_instr(regcode, REG_JZ, 0, cond, 0)) {
+            return -1;
+        }
+
+        alloc->top = base;
+        if (dst < 0 && (dst = regcode_alloc_temp(regcode, alloc)) < 0) {
+            return -1;
+        }
+
+        ptrdiff_t then_reg = regcode_compile_ast(regcode, alloc, expr->data.terneary.then_expr, dst);
+        if (then_reg < 0) {
+            return -1;
+        }
+
+        if (then_reg != dst && !regcode_add_instr(regcode, REG_MOV, dst, then_reg, 0)) {
+            return -1;
+        }
+
+        size_t then_jmp_index = regcode->instrs_size;
+        if (!regcode_add_instr(regcode, REG_JMP, 0, 0, 0)) {
+            return -1;
+        }
+
+        regcode_patch_jump(regcode, cond_jmp_index);
+
+        ptrdiff_t else_reg = regcode_compile_ast(regcode, alloc, expr->data.terneary.else_expr, dst);
+        if (else_reg < 0) {
+            return -1;
+        }
+
+        if (else_reg != dst && !regcode_add_instr(regcode, REG_MOV, dst, else_reg, 0)) {
+            return -1;
+        }
+
+        regcode_patch_jump(regcode, then_jmp_index);
+        alloc->top = MAX(base, (size_t)dst + 1);
+
+        return dst;
+    } else if (expr->type == NODE_INT) {
+        ptrdiff_t index = regcode_get_const_index(regcode, expr->data.value);
+        assert(index >= 0);
+        return regcode->params_size + index;
+    } else if (expr->type == NODE_VAR) {
+        ptrdiff_t index = regcode_find_param(regcode, expr->data.symbol);
+        assert(index >= 0);
+        return index;
+    } else {
+        assert(false);
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+bool regcode_compile(struct Regcode *regcode, const struct AstNode *expr) {
+    if (!regcode_collect_leaves(regcode, expr)) {
+        regcode_clear(regcode);
+        return false;
+    }
+
+    regcode->regs_size = regcode->params_size + regcode->consts_size;
+    if (regcode->regs_size > REGCODE_MAX_INDEX) {
+        regcode_clear(regcode);
+        errno = ERANGE;
+        return false;
+    }
+
+    struct RegAlloc alloc = {
+        .top = regcode->regs_size,
+    };
+
+    ptrdiff_t result = regcode_compile_ast(regcode, &alloc, expr, -1);
+    if (result < 0) {
+        regcode_clear(regcode);
+        return false;
+    }
+
+    if (!regcode_add_instr(regcode, REG_RET, 0, result, 0)) {
+        regcode_clear(regcode);
+        return false;
+    }
+
+    return true;
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MINMATH_ADDRESS_FROM_LABEL)
+#   define MINMATH_ADDRESS_FROM_LABEL
+#endif
+
+#ifdef MINMATH_ADDRESS_FROM_LABEL
+#   define DISPATCH_INSTR \
+        assert(instr >= regcode->instrs && instr < regcode->instrs + regcode->instrs_size); \
+        goto *(jmptbl[instr->opcode]);
+#   define BEGIN_EXEC DISPATCH_INSTR
+#   define JMP_LABEL(NAME) DO_ ## NAME:
+#   define NEXT_INSTR DISPATCH_INSTR
+#   define END_EXEC
+#else
+#   define BEGIN_EXEC \
+        const struct RegInstr *instrs_end = regcode->instrs + regcode->instrs_size; \
+        while (instr < instrs_end) { \
+            switch (instr->opcode) {
+#   define JMP_LABEL(NAME) case REG_ ## NAME:
+#   define NEXT_INSTR break;
+#   define END_EXEC } }
+#endif
+
+#define BINARY_OP(OP) \
+    regs[instr->dst] = regs[instr->lhs] OP regs[instr->rhs]; \
+    ++ instr;
+
+int regcode_execute(const struct Regcode *regcode, const int *params, int *regs) {
+#ifdef MINMATH_ADDRESS_FROM_LABEL
+    static const void *jmptbl[] = {
+        [REG_ADD]     = &&DO_ADD,
+        [REG_SUB]     = &&DO_SUB,
+        [REG_MUL]     = &&DO_MUL,
+        [REG_DIV]     = &&DO_DIV,
+        [REG_MOD]     = &&DO_MOD,
+        [REG_BIT_AND] = &&DO_BIT_AND,
+        [REG_BIT_XOR] = &&DO_BIT_XOR,
+        [REG_BIT_OR]  = &&DO_BIT_OR,
+        [REG_LT]      = &&DO_LT,
+        [REG_LE]      = &&DO_LE,
+        [REG_GT]      = &&DO_GT,
+        [REG_GE]      = &&DO_GE,
+        [REG_EQ]      = &&DO_EQ,
+        [REG_NE]      = &&DO_NE,
+        [REG_LSHIFT]  = &&DO_LSHIFT,
+        [REG_RSHIFT]  = &&DO_RSHIFT,
+        [REG_NEG]     = &&DO_NEG,
+        [REG_BIT_NEG] = &&DO_BIT_NEG,
+        [REG_NOT]     = &&DO_NOT,
+        [REG_BOOL]    = &&DO_BOOL,
+        [REG_MOV]     = &&DO_MOV,
+        [REG_JMP]     = &&DO_JMP,
+        [REG_JEZ]     = &&DO_JEZ,
+        [REG_JNZ]     = &&DO_JNZ,
+        [REG_JZ]      = &&DO_JZ,
+        [REG_RET]     = &&DO_RET,
+    };
+#endif
+
+    const struct RegInstr *instrs = regcode->instrs;
+    const struct RegInstr *instr = instrs;
+
+    // a constant expression may be run with params == NULL
+    if (regcode->params_size > 0) {
+        memcpy(regs, params, regcode->params_size * sizeof(int));
+    }
+    if (regcode->consts_size > 0) {
+        memcpy(regs + regcode->params_size, regcode->consts, regcode->consts_size * sizeof(int));
+    }
+
+    BEGIN_EXEC
+
+    JMP_LABEL(ADD)
+    BINARY_OP(+)
+    NEXT_INSTR
+
+    JMP_LABEL(SUB)
+    BINARY_OP(-)
+    NEXT_INSTR
+
+    JMP_LABEL(MUL)
+    BINARY_OP(*)
+    NEXT_INSTR
+
+    JMP_LABEL(DIV)
+    BINARY_OP(/)
+    NEXT_INSTR
+
+    JMP_LABEL(MOD)
+    BINARY_OP(%)
+    NEXT_INSTR
+
+    JMP_LABEL(BIT_AND)
+    BINARY_OP(&)
+    NEXT_INSTR
+
+    JMP_LABEL(BIT_XOR)
+    BINARY_OP(^)
+    NEXT_INSTR
+
+    JMP_LABEL(BIT_OR)
+    BINARY_OP(|)
+    NEXT_INSTR
+
+    JMP_LABEL(LT)
+    BINARY_OP(<)
+    NEXT_INSTR
+
+    JMP_LABEL(LE)
+    BINARY_OP(<=)
+    NEXT_INSTR
+
+    JMP_LABEL(GT)
+    BINARY_OP(>)
+    NEXT_INSTR
+
+    JMP_LABEL(GE)
+    BINARY_OP(>=)
+    NEXT_INSTR
+
+    JMP_LABEL(EQ)
+    BINARY_OP(==)
+    NEXT_INSTR
+
+    JMP_LABEL(NE)
+    BINARY_OP(!=)
+    NEXT_INSTR
+
+    JMP_LABEL(LSHIFT)
+    BINARY_OP(<<)
+    NEXT_INSTR
+
+    JMP_LABEL(RSHIFT)
+    BINARY_OP(>>)
+    NEXT_INSTR
+
+    JMP_LABEL(NEG)
+    regs[instr->dst] = -regs[instr->lhs];
+    ++ instr;
+    NEXT_INSTR
+
+    JMP_LABEL(BIT_NEG)
+    regs[instr->dst] = ~regs[instr->lhs];
+    ++ instr;
+    NEXT_INSTR
+
+    JMP_LABEL(NOT)
+    regs[instr->dst] = !regs[instr->lhs];
+    ++ instr;
+    NEXT_INSTR
+
+    JMP_LABEL(BOOL)
+    regs[instr->dst] = regs[instr->lhs] != 0;
+    ++ instr;
+    NEXT_INSTR
+
+    JMP_LABEL(MOV)
+    regs[instr->dst] = regs[instr->lhs];
+    ++ instr;
+    NEXT_INSTR
+
+    JMP_LABEL(JMP)
+    instr = instrs + instr->rhs;
+    NEXT_INSTR
+
+    JMP_LABEL(JEZ)
+    if (regs[instr->lhs]) {
+        ++ instr;
+    } else {
+        regs[instr->dst] = 0;
+        instr = instrs + instr->rhs;
+    }
+    NEXT_INSTR
+
+    JMP_LABEL(JNZ)
+    if (regs[instr->lhs]) {
+        regs[instr->dst] = 1;
+        instr = instrs + instr->rhs;
+    } else {
+        ++ instr;
+    }
+    NEXT_INSTR
+
+    JMP_LABEL(JZ)
+    if (regs[instr->lhs]) {
+        ++ instr;
+    } else {
+        instr = instrs + instr->rhs;
+    }
+    NEXT_INSTR
+
+    JMP_LABEL(RET)
+    return regs[instr->lhs];
+    NEXT_INSTR
+
+    END_EXEC
+
+    assert(false);
+    errno = EINVAL;
+    return -1;
+}
+
+void regcode_clear(struct Regcode *regcode) {
+#ifndef NDEBUG
+    if (regcode->params_capacity > 0) {
+        memset(regcode->params, 0x00, regcode->params_capacity * sizeof(*regcode->params));
+    }
+    if (regcode->instrs_capacity > 0) {
+        memset(regcode->instrs, 0xFF, regcode->instrs_capacity * sizeof(*regcode->instrs));
+    }
+#endif
+
+    regcode->instrs_size = 0;
+    regcode->params_size = 0;
+    symbol_map_clear(&regcode->param_map);
+    regcode->consts_size = 0;
+    regcode->regs_size   = 0;
+}
+
+void regcode_free(struct Regcode *regcode) {
+    free(regcode->instrs);
+    free(regcode->params);
+    symbol_map_free(&regcode->param_map);
+    free(regcode->consts);
+
+    *regcode = (struct Regcode)REGCODE_INIT();
+}
+
+int *regcode_alloc_params(const struct Regcode *regcode) {
+    return calloc(regcode->params_size, sizeof(int));
+}
+
+int *regcode_alloc_registers(const struct Regcode *regcode) {
+    return calloc(regcode->regs_size, sizeof(int));
+}
+
+ptrdiff_t regcode_get_param_index(const struct Regcode *regcode, const char *name) {
+    for (size_t index = 0; index < regcode->params_size; ++ index) {
+        if (strcmp(regcode->params[index]->name, name) == 0) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+bool regcode_set_param(const struct Regcode *regcode, int *params, const char *name, int value) {
+    ptrdiff_t index = regcode_get_param_index(regcode, name);
+    if (index < 0) {
+        return false;
+    }
+    params[index] = value;
+    return true;
+}
+
+static void regcode_print_reg(const struct Regcode *regcode, FILE *stream, size_t reg) {
+    if (reg < regcode->params_size) {
+        fprintf(stream, "%s", regcode->params[reg]->name);
+    } else if (reg < regcode->params_size + regcode->consts_size) {
+        fprintf(stream, "%d", regcode->consts[reg - regcode->params_size]);
+    } else {
+        fprintf(stream, "r%" PRIuPTR, reg - regcode->params_size - regcode->consts_size);
+    }
+}
+
+void regcode_print(const struct Regcode *regcode, FILE *stream) {
+    fprintf(stream, "registers: %" PRIuPTR "\n", regcode->regs_size);
+
+    fprintf(stream, "parameters:\n");
+    for (size_t param_index = 0; param_index < regcode->params_size; ++ param_index) {
+        fprintf(stream, "%6" PRIuPTR ": %s\n", param_index, regcode->params[param_index]->name);
+    }
+
+    fprintf(stream, "instructions:\n");
+    for (size_t instr_ptr = 0; instr_ptr < regcode->instrs_size; ++ instr_ptr) {
+        const struct RegInstr *instr = &regcode->instrs[instr_ptr];
+        const char *name = NULL;
+
+        switch (instr->opcode) {
+            case REG_ADD:     name = "add";     break;
+            case REG_SUB:     name = "sub";     break;
+            case REG_MUL:     name = "mul";     break;
+            case REG_DIV:     name = "div";     break;
+            case REG_MOD:     name = "mod";     break;
+            case REG_BIT_AND: name = "bit_and"; break;
+            case REG_BIT_XOR: name = "bit_xor"; break;
+            case REG_BIT_OR:  name = "bit_or";  break;
+            case REG_LT:      name = "lt";      break;
+            case REG_LE:      name = "le";      break;
+            case REG_GT:      name = "gt";      break;
+            case REG_GE:      name = "ge";      break;
+            case REG_EQ:      name = "eq";      break;
+            case REG_NE:      name = "ne";      break;
+            case REG_LSHIFT:  name = "lshift";  break;
+            case REG_RSHIFT:  name = "rshift";  break;
+            case REG_NEG:     name = "neg";     break;
+            case REG_BIT_NEG: name = "bit_neg"; break;
+            case REG_NOT:     name = "not";     break;
+            case REG_BOOL:    name = "bool";    break;
+            case REG_MOV:     name = "mov";     break;
+            case REG_JMP:     name = "jmp";     break;
+            case REG_JEZ:     name = "jez";     break;
+            case REG_JNZ:     name = "jnz";     break;
+            case REG_JZ:      name = "jz";      break;
+            case REG_RET:     name = "ret";     break;
+        }
+
+        if (name == NULL) {
+            fprintf(stream, "%6" PRIuPTR ": illegal instruction %u\n", instr_ptr, instr->opcode);
+            continue;
+        }
+
+        fprintf(stream, "%6" PRIuPTR ": ", instr_ptr);
+
+        switch (instr->opcode) {
+            case REG_JMP:
+                fprintf(stream, "%s %u\n", name, instr->rhs);
+                break;
+
+            case REG_JZ:
+                fprintf(stream, "%s ", name);
+                regcode_print_reg(regcode, stream, instr->lhs);
+                fprintf(stream, ", %u\n", instr->rhs);
+                break;
+
+            case REG_JEZ:
+            case REG_JNZ:
+                regcode_print_reg(regcode, stream, instr->dst);
+                fprintf(stream, " = %s ", name);
+                regcode_print_reg(regcode, stream, instr->lhs);
+                fprintf(stream, ", %u\n", instr->rhs);
+                break;
+
+            case REG_RET:
+                fprintf(stream, "%s ", name);
+                regcode_print_reg(regcode, stream, instr->lhs);
+                fputc('\n', stream);
+                break;
+
+            case REG_NEG:
+            case REG_BIT_NEG:
+            case REG_NOT:
+            case REG_BOOL:
+            case REG_MOV:
+                regcode_print_reg(regcode, stream, instr->dst);
+                fprintf(stream, " = %s ", name);
+                regcode_print_reg(regcode, stream, instr->lhs);
+                fputc('\n', stream);
+                break;
+
+            default:
+                regcode_print_reg(regcode, stream, instr->dst);
+                fprintf(stream, " = %s ", name);
+                regcode_print_reg(regcode, stream, instr->lhs);
+                fprintf(stream, ", ");
+                regcode_print_reg(regcode, stream, instr->rhs);
+                fputc('\n', stream);
+                break;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef MINMATH_REGCODE_H__
+#define MINMATH_REGCODE_H__
+#pragma once
+
+#include "ast.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Three-address instructions over a register file. The register file is laid
+// out as: parameters, constants, temporaries. Parameters and constants are
+// copied in on execution, so leaves of the expression don't need any
+// instructions at all.
+enum RegOpcode {
+    REG_ADD,     // dst = lhs + rhs
+    REG_SUB,
+    REG_MUL,
+    REG_DIV,
+    REG_MOD,
+    REG_BIT_AND,
+    REG_BIT_XOR,
+    REG_BIT_OR,
+    REG_LT,
+    REG_LE,
+    REG_GT,
+    REG_GE,
+    REG_EQ,
+    REG_NE,
+    REG_LSHIFT,
+    REG_RSHIFT,
+    REG_NEG,     // dst = -lhs
+    REG_BIT_NEG,
+    REG_NOT,
+    REG_BOOL,    // dst = lhs != 0
+    REG_MOV,     // dst = lhs
+    REG_JMP,     // jump to rhs
+    REG_JEZ,     // if lhs == 0 then dst = 0 and jump to rhs
+    REG_JNZ,     // if lhs != 0 then dst = 1 and jump to rhs
+    REG_JZ,      // if lhs == 0 then jump to rhs
+    REG_RET,     // return lhs
+};
+
+struct RegInstr {
+    uint16_t opcode;
+    uint16_t dst;
+    uint16_t lhs;
+    uint16_t rhs;
+};
+
+#define REGCODE_MAX_INDEX UINT16_MAX
+
+struct Regcode {
+    struct RegInstr *instrs;
+    size_t instrs_size;
+    size_t instrs_capacity;
+
+    const struct Symbol **params;
+    size_t params_size;
+    size_t params_capacity;
+    struct SymbolMap param_map; // index of each symbol in params
+
+    int *consts;
+    size_t consts_size;
+    size_t consts_capacity;
+
+    size_t regs_size;
+};
+
+#define REGCODE_INIT() {            \
+    .instrs = NULL,                 \
+    .instrs_size = 0,               \
+    .instrs_capacity = 0,           \
+    .params = NULL,                 \
+    .params_size = 0,               \
+    .params_capacity = 0,           \
+    .param_map = SYMBOL_MAP_INIT(), \
+    .consts = NULL,                 \
+    .consts_size = 0,               \
+    .consts_capacity = 0,           \
+    .regs_size = 0,                 \
+}
+
+bool regcode_compile(struct Regcode *regcode, const struct AstNode *expr);
+int  regcode_execute(const struct Regcode *regcode, const int *params, int *regs);
+void regcode_free(struct Regcode *regcode);
+void regcode_clear(struct Regcode *regcode);
+ptrdiff_t regcode_get_param_index(const struct Regcode *regcode, const char *name);
+bool regcode_set_param(const struct Regcode *regcode, int *params, const char *name, int value);
+int *regcode_alloc_params(const struct Regcode *regcode);
+int *regcode_alloc_registers(const struct Regcode *regcode);
+void regcode_print(const struct Regcode *regcode, FILE *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,229 @@
+#include "symbol.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+
+uint32_t symbol_hash(const char *name, size_t length) {
+    uint32_t hash = SYMBOL_HASH_INIT;
+    for (size_t index = 0; index < length; ++ index) {
+        hash = SYMBOL_HASH_STEP(hash, name[index]);
+    }
+    return hash;
+}
+
+static size_t symbol_find_slot(const struct SymbolTable *table, const char *name, size_t length, uint32_t hash) {
+    const size_t mask = table->slots_capacity - 1;
+    size_t index = hash & mask;
+
+    for (;;) {
+        const struct Symbol *symbol = table->slots[index];
+        if (symbol == NULL || (
+                symbol->hash == hash &&
+                symbol->length == length &&
+                memcmp(symbol->name, name, length) == 0)) {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static bool symbol_table_grow(struct SymbolTable *table) {
+    size_t new_capacity;
+    if (table->slots_capacity == 0) {
+        new_capacity = 64;
+    } else if (table->slots_capacity > SIZE_MAX / 2 / sizeof(struct Symbol*)) {
+        errno = ENOMEM;
+        return false;
+    } else {
+        new_capacity = table->slots_capacity * 2;
+    }
+
+    const struct Symbol **slots = calloc(new_capacity, sizeof(struct Symbol*));
+    if (slots == NULL) {
+        return false;
+    }
+
+    const struct Symbol **symbols = realloc(table->symbols, new_capacity / 2 * sizeof(struct Symbol*));
+    if (symbols == NULL) {
+        free(slots);
+        return false;
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slots_capacity = new_capacity;
+    table->symbols = symbols;
+    table->symbols_capacity = new_capacity / 2;
+
+    for (size_t id = 0; id < table->symbols_size; ++ id) {
+        const struct Symbol *symbol = symbols[id];
+        slots[symbol_find_slot(table, symbol->name, symbol->length, symbol->hash)] = symbol;
+    }
+
+    return true;
+}
+
+const struct Symbol *symbol_intern(struct SymbolTable *table, const char *name, size_t length) {
+    return symbol_intern_hashed(table, name, length, symbol_hash(name, length));
+}
+
+const struct Symbol *symbol_intern_hashed(struct SymbolTable *table, const char *name, size_t length, uint32_t hash) {
+    assert(hash == symbol_hash(name, length));
+
+    if (table->slots_capacity != 0) {
+        const struct Symbol *symbol = table->slots[symbol_find_slot(table, name, length, hash)];
+        if (symbol != NULL) {
+            return symbol;
+        }
+    }
+
+    if (table->symbols_size == table->symbols_capacity) {
+        if (table->symbols_size >= UINT32_MAX) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        if (!symbol_table_grow(table)) {
+            return NULL;
+        }
+    }
+
+    if (length > SIZE_MAX - sizeof(struct Symbol) - 1) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    struct Symbol *symbol = arena_alloc(&table->arena, sizeof(struct Symbol) + length + 1, _Alignof(struct Symbol));
+    if (symbol == NULL) {
+        return NULL;
+    }
+
+    symbol->id     = table->symbols_size;
+    symbol->hash   = hash;
+    symbol->length = length;
+    memcpy(symbol->name, name, length);
+    symbol->name[length] = 0;
+
+    table->symbols[table->symbols_size ++] = symbol;
+    table->slots[symbol_find_slot(table, name, length, hash)] = symbol;
+
+    return symbol;
+}
+
+const struct Symbol *symbol_lookup(const struct SymbolTable *table, const char *name) {
+    if (table->slots_capacity == 0) {
+        return NULL;
+    }
+    const size_t length = strlen(name);
+    return table->slots[symbol_find_slot(table, name, length, symbol_hash(name, length))];
+}
+
+const struct Symbol *symbol_get(const struct SymbolTable *table, uint32_t id) {
+    assert(id < table->symbols_size);
+    return table->symbols[id];
+}
+
+size_t symbol_count(const struct SymbolTable *table) {
+    return table->symbols_size;
+}
+
+void symbol_table_free(struct SymbolTable *table) {
+    arena_free(&table->arena);
+    free(table->slots);
+    free(table->symbols);
+
+    *table = (struct SymbolTable)SYMBOL_TABLE_INIT();
+}
+
+// Fibonacci hashing of the name hash: the top log2(capacity) bits of the
+// product depend on all of its bits
+static inline size_t symbol_map_home(const struct SymbolMap *map, uint32_t hash) {
+    return (uint32_t)(hash * UINT32_C(2654435769)) >> (32 - __builtin_ctzll(map->entries_capacity));
+}
+
+// the entry of symbol, or the free entry where it belongs
+static inline struct SymbolMapEntry *symbol_map_find(const struct SymbolMap *map, const struct Symbol *symbol) {
+    const size_t mask = map->entries_capacity - 1;
+    size_t index = symbol_map_home(map, symbol->hash);
+
+    for (;;) {
+        struct SymbolMapEntry *entry = &map->entries[index];
+        if (entry->symbol == symbol || entry->symbol == NULL) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static bool symbol_map_grow(struct SymbolMap *map) {
+    size_t new_capacity;
+    if (map->entries_capacity == 0) {
+        new_capacity = 8;
+    } else if (map->entries_capacity > UINT32_MAX / 2) {
+        errno = ENOMEM;
+        return false;
+    } else {
+        new_capacity = map->entries_capacity * 2;
+    }
+
+    struct SymbolMapEntry *old_entries = map->entries;
+    const size_t old_capacity = map->entries_capacity;
+
+    struct SymbolMapEntry *entries = calloc(new_capacity, sizeof(struct SymbolMapEntry));
+    if (entries == NULL) {
+        return false;
+    }
+    map->entries = entries;
+    map->entries_capacity = new_capacity;
+
+    for (size_t index = 0; index < old_capacity; ++ index) {
+        if (old_entries[index].symbol != NULL) {
+            *symbol_map_find(map, old_entries[index].symbol) = old_entries[index];
+        }
+    }
+    free(old_entries);
+
+    return true;
+}
+
+ptrdiff_t symbol_map_get(const struct SymbolMap *map, const struct Symbol *symbol) {
+    if (map->entries_size == 0) {
+        return -1;
+    }
+    const struct SymbolMapEntry *entry = symbol_map_find(map, symbol);
+    return entry->symbol == NULL ? -1 : (ptrdiff_t)entry->index;
+}
+
+bool symbol_map_put(struct SymbolMap *map, const struct Symbol *symbol, uint32_t index) {
+    if (map->entries_capacity != 0) {
+        struct SymbolMapEntry *entry = symbol_map_find(map, symbol);
+        if (entry->symbol != NULL) {
+            entry->index = index;
+            return true;
+        }
+    }
+
+    if ((map->entries_size + 1) * 2 > map->entries_capacity && !symbol_map_grow(map)) {
+        return false;
+    }
+
+    *symbol_map_find(map, symbol) = (struct SymbolMapEntry){ .symbol = symbol, .index = index };
+    ++ map->entries_size;
+
+    return true;
+}
+
+void symbol_map_clear(struct SymbolMap *map) {
+    if (map->entries_size > 0) {
+        memset(map->entries, 0, map->entries_capacity * sizeof(struct SymbolMapEntry));
+        map->entries_size = 0;
+    }
+}
+
+void symbol_map_free(struct SymbolMap *map) {
+    free(map->entries);
+
+    *map = (struct SymbolMap)SYMBOL_MAP_INIT();
+}
@@ -0,0 +1,100 @@
+#ifndef MINMATH_SYMBOL_H__
+#define MINMATH_SYMBOL_H__
+#pragma once
+
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interned identifiers. Every name is stored only once per symbol table, so
+// equal names of one table are the same symbol and can be compared by
+// pointer. Ids are dense per table (0 ... symbol_count() - 1, in the order of
+// interning) and can be used to index arrays.
+struct Symbol {
+    uint32_t id;
+    uint32_t hash;
+    size_t length;
+    char name[];
+};
+
+// FNV-1a, SYMBOL_HASH_STEP() is applied to every char of the name, so the
+// tokenizer can hash identifiers while scanning them.
+#define SYMBOL_HASH_INIT UINT32_C(2166136261)
+#define SYMBOL_HASH_STEP(HASH, CH) (((HASH) ^ (uint8_t)(CH)) * UINT32_C(16777619))
+
+// Owned by the caller and passed to the parsers like a struct Arena. Trees
+// refer to its symbols, so it has to outlive them. It only grows, release it
+// with symbol_table_free() once its trees are gone. Not thread safe, use a
+// table per thread or lock it.
+//
+// Open addressing with linear probing, the capacity is a power of two and the
+// table is at most half full.
+struct SymbolTable {
+    struct Arena arena;
+    const struct Symbol **slots;
+    size_t slots_capacity;
+    const struct Symbol **symbols; // by id
+    size_t symbols_size;
+    size_t symbols_capacity;
+};
+
+#define SYMBOL_TABLE_INIT() { \
+    .arena = ARENA_INIT(),    \
+    .slots = NULL,            \
+    .slots_capacity = 0,      \
+    .symbols = NULL,          \
+    .symbols_size = 0,        \
+    .symbols_capacity = 0,    \
+}
+
+struct SymbolMapEntry {
+    const struct Symbol *symbol; // NULL for a free entry
+    uint32_t index;
+};
+
+// Maps symbols to indices, e.g. of the parameter list of compiled code, so
+// compilers don't scan that list for every variable. Symbols are compared by
+// pointer and probed by their precomputed hash. Open addressing with linear
+// probing, the capacity is a power of two and the map is at most half full.
+struct SymbolMap {
+    struct SymbolMapEntry *entries;
+    size_t entries_size;
+    size_t entries_capacity;
+};
+
+#define SYMBOL_MAP_INIT() { \
+    .entries = NULL,        \
+    .entries_size = 0,      \
+    .entries_capacity = 0,  \
+}
+
+uint32_t symbol_hash(const char *name, size_t length);
+/// returns NULL and sets errno on error
+const struct Symbol *symbol_intern(struct SymbolTable *table, const char *name, size_t length);
+/// same as symbol_intern(), hash has to be symbol_hash(name, length)
+const struct Symbol *symbol_intern_hashed(struct SymbolTable *table, const char *name, size_t length, uint32_t hash);
+/// returns NULL if the name was never interned
+const struct Symbol *symbol_lookup(const struct SymbolTable *table, const char *name);
+const struct Symbol *symbol_get(const struct SymbolTable *table, uint32_t id);
+size_t symbol_count(const struct SymbolTable *table);
+/// releases all symbols, pointers to them become invalid
+void symbol_table_free(struct SymbolTable *table);
+
+/// index of symbol, -1 if it isn't in the map
+ptrdiff_t symbol_map_get(const struct SymbolMap *map, const struct Symbol *symbol);
+/// sets the index of symbol, returns false and sets errno on error
+bool symbol_map_put(struct SymbolMap *map, const struct Symbol *symbol, uint32_t index);
+void symbol_map_clear(struct SymbolMap *map);
+void symbol_map_free(struct SymbolMap *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,6 +3,11 @@
 #include "fast_parser.h"
 #include "optimizer.h"
 #include "bytecode.h"
+#include "regcode.h"
+#include "batch_kernels.h"
+#include "jit.h"
+#include "closure.h"
+#include "threaded.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -25,21 +30,53 @@ extern char **environ;
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
+#define BATCH_ROWS  4099
+#define BATCH_ITERS 1000
+#define BATCH_TEST_ROWS 300
+#define BATCH_VAR_COUNT 3
+
+#define MULTI_RULE_COUNT 240
+#define MULTI_ITERS 20
+
+#define DEEP_TEST_DEPTH  100000
+#define DEEP_BENCH_DEPTH 1000
+#define WIDE_BENCH_TERMS 10000
+#define SHAPE_ITERS 200
+#define ONE_SHOT_ITERS 1000
+#define TOKEN_ARRAY_ITERS 1000
+#define PARAM_TEST_COUNT  3000
+#define PARAM_BENCH_COUNT 5000
+#define PARAM_BENCH_ITERS 100
+
+#define TOKENIZER_BULK_SIZE (4 << 20)
+#define TOKENIZER_BULK_ITERS 50
+
 struct OptItem {
     struct AstNode *expr;
     struct AstNode *opt_expr;
     struct Bytecode unopt_bytecode;
     struct Bytecode bytecode;
     struct Bytecode opt_bytecode;
+    struct Regcode regcode;
+    struct JitCode jit;
+    struct Closure closure;
+    struct ThreadedCode threaded;
+    struct FlatAst flat_ast;
     int *unopt_params;
     int *params;
+    int *reg_params;
+    int *closure_params;
     struct Param *ast_params;
     size_t ast_params_size;
+    struct AstBinding binding;
+    int *slot_values;
+    struct AstEnviron env;
+    int *flat_values; // by variable of flat_ast
 };
 
 struct ParseFunc {
     const char *name;
-    struct AstNode *(*parse)(const char *input, struct ErrorInfo *error);
+    struct AstNode *(*parse)(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
 };
 
 struct Stats {
@@ -50,20 +87,105 @@ struct Stats {
     struct timespec sum;
 };
 
+// Expressions with data dependent branches for the batch interpreter. The
+// variables a, b, and c are in the range of -100 to 100, so there is no
+// division by zero and no overflow.
+const char *BATCH_EXPRS[] = {
+    "a < b ? a * 3 + c : b - c * 2",
+    "a && b || c > 10",
+    "(a > 0 ? a / (b | 1) : c % (a | 1)) + (b >= c && a != 0)",
+    "~a ^ (b << 3) >> 1 == c ? !a : -b",
+    "a == 0 ? 1 : b == 0 ? 2 : c == 0 ? 3 : a + b + c",
+    "(a <= 0 || b != c) * (a & 12) | (b ^ c) % 7",
+    "(a << (b & 31)) + (c >> (a & 31))",
+    NULL,
+};
+
+struct BatchItem {
+    struct Bytecode bytecode;
+    const int **params;
+    int *columns;
+    int *row_params;
+    int *results;
+};
+
+// the variables of the trees of all tests, released at the end of main()
+static struct SymbolTable symbol_table = SYMBOL_TABLE_INIT();
+
+static struct AstNode *parse_pretokenized(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+static struct AstNode *fast_parse_pretokenized(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error);
+
 const struct ParseFunc PARSE_FUNCS[] = {
     { "Recursive Descent", parse },
     { "Pratt", fast_parse },
+    { "Iterative Pratt", fast_parse_iterative },
+    { "Recursive Descent (tokens)", parse_pretokenized },
+    { "Pratt (tokens)", fast_parse_pretokenized },
     { NULL, NULL },
 };
 
 static void opt_item_free(struct OptItem *opt_item);
 static void opt_items_free(struct OptItem *opt_items, size_t count);
 
+typedef bool (*SetParamFunc)(const void *code, int *params, const char *name, int value);
+
+static bool params_from_environ_with(SetParamFunc set_param, const void *code, int *params, char * const *environ);
 static bool params_from_environ(const struct Bytecode *bytecode, int *params, char * const *environ);
+static bool regcode_params_from_environ(const struct Regcode *regcode, int *params, char * const *environ);
+static bool closure_params_from_environ(const struct Closure *closure, int *params, char * const *environ);
+
+static size_t test_regcode(const char *parser_name, const struct TestCase *test, const struct AstNode *expr);
+static size_t test_ast_slots(const char *parser_name, const struct TestCase *test, struct AstNode *expr, const struct Param *ast_params, size_t ast_params_size);
+static size_t test_ast_binding(void);
+static size_t test_ast_environ(void);
+static size_t test_specialize(const char *parser_name, const struct TestCase *test, const struct AstNode *expr, const struct Param *ast_params, size_t ast_params_size);
+static size_t test_specialize_branches(void);
+static size_t test_optimize_ranges(const char *parser_name, const struct TestCase *test, const struct AstNode *expr, const struct Param *ast_params, size_t ast_params_size);
+static size_t test_range_folding(void);
+static size_t test_closure(const char *parser_name, const struct TestCase *test, const struct AstNode *expr);
+static bool jit_is_unavailable(int errnum);
+static size_t test_jit(const char *parser_name, const struct TestCase *test, const struct Bytecode *bytecode, const int *params);
+static size_t test_threaded(const char *parser_name, const struct TestCase *test, const struct Bytecode *bytecode, const int *params);
+static size_t test_tailcall(const char *parser_name, const struct TestCase *test, const struct Bytecode *bytecode, const int *params);
+static size_t test_verify(const char *parser_name, const struct TestCase *test, struct Bytecode *bytecode, const int *params);
+
+static int *batch_random_columns(size_t row_count);
+static bool batch_item_init(struct BatchItem *item, const char *source, int *const columns[], size_t row_count);
+static void batch_item_free(struct BatchItem *item);
+static size_t test_batch(const char *source, const struct BatchItem *item, size_t row_count);
+
+static size_t test_bytecode_encoding(void);
+static size_t test_bytecode_wide(void);
+static size_t test_wide_bytecode(const char *name, struct Bytecode *bytecode, size_t x_index, size_t y_index, const int expected[]);
+static size_t test_bytecode_verifier(void);
+static size_t test_bytecode_cse(void);
+static size_t test_arena_ast(void);
+static size_t test_flat_ast(void);
+static size_t test_symbols(void);
+static size_t test_tokenizer_runs(void);
+static size_t test_iterative_parser(void);
+static size_t test_token_array_parsers(void);
+static bool same_parser_error(const struct ErrorInfo *lhs, const struct ErrorInfo *rhs);
+static size_t test_bytecode_source(void);
+static size_t test_bytecode_params(void);
+static char *make_param_sum(const char *prefix, size_t count);
+static char *make_deep_input(const char *prefix, const char *leaf, const char *suffix, size_t depth);
+static int bench_parser_shapes(void);
+static int bench_one_shot(void);
+static int bench_token_array(void);
+static bool bench_bulk_tokenizer(const char *input, struct timespec *times, size_t *token_count);
+static int bench_param_binding(void);
+static bool multi_parse_rules(struct AstNode **rules, size_t count);
+static void multi_free_rules(struct AstNode **rules, size_t count);
+static size_t test_bytecode_multi(void);
+static int bench_multi(void);
+
+static bool print_census(FILE *stream);
 
 static struct Param *ast_params_from_environ(char * const *environ);
 static size_t ast_params_len(const struct Param *params);
 static void ast_params_free(struct Param *params);
+static bool ast_bind_params(struct AstBinding *binding, struct AstNode *expr, const struct Param *params, size_t param_count, int **values);
 
 static inline struct timespec timespec_add(const struct timespec lhs, const struct timespec rhs);
 static inline struct timespec timespec_sub(const struct timespec lhs, const struct timespec rhs);
@@ -281,9 +403,20 @@ void opt_item_free(struct OptItem *opt_item) {
     bytecode_free(&opt_item->unopt_bytecode);
     bytecode_free(&opt_item->bytecode);
     bytecode_free(&opt_item->opt_bytecode);
+    regcode_free(&opt_item->regcode);
+    jit_free(&opt_item->jit);
+    closure_free(&opt_item->closure);
+    threaded_free(&opt_item->threaded);
+    flat_ast_free(&opt_item->flat_ast);
     free(opt_item->unopt_params);
     free(opt_item->params);
+    free(opt_item->reg_params);
+    free(opt_item->closure_params);
     ast_params_free(opt_item->ast_params);
+    ast_binding_free(&opt_item->binding);
+    free(opt_item->slot_values);
+    ast_environ_free(&opt_item->env);
+    free(opt_item->flat_values);
 }
 
 void opt_items_free(struct OptItem *opt_items, size_t count) {
@@ -293,7 +426,31 @@ void opt_items_free(struct OptItem *opt_items, size_t count) {
     free(opt_items);
 }
 
+static bool bytecode_set_param_func(const void *code, int *params, const char *name, int value) {
+    return bytecode_set_param(code, params, name, value);
+}
+
+static bool regcode_set_param_func(const void *code, int *params, const char *name, int value) {
+    return regcode_set_param(code, params, name, value);
+}
+
+static bool closure_set_param_func(const void *code, int *params, const char *name, int value) {
+    return closure_set_param(code, params, name, value);
+}
+
 bool params_from_environ(const struct Bytecode *bytecode, int *params, char * const *environ) {
+    return params_from_environ_with(bytecode_set_param_func, bytecode, params, environ);
+}
+
+bool regcode_params_from_environ(const struct Regcode *regcode, int *params, char * const *environ) {
+    return params_from_environ_with(regcode_set_param_func, regcode, params, environ);
+}
+
+bool closure_params_from_environ(const struct Closure *closure, int *params, char * const *environ) {
+    return params_from_environ_with(closure_set_param_func, closure, params, environ);
+}
+
+bool params_from_environ_with(SetParamFunc set_param, const void *code, int *params, char * const *environ) {
     char *name = NULL;
     size_t name_size = 0;
     for (char * const *envvar = environ; *envvar; ++ envvar) {
@@ -332,7 +489,7 @@ bool params_from_environ(const struct Bytecode *bytecode, int *params, char * co
         }
 
         // ignoring return value because parameter might be optimized out
-        bytecode_set_param(bytecode, params, name, value);
+        set_param(code, params, name, value);
     }
 
     free(name);
@@ -407,232 +564,3430 @@ void ast_params_free(struct Param *params) {
     }
 }
 
-int main(int argc, char *argv[]) {
-    struct ErrorInfo error;
-    struct timespec ts_start, ts_end;
-    int res_start, res_end;
-    size_t error_count = 0;
-    struct Bytecode bytecode = BYTECODE_INIT();
+// binds expr to the names of params, *values gets their values in the same order
+bool ast_bind_params(struct AstBinding *binding, struct AstNode *expr, const struct Param *params, size_t param_count, int **values) {
+    const char **names = calloc(param_count + 1, sizeof(const char*));
+    int *slot_values = calloc(param_count + 1, sizeof(int));
+    if (names == NULL || slot_values == NULL) {
+        free(names);
+        free(slot_values);
+        return false;
+    }
 
-    for (const struct ParseFunc *func = PARSE_FUNCS; func->name; ++ func) {
-        printf("Testing with %s parser...\n", func->name);
-        for (const struct TestCase *test = TESTS; test->expr; ++ test) {
-            struct AstNode *expr = func->parse(test->expr, &error);
-            if (expr == NULL) {
-                fprintf(stderr, "*** [%s] Error parsing expression: \"%s\"\n", func->name, test->expr);
-                print_parser_error(stderr, test->expr, &error, 1);
-                ++ error_count;
-            } else {
-                // Test AST interpreter
-                char **environ_bakup = environ;
-                environ = test->environ;
-                int result = ast_execute_with_environ(expr);
-                environ = environ_bakup;
+    for (size_t index = 0; index < param_count; ++ index) {
+        names[index] = params[index].name;
+        slot_values[index] = params[index].value;
+    }
 
-                if (result != test->result) {
-                    fprintf(stderr, "*** [%s] Result missmatch of ast_execute_with_environ():\nEnvironment:\n", func->name);
-                    for (char **ptr = test->environ; *ptr; ++ ptr) {
-                        fprintf(stderr, "    %s\n", *ptr);
-                    }
-                    fprintf(stderr,
-                        "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
-                    ast_print(stderr, expr);
+    const struct Symbol *missing = NULL;
+    const bool ok = ast_bind(binding, expr, names, param_count, &missing);
+    free(names);
 
-                    if (func->parse != parse) {
-                        struct AstNode *rd_expr = parse(test->expr, NULL);
-                        if (rd_expr != NULL) {
-                            fprintf(stderr, "\nRD Parser:\n    ");
-                            ast_print(stderr, rd_expr);
-                            ast_free(rd_expr);
-                        }
-                    }
+    if (!ok) {
+        if (missing != NULL) {
+            fprintf(stderr, "*** parameter not found: %s\n", missing->name);
+        }
+        free(slot_values);
+        return false;
+    }
 
-                    fprintf(stderr, "\nResult:\n    %d\nExpected:\n    %d\n\n",
-                        result, test->result);
+    *values = slot_values;
+    return true;
+}
 
-                    ++ error_count;
-                }
+size_t test_ast_slots(const char *parser_name, const struct TestCase *test, struct AstNode *expr, const struct Param *ast_params, size_t ast_params_size) {
+    struct AstBinding binding = AST_BINDING_INIT();
+    int *values = NULL;
+    size_t error_count = 0;
 
-                struct Param *ast_params = ast_params_from_environ(test->environ);
-                size_t ast_params_size = ast_params_len(ast_params);
-                if (ast_params == NULL) {
-                    fprintf(stderr, "[%s] Error creating ast params: %s\n", func->name, strerror(errno));
-                    ++ error_count;
-                } else {
-                    int result = ast_execute_with_params(expr, ast_params, ast_params_size);
+    if (!ast_bind_params(&binding, expr, ast_params, ast_params_size, &values)) {
+        fprintf(stderr, "*** [%s] Error binding parameters: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else {
+        const int result = ast_execute_with_slots(expr, values);
+        if (result != test->result) {
+            fprintf(stderr, "*** [%s] Result missmatch of ast_execute_with_slots(): %d != %d\n", parser_name, result, test->result);
+            fprintf(stderr, "Expression: %s\n", test->expr);
+            ++ error_count;
+        }
+    }
 
-                    if (result != test->result) {
-                        fprintf(stderr, "*** [%s] Result missmatch of ast_execute_with_params():\nParameters:\n", func->name);
-                        for (const struct Param *param = ast_params; param->name; ++ param) {
-                            fprintf(stderr, "    %s = %d\n", param->name, param->value);
-                        }
-                        fprintf(stderr,
-                            "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
-                        ast_print(stderr, expr);
-                        fprintf(stderr, "\nResult:\n    %d\nExpected:\n    %d\n\n",
-                            result, test->result);
+    ast_binding_free(&binding);
+    free(values);
 
-                        ++ error_count;
-                    }
-                }
+    return error_count;
+}
 
-                // Test bytecode interpreter
-                if (!bytecode_compile(&bytecode, expr)) {
-                    fprintf(stderr, "*** [%s] Error compiling to bytecode: %s\n", func->name, strerror(errno));
-                    fprintf(stderr, "Expression: %s\n", test->expr);
-                    ++ error_count;
-                } else {
-                    int *stack = bytecode_alloc_stack(&bytecode);
-                    if (stack == NULL) {
-                        fprintf(stderr, "*** [%s] Error allocating stack: %s\n", func->name, strerror(errno));
-                        fprintf(stderr, "Expression: %s\n", test->expr);
-                        ++ error_count;
-                    } else {
-                        int *params = bytecode_alloc_params(&bytecode);
-                        if (params == NULL) {
-                            fprintf(stderr, "*** [%s] Error allocating params: %s\n", func->name, strerror(errno));
-                            fprintf(stderr, "Expression: %s\n", test->expr);
-                            ++ error_count;
-                        } else {
-                            if (!params_from_environ(&bytecode, params, test->environ)) {
-                                fprintf(stderr, "*** [%s] Error initializing params: %s\n", func->name, strerror(errno));
-                                fprintf(stderr, "Expression: %s\nEnvironment:\n", test->expr);
-                                for (char **ptr = test->environ; *ptr; ++ ptr) {
-                                    fprintf(stderr, "    %s\n", *ptr);
-                                }
-                                ++ error_count;
-                            } else {
-                                result = bytecode_execute(&bytecode, params, stack);
+// Every other parameter is fixed, the specialized tree and bytecode only read
+// the remaining ones.
+size_t test_specialize(const char *parser_name, const struct TestCase *test, const struct AstNode *expr, const struct Param *ast_params, size_t ast_params_size) {
+    struct Param *fixed = calloc(ast_params_size + 1, sizeof(struct Param));
+    struct Param *free_params = calloc(ast_params_size + 1, sizeof(struct Param));
+    struct AstNode *spec_expr = NULL;
+    struct AstBinding binding = AST_BINDING_INIT();
+    struct Bytecode bytecode = BYTECODE_INIT();
+    int *values = NULL;
+    int *params = NULL;
+    int *stack = NULL;
+    size_t error_count = 0;
 
-                                if (result != test->result) {
-                                    fprintf(stderr, "*** [%s] Bytecode execution result missmatch:\nEnvironment:\n", func->name);
-                                    for (char **ptr = test->environ; *ptr; ++ ptr) {
-                                        fprintf(stderr, "    %s\n", *ptr);
-                                    }
-                                    fprintf(stderr, "Expression:\n    %s\nBytecode:\n", test->expr);
-                                    bytecode_print(&bytecode, stderr);
-                                    fprintf(stderr,
-                                        "\nResult:\n    %d\nExpected:\n    %d\n\n",
-                                        result, test->result);
+    if (fixed == NULL || free_params == NULL) {
+        fprintf(stderr, "*** [%s] Error allocating parameters: %s\n", parser_name, strerror(errno));
+        ++ error_count;
+        goto cleanup;
+    }
 
-                                    ++ error_count;
-                                }
-                            }
+    // subsets of sorted parameters are sorted
+    size_t fixed_count = 0;
+    size_t free_count  = 0;
+    for (size_t index = 0; index < ast_params_size; ++ index) {
+        if (index % 2 == 0) {
+            fixed[fixed_count ++] = ast_params[index];
+        } else {
+            free_params[free_count ++] = ast_params[index];
+        }
+    }
 
-                            free(params);
-                        }
+    spec_expr = ast_specialize(expr, fixed, fixed_count);
+    if (spec_expr == NULL) {
+        fprintf(stderr, "*** [%s] Error specializing expression: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+        goto cleanup;
+    }
 
-                        free(stack);
-                    }
-                }
+    // binding fails if a fixed parameter is still read
+    if (!ast_bind_params(&binding, spec_expr, free_params, free_count, &values)) {
+        fprintf(stderr, "*** [%s] Specialized expression reads fixed parameters\n", parser_name);
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else {
+        const int result = ast_execute_with_slots(spec_expr, values);
+        if (result != test->result) {
+            fprintf(stderr, "*** [%s] Result missmatch of ast_specialize(): %d != %d\n", parser_name, result, test->result);
+            fprintf(stderr, "Expression: %s\n", test->expr);
+            ++ error_count;
+        }
+    }
 
-                bytecode_clear(&bytecode);
+    if (!bytecode_specialize(&bytecode, expr, fixed, fixed_count)) {
+        fprintf(stderr, "*** [%s] Error in bytecode_specialize(): %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+        goto cleanup;
+    }
 
-                // Optimizations
-                struct AstNode *opt_expr = ast_optimize(expr);
-                if (opt_expr == NULL) {
-                    fprintf(stderr,
-                        "*** [%s] Error optimizing expression \"%s\": %s\n",
-                        func->name, test->expr, strerror(errno));
-                    ++ error_count;
-                } else {
-                    // Test AST interpreter on optimized AST
-                    environ = test->environ;
-                    int result = ast_execute_with_environ(opt_expr);
-                    environ = environ_bakup;
-                    if (result != test->result) {
-                        fprintf(stderr, "*** [%s] Optimized result missmatch of ast_execute_with_environ():\nEnvironment:\n", func->name);
-                        for (char **ptr = test->environ; *ptr; ++ ptr) {
-                            fprintf(stderr, "    %s\n", *ptr);
-                        }
-                        fprintf(stderr,
-                            "Expression:\n    %s\nOptimized Expression:\n    ",
-                            test->expr);
-                        ast_print(stderr, opt_expr);
-                        fprintf(stderr,
-                            "\nResult:\n    %d\nExpected:\n    %d\n\n",
-                            result, test->result);
+    params = bytecode_alloc_params(&bytecode);
+    stack  = bytecode_alloc_stack(&bytecode);
+    if ((params == NULL && bytecode.params_size > 0) || stack == NULL) {
+        fprintf(stderr, "*** [%s] Error allocating bytecode memory: %s\n", parser_name, strerror(errno));
+        ++ error_count;
+        goto cleanup;
+    }
 
-                        ++ error_count;
-                    }
+    for (size_t index = 0; index < bytecode.params_size; ++ index) {
+        const struct Param *param = params_find(free_params, free_count, bytecode.params[index]->name);
+        if (param == NULL) {
+            fprintf(stderr, "*** [%s] Specialized bytecode reads fixed parameter: %s\n", parser_name, bytecode.params[index]->name);
+            fprintf(stderr, "Expression: %s\n", test->expr);
+            ++ error_count;
+            goto cleanup;
+        }
+        params[index] = param->value;
+    }
 
-                    if (ast_params != NULL) {
-                        int result = ast_execute_with_params(expr, ast_params, ast_params_size);
+    const int result = bytecode_execute(&bytecode, params, stack);
+    if (result != test->result) {
+        fprintf(stderr, "*** [%s] Result missmatch of bytecode_specialize(): %d != %d\n", parser_name, result, test->result);
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    }
 
-                        if (result != test->result) {
-                            fprintf(stderr, "*** [%s] Optimized result missmatch of ast_execute_with_params():\nParameters:\n", func->name);
-                            for (const struct Param *param = ast_params; param->name; ++ param) {
-                                fprintf(stderr, "    %s = %d\n", param->name, param->value);
-                            }
-                            fprintf(stderr,
-                                "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
-                            ast_print(stderr, expr);
-                            fprintf(stderr, "\nResult:\n    %d\nExpected:\n    %d\n\n",
-                                result, test->result);
+cleanup:
+    free(fixed);
+    free(free_params);
+    ast_free(spec_expr);
+    ast_binding_free(&binding);
+    bytecode_free(&bytecode);
+    free(values);
+    free(params);
+    free(stack);
 
-                            ++ error_count;
-                        }
-                    }
+    return error_count;
+}
 
-                    // Test optimized bytecode interpreter on optimized AST
-                    if (!bytecode_compile(&bytecode, opt_expr)) {
-                        fprintf(stderr, "*** [%s] Error compiling to bytecode: %s\n", func->name, strerror(errno));
-                        fprintf(stderr, "Expression: %s\n", test->expr);
-                        ++ error_count;
-                    } else if (!bytecode_optimize(&bytecode)) {
-                            fprintf(stderr, "*** [%s] Error optimizing bytecode: %s\n", func->name, strerror(errno));
-                            fprintf(stderr, "Expression: %s\n", test->expr);
-                            ++ error_count;
-                    } else {
-                        int *stack = bytecode_alloc_stack(&bytecode);
-                        if (stack == NULL) {
-                            fprintf(stderr, "*** [%s] Error allocating stack: %s\n", func->name, strerror(errno));
-                            fprintf(stderr, "Expression: %s\n", test->expr);
-                            ++ error_count;
-                        } else {
-                            int *params = bytecode_alloc_params(&bytecode);
-                            if (params == NULL) {
-                                fprintf(stderr, "*** [%s] Error allocating params: %s\n", func->name, strerror(errno));
-                                fprintf(stderr, "Expression: %s\n", test->expr);
-                                ++ error_count;
-                            } else {
-                                if (!params_from_environ(&bytecode, params, test->environ)) {
-                                    fprintf(stderr, "*** [%s] Error initializing params: %s\n", func->name, strerror(errno));
-                                    fprintf(stderr, "Expression: %s\nEnvironment:\n", test->expr);
-                                    for (char **ptr = test->environ; *ptr; ++ ptr) {
-                                        fprintf(stderr, "    %s\n", *ptr);
-                                    }
-                                    ++ error_count;
-                                } else {
-                                    result = bytecode_execute(&bytecode, params, stack);
+// Branches on fixed parameters are eliminated, only the free parameters
+// remain. Unknown names are ignored.
+size_t test_specialize_branches(void) {
+    size_t error_count = 0;
 
-                                    if (result != test->result) {
-                                        fprintf(stderr, "*** [%s] Bytecode execution result missmatch:\nEnvironment:\n", func->name);
-                                        for (char **ptr = test->environ; *ptr; ++ ptr) {
-                                            fprintf(stderr, "    %s\n", *ptr);
-                                        }
-                                        fprintf(stderr,
-                                            "Expression:\n    %s\nOptimized Expression:\n    ",
-                                            test->expr);
-                                        ast_print(stderr, opt_expr);
-                                        fprintf(stderr, "\nOptimized Bytecode:\n");
-                                        bytecode_print(&bytecode, stderr);
-                                        fprintf(stderr,
-                                            "\nResult:\n    %d\nExpected:\n    %d\n\n",
-                                            result, test->result);
+    struct AstNode *expr = fast_parse(&symbol_table, "tenant_flag ? x * tenant_limit : x + tenant_limit", NULL);
+    if (expr == NULL) {
+        fprintf(stderr, "*** Error parsing specialization test expression: %s\n", strerror(errno));
+        return 1;
+    }
 
-                                        ++ error_count;
-                                    }
-                                }
+    const struct Param fixed[] = {
+        { .name = "no_such_param", .value = 7 },
+        { .name = "tenant_flag",   .value = 0 },
+        { .name = "tenant_limit",  .value = 4 },
+    };
 
-                                free(params);
-                            }
+    struct AstNode *spec_expr = ast_specialize(expr, fixed, sizeof(fixed) / sizeof(fixed[0]));
+    if (spec_expr == NULL) {
+        fprintf(stderr, "*** Error specializing: %s\n", strerror(errno));
+        ++ error_count;
+    } else if (spec_expr->type != NODE_ADD ||
+               spec_expr->data.binary.lhs->type != NODE_VAR ||
+               strcmp(spec_expr->data.binary.lhs->data.symbol->name, "x") != 0 ||
+               spec_expr->data.binary.rhs->type != NODE_INT ||
+               spec_expr->data.binary.rhs->data.value != 4) {
+        fprintf(stderr, "*** Branch wasn't eliminated by ast_specialize(): ");
+        ast_print(stderr, spec_expr);
+        fprintf(stderr, "\n");
+        ++ error_count;
+    }
+    ast_free(spec_expr);
 
-                            free(stack);
-                        }
-                    }
+    struct Bytecode bytecode = BYTECODE_INIT();
+    struct Bytecode full = BYTECODE_INIT();
+    if (!bytecode_specialize(&bytecode, expr, fixed, sizeof(fixed) / sizeof(fixed[0])) ||
+        !bytecode_compile(&full, expr)) {
+        fprintf(stderr, "*** Error compiling specialization test expression: %s\n", strerror(errno));
+        ++ error_count;
+    } else if (bytecode.params_size != 1 || strcmp(bytecode.params[0]->name, "x") != 0 ||
+               bytecode.instrs_size >= full.instrs_size) {
+        fprintf(stderr, "*** bytecode_specialize() didn't drop the fixed parameters\n");
+        ++ error_count;
+    } else {
+        int stack[16];
+        const int params[] = { 10 };
+        if (bytecode.stack_size > 16 || bytecode_execute(&bytecode, params, stack) != 14) {
+            fprintf(stderr, "*** Wrong result of specialized bytecode\n");
+            ++ error_count;
+        }
+    }
+
+    bytecode_free(&bytecode);
+    bytecode_free(&full);
+    ast_free(expr);
+
+    return error_count;
+}
+
+// The ranges contain the parameter values of the test, so the result has to
+// stay the same. Some ranges are single values, some are small and some are
+// only bounded on one side.
+size_t test_optimize_ranges(const char *parser_name, const struct TestCase *test, const struct AstNode *expr, const struct Param *ast_params, size_t ast_params_size) {
+    struct ParamRange *ranges = calloc(ast_params_size + 1, sizeof(struct ParamRange));
+    if (ranges == NULL) {
+        fprintf(stderr, "*** [%s] Error allocating ranges: %s\n", parser_name, strerror(errno));
+        return 1;
+    }
+
+    for (size_t index = 0; index < ast_params_size; ++ index) {
+        const int64_t value = ast_params[index].value;
+        int64_t min = value;
+        int64_t max = value;
+        switch (index % 4) {
+            case 1: min -= 3; max += 3; break;
+            case 2: min = INT32_MIN; break;
+            case 3: max = INT32_MAX; break;
+        }
+        ranges[index] = (struct ParamRange){
+            .name = ast_params[index].name,
+            .min  = (int)MAX(min, INT32_MIN),
+            .max  = (int)(max > INT32_MAX ? INT32_MAX : max),
+        };
+    }
+
+    size_t error_count = 0;
+    struct AstNode *opt_expr = ast_optimize_ranges(expr, ranges, ast_params_size);
+    if (opt_expr == NULL) {
+        fprintf(stderr, "*** [%s] Error in ast_optimize_ranges(): %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else {
+        const int result = ast_execute_with_params(opt_expr, ast_params, ast_params_size);
+        if (result != test->result) {
+            fprintf(stderr, "*** [%s] Result missmatch of ast_optimize_ranges(): %d != %d\n", parser_name, result, test->result);
+            fprintf(stderr, "Expression: %s\nOptimized Expression: ", test->expr);
+            ast_print(stderr, opt_expr);
+            fprintf(stderr, "\n");
+            ++ error_count;
+        }
+    }
+
+    ast_free(opt_expr);
+    free(ranges);
+
+    return error_count;
+}
+
+struct RangeTest {
+    const char *expr;
+    const char *expected;
+    struct ParamRange ranges[2]; // sorted
+    size_t range_count;
+};
+
+#define RANGE(NAME, MIN, MAX) { .name = (NAME), .min = (MIN), .max = (MAX) }
+
+static const struct RangeTest RANGE_TESTS[] = {
+    { "x < 10 ? a : b",         "a",          { RANGE("x", 0, 5) }, 1 },
+    { "x > 0 ? x : -x",         "-x",         { RANGE("x", -10, -1) }, 1 },
+    { "x % 16",                 "x",          { RANGE("x", 0, 9) }, 1 },
+    { "x % d",                  "x",          { RANGE("d", -20, -10), RANGE("x", -9, 9) }, 2 },
+    { "x & 255",                "x",          { RANGE("x", 0, 100) }, 1 },
+    { "(x & 7) == 8",           "0",          { RANGE("y", 0, 1) }, 1 },
+    { "!!flag",                 "flag",       { RANGE("flag", 0, 1) }, 1 },
+    { "x > 100 || y == 2",      "y == 2",     { RANGE("x", 0, 50) }, 1 },
+    { "x && y < 3",             "y < 3",      { RANGE("x", 1, 9) }, 1 },
+    { "x / d <= 50",            "1",          { RANGE("d", 2, 4), RANGE("x", 0, 100) }, 2 },
+    { "(x << s) < 0",           "0",          { RANGE("s", 0, 8), RANGE("x", 0, 255) }, 2 },
+    { "x == 3 ? y : z",         "y",          { RANGE("x", 3, 3) }, 1 },
+    // unproven divisors and shift counts aren't analyzed
+    { "x / d >= 0",             "x / d >= 0", { RANGE("d", -1, 1), RANGE("x", 0, 10) }, 2 },
+    { "(x << s) >= 0",          "(x << s) >= 0", { RANGE("s", 0, 32), RANGE("x", 0, 1) }, 2 },
+    // wraps around
+    { "x + 1 > 0",              "x + 1 > 0",  { RANGE("x", 0, INT32_MAX) }, 1 },
+};
+
+// Trees are compared by hash-consing both, identical trees are in the same class.
+size_t test_range_folding(void) {
+    size_t error_count = 0;
+
+    for (size_t index = 0; index < sizeof(RANGE_TESTS) / sizeof(RANGE_TESTS[0]); ++ index) {
+        const struct RangeTest *test = &RANGE_TESTS[index];
+        struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+        struct AstNode *expected_expr = fast_parse(&symbol_table, test->expected, NULL);
+        struct AstNode *expected = expected_expr == NULL ? NULL : ast_optimize(expected_expr);
+        struct AstNode *opt_expr = expr == NULL ? NULL : ast_optimize_ranges(expr, test->ranges, test->range_count);
+        struct AstCse cse = AST_CSE_INIT();
+
+        if (expr == NULL || expected == NULL || opt_expr == NULL) {
+            fprintf(stderr, "*** Error optimizing with ranges: %s: %s\n", test->expr, strerror(errno));
+            ++ error_count;
+        } else {
+            const struct AstNode *const exprs[] = { opt_expr, expected };
+            if (!ast_cse_build(&cse, exprs, 2)) {
+                fprintf(stderr, "*** Error in ast_cse_build(): %s\n", strerror(errno));
+                ++ error_count;
+            } else if (ast_cse_class(&cse, opt_expr) != ast_cse_class(&cse, expected)) {
+                fprintf(stderr, "*** Wrong range optimization of: %s\nExpected: %s\nGot: ", test->expr, test->expected);
+                ast_print(stderr, opt_expr);
+                fprintf(stderr, "\n");
+                ++ error_count;
+            }
+        }
+
+        ast_cse_free(&cse);
+        ast_free(opt_expr);
+        ast_free(expected);
+        ast_free(expected_expr);
+        ast_free(expr);
+    }
+
+    // && and || don't normalize operands that already are 0 or 1
+    struct AstNode *expr = fast_parse(&symbol_table, "a < 1 && (b > 2 || !c)", NULL);
+    struct Bytecode bytecode = BYTECODE_INIT();
+    if (expr == NULL || !bytecode_compile(&bytecode, expr)) {
+        fprintf(stderr, "*** Error compiling boolean test expression: %s\n", strerror(errno));
+        ++ error_count;
+    } else {
+        for (size_t index = 0; index < bytecode.instrs_size; index += bytecode_instr_size(BYTECODE_INSTR(bytecode.instrs[index]))) {
+            if (BYTECODE_INSTR(bytecode.instrs[index]) == INSTR_BOOL) {
+                fprintf(stderr, "*** Boolean value was normalized again:\n");
+                bytecode_print(&bytecode, stderr);
+                ++ error_count;
+                break;
+            }
+        }
+    }
+    bytecode_free(&bytecode);
+    ast_free(expr);
+
+    return error_count;
+}
+
+// Variables without a name are reported when binding, bindings can be reused
+// for other trees and the slots stay in the bound tree and its optimized copies.
+size_t test_ast_binding(void) {
+    struct AstBinding binding = AST_BINDING_INIT();
+    const struct Symbol *missing = NULL;
+    size_t error_count = 0;
+
+    struct AstNode *expr = fast_parse(&symbol_table, "a + b * c", NULL);
+    struct AstNode *other = fast_parse(&symbol_table, "(c ? 5 : a) - 2", NULL);
+    if (expr == NULL || other == NULL) {
+        fprintf(stderr, "*** Error parsing binding test expressions: %s\n", strerror(errno));
+        ast_free(expr);
+        ast_free(other);
+        return 1;
+    }
+
+    static const char *const PARTIAL_NAMES[] = { "c", "a" };
+    errno = 0;
+    if (ast_bind(&binding, expr, PARTIAL_NAMES, 2, &missing) || errno != ENOENT ||
+        missing == NULL || strcmp(missing->name, "b") != 0) {
+        fprintf(stderr, "*** Binding didn't report the missing parameter b\n");
+        ++ error_count;
+    }
+
+    // the first of duplicate names is used
+    static const char *const NAMES[] = { "c", "a", "b", "a", "never_bound_name" };
+    const int values[] = { 3, 1, 2, 99, 1000 };
+    if (!ast_bind(&binding, expr, NAMES, 5, &missing) || missing != NULL ||
+        ast_execute_with_slots(expr, values) != 7) {
+        fprintf(stderr, "*** Error binding and executing: a + b * c\n");
+        ++ error_count;
+    }
+
+    // sized by the variables of the tree, not by the number of symbols
+    if (binding.entries_size != 3 || binding.entries_capacity > 8) {
+        fprintf(stderr, "*** Binding of 3 variables has %zu entries with a capacity of %zu\n",
+            binding.entries_size, binding.entries_capacity);
+        ++ error_count;
+    }
+
+    if (!ast_bind(&binding, other, NAMES, 5, NULL) ||
+        ast_execute_with_slots(other, values) != 3 ||
+        ast_execute_with_slots(other, (const int[]){ 0, 7, 0 }) != 5) {
+        fprintf(stderr, "*** Error rebinding to: (c ? 5 : a) - 2\n");
+        ++ error_count;
+    }
+
+    if (ast_execute_with_slots(expr, values) != 7) {
+        fprintf(stderr, "*** Binding another tree changed the slots of: a + b * c\n");
+        ++ error_count;
+    }
+
+    struct AstNode *opt_expr = ast_optimize(expr);
+    if (opt_expr == NULL || ast_execute_with_slots(opt_expr, values) != 7) {
+        fprintf(stderr, "*** Optimized copy lost the slots of: a + b * c\n");
+        ++ error_count;
+    }
+    ast_free(opt_expr);
+
+    ast_binding_free(&binding);
+    ast_free(expr);
+    ast_free(other);
+
+    return error_count;
+}
+
+// A snapshot has to give the results of ast_execute_with_environ() and keep
+// the values of all variables until it is taken again.
+size_t test_ast_environ(void) {
+    struct AstEnviron env = AST_ENVIRON_INIT();
+    char **environ_bakup = environ;
+    size_t error_count = 0;
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+        struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+        if (expr == NULL) {
+            fprintf(stderr, "*** Error parsing expression: %s\n", test->expr);
+            ++ error_count;
+            continue;
+        }
+
+        environ = test->environ;
+        const bool ok = ast_environ_snapshot(&env, expr);
+        environ = environ_bakup;
+
+        if (!ok) {
+            fprintf(stderr, "*** Error taking environment snapshot: %s\n", strerror(errno));
+            ++ error_count;
+        } else {
+            const int result = ast_execute_with_snapshot(expr, &env);
+            if (result != test->result) {
+                fprintf(stderr, "*** Result missmatch with environment snapshot: %s\n", test->expr);
+                ++ error_count;
+            }
+        }
+        ast_free(expr);
+    }
+
+    struct AstNode *expr = fast_parse(&symbol_table, "x * 2 + y - x", NULL);
+    struct AstNode *cond_expr = fast_parse(&symbol_table, "x ? y : z", NULL);
+    if (expr == NULL || cond_expr == NULL) {
+        fprintf(stderr, "*** Error parsing snapshot test expression\n");
+        ast_free(expr);
+        ast_free(cond_expr);
+        ast_environ_free(&env);
+        return error_count + 1;
+    }
+
+    // unset variables are 0, each variable has one slot
+    environ = (char*[]){ "x=5", "z=1", NULL };
+    if (!ast_environ_snapshot(&env, expr) || env.values_size != 2 ||
+        ast_execute_with_snapshot(expr, &env) != 5) {
+        fprintf(stderr, "*** Wrong environment snapshot of: x * 2 + y - x\n");
+        ++ error_count;
+    }
+
+    environ = (char*[]){ "x=7", "y=1", NULL };
+    if (ast_execute_with_snapshot(expr, &env) != 5) {
+        fprintf(stderr, "*** Environment snapshot changed with the environment\n");
+        ++ error_count;
+    }
+
+    if (!ast_environ_snapshot(&env, expr) || ast_execute_with_snapshot(expr, &env) != 8) {
+        fprintf(stderr, "*** Environment snapshot wasn't updated\n");
+        ++ error_count;
+    }
+
+    // variables of both branches are read when the snapshot is taken
+    environ = (char*[]){ "x=1", "y=2", "z=3", NULL };
+    if (!ast_environ_snapshot(&env, cond_expr) || env.values_size != 3 ||
+        ast_execute_with_snapshot(cond_expr, &env) != 2) {
+        fprintf(stderr, "*** Wrong environment snapshot of: x ? y : z\n");
+        ++ error_count;
+    }
+
+    environ = (char*[]){ "x=0", "y=5", "z=4", NULL };
+    if (ast_execute_with_snapshot(cond_expr, &env) != 2) {
+        fprintf(stderr, "*** Environment snapshot of x ? y : z changed with the environment\n");
+        ++ error_count;
+    }
+
+    if (!ast_environ_snapshot(&env, cond_expr) || ast_execute_with_snapshot(cond_expr, &env) != 4) {
+        fprintf(stderr, "*** Environment snapshot of x ? y : z wasn't updated\n");
+        ++ error_count;
+    }
+    environ = environ_bakup;
+
+    ast_free(expr);
+    ast_free(cond_expr);
+    ast_environ_free(&env);
+
+    return error_count;
+}
+
+size_t test_regcode(const char *parser_name, const struct TestCase *test, const struct AstNode *expr) {
+    struct Regcode regcode = REGCODE_INIT();
+    size_t error_count = 0;
+
+    if (!regcode_compile(&regcode, expr)) {
+        fprintf(stderr, "*** [%s] Error compiling to register code: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        return 1;
+    }
+
+    int *params = regcode_alloc_params(&regcode);
+    int *regs   = regcode_alloc_registers(&regcode);
+    if ((params == NULL && regcode.params_size > 0) || regs == NULL) {
+        fprintf(stderr, "*** [%s] Error allocating registers: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else if (!regcode_params_from_environ(&regcode, params, test->environ)) {
+        fprintf(stderr, "*** [%s] Error initializing params: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else {
+        int result = regcode_execute(&regcode, params, regs);
+
+        if (result != test->result) {
+            fprintf(stderr, "*** [%s] Register code execution result missmatch:\nEnvironment:\n", parser_name);
+            for (char **ptr = test->environ; *ptr; ++ ptr) {
+                fprintf(stderr, "    %s\n", *ptr);
+            }
+            fprintf(stderr, "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
+            ast_print(stderr, expr);
+            fprintf(stderr, "\nRegister Code:\n");
+            regcode_print(&regcode, stderr);
+            fprintf(stderr,
+                "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                result, test->result);
+
+            ++ error_count;
+        }
+    }
+
+    free(params);
+    free(regs);
+    regcode_free(&regcode);
+
+    return error_count;
+}
+
+size_t test_closure(const char *parser_name, const struct TestCase *test, const struct AstNode *expr) {
+    struct Closure closure = CLOSURE_INIT();
+    size_t error_count = 0;
+
+    if (!closure_compile(&closure, expr)) {
+        fprintf(stderr, "*** [%s] Error compiling to closures: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        return 1;
+    }
+
+    int *params = closure_alloc_params(&closure);
+    if (params == NULL && closure.params_size > 0) {
+        fprintf(stderr, "*** [%s] Error allocating params: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else if (!closure_params_from_environ(&closure, params, test->environ)) {
+        fprintf(stderr, "*** [%s] Error initializing params: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    } else {
+        int result = closure_execute(&closure, params);
+
+        if (result != test->result) {
+            fprintf(stderr, "*** [%s] Closure execution result missmatch:\nEnvironment:\n", parser_name);
+            for (char **ptr = test->environ; *ptr; ++ ptr) {
+                fprintf(stderr, "    %s\n", *ptr);
+            }
+            fprintf(stderr, "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
+            ast_print(stderr, expr);
+            fprintf(stderr,
+                "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                result, test->result);
+
+            ++ error_count;
+        }
+    }
+
+    free(params);
+    closure_free(&closure);
+
+    return error_count;
+}
+
+// Missing platform support or executable memory is not an error, JIT tests
+// are just skipped then.
+bool jit_is_unavailable(int errnum) {
+    return errnum == ENOSYS || errnum == EPERM || errnum == EACCES;
+}
+
+size_t test_jit(const char *parser_name, const struct TestCase *test, const struct Bytecode *bytecode, const int *params) {
+    struct JitCode jit = JIT_CODE_INIT();
+
+    if (!jit_compile(&jit, bytecode)) {
+        if (jit_is_unavailable(errno)) {
+            return 0;
+        }
+        fprintf(stderr, "*** [%s] Error compiling bytecode to machine code: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        return 1;
+    }
+
+    size_t error_count = 0;
+    int result = jit_execute(&jit, params);
+
+    if (result != test->result) {
+        fprintf(stderr, "*** [%s] JIT execution result missmatch:\nEnvironment:\n", parser_name);
+        for (char **ptr = test->environ; *ptr; ++ ptr) {
+            fprintf(stderr, "    %s\n", *ptr);
+        }
+        fprintf(stderr, "Expression:\n    %s\nBytecode:\n", test->expr);
+        bytecode_print(bytecode, stderr);
+        fprintf(stderr,
+            "\nResult:\n    %d\nExpected:\n    %d\n\n",
+            result, test->result);
+
+        ++ error_count;
+    }
+
+    jit_free(&jit);
+
+    return error_count;
+}
+
+size_t test_threaded(const char *parser_name, const struct TestCase *test, const struct Bytecode *bytecode, const int *params) {
+    struct ThreadedCode threaded = THREADED_CODE_INIT();
+
+    if (!threaded_compile(&threaded, bytecode)) {
+        if (errno == ENOSYS) {
+            return 0;
+        }
+        fprintf(stderr, "*** [%s] Error compiling bytecode to threaded code: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        return 1;
+    }
+
+    int *stack = bytecode_alloc_stack(bytecode);
+    if (stack == NULL) {
+        perror("bytecode_alloc_stack(bytecode)");
+        threaded_free(&threaded);
+        return 1;
+    }
+
+    size_t error_count = 0;
+    int result = threaded_execute(&threaded, params, stack);
+
+    if (result != test->result) {
+        fprintf(stderr, "*** [%s] threaded code execution result missmatch:\nEnvironment:\n", parser_name);
+        for (char **ptr = test->environ; *ptr; ++ ptr) {
+            fprintf(stderr, "    %s\n", *ptr);
+        }
+        fprintf(stderr, "Expression:\n    %s\nBytecode:\n", test->expr);
+        bytecode_print(bytecode, stderr);
+        fprintf(stderr,
+            "\nResult:\n    %d\nExpected:\n    %d\n\n",
+            result, test->result);
+
+        ++ error_count;
+    }
+
+    free(stack);
+    threaded_free(&threaded);
+
+    return error_count;
+}
+
+size_t test_tailcall(const char *parser_name, const struct TestCase *test, const struct Bytecode *bytecode, const int *params) {
+    int *stack = bytecode_alloc_stack(bytecode);
+    if (stack == NULL) {
+        perror("bytecode_alloc_stack(bytecode)");
+        return 1;
+    }
+
+    size_t error_count = 0;
+    int result = bytecode_execute_tailcall(bytecode, params, stack);
+
+    if (result != test->result) {
+        fprintf(stderr, "*** [%s] tail call bytecode execution result missmatch:\nEnvironment:\n", parser_name);
+        for (char **ptr = test->environ; *ptr; ++ ptr) {
+            fprintf(stderr, "    %s\n", *ptr);
+        }
+        fprintf(stderr, "Expression:\n    %s\nBytecode:\n", test->expr);
+        bytecode_print(bytecode, stderr);
+        fprintf(stderr,
+            "\nResult:\n    %d\nExpected:\n    %d\n\n",
+            result, test->result);
+
+        ++ error_count;
+    }
+
+    free(stack);
+
+    return error_count;
+}
+
+size_t test_verify(const char *parser_name, const struct TestCase *test, struct Bytecode *bytecode, const int *params) {
+    int *stack = bytecode_alloc_stack(bytecode);
+    if (stack == NULL && bytecode->stack_size > 0) {
+        perror("bytecode_alloc_stack(bytecode)");
+        return 1;
+    }
+
+    size_t error_count = 0;
+    int result = 0;
+
+    // checked execution of unverified bytecode
+    if (!bytecode_execute_checked(bytecode, params, stack, &result)) {
+        fprintf(stderr, "*** [%s] Checked bytecode execution failed: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        bytecode_print(bytecode, stderr);
+        ++ error_count;
+    } else if (result != test->result) {
+        fprintf(stderr, "*** [%s] Checked bytecode execution result missmatch: %d != %d\n", parser_name, result, test->result);
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        bytecode_print(bytecode, stderr);
+        ++ error_count;
+    }
+
+    if (!bytecode_verify(bytecode)) {
+        fprintf(stderr, "*** [%s] Bytecode verification failed: %s\n", parser_name, strerror(errno));
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        bytecode_print(bytecode, stderr);
+        ++ error_count;
+    } else if (!bytecode_execute_checked(bytecode, params, stack, &result) || result != test->result) {
+        fprintf(stderr, "*** [%s] Verified bytecode execution result missmatch: %d != %d\n", parser_name, result, test->result);
+        fprintf(stderr, "Expression: %s\n", test->expr);
+        ++ error_count;
+    }
+
+    free(stack);
+
+    return error_count;
+}
+
+struct MalformedBytecode {
+    const char *name;
+    uint32_t instrs[4];
+    size_t instrs_size;
+    size_t params_size;
+    size_t stack_size;
+};
+
+#define W(INSTR, ARG) BYTECODE_WORD(INSTR_ ## INSTR, ARG)
+
+// Executed with all parameters set to 0, every one of these has to be
+// rejected by the verifier and by the checked execution.
+static const struct MalformedBytecode MALFORMED_BYTECODES[] = {
+    { "empty",                 { 0 }, 0, 0, 0 },
+    { "illegal instruction",   { 0xFF }, 1, 0, 1 },
+    { "truncated instruction", { W(INT_WIDE, 0) }, 1, 0, 1 },
+    { "missing return",        { W(INT, 1) }, 1, 0, 1 },
+    { "stack underflow",       { W(INT, 1), W(ADD, 0), W(RET, 0) }, 3, 0, 1 },
+    { "stack overflow",        { W(INT, 1), W(INT, 2), W(ADD, 0), W(RET, 0) }, 4, 0, 1 },
+    { "parameter index",       { W(VAR, 1), W(RET, 0) }, 2, 1, 1 },
+    { "backward jump",         { W(JMP, 0), W(RET_INT, 0) }, 2, 0, 0 },
+    { "jump out of range",     { W(JMP, 5), W(RET_INT, 0) }, 2, 0, 0 },
+    { "jump into argument",    { W(JZP_VAR, 0), 1, W(RET_INT, 0) }, 3, 1, 1 },
+    { "stack depth mismatch",  { W(JZP_VAR, 0), 3, W(INT, 1), W(RET, 0) }, 4, 1, 1 },
+    { "return depth",          { W(INT, 1), W(RET_INT, 2) }, 2, 0, 1 },
+    { "temporary index",       { W(INT, 1), W(STORE, 0), W(RET, 0) }, 3, 0, 1 },
+    { "load temporary index",  { W(LOAD, 0), W(RET, 0) }, 2, 0, 1 },
+};
+
+// Well formed, but bytecode_execute() would trap on these. Unverified they
+// have to fail with EDOM in the checked execution.
+static const struct MalformedBytecode TRAPPING_BYTECODES[] = {
+    { "division by zero",      { W(INT, 1), W(VAR, 0), W(DIV, 0), W(RET, 0) }, 4, 1, 2 },
+    { "modulo by zero",        { W(INT, 1), W(MOD_VAR, 0), W(RET, 0) }, 3, 1, 1 },
+    { "INT_MIN / -1",          { W(INT_WIDE, 0), 0x80000000, W(DIV_INT, -1), W(RET, 0) }, 4, 0, 1 },
+    { "INT_MIN % -1",          { W(INT_WIDE, 0), 0x80000000, W(MOD_INT, -1), W(RET, 0) }, 4, 0, 1 },
+};
+
+#undef W
+
+size_t test_bytecode_verifier(void) {
+    size_t error_count = 0;
+
+    for (size_t index = 0; index < sizeof(MALFORMED_BYTECODES) / sizeof(MALFORMED_BYTECODES[0]); ++ index) {
+        const struct MalformedBytecode *malformed = &MALFORMED_BYTECODES[index];
+        uint32_t instrs[4];
+        int params[1] = { 0 };
+        int stack[4] = { 0 };
+        int result = 0;
+
+        memcpy(instrs, malformed->instrs, sizeof(instrs));
+
+        struct Bytecode bytecode = BYTECODE_INIT();
+        bytecode.instrs          = instrs;
+        bytecode.instrs_size     = malformed->instrs_size;
+        bytecode.instrs_capacity = sizeof(instrs) / sizeof(instrs[0]);
+        bytecode.params_size     = malformed->params_size;
+        bytecode.stack_size      = malformed->stack_size;
+
+        errno = 0;
+        if (bytecode_execute_checked(&bytecode, params, stack, &result) || errno != EINVAL) {
+            fprintf(stderr, "*** Checked execution accepted malformed bytecode: %s\n", malformed->name);
+            ++ error_count;
+        }
+
+        errno = 0;
+        if (bytecode_verify(&bytecode) || errno != EINVAL || bytecode.verified) {
+            fprintf(stderr, "*** Verifier accepted malformed bytecode: %s\n", malformed->name);
+            ++ error_count;
+        }
+    }
+
+    for (size_t index = 0; index < sizeof(TRAPPING_BYTECODES) / sizeof(TRAPPING_BYTECODES[0]); ++ index) {
+        const struct MalformedBytecode *trapping = &TRAPPING_BYTECODES[index];
+        uint32_t instrs[4];
+        int params[1] = { 0 };
+        int stack[4] = { 0 };
+        int result = 0;
+
+        memcpy(instrs, trapping->instrs, sizeof(instrs));
+
+        struct Bytecode bytecode = BYTECODE_INIT();
+        bytecode.instrs          = instrs;
+        bytecode.instrs_size     = trapping->instrs_size;
+        bytecode.instrs_capacity = sizeof(instrs) / sizeof(instrs[0]);
+        bytecode.params_size     = trapping->params_size;
+        bytecode.stack_size      = trapping->stack_size;
+
+        errno = 0;
+        if (bytecode_execute_checked(&bytecode, params, stack, &result) || errno != EDOM) {
+            fprintf(stderr, "*** Checked execution didn't fail with EDOM: %s: %s\n", trapping->name, strerror(errno));
+            ++ error_count;
+        }
+
+        // verifying has to leave the arithmetic to the runtime
+        if (!bytecode_verify(&bytecode)) {
+            fprintf(stderr, "*** Verifier rejected bytecode: %s: %s\n", trapping->name, strerror(errno));
+            ++ error_count;
+        }
+    }
+
+    return error_count;
+}
+
+static const char *MULTI_PARAM_NAMES[BATCH_VAR_COUNT] = { "a", "b", "c" };
+
+// Parses and optimizes count rules, cycling through BATCH_EXPRS.
+bool multi_parse_rules(struct AstNode **rules, size_t count) {
+    const size_t batch_expr_count = sizeof(BATCH_EXPRS) / sizeof(BATCH_EXPRS[0]) - 1;
+
+    for (size_t index = 0; index < count; ++ index) {
+        struct AstNode *expr = fast_parse(&symbol_table, BATCH_EXPRS[index % batch_expr_count], NULL);
+        struct AstNode *opt_expr = expr == NULL ? NULL : ast_optimize(expr);
+        ast_free(expr);
+
+        if (opt_expr == NULL) {
+            multi_free_rules(rules, index);
+            return false;
+        }
+        rules[index] = opt_expr;
+    }
+
+    return true;
+}
+
+void multi_free_rules(struct AstNode **rules, size_t count) {
+    for (size_t index = 0; index < count; ++ index) {
+        ast_free(rules[index]);
+        rules[index] = NULL;
+    }
+}
+
+// Compiles all BATCH_EXPRS into one program and compares every result with
+// the AST interpreter.
+size_t test_bytecode_multi(void) {
+    struct AstNode *rules[sizeof(BATCH_EXPRS) / sizeof(BATCH_EXPRS[0]) - 1];
+    const size_t count = sizeof(rules) / sizeof(rules[0]);
+    struct Bytecode bytecode = BYTECODE_INIT();
+    int *values  = NULL;
+    int *params  = NULL;
+    int *stack   = NULL;
+    int *results = NULL;
+    size_t error_count = 0;
+
+    if (!multi_parse_rules(rules, count)) {
+        fprintf(stderr, "*** Error parsing rules: %s\n", strerror(errno));
+        return 1;
+    }
+
+    if (!bytecode_compile_multi(&bytecode, (const struct AstNode *const *)rules, count) ||
+        !bytecode_optimize(&bytecode) ||
+        !bytecode_verify(&bytecode) ||
+        (values  = batch_random_columns(BATCH_TEST_ROWS)) == NULL ||
+        (params  = bytecode_alloc_params(&bytecode)) == NULL ||
+        (stack   = bytecode_alloc_stack(&bytecode)) == NULL ||
+        (results = calloc(count, sizeof(int))) == NULL) {
+        fprintf(stderr, "*** Error compiling multi-expression program: %s\n", strerror(errno));
+        bytecode_print(&bytecode, stderr);
+        ++ error_count;
+        goto cleanup;
+    }
+
+    for (size_t row_index = 0; row_index < BATCH_TEST_ROWS && error_count == 0; ++ row_index) {
+        struct Param row_params[BATCH_VAR_COUNT];
+
+        for (size_t var_index = 0; var_index < BATCH_VAR_COUNT; ++ var_index) {
+            const int value = values[var_index * BATCH_TEST_ROWS + row_index];
+            row_params[var_index] = (struct Param){ .name = MULTI_PARAM_NAMES[var_index], .value = value };
+            bytecode_set_param(&bytecode, params, MULTI_PARAM_NAMES[var_index], value);
+        }
+
+        if (!bytecode_execute_multi(&bytecode, params, stack, results)) {
+            fprintf(stderr, "*** Error executing multi-expression program: %s\n", strerror(errno));
+            ++ error_count;
+            break;
+        }
+
+        for (size_t rule_index = 0; rule_index < count; ++ rule_index) {
+            const int expected = ast_execute_with_params(rules[rule_index], row_params, BATCH_VAR_COUNT);
+
+            if (results[rule_index] != expected) {
+                fprintf(stderr,
+                    "*** Multi-expression result missmatch for \"%s\" with a = %d, b = %d, c = %d: %d != %d\n",
+                    BATCH_EXPRS[rule_index], row_params[0].value, row_params[1].value, row_params[2].value,
+                    results[rule_index], expected);
+                bytecode_print(&bytecode, stderr);
+                ++ error_count;
+            }
+        }
+    }
+
+cleanup:
+    multi_free_rules(rules, count);
+    bytecode_free(&bytecode);
+    free(values);
+    free(params);
+    free(stack);
+    free(results);
+
+    return error_count;
+}
+
+// MULTI_RULE_COUNT rules evaluated against the same parameter record, once as
+// separate bytecode per rule and once as one multi-expression program.
+int bench_multi(void) {
+    struct AstNode *rules[MULTI_RULE_COUNT] = { NULL };
+    struct Bytecode rule_bytecodes[MULTI_RULE_COUNT];
+    int *rule_params[MULTI_RULE_COUNT] = { NULL };
+    ptrdiff_t rule_param_indices[MULTI_RULE_COUNT][BATCH_VAR_COUNT];
+    struct Bytecode bytecode = BYTECODE_INIT();
+    ptrdiff_t param_indices[BATCH_VAR_COUNT];
+    struct timespec *times = calloc(MULTI_ITERS * 2, sizeof(struct timespec));
+    int *values  = batch_random_columns(BATCH_ROWS);
+    int *params  = NULL;
+    int *stack   = NULL;
+    int *results = calloc(MULTI_RULE_COUNT, sizeof(int));
+    size_t max_stack_size = 0;
+    int status = 1;
+
+    for (size_t index = 0; index < MULTI_RULE_COUNT; ++ index) {
+        rule_bytecodes[index] = (struct Bytecode)BYTECODE_INIT();
+    }
+
+    printf("\nBenchmarking %d rules against the same parameters for %d rows with %d iterations:\n\n",
+        MULTI_RULE_COUNT, BATCH_ROWS, MULTI_ITERS);
+
+    if (times == NULL || values == NULL || results == NULL || !multi_parse_rules(rules, MULTI_RULE_COUNT)) {
+        perror("allocating multi-expression benchmark");
+        goto cleanup;
+    }
+
+    for (size_t rule_index = 0; rule_index < MULTI_RULE_COUNT; ++ rule_index) {
+        struct Bytecode *rule_bytecode = &rule_bytecodes[rule_index];
+        if (!bytecode_compile(rule_bytecode, rules[rule_index]) ||
+            !bytecode_optimize(rule_bytecode) ||
+            (rule_params[rule_index] = bytecode_alloc_params(rule_bytecode)) == NULL) {
+            perror("compiling rule");
+            goto cleanup;
+        }
+        for (size_t var_index = 0; var_index < BATCH_VAR_COUNT; ++ var_index) {
+            rule_param_indices[rule_index][var_index] = bytecode_get_param_index(rule_bytecode, MULTI_PARAM_NAMES[var_index]);
+        }
+        max_stack_size = MAX(max_stack_size, rule_bytecode->stack_size);
+    }
+
+    if (!bytecode_compile_multi(&bytecode, (const struct AstNode *const *)rules, MULTI_RULE_COUNT) ||
+        !bytecode_optimize(&bytecode) ||
+        (params = bytecode_alloc_params(&bytecode)) == NULL) {
+        perror("compiling multi-expression program");
+        goto cleanup;
+    }
+
+    for (size_t var_index = 0; var_index < BATCH_VAR_COUNT; ++ var_index) {
+        param_indices[var_index] = bytecode_get_param_index(&bytecode, MULTI_PARAM_NAMES[var_index]);
+    }
+    max_stack_size = MAX(max_stack_size, bytecode.stack_size);
+
+    stack = calloc(max_stack_size, sizeof(int));
+    if (stack == NULL) {
+        perror("allocating stack");
+        goto cleanup;
+    }
+
+    int checksum_rules = 0;
+    int checksum_multi = 0;
+
+    // one bytecode_execute() per rule, every rule has its own parameters
+    for (size_t iter = 0; iter < MULTI_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t row_index = 0; row_index < BATCH_ROWS; ++ row_index) {
+            for (size_t rule_index = 0; rule_index < MULTI_RULE_COUNT; ++ rule_index) {
+                for (size_t var_index = 0; var_index < BATCH_VAR_COUNT; ++ var_index) {
+                    const ptrdiff_t param_index = rule_param_indices[rule_index][var_index];
+                    if (param_index >= 0) {
+                        rule_params[rule_index][param_index] = values[var_index * BATCH_ROWS + row_index];
+                    }
+                }
+                results[rule_index] = bytecode_execute(&rule_bytecodes[rule_index], rule_params[rule_index], stack);
+            }
+            checksum_rules += results[MULTI_RULE_COUNT - 1];
+        }
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        times[iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // one bytecode_execute_multi() for all rules
+    for (size_t iter = 0; iter < MULTI_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t row_index = 0; row_index < BATCH_ROWS; ++ row_index) {
+            for (size_t var_index = 0; var_index < BATCH_VAR_COUNT; ++ var_index) {
+                if (param_indices[var_index] >= 0) {
+                    params[param_indices[var_index]] = values[var_index * BATCH_ROWS + row_index];
+                }
+            }
+            bytecode_execute_multi(&bytecode, params, stack, results);
+            checksum_multi += results[MULTI_RULE_COUNT - 1];
+        }
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        times[MULTI_ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    if (checksum_rules != checksum_multi) {
+        fprintf(stderr, "*** Multi-expression benchmark checksum missmatch: %d != %d\n", checksum_multi, checksum_rules);
+        goto cleanup;
+    }
+
+    struct Stats stats_rules = make_stats(times, MULTI_ITERS);
+    struct Stats stats_multi = make_stats(times + MULTI_ITERS, MULTI_ITERS);
+    struct Stats stats_max = max_stats((struct Stats[]){ stats_rules, stats_multi }, 2);
+
+    printf("Multi-expression benchmark result:\n");
+    print_bench_header(32);
+    print_bench("bytecode per rule",                32, &stats_rules, &stats_max);
+    print_bench("multi-expression bytecode",        32, &stats_multi, &stats_max);
+
+    status = 0;
+
+cleanup:
+    multi_free_rules(rules, MULTI_RULE_COUNT);
+    for (size_t index = 0; index < MULTI_RULE_COUNT; ++ index) {
+        bytecode_free(&rule_bytecodes[index]);
+        free(rule_params[index]);
+    }
+    bytecode_free(&bytecode);
+    free(times);
+    free(values);
+    free(params);
+    free(stack);
+    free(results);
+
+    return status;
+}
+
+// Constants around the limits of the 24-bit instruction argument.
+static const char *ENCODING_EXPRS[] = {
+    "x + 8388607",
+    "x + 8388608",
+    "x - -8388608",
+    "x - -8388609",
+    "8388607",
+    "8388608",
+    "-8388608",
+    "-8388609",
+    "2147483647",
+    "x ? 8388608 : -8388609",
+    "x < 8388608 ? x - -8388609 : x % 8388607",
+    "x != -8388609 && 8388608",
+    NULL,
+};
+
+size_t test_bytecode_encoding(void) {
+    static const int values[] = { 0, 1, -1, 8388607, 8388608, -8388608, -8388609 };
+    size_t error_count = 0;
+
+    for (const char **source = ENCODING_EXPRS; *source; ++ source) {
+        struct Bytecode bytecode = BYTECODE_INIT();
+        struct JitCode jit = JIT_CODE_INIT();
+        int *stack = NULL;
+        int *params = NULL;
+
+        struct AstNode *expr = fast_parse(&symbol_table, *source, NULL);
+        if (expr == NULL ||
+            !bytecode_compile(&bytecode, expr) ||
+            !bytecode_optimize(&bytecode) ||
+            !bytecode_shrink_to_fit(&bytecode) ||
+            (stack = bytecode_alloc_stack(&bytecode)) == NULL ||
+            (params = bytecode_alloc_params(&bytecode)) == NULL) {
+            fprintf(stderr, "*** Error compiling expression \"%s\": %s\n", *source, strerror(errno));
+            ++ error_count;
+            goto next;
+        }
+
+        const bool has_jit = jit_compile(&jit, &bytecode);
+        if (!has_jit && !jit_is_unavailable(errno)) {
+            fprintf(stderr, "*** Error JIT compiling expression \"%s\": %s\n", *source, strerror(errno));
+            ++ error_count;
+        }
+
+        for (size_t index = 0; index < sizeof(values) / sizeof(values[0]); ++ index) {
+            struct Param param = { .name = "x", .value = values[index] };
+            const int expected = ast_execute_with_params(expr, &param, 1);
+
+            bytecode_set_param(&bytecode, params, "x", values[index]);
+            const int result = bytecode_execute(&bytecode, params, stack);
+            const int jit_result = has_jit ? jit_execute(&jit, params) : expected;
+
+            if (result != expected || jit_result != expected) {
+                fprintf(stderr,
+                    "*** Encoding result missmatch for \"%s\" with x = %d: bytecode %d, jit %d, expected %d\n",
+                    *source, values[index], result, jit_result, expected);
+                bytecode_print(&bytecode, stderr);
+                ++ error_count;
+            }
+        }
+
+    next:
+        jit_free(&jit);
+        bytecode_free(&bytecode);
+        ast_free(expr);
+        free(stack);
+        free(params);
+    }
+
+    return error_count;
+}
+
+// x and y of the rows run by test_wide_bytecode()
+#define WIDE_ROWS 4
+static const int WIDE_X[WIDE_ROWS] = { 0, 0, 1, 1 };
+static const int WIDE_Y[WIDE_ROWS] = { 0, 1, 0, 1 };
+
+// terms of a sum of y that is too long for a jump over it with a 24-bit offset
+#define WIDE_SUM_TERMS (BYTECODE_ARG_MAX + 1)
+
+struct WideCase {
+    const char *format; // %s is replaced by the sum
+    int results[WIDE_ROWS];
+};
+
+static const struct WideCase WIDE_CASES[] = {
+    { "x || %s",          { 0, 1, 1, 1 } },
+    { "x && %s",          { 0, 0, 0, 1 } },
+    { "x < 1 ? %s : 2",   { 0, WIDE_SUM_TERMS, 2, 2 } },
+    { "(x ? 2 : %s) - 1", { -1, WIDE_SUM_TERMS - 1, 1, 1 } },
+    { NULL,               { 0 } },
+};
+
+#define W(INSTR, ARG) BYTECODE_WORD(INSTR_ ## INSTR, ARG)
+
+// x ? (y || (y && 7)) : (y && 7) with every wide instruction, x is parameter 0
+// and y is parameter 1
+static const uint32_t WIDE_INSTRS[] = {
+    /*  0 */ W(VAR_WIDE, 0), 0,
+    /*  2 */ W(JZP_WIDE, 0), 8,
+    /*  4 */ W(VAR_WIDE, 0), 1,
+    /*  6 */ W(JNZ_WIDE, 0), 11,
+    /*  8 */ W(JMP_WIDE, 0), 2,
+    /* 10 */ W(VAR_WIDE, 0), 1,
+    /* 12 */ W(JEZ_WIDE, 0), 5,
+    /* 14 */ W(INT, 7),
+    /* 15 */ W(JMP_WIDE, 0), 2,
+    /* 17 */ W(RET, 0),
+};
+
+#undef W
+
+// The hand written wide instructions and code that the compilers can only
+// encode with wide jumps, in all interpreters.
+size_t test_bytecode_wide(void) {
+    static const int wide_instrs_results[WIDE_ROWS] = { 0, 7, 0, 1 };
+    uint32_t instrs[sizeof(WIDE_INSTRS) / sizeof(WIDE_INSTRS[0])];
+    size_t error_count = 0;
+
+    memcpy(instrs, WIDE_INSTRS, sizeof(instrs));
+
+    struct Bytecode bytecode = BYTECODE_INIT();
+    bytecode.instrs          = instrs;
+    bytecode.instrs_size     = sizeof(instrs) / sizeof(instrs[0]);
+    bytecode.instrs_capacity = bytecode.instrs_size;
+    bytecode.params_size     = 2;
+    bytecode.stack_size      = 1;
+
+    error_count += test_wide_bytecode("wide instructions", &bytecode, 0, 1, wide_instrs_results);
+
+    char *sum = malloc(2 * WIDE_SUM_TERMS);
+    char *input = malloc(2 * WIDE_SUM_TERMS + 32);
+    if (sum == NULL || input == NULL) {
+        perror("malloc(2 * WIDE_SUM_TERMS)");
+        free(sum);
+        free(input);
+        return error_count + 1;
+    }
+
+    // y+y+...+y
+    for (size_t index = 0; index < WIDE_SUM_TERMS; ++ index) {
+        sum[2 * index] = 'y';
+        sum[2 * index + 1] = '+';
+    }
+    sum[2 * WIDE_SUM_TERMS - 1] = 0;
+
+    for (const struct WideCase *wide = WIDE_CASES; wide->format; ++ wide) {
+        struct Bytecode bytecode = BYTECODE_INIT();
+        snprintf(input, 2 * WIDE_SUM_TERMS + 32, wide->format, sum);
+
+        if (!bytecode_compile_source(&bytecode, &symbol_table, input, NULL) || !bytecode_optimize(&bytecode)) {
+            fprintf(stderr, "*** Error compiling \"%s\": %s\n", wide->format, strerror(errno));
+            ++ error_count;
+            bytecode_free(&bytecode);
+            continue;
+        }
+
+        bool has_wide_jump = false;
+        for (size_t index = 0; index < bytecode.instrs_size; index += bytecode_instr_size(BYTECODE_INSTR(bytecode.instrs[index]))) {
+            const enum Instr instr = BYTECODE_INSTR(bytecode.instrs[index]);
+            if (instr >= INSTR_JMP_WIDE && instr <= INSTR_JZP_WIDE) {
+                has_wide_jump = true;
+            }
+        }
+
+        if (!has_wide_jump) {
+            fprintf(stderr, "*** No wide jumps in \"%s\"\n", wide->format);
+            ++ error_count;
+        }
+
+        error_count += test_wide_bytecode(wide->format, &bytecode,
+            bytecode_get_param_index(&bytecode, "x"),
+            bytecode_get_param_index(&bytecode, "y"),
+            wide->results);
+
+        bytecode_free(&bytecode);
+    }
+
+    free(sum);
+    free(input);
+
+    return error_count;
+}
+
+size_t test_wide_bytecode(const char *name, struct Bytecode *bytecode, size_t x_index, size_t y_index, const int expected[]) {
+    struct JitCode jit = JIT_CODE_INIT();
+    struct ThreadedCode threaded = THREADED_CODE_INIT();
+    const int *batch_params[2] = { NULL, NULL };
+    int batch_results[WIDE_ROWS];
+    int params[2];
+    int *stack = bytecode_alloc_stack(bytecode);
+    int *batch_stack = bytecode_alloc_batch_stack(bytecode);
+    size_t error_count = 0;
+    int result = 0;
+
+    if (stack == NULL || batch_stack == NULL) {
+        perror("bytecode_alloc_stack(bytecode)");
+        ++ error_count;
+        goto cleanup;
+    }
+
+    if (bytecode->params_size != 2 || x_index > 1 || y_index > 1) {
+        fprintf(stderr, "*** [%s] Expected the parameters x and y\n", name);
+        ++ error_count;
+        goto cleanup;
+    }
+
+    // checked execution of unverified bytecode
+    for (size_t row = 0; row < WIDE_ROWS; ++ row) {
+        params[x_index] = WIDE_X[row];
+        params[y_index] = WIDE_Y[row];
+        if (!bytecode_execute_checked(bytecode, params, stack, &result) || result != expected[row]) {
+            fprintf(stderr, "*** [%s] Checked execution with x = %d, y = %d: %d != %d\n",
+                name, WIDE_X[row], WIDE_Y[row], result, expected[row]);
+            ++ error_count;
+        }
+    }
+
+    if (!bytecode_verify(bytecode)) {
+        fprintf(stderr, "*** [%s] Bytecode verification failed: %s\n", name, strerror(errno));
+        ++ error_count;
+        goto cleanup;
+    }
+
+    const bool has_jit = jit_compile(&jit, bytecode);
+    if (!has_jit && !jit_is_unavailable(errno)) {
+        fprintf(stderr, "*** [%s] Error JIT compiling: %s\n", name, strerror(errno));
+        ++ error_count;
+    }
+
+    const bool has_threaded = threaded_compile(&threaded, bytecode);
+    if (!has_threaded && errno != ENOSYS) {
+        fprintf(stderr, "*** [%s] Error compiling to threaded code: %s\n", name, strerror(errno));
+        ++ error_count;
+    }
+
+    for (size_t row = 0; row < WIDE_ROWS; ++ row) {
+        params[x_index] = WIDE_X[row];
+        params[y_index] = WIDE_Y[row];
+
+        const int result          = bytecode_execute(bytecode, params, stack);
+        const int tailcall_result = bytecode_execute_tailcall(bytecode, params, stack);
+        const int threaded_result = has_threaded ? threaded_execute(&threaded, params, stack) : expected[row];
+        const int jit_result      = has_jit ? jit_execute(&jit, params) : expected[row];
+
+        if (result != expected[row] || tailcall_result != expected[row] || threaded_result != expected[row] || jit_result != expected[row]) {
+            fprintf(stderr,
+                "*** [%s] Result missmatch with x = %d, y = %d: bytecode %d, tail call %d, threaded %d, jit %d, expected %d\n",
+                name, WIDE_X[row], WIDE_Y[row], result, tailcall_result, threaded_result, jit_result, expected[row]);
+            ++ error_count;
+        }
+    }
+
+    batch_params[x_index] = WIDE_X;
+    batch_params[y_index] = WIDE_Y;
+    if (!bytecode_execute_batch(bytecode, batch_params, WIDE_ROWS, batch_results, batch_stack)) {
+        fprintf(stderr, "*** [%s] Error executing in batch: %s\n", name, strerror(errno));
+        ++ error_count;
+    } else if (memcmp(batch_results, expected, sizeof(batch_results)) != 0) {
+        fprintf(stderr, "*** [%s] Batch result missmatch\n", name);
+        ++ error_count;
+    }
+
+cleanup:
+    threaded_free(&threaded);
+    jit_free(&jit);
+    free(stack);
+    free(batch_stack);
+
+    return error_count;
+}
+
+struct CseCase {
+    const char *expr;
+    size_t loads; // INSTR_LOAD instructions in the compiled bytecode
+};
+
+// Repeated subtrees, also in conditional code where the first evaluation
+// doesn't happen on every path and the value must not be reused.
+static const struct CseCase CSE_CASES[] = {
+    { "(x * y + 3) + (x * y + 3)", 1 },
+    { "(x * y + 3) * (x * y + 3) - (x * y + 3)", 2 },
+    { "x > y ? (x * y + 3) : (x * y + 3) - 1", 0 },
+    { "(x * y + 3) > 10 ? (x * y + 3) * 2 : -(x * y + 3)", 2 },
+    { "(x - y) && (x - y) + 1", 1 },
+    { "(x < y) ? (x < y) + 5 : (x < y)", 2 },
+    { "x && (y * y) || (y * y) - 1", 0 },
+    { "((x + 1) * (y + 1)) / ((x + 1) * (y + 1) | 1)", 1 },
+    { "~(x ^ y) + ~(x ^ y) + (x ^ y)", 2 },
+    { NULL, 0 },
+};
+
+size_t test_bytecode_cse(void) {
+    static const int values[] = { 0, 1, -1, 7, -13 };
+    enum { VALUE_COUNT = sizeof(values) / sizeof(values[0]), ROW_COUNT = VALUE_COUNT * VALUE_COUNT };
+    size_t error_count = 0;
+
+    for (const struct CseCase *cse = CSE_CASES; cse->expr; ++ cse) {
+        struct Bytecode bytecode = BYTECODE_INIT();
+        struct JitCode jit = JIT_CODE_INIT();
+        struct ThreadedCode threaded = THREADED_CODE_INIT();
+        int *stack = NULL;
+        int *batch_stack = NULL;
+        int *params = NULL;
+        int columns[2][ROW_COUNT];
+        int batch_results[ROW_COUNT];
+        const int *batch_params[2];
+
+        struct AstNode *expr = fast_parse(&symbol_table, cse->expr, NULL);
+        if (expr == NULL || !bytecode_compile(&bytecode, expr)) {
+            fprintf(stderr, "*** Error compiling expression \"%s\": %s\n", cse->expr, strerror(errno));
+            ++ error_count;
+            goto next;
+        }
+
+        size_t loads = 0;
+        for (size_t index = 0; index < bytecode.instrs_size; index += bytecode_instr_size(BYTECODE_INSTR(bytecode.instrs[index]))) {
+            if (BYTECODE_INSTR(bytecode.instrs[index]) == INSTR_LOAD) {
+                ++ loads;
+            }
+        }
+
+        if (loads != cse->loads) {
+            fprintf(stderr, "*** Expected %zu loads of temporaries for \"%s\", got %zu\n", cse->loads, cse->expr, loads);
+            bytecode_print(&bytecode, stderr);
+            ++ error_count;
+        }
+
+        if (!bytecode_optimize(&bytecode) ||
+            !bytecode_verify(&bytecode) ||
+            (stack = bytecode_alloc_stack(&bytecode)) == NULL ||
+            (batch_stack = bytecode_alloc_batch_stack(&bytecode)) == NULL ||
+            (params = bytecode_alloc_params(&bytecode)) == NULL) {
+            fprintf(stderr, "*** Error preparing bytecode of \"%s\": %s\n", cse->expr, strerror(errno));
+            bytecode_print(&bytecode, stderr);
+            ++ error_count;
+            goto next;
+        }
+
+        const bool has_jit = jit_compile(&jit, &bytecode);
+        if (!has_jit && !jit_is_unavailable(errno)) {
+            fprintf(stderr, "*** Error JIT compiling expression \"%s\": %s\n", cse->expr, strerror(errno));
+            ++ error_count;
+        }
+
+        const bool has_threaded = threaded_compile(&threaded, &bytecode);
+        if (!has_threaded && errno != ENOSYS) {
+            fprintf(stderr, "*** Error compiling expression \"%s\" to threaded code: %s\n", cse->expr, strerror(errno));
+            ++ error_count;
+        }
+
+        for (size_t row = 0; row < ROW_COUNT; ++ row) {
+            struct Param row_params[2] = {
+                { .name = "x", .value = values[row / VALUE_COUNT] },
+                { .name = "y", .value = values[row % VALUE_COUNT] },
+            };
+            const int expected = ast_execute_with_params(expr, row_params, 2);
+
+            bytecode_set_param(&bytecode, params, "x", row_params[0].value);
+            bytecode_set_param(&bytecode, params, "y", row_params[1].value);
+            columns[0][row] = row_params[0].value;
+            columns[1][row] = row_params[1].value;
+
+            const int result          = bytecode_execute(&bytecode, params, stack);
+            const int tailcall_result = bytecode_execute_tailcall(&bytecode, params, stack);
+            const int threaded_result = has_threaded ? threaded_execute(&threaded, params, stack) : expected;
+            const int jit_result      = has_jit ? jit_execute(&jit, params) : expected;
+
+            if (result != expected || tailcall_result != expected || threaded_result != expected || jit_result != expected) {
+                fprintf(stderr,
+                    "*** CSE result missmatch for \"%s\" with x = %d, y = %d: bytecode %d, tail call %d, threaded %d, jit %d, expected %d\n",
+                    cse->expr, row_params[0].value, row_params[1].value,
+                    result, tailcall_result, threaded_result, jit_result, expected);
+                bytecode_print(&bytecode, stderr);
+                ++ error_count;
+            }
+        }
+
+        // rows diverge on the conditions, so the temporaries get compacted
+        for (size_t param_index = 0; param_index < bytecode.params_size; ++ param_index) {
+            batch_params[param_index] = columns[strcmp(bytecode.params[param_index]->name, "x") == 0 ? 0 : 1];
+        }
+
+        if (!bytecode_execute_batch(&bytecode, batch_params, ROW_COUNT, batch_results, batch_stack)) {
+            fprintf(stderr, "*** Error executing \"%s\" in batch: %s\n", cse->expr, strerror(errno));
+            ++ error_count;
+        } else {
+            for (size_t row = 0; row < ROW_COUNT; ++ row) {
+                struct Param row_params[2] = {
+                    { .name = "x", .value = columns[0][row] },
+                    { .name = "y", .value = columns[1][row] },
+                };
+                const int expected = ast_execute_with_params(expr, row_params, 2);
+                if (batch_results[row] != expected) {
+                    fprintf(stderr,
+                        "*** CSE batch result missmatch for \"%s\" with x = %d, y = %d: %d != %d\n",
+                        cse->expr, columns[0][row], columns[1][row], batch_results[row], expected);
+                    ++ error_count;
+                    break;
+                }
+            }
+        }
+
+    next:
+        threaded_free(&threaded);
+        jit_free(&jit);
+        bytecode_free(&bytecode);
+        ast_free(expr);
+        free(stack);
+        free(batch_stack);
+        free(params);
+    }
+
+    return error_count;
+}
+
+// Parses and optimizes all tests into one arena, which is reset every few
+// tests so that its chunks get reused.
+size_t test_arena_ast(void) {
+    struct Arena arena = ARENA_INIT();
+    size_t error_count = 0;
+    size_t test_index = 0;
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test, ++ test_index) {
+        if (test_index % 64 == 0) {
+            arena_reset(&arena);
+        }
+
+        struct Param *ast_params = ast_params_from_environ(test->environ);
+        if (ast_params == NULL) {
+            fprintf(stderr, "*** Error creating ast params: %s\n", strerror(errno));
+            ++ error_count;
+            continue;
+        }
+        const size_t ast_params_size = ast_params_len(ast_params);
+
+        struct AstNode *exprs[3] = {
+            parse_in(&arena, &symbol_table, test->expr, NULL),
+            fast_parse_in(&arena, &symbol_table, test->expr, NULL),
+            NULL,
+        };
+        if (exprs[1] != NULL) {
+            exprs[2] = ast_optimize_in(&arena, exprs[1]);
+        }
+
+        for (size_t index = 0; index < sizeof(exprs) / sizeof(exprs[0]); ++ index) {
+            if (exprs[index] == NULL) {
+                fprintf(stderr, "*** Error parsing expression into arena: %s\n", test->expr);
+                ++ error_count;
+                continue;
+            }
+
+            const int result = ast_execute_with_params(exprs[index], ast_params, ast_params_size);
+            if (result != test->result) {
+                fprintf(stderr, "*** Arena AST result missmatch for \"%s\": %d != %d\n", test->expr, result, test->result);
+                ++ error_count;
+            }
+        }
+
+        ast_params_free(ast_params);
+    }
+
+    arena_free(&arena);
+
+    return error_count;
+}
+
+// The flat AST emitted by the Pratt parser has to be the same as the one
+// converted from its tree.
+size_t test_flat_ast(void) {
+    struct FlatAst parsed = FLAT_AST_INIT();
+    struct FlatAst converted = FLAT_AST_INIT();
+    size_t error_count = 0;
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+        struct Param *ast_params = ast_params_from_environ(test->environ);
+        if (ast_params == NULL) {
+            fprintf(stderr, "*** Error creating ast params: %s\n", strerror(errno));
+            ++ error_count;
+            continue;
+        }
+        const size_t ast_params_size = ast_params_len(ast_params);
+
+        struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+        struct AstNode *opt_expr = expr != NULL ? ast_optimize(expr) : NULL;
+
+        flat_ast_clear(&parsed);
+        flat_ast_clear(&converted);
+
+        if (!fast_parse_flat(&symbol_table, test->expr, &parsed, NULL)) {
+            fprintf(stderr, "*** Error parsing expression into flat AST: %s\n", test->expr);
+            ++ error_count;
+        } else {
+            int *scratch = flat_ast_alloc_scratch(&parsed);
+            if (scratch == NULL) {
+                fprintf(stderr, "*** Error allocating flat AST scratch buffer: %s\n", strerror(errno));
+                ++ error_count;
+            } else {
+                const int result = flat_ast_execute_with_params(&parsed, ast_params, ast_params_size, scratch);
+                if (result != test->result) {
+                    fprintf(stderr, "*** Flat AST result missmatch for \"%s\": %d != %d\n", test->expr, result, test->result);
+                    ++ error_count;
+                }
+                free(scratch);
+            }
+        }
+
+        if (expr == NULL || !flat_ast_from_ast(&converted, expr)) {
+            fprintf(stderr, "*** Error converting expression to flat AST: %s\n", test->expr);
+            ++ error_count;
+        } else if (
+            converted.nodes_size != parsed.nodes_size ||
+            memcmp(converted.types, parsed.types, parsed.nodes_size * sizeof(*parsed.types)) != 0 ||
+            memcmp(converted.args, parsed.args, parsed.nodes_size * sizeof(*parsed.args)) != 0 ||
+            memcmp(converted.flows, parsed.flows, parsed.nodes_size * sizeof(*parsed.flows)) != 0 ||
+            memcmp(converted.jumps, parsed.jumps, parsed.nodes_size * sizeof(*parsed.jumps)) != 0 ||
+            converted.vars_size != parsed.vars_size ||
+            memcmp(converted.vars, parsed.vars, parsed.vars_size * sizeof(*parsed.vars)) != 0 ||
+            converted.stack_size != parsed.stack_size
+        ) {
+            fprintf(stderr, "*** Flat AST of the parser differs from the converted tree: %s\n", test->expr);
+            ++ error_count;
+        }
+
+        flat_ast_clear(&converted);
+        if (opt_expr == NULL || !flat_ast_from_ast(&converted, opt_expr)) {
+            fprintf(stderr, "*** Error converting optimized expression to flat AST: %s\n", test->expr);
+            ++ error_count;
+        } else {
+            int *scratch = flat_ast_alloc_scratch(&converted);
+            if (scratch == NULL) {
+                fprintf(stderr, "*** Error allocating flat AST scratch buffer: %s\n", strerror(errno));
+                ++ error_count;
+            } else {
+                const int result = flat_ast_execute_with_params(&converted, ast_params, ast_params_size, scratch);
+                if (result != test->result) {
+                    fprintf(stderr, "*** Optimized flat AST result missmatch for \"%s\": %d != %d\n", test->expr, result, test->result);
+                    ++ error_count;
+                }
+                free(scratch);
+            }
+        }
+
+        ast_free(expr);
+        ast_free(opt_expr);
+        ast_params_free(ast_params);
+    }
+
+    // branches that aren't taken are skipped, else they would divide by 0
+    static const struct {
+        const char *expr;
+        int result;
+    } SHORT_CIRCUITS[] = {
+        { "0 && 1 / 0", 0 },
+        { "2 || 1 / 0", 1 },
+        { "1 ? 2 : 1 / 0", 2 },
+        { "0 ? 1 / 0 : 3", 3 },
+        { "(0 && 1 / 0) ? 1 / 0 : (1 || 1 / 0) + 4", 5 },
+        { NULL, 0 },
+    };
+    for (size_t index = 0; SHORT_CIRCUITS[index].expr; ++ index) {
+        flat_ast_clear(&parsed);
+        int stack[16];
+        if (!fast_parse_flat(&symbol_table, SHORT_CIRCUITS[index].expr, &parsed, NULL)) {
+            fprintf(stderr, "*** Error parsing expression into flat AST: %s\n", SHORT_CIRCUITS[index].expr);
+            ++ error_count;
+        } else if (parsed.stack_size > sizeof(stack) / sizeof(*stack)) {
+            fprintf(stderr, "*** Flat AST needs a stack of %zu entries: %s\n", parsed.stack_size, SHORT_CIRCUITS[index].expr);
+            ++ error_count;
+        } else if (flat_ast_execute(&parsed, NULL, stack) != SHORT_CIRCUITS[index].result) {
+            fprintf(stderr, "*** Flat AST result missmatch for: %s\n", SHORT_CIRCUITS[index].expr);
+            ++ error_count;
+        }
+    }
+
+    // a failed parse leaves the nodes of earlier expressions as they were
+    flat_ast_clear(&parsed);
+    if (!fast_parse_flat(&symbol_table, "a + b", &parsed, NULL)) {
+        fprintf(stderr, "*** Error parsing expression into flat AST: a + b\n");
+        ++ error_count;
+    } else if (fast_parse_flat(&symbol_table, "c * (d", &parsed, NULL)) {
+        fprintf(stderr, "*** fast_parse_flat() accepted: c * (d\n");
+        ++ error_count;
+    } else if (parsed.nodes_size != 3 || parsed.vars_size != 2 || parsed.stack_depth != 1 || parsed.stack_size != 2) {
+        fprintf(stderr, "*** fast_parse_flat() didn't restore the flat AST after an error\n");
+        ++ error_count;
+    }
+
+    // inner nodes need all their children
+    flat_ast_clear(&parsed);
+    if (flat_ast_push(&parsed, NODE_NEG) || errno != EINVAL) {
+        fprintf(stderr, "*** flat_ast_push() accepted a unary node without child\n");
+        ++ error_count;
+    }
+    if (!flat_ast_push_int(&parsed, 1) || flat_ast_push(&parsed, NODE_ADD) || errno != EINVAL) {
+        fprintf(stderr, "*** flat_ast_push() accepted a binary node with one child\n");
+        ++ error_count;
+    }
+
+    flat_ast_free(&parsed);
+    flat_ast_free(&converted);
+
+    return error_count;
+}
+
+// Equal names have to be interned as the same symbol of a table, also once the
+// table has grown, tables have to be independent, and the tokenizer has to
+// hash identifiers like symbol_hash().
+#define SYMBOL_TEST_COUNT 5000
+
+size_t test_symbols(void) {
+    struct SymbolTable table = SYMBOL_TABLE_INIT();
+    struct SymbolTable other_table = SYMBOL_TABLE_INIT();
+    size_t error_count = 0;
+    char name[32];
+
+    for (size_t index = 0; index < SYMBOL_TEST_COUNT; ++ index) {
+        snprintf(name, sizeof(name), "symbol_test_%zu", index);
+        const struct Symbol *symbol = symbol_intern(&table, name, strlen(name));
+        if (symbol == NULL) {
+            fprintf(stderr, "*** Error interning symbol %s: %s\n", name, strerror(errno));
+            symbol_table_free(&table);
+            return error_count + 1;
+        }
+        if (symbol->id != index || strcmp(symbol->name, name) != 0) {
+            fprintf(stderr, "*** Symbol %s got id %" PRIu32 " instead of %zu\n", name, symbol->id, index);
+            ++ error_count;
+        }
+    }
+
+    for (size_t index = 0; index < SYMBOL_TEST_COUNT; ++ index) {
+        snprintf(name, sizeof(name), "symbol_test_%zu", index);
+        const struct Symbol *symbol = symbol_intern(&table, name, strlen(name));
+        if (symbol != symbol_lookup(&table, name) || symbol != symbol_get(&table, index)) {
+            fprintf(stderr, "*** Symbol %s was interned twice\n", name);
+            ++ error_count;
+        }
+    }
+
+    if (symbol_count(&table) != SYMBOL_TEST_COUNT) {
+        fprintf(stderr, "*** Symbol count %zu instead of %d\n", symbol_count(&table), SYMBOL_TEST_COUNT);
+        ++ error_count;
+    }
+
+    if (symbol_lookup(&table, "symbol_test_never_interned") != NULL) {
+        fprintf(stderr, "*** Found a symbol that was never interned\n");
+        ++ error_count;
+    }
+
+    // indices of symbols survive growing, can be replaced and are gone after
+    // clearing
+    struct SymbolMap map = SYMBOL_MAP_INIT();
+    for (size_t index = 0; index < SYMBOL_TEST_COUNT; index += 2) {
+        if (!symbol_map_put(&map, symbol_get(&table, index), (uint32_t)(index * 3))) {
+            fprintf(stderr, "*** Error adding to symbol map: %s\n", strerror(errno));
+            ++ error_count;
+            break;
+        }
+    }
+    for (size_t index = 0; index < SYMBOL_TEST_COUNT; ++ index) {
+        const ptrdiff_t expected = index % 2 == 0 ? (ptrdiff_t)(index * 3) : -1;
+        if (symbol_map_get(&map, symbol_get(&table, index)) != expected) {
+            fprintf(stderr, "*** Symbol map has the wrong index for symbol_test_%zu\n", index);
+            ++ error_count;
+            break;
+        }
+    }
+    if (!symbol_map_put(&map, symbol_get(&table, 0), 1) || symbol_map_get(&map, symbol_get(&table, 0)) != 1 ||
+        map.entries_size != (SYMBOL_TEST_COUNT + 1) / 2) {
+        fprintf(stderr, "*** Symbol map didn't replace an index\n");
+        ++ error_count;
+    }
+    symbol_map_clear(&map);
+    if (symbol_map_get(&map, symbol_get(&table, 0)) != -1) {
+        fprintf(stderr, "*** Cleared symbol map still has an index\n");
+        ++ error_count;
+    }
+    symbol_map_free(&map);
+
+    const struct Symbol *other = symbol_intern(&other_table, "symbol_test_7", strlen("symbol_test_7"));
+    if (other == NULL || other == symbol_lookup(&table, "symbol_test_7") || other->id != 0 ||
+        symbol_lookup(&other_table, "symbol_test_8") != NULL) {
+        fprintf(stderr, "*** Symbol tables aren't independent\n");
+        ++ error_count;
+    }
+    symbol_table_free(&other_table);
+
+    struct Tokenizer tokenizer = TOKENIZER_INIT("symbol_test_17 + _x9");
+    for (enum TokenType token = next_token(&tokenizer); token != TOK_EOF; token = next_token(&tokenizer)) {
+        if (token != TOK_IDENT) {
+            continue;
+        }
+        const char *ident = tokenizer.input + tokenizer.ident_start;
+        const struct Symbol *symbol = tokenizer_get_symbol(&tokenizer, &table);
+        if (tokenizer.ident_hash != symbol_hash(ident, tokenizer.ident_length) ||
+            symbol == NULL || symbol->length != tokenizer.ident_length ||
+            memcmp(symbol->name, ident, tokenizer.ident_length) != 0) {
+            fprintf(stderr, "*** Tokenizer interned the wrong symbol for %.*s\n", (int)tokenizer.ident_length, ident);
+            ++ error_count;
+        }
+    }
+    tokenizer_free(&tokenizer);
+    symbol_table_free(&table);
+
+    return error_count;
+}
+
+// Long runs of whitespace, comments, identifier chars and digits are scanned
+// in blocks, so a generated token stream is tokenized at every alignment and
+// compared to the tokens it was generated from. Each copy ends right after its
+// terminating zero, so AddressSanitizer sees blocks loaded past the end.
+#define TOKENIZER_RUNS_TOKENS 2000
+
+struct ExpectedToken {
+    enum TokenType token;
+    int value;
+    size_t pos;
+    size_t length;
+};
+
+static const char *TOKENIZER_RUNS_OPS[] = {
+    "+", "-", "*", "/", "%", "(", ")", "?", ":", "|", "^", "&", "~", "!",
+    "&&", "||", "<", ">", "<=", ">=", "==", "!=", "<<", ">>",
+};
+
+static const char TOKENIZER_RUNS_SPACE[] = " \t\n\v\f\r";
+static const char TOKENIZER_RUNS_IDENT[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+
+size_t test_tokenizer_runs(void) {
+    const size_t max_size = TOKENIZER_RUNS_TOKENS * 128;
+    struct ExpectedToken *expected = calloc(TOKENIZER_RUNS_TOKENS, sizeof(struct ExpectedToken));
+    char *buffer = malloc(max_size + 16);
+    struct TokenArray tokens = TOKEN_ARRAY_INIT();
+    size_t error_count = 0;
+
+    if (expected == NULL || buffer == NULL) {
+        fprintf(stderr, "*** Error allocating tokenizer test input: %s\n", strerror(errno));
+        free(expected);
+        free(buffer);
+        return 1;
+    }
+
+    uint32_t state = 54321;
+#define NEXT_RANDOM(N) (state = state * 1103515245 + 12345, (state >> 16) % (N))
+
+    char *input = buffer + 16;
+    size_t size = 0;
+    for (size_t index = 0; index < TOKENIZER_RUNS_TOKENS; ++ index) {
+        // at least one space, so tokens don't run into each other
+        const size_t space_count = 1 + (NEXT_RANDOM(4) == 0 ? NEXT_RANDOM(40) : 0);
+        for (size_t space_index = 0; space_index < space_count; ++ space_index) {
+            input[size ++] = TOKENIZER_RUNS_SPACE[NEXT_RANDOM(sizeof(TOKENIZER_RUNS_SPACE) - 1)];
+        }
+        if (NEXT_RANDOM(8) == 0) {
+            const size_t comment_length = NEXT_RANDOM(50);
+            input[size ++] = '#';
+            for (size_t char_index = 0; char_index < comment_length; ++ char_index) {
+                input[size ++] = (char)(' ' + NEXT_RANDOM(95));
+            }
+            input[size ++] = '\n';
+        }
+
+        struct ExpectedToken *token = &expected[index];
+        token->pos = size;
+
+        switch (NEXT_RANDOM(3)) {
+            case 0:
+            {
+                const size_t length = 1 + NEXT_RANDOM(40);
+                input[size ++] = TOKENIZER_RUNS_IDENT[NEXT_RANDOM(sizeof(TOKENIZER_RUNS_IDENT) - 11)];
+                for (size_t char_index = 1; char_index < length; ++ char_index) {
+                    input[size ++] = TOKENIZER_RUNS_IDENT[NEXT_RANDOM(sizeof(TOKENIZER_RUNS_IDENT) - 1)];
+                }
+                token->token = TOK_IDENT;
+                token->length = length;
+                break;
+            }
+            case 1:
+            {
+                // digits wrap around like int arithmetic, a sign right before
+                // the digits is part of the integer
+                const bool negative = NEXT_RANDOM(4) == 0;
+                const size_t length = 1 + NEXT_RANDOM(25);
+                uint32_t value = 0;
+                if (negative) {
+                    input[size ++] = '-';
+                }
+                for (size_t char_index = 0; char_index < length; ++ char_index) {
+                    const uint32_t digit = NEXT_RANDOM(10);
+                    input[size ++] = (char)('0' + digit);
+                    value = value * 10 + digit;
+                }
+                token->token = TOK_INT;
+                token->value = (int)(negative ? -value : value);
+                break;
+            }
+            default:
+            {
+                const char *op = TOKENIZER_RUNS_OPS[NEXT_RANDOM(sizeof(TOKENIZER_RUNS_OPS) / sizeof(TOKENIZER_RUNS_OPS[0]))];
+                const size_t length = strlen(op);
+                memcpy(input + size, op, length);
+                size += length;
+                token->token = length == 1 ? (enum TokenType)op[0] : (enum TokenType)((op[0] << 8) | op[1]);
+                break;
+            }
+        }
+        assert(size < max_size - 128);
+    }
+#undef NEXT_RANDOM
+
+    for (size_t offset = 0; offset < 16; ++ offset) {
+        char *shifted = malloc(offset + size + 1);
+        if (shifted == NULL) {
+            fprintf(stderr, "*** Error allocating tokenizer test input: %s\n", strerror(errno));
+            ++ error_count;
+            break;
+        }
+        memcpy(shifted + offset, buffer + 16, size);
+        shifted[offset + size] = 0;
+        input = shifted + offset;
+
+        // the same tokens have to come out of the scanner and a token array
+        if (!token_array_tokenize(&tokens, input)) {
+            fprintf(stderr, "*** Error creating token array: %s\n", strerror(errno));
+            ++ error_count;
+            free(shifted);
+            break;
+        }
+
+        for (int from_array = 0; from_array < 2; ++ from_array) {
+            struct Tokenizer tokenizer = TOKENIZER_INIT(input);
+            if (from_array) {
+                tokenizer = (struct Tokenizer)TOKENIZER_INIT_TOKENS(&tokens);
+            }
+            const char *mode = from_array ? "token array" : "tokenizer";
+
+            for (size_t index = 0; index < TOKENIZER_RUNS_TOKENS; ++ index) {
+                const struct ExpectedToken *token = &expected[index];
+                const enum TokenType actual = next_token(&tokenizer);
+
+                if (actual != token->token || tokenizer.token_pos != token->pos || (
+                        actual == TOK_INT && tokenizer.value != token->value) || (
+                        actual == TOK_IDENT && (
+                            tokenizer.ident_start != token->pos ||
+                            tokenizer.ident_length != token->length ||
+                            tokenizer.ident_hash != symbol_hash(input + token->pos, token->length)))) {
+                    fprintf(stderr, "*** %s missmatch at offset %zu of token %zu at %zu: %s instead of %s\n",
+                        mode, offset, index, token->pos, get_token_name(actual), get_token_name(token->token));
+                    ++ error_count;
+                    break;
+                }
+            }
+
+            // stays at the end
+            if (next_token(&tokenizer) != TOK_EOF || next_token(&tokenizer) != TOK_EOF) {
+                fprintf(stderr, "*** %s didn't end at offset %zu\n", mode, offset);
+                ++ error_count;
+            }
+            tokenizer_free(&tokenizer);
+        }
+
+        if (tokens.size != TOKENIZER_RUNS_TOKENS + 1) {
+            fprintf(stderr, "*** Token array has %zu instead of %d tokens at offset %zu\n",
+                tokens.size, TOKENIZER_RUNS_TOKENS + 1, offset);
+            ++ error_count;
+        }
+        free(shifted);
+    }
+
+    token_array_free(&tokens);
+    free(expected);
+    free(buffer);
+
+    return error_count;
+}
+
+// The iterative parser has to build the same trees and report the same errors
+// as the recursive Pratt parser, and it has to handle nesting that would
+// overflow the stack of the recursive parsers.
+static const char *MALFORMED_EXPRS[] = {
+    "",
+    "1 +",
+    "(1 + 2",
+    "((a) * b",
+    "a ? b",
+    "a ? (b : c)",
+    "a ? b : c ? d",
+    "1 2",
+    "(a) b",
+    "-",
+    "* 3",
+    "a + )",
+    "(1 + 2))",
+    NULL,
+};
+
+size_t test_iterative_parser(void) {
+    struct FlatAst expected = FLAT_AST_INIT();
+    struct FlatAst actual = FLAT_AST_INIT();
+    size_t error_count = 0;
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+        struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+        struct AstNode *iter_expr = fast_parse_iterative(&symbol_table, test->expr, NULL);
+
+        flat_ast_clear(&expected);
+        flat_ast_clear(&actual);
+
+        if (expr == NULL || iter_expr == NULL ||
+            !flat_ast_from_ast(&expected, expr) ||
+            !flat_ast_from_ast(&actual, iter_expr)) {
+            fprintf(stderr, "*** Error parsing expression iteratively: %s\n", test->expr);
+            ++ error_count;
+        } else if (
+            expected.nodes_size != actual.nodes_size ||
+            memcmp(expected.types, actual.types, actual.nodes_size * sizeof(*actual.types)) != 0 ||
+            memcmp(expected.args, actual.args, actual.nodes_size * sizeof(*actual.args)) != 0
+        ) {
+            fprintf(stderr, "*** Iterative parser built a different tree for: %s\n", test->expr);
+            ++ error_count;
+        }
+
+        ast_free(expr);
+        ast_free(iter_expr);
+    }
+
+    flat_ast_free(&expected);
+    flat_ast_free(&actual);
+
+    for (const char **input = MALFORMED_EXPRS; *input; ++ input) {
+        struct ErrorInfo error;
+        struct ErrorInfo iter_error;
+        struct AstNode *expr = fast_parse(&symbol_table, *input, &error);
+        struct AstNode *iter_expr = fast_parse_iterative(&symbol_table, *input, &iter_error);
+
+        if (expr != NULL || iter_expr != NULL) {
+            fprintf(stderr, "*** Parsed malformed expression: \"%s\"\n", *input);
+            ++ error_count;
+        } else if (
+            error.error != iter_error.error ||
+            error.offset != iter_error.offset ||
+            error.context_offset != iter_error.context_offset ||
+            (error.error == PARSER_ERROR_EXPECTED_TOKEN && error.token != iter_error.token)
+        ) {
+            fprintf(stderr, "*** Iterative parser reported a different error for: \"%s\"\n", *input);
+            print_parser_error(stderr, *input, &error, 1);
+            print_parser_error(stderr, *input, &iter_error, 1);
+            ++ error_count;
+        }
+
+        ast_free(expr);
+        ast_free(iter_expr);
+    }
+
+    // ast_free() and ast_execute() recurse too, so the deep trees are released
+    // with an arena and checked by walking them in a loop
+    struct Arena arena = ARENA_INIT();
+    char *parens = make_deep_input("-(", "x", ")", DEEP_TEST_DEPTH);
+    char *ifs = make_deep_input("a ? b : ", "c", "", DEEP_TEST_DEPTH);
+
+    if (parens == NULL || ifs == NULL) {
+        fprintf(stderr, "*** Error creating deep inputs: %s\n", strerror(errno));
+        ++ error_count;
+    } else {
+        struct AstNode *expr = fast_parse_iterative_in(&arena, &symbol_table, parens, NULL);
+        size_t depth = 0;
+        while (expr != NULL && expr->type == NODE_NEG) {
+            expr = expr->data.child;
+            ++ depth;
+        }
+        if (expr == NULL || expr->type != NODE_VAR || depth != DEEP_TEST_DEPTH) {
+            fprintf(stderr, "*** Iterative parser failed on %d nested parentheses\n", DEEP_TEST_DEPTH);
+            ++ error_count;
+        }
+
+        expr = fast_parse_iterative_in(&arena, &symbol_table, ifs, NULL);
+        depth = 0;
+        while (expr != NULL && expr->type == NODE_IF) {
+            expr = expr->data.terneary.else_expr;
+            ++ depth;
+        }
+        if (expr == NULL || expr->type != NODE_VAR || depth != DEEP_TEST_DEPTH) {
+            fprintf(stderr, "*** Iterative parser failed on %d nested ifs\n", DEEP_TEST_DEPTH);
+            ++ error_count;
+        }
+    }
+
+    free(parens);
+    free(ifs);
+    arena_free(&arena);
+
+    return error_count;
+}
+
+// The parsers have to give the same results when reading a token array as when
+// scanning the input themselves. The wrappers run the pre-tokenized parsers
+// through all tests of the parsers.
+struct AstNode *parse_pretokenized(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    struct TokenArray tokens = TOKEN_ARRAY_INIT();
+    struct AstNode *expr = NULL;
+    if (token_array_tokenize(&tokens, input)) {
+        expr = parse_tokens(symbols, &tokens, error);
+    }
+    token_array_free(&tokens);
+    return expr;
+}
+
+struct AstNode *fast_parse_pretokenized(struct SymbolTable *symbols, const char *input, struct ErrorInfo *error) {
+    struct TokenArray tokens = TOKEN_ARRAY_INIT();
+    struct AstNode *expr = NULL;
+    if (token_array_tokenize(&tokens, input)) {
+        expr = fast_parse_tokens(symbols, &tokens, error);
+    }
+    token_array_free(&tokens);
+    return expr;
+}
+
+static const char *TOKEN_ERROR_EXPRS[] = {
+    "a = 1",
+    "(a == 1) = 2",
+    "a ? b : $",
+    "(1 + 2 @",
+    NULL,
+};
+
+bool same_parser_error(const struct ErrorInfo *lhs, const struct ErrorInfo *rhs) {
+    return (
+        lhs->error == rhs->error &&
+        lhs->offset == rhs->offset &&
+        lhs->context_offset == rhs->context_offset &&
+        (lhs->error != PARSER_ERROR_EXPECTED_TOKEN || lhs->token == rhs->token)
+    );
+}
+
+size_t test_token_array_parsers(void) {
+    size_t error_count = 0;
+
+    const char **const expr_lists[] = { MALFORMED_EXPRS, TOKEN_ERROR_EXPRS };
+    for (size_t list_index = 0; list_index < 2; ++ list_index) {
+        for (const char **input = expr_lists[list_index]; *input; ++ input) {
+            struct ErrorInfo errors[4];
+            struct AstNode *results[4] = {
+                parse(&symbol_table, *input, &errors[0]),
+                parse_pretokenized(&symbol_table, *input, &errors[1]),
+                fast_parse(&symbol_table, *input, &errors[2]),
+                fast_parse_pretokenized(&symbol_table, *input, &errors[3]),
+            };
+
+            if (results[0] != NULL || results[1] != NULL || results[2] != NULL || results[3] != NULL) {
+                fprintf(stderr, "*** Parsed malformed expression: \"%s\"\n", *input);
+                ++ error_count;
+            } else if (!same_parser_error(&errors[0], &errors[1]) || !same_parser_error(&errors[2], &errors[3])) {
+                fprintf(stderr, "*** Parsing a token array reported a different error for: \"%s\"\n", *input);
+                for (size_t index = 0; index < 4; ++ index) {
+                    print_parser_error(stderr, *input, &errors[index], 1);
+                }
+                ++ error_count;
+            }
+
+            for (size_t index = 0; index < 4; ++ index) {
+                ast_free(results[index]);
+            }
+        }
+    }
+
+    return error_count;
+}
+
+// The single pass compiler has to give the same results as the tree based one,
+// produce verifiable code, report the errors of fast_parse() and fold
+// constants including short circuits and ifs.
+struct FoldCase {
+    const char *expr;
+    int value;
+};
+
+static const struct FoldCase FOLD_CASES[] = {
+    { "1 + 2 * 3",          7 },
+    { "0 && x / 0",         0 },
+    { "1 || x",             1 },
+    { "2 && 3",             1 },
+    { "2 > 1 ? -3 : y",    -3 },
+    { "0 ? y : (5 % 3)",    2 },
+    { "!(4 - 4) << 3",      8 },
+    { "~-+(1) - 1",        -1 },
+    { NULL, 0 },
+};
+
+size_t test_bytecode_source(void) {
+    struct Bytecode bytecode = BYTECODE_INIT();
+    size_t error_count = 0;
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+        if (!bytecode_compile_source(&bytecode, &symbol_table, test->expr, NULL)) {
+            fprintf(stderr, "*** Error compiling source to bytecode: %s\n", test->expr);
+            ++ error_count;
+            continue;
+        }
+
+        for (int optimized = 0; optimized < 2; ++ optimized) {
+            int *params = bytecode_alloc_params(&bytecode);
+            int *stack = bytecode_alloc_stack(&bytecode);
+
+            if ((params == NULL && bytecode.params_size > 0) || (stack == NULL && bytecode.stack_size > 0)) {
+                fprintf(stderr, "*** Error allocating bytecode params or stack: %s\n", strerror(errno));
+                ++ error_count;
+            } else if (!params_from_environ(&bytecode, params, test->environ)) {
+                fprintf(stderr, "*** Error setting bytecode params: %s\n", strerror(errno));
+                ++ error_count;
+            } else if (!bytecode_verify(&bytecode)) {
+                fprintf(stderr, "*** Single pass bytecode%s doesn't verify: %s\n", optimized ? " (optimized)" : "", test->expr);
+                bytecode_print(&bytecode, stderr);
+                ++ error_count;
+            } else {
+                const int result = bytecode_execute(&bytecode, params, stack);
+                if (result != test->result) {
+                    fprintf(stderr, "*** Single pass bytecode%s result missmatch for \"%s\": %d != %d\n",
+                        optimized ? " (optimized)" : "", test->expr, result, test->result);
+                    bytecode_print(&bytecode, stderr);
+                    ++ error_count;
+                }
+            }
+
+            free(params);
+            free(stack);
+
+            if (!optimized && !bytecode_optimize(&bytecode)) {
+                fprintf(stderr, "*** Error optimizing single pass bytecode: %s\n", test->expr);
+                ++ error_count;
+                break;
+            }
+        }
+
+        bytecode_clear(&bytecode);
+    }
+
+    for (const char **input = MALFORMED_EXPRS; *input; ++ input) {
+        struct ErrorInfo error;
+        struct ErrorInfo source_error;
+        struct AstNode *expr = fast_parse(&symbol_table, *input, &error);
+
+        if (expr != NULL || bytecode_compile_source(&bytecode, &symbol_table, *input, &source_error)) {
+            fprintf(stderr, "*** Compiled malformed expression: \"%s\"\n", *input);
+            ++ error_count;
+        } else if (
+            error.error != source_error.error ||
+            error.offset != source_error.offset ||
+            error.context_offset != source_error.context_offset ||
+            (error.error == PARSER_ERROR_EXPECTED_TOKEN && error.token != source_error.token)
+        ) {
+            fprintf(stderr, "*** Single pass compiler reported a different error for: \"%s\"\n", *input);
+            print_parser_error(stderr, *input, &error, 1);
+            print_parser_error(stderr, *input, &source_error, 1);
+            ++ error_count;
+        }
+
+        ast_free(expr);
+        bytecode_clear(&bytecode);
+    }
+
+    for (const struct FoldCase *test = FOLD_CASES; test->expr; ++ test) {
+        if (!bytecode_compile_source(&bytecode, &symbol_table, test->expr, NULL)) {
+            fprintf(stderr, "*** Error compiling source to bytecode: %s\n", test->expr);
+            ++ error_count;
+        } else if (
+            bytecode.instrs_size != 2 ||
+            BYTECODE_INSTR(bytecode.instrs[0]) != INSTR_INT ||
+            BYTECODE_ARG(bytecode.instrs[0]) != test->value
+        ) {
+            fprintf(stderr, "*** Expression wasn't folded to %d: %s\n", test->value, test->expr);
+            bytecode_print(&bytecode, stderr);
+            ++ error_count;
+        }
+        bytecode_clear(&bytecode);
+    }
+
+    bytecode_free(&bytecode);
+
+    return error_count;
+}
+
+// prefix and suffix repeated depth times around leaf
+char *make_deep_input(const char *prefix, const char *leaf, const char *suffix, size_t depth) {
+    const size_t prefix_len = strlen(prefix);
+    const size_t suffix_len = strlen(suffix);
+    const size_t leaf_len = strlen(leaf);
+    char *input = malloc((prefix_len + suffix_len) * depth + leaf_len + 1);
+    if (input == NULL) {
+        return NULL;
+    }
+
+    char *ptr = input;
+    for (size_t index = 0; index < depth; ++ index) {
+        memcpy(ptr, prefix, prefix_len);
+        ptr += prefix_len;
+    }
+    memcpy(ptr, leaf, leaf_len);
+    ptr += leaf_len;
+    for (size_t index = 0; index < depth; ++ index) {
+        memcpy(ptr, suffix, suffix_len);
+        ptr += suffix_len;
+    }
+    *ptr = 0;
+
+    return input;
+}
+
+// Deeply nested parentheses recurse through every precedence level of the
+// recursive descent parser, long flat expressions stress the operator loop.
+// The depth is kept low enough for the recursive parsers.
+int bench_parser_shapes(void) {
+    struct Arena arena = ARENA_INIT();
+    struct timespec *times = calloc(SHAPE_ITERS * 6, sizeof(struct timespec));
+    char *deep = make_deep_input("(x + ", "1", ")", DEEP_BENCH_DEPTH);
+    char *wide = malloc(WIDE_BENCH_TERMS * 16);
+    int status = 1;
+
+    printf("\nBenchmarking parsing of %d nested parentheses and %d terms with %d iterations:\n\n",
+        DEEP_BENCH_DEPTH, WIDE_BENCH_TERMS, SHAPE_ITERS);
+
+    if (times == NULL || deep == NULL || wide == NULL) {
+        perror("allocating parser benchmark inputs");
+        goto cleanup;
+    }
+
+    static const char *WIDE_OPS[] = { " + ", " * ", " - ", " < ", " && ", " | " };
+    char *ptr = wide;
+    for (size_t index = 0; index < WIDE_BENCH_TERMS; ++ index) {
+        if (index > 0) {
+            ptr = stpcpy(ptr, WIDE_OPS[index % (sizeof(WIDE_OPS) / sizeof(WIDE_OPS[0]))]);
+        }
+        ptr = stpcpy(ptr, index % 2 ? "x" : "3");
+    }
+
+    const char *inputs[2] = { deep, wide };
+    for (size_t input_index = 0; input_index < 2; ++ input_index) {
+        for (size_t parser_index = 0; parser_index < 3; ++ parser_index) {
+            for (size_t iter = 0; iter < SHAPE_ITERS; ++ iter) {
+                struct ErrorInfo error;
+                struct timespec ts_start, ts_end;
+                int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+                struct AstNode *expr =
+                    parser_index == 0 ? parse_in(&arena, &symbol_table, inputs[input_index], &error) :
+                    parser_index == 1 ? fast_parse_in(&arena, &symbol_table, inputs[input_index], &error) :
+                    fast_parse_iterative_in(&arena, &symbol_table, inputs[input_index], &error);
+                arena_reset(&arena);
+                int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+                assert(res_start == 0); (void)res_start;
+                assert(res_end == 0); (void)res_end;
+
+                if (expr == NULL) {
+                    fprintf(stderr, "*** Error parsing benchmark input\n");
+                    print_parser_error(stderr, inputs[input_index], &error, 1);
+                    goto cleanup;
+                }
+
+                times[(input_index * 3 + parser_index) * SHAPE_ITERS + iter] = timespec_sub(ts_end, ts_start);
+            }
+        }
+    }
+
+    struct Stats stats[6];
+    for (size_t index = 0; index < 6; ++ index) {
+        stats[index] = make_stats(times + index * SHAPE_ITERS, SHAPE_ITERS);
+    }
+    struct Stats stats_max = max_stats(stats, 6);
+
+    printf("Deep and wide parser benchmark result:\n");
+    print_bench_header(25);
+    print_bench("Recursive Descent (deep)", 25, &stats[0], &stats_max);
+    print_bench("Pratt (deep)",             25, &stats[1], &stats_max);
+    print_bench("Iterative Pratt (deep)",   25, &stats[2], &stats_max);
+    print_bench("Recursive Descent (wide)", 25, &stats[3], &stats_max);
+    print_bench("Pratt (wide)",             25, &stats[4], &stats_max);
+    print_bench("Iterative Pratt (wide)",   25, &stats[5], &stats_max);
+
+    status = 0;
+
+cleanup:
+    arena_free(&arena);
+    free(times);
+    free(deep);
+    free(wide);
+
+    return status;
+}
+
+// Time to the first result of every test expression from its source, like
+// for a one-shot evaluation.
+#define ONE_SHOT_COUNT 3
+
+static bool one_shot_execute(struct Bytecode *bytecode, const struct TestCase *test, int *result) {
+    int *params = bytecode_alloc_params(bytecode);
+    int *stack = bytecode_alloc_stack(bytecode);
+    bool ok = false;
+
+    if ((params != NULL || bytecode->params_size == 0) && (stack != NULL || bytecode->stack_size == 0) &&
+        params_from_environ(bytecode, params, test->environ)) {
+        *result = bytecode_execute(bytecode, params, stack);
+        ok = true;
+    }
+
+    free(params);
+    free(stack);
+    bytecode_clear(bytecode);
+    return ok;
+}
+
+int bench_one_shot(void) {
+    struct Bytecode bytecode = BYTECODE_INIT();
+    struct timespec *times = calloc(ONE_SHOT_COUNT * ONE_SHOT_ITERS, sizeof(struct timespec));
+    int status = 1;
+
+    printf("\nBenchmarking one-shot evaluation with %d iterations:\n\n", ONE_SHOT_ITERS);
+
+    if (times == NULL) {
+        perror("calloc(ONE_SHOT_COUNT * ONE_SHOT_ITERS, sizeof(struct timespec))");
+        return 1;
+    }
+
+    for (size_t index = 0; index < ONE_SHOT_COUNT; ++ index) {
+        for (size_t iter = 0; iter < ONE_SHOT_ITERS; ++ iter) {
+            struct timespec ts_start, ts_end;
+            int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+            for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+                int result = 0;
+                bool ok = false;
+
+                if (index == 0) {
+                    // parse and interpret the tree
+                    struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+                    if (expr != NULL) {
+                        struct Param *ast_params = ast_params_from_environ(test->environ);
+                        if (ast_params != NULL) {
+                            result = ast_execute_with_params(expr, ast_params, ast_params_len(ast_params));
+                            ok = true;
+                        }
+                        ast_params_free(ast_params);
+                    }
+                    ast_free(expr);
+                } else if (index == 1) {
+                    // parse, fold the tree and compile it
+                    struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+                    struct AstNode *opt_expr = expr != NULL ? ast_optimize(expr) : NULL;
+                    ok = opt_expr != NULL && bytecode_compile(&bytecode, opt_expr) &&
+                        one_shot_execute(&bytecode, test, &result);
+                    ast_free(expr);
+                    ast_free(opt_expr);
+                } else {
+                    ok = bytecode_compile_source(&bytecode, &symbol_table, test->expr, NULL) &&
+                        one_shot_execute(&bytecode, test, &result);
+                }
+
+                if (!ok || result != test->result) {
+                    fprintf(stderr, "*** One-shot evaluation failed for: %s\n", test->expr);
+                    goto cleanup;
+                }
+            }
+            int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+            assert(res_start == 0); (void)res_start;
+            assert(res_end == 0); (void)res_end;
+            times[index * ONE_SHOT_ITERS + iter] = timespec_sub(ts_end, ts_start);
+        }
+    }
+
+    struct Stats stats[ONE_SHOT_COUNT];
+    for (size_t index = 0; index < ONE_SHOT_COUNT; ++ index) {
+        stats[index] = make_stats(times + index * ONE_SHOT_ITERS, ONE_SHOT_ITERS);
+    }
+    struct Stats stats_max = max_stats(stats, ONE_SHOT_COUNT);
+
+    printf("One-shot benchmark result:\n");
+    print_bench_header(32);
+    print_bench("parse + ast interpreter",          32, &stats[0], &stats_max);
+    print_bench("parse + optimize + bytecode",      32, &stats[1], &stats_max);
+    print_bench("single pass bytecode",             32, &stats[2], &stats_max);
+
+    status = 0;
+
+cleanup:
+    bytecode_free(&bytecode);
+    free(times);
+
+    return status;
+}
+
+// "<prefix>0 + <prefix>1 + ... + <prefix><count - 1>", so the parameter of
+// <prefix><index> gets the index
+char *make_param_sum(const char *prefix, size_t count) {
+    const size_t prefix_len = strlen(prefix);
+    char *input = malloc(count * (prefix_len + 24) + 1);
+    if (input == NULL) {
+        return NULL;
+    }
+
+    char *ptr = input;
+    for (size_t index = 0; index < count; ++ index) {
+        ptr += sprintf(ptr, index > 0 ? " + %s%zu" : "%s%zu", prefix, index);
+    }
+
+    return input;
+}
+
+// Parameters are found by name through a hash index, which has to survive
+// growing, cloning and clearing the bytecode.
+size_t test_bytecode_params(void) {
+    struct Bytecode bytecode = BYTECODE_INIT();
+    struct Bytecode clone = BYTECODE_INIT();
+    char *input = make_param_sum("param_test_", PARAM_TEST_COUNT);
+    size_t error_count = 0;
+    char name[32];
+
+    if (input == NULL) {
+        fprintf(stderr, "*** Error creating parameter test input: %s\n", strerror(errno));
+        return 1;
+    }
+
+    for (int single_pass = 0; single_pass < 2; ++ single_pass) {
+        const char *compiler = single_pass ? "single pass" : "AST";
+        bool ok;
+        if (single_pass) {
+            ok = bytecode_compile_source(&bytecode, &symbol_table, input, NULL);
+        } else {
+            struct AstNode *expr = fast_parse(&symbol_table, input, NULL);
+            ok = expr != NULL && bytecode_compile(&bytecode, expr);
+            ast_free(expr);
+        }
+
+        int *params = ok ? bytecode_alloc_params(&bytecode) : NULL;
+        int *stack  = ok ? bytecode_alloc_stack(&bytecode) : NULL;
+        if (params == NULL || stack == NULL) {
+            fprintf(stderr, "*** [%s] Error compiling %d parameters: %s\n", compiler, PARAM_TEST_COUNT, strerror(errno));
+            ++ error_count;
+            free(params);
+            free(stack);
+            break;
+        }
+
+        if (bytecode.params_size != PARAM_TEST_COUNT) {
+            fprintf(stderr, "*** [%s] %zu instead of %d parameters\n", compiler, bytecode.params_size, PARAM_TEST_COUNT);
+            ++ error_count;
+        }
+
+        int expected = 0;
+        for (size_t index = 0; index < PARAM_TEST_COUNT; ++ index) {
+            snprintf(name, sizeof(name), "param_test_%zu", index);
+            if (bytecode_get_param_index(&bytecode, name) != (ptrdiff_t)index ||
+                !bytecode_set_param(&bytecode, params, name, (int)index * 3)) {
+                fprintf(stderr, "*** [%s] Wrong index for parameter %s\n", compiler, name);
+                ++ error_count;
+                break;
+            }
+            expected += (int)index * 3;
+        }
+
+        const int result = bytecode_execute(&bytecode, params, stack);
+        if (result != expected) {
+            fprintf(stderr, "*** [%s] Result %d instead of %d with %d parameters\n", compiler, result, expected, PARAM_TEST_COUNT);
+            ++ error_count;
+        }
+
+        // interned, but no parameter
+        if (bytecode_get_param_index(&bytecode, "symbol_test_0") != -1 ||
+            bytecode_get_param_index(&bytecode, "param_test_never_interned") != -1 ||
+            bytecode_set_param(&bytecode, params, "symbol_test_0", 1)) {
+            fprintf(stderr, "*** [%s] Found a parameter that isn't one\n", compiler);
+            ++ error_count;
+        }
+
+        if (!bytecode_clone(&bytecode, &clone)) {
+            fprintf(stderr, "*** [%s] Error cloning bytecode: %s\n", compiler, strerror(errno));
+            ++ error_count;
+        } else if (
+            bytecode_get_param_index(&clone, "param_test_0") != 0 ||
+            bytecode_get_param_index(&clone, "param_test_2999") != 2999
+        ) {
+            fprintf(stderr, "*** [%s] Cloned bytecode lost its parameters\n", compiler);
+            ++ error_count;
+        }
+        bytecode_free(&clone);
+
+        free(params);
+        free(stack);
+
+        // compiling into cleared bytecode starts over with the parameters
+        bytecode_clear(&bytecode);
+        if (!bytecode_compile_source(&bytecode, &symbol_table, "param_test_7 * param_test_3", NULL) ||
+            bytecode_get_param_index(&bytecode, "param_test_0") != -1 ||
+            bytecode_get_param_index(&bytecode, "param_test_7") != 0 ||
+            bytecode_get_param_index(&bytecode, "param_test_3") != 1) {
+            fprintf(stderr, "*** [%s] Cleared bytecode kept its parameters\n", compiler);
+            ++ error_count;
+        }
+        bytecode_clear(&bytecode);
+    }
+
+    bytecode_free(&bytecode);
+    free(input);
+
+    return error_count;
+}
+
+// Compiling and binding an expression with many distinct parameters, like
+// rules over wide records.
+int bench_param_binding(void) {
+    struct Bytecode bytecode = BYTECODE_INIT();
+    struct Closure closure = CLOSURE_INIT();
+    struct Regcode regcode = REGCODE_INIT();
+    struct FlatAst flat_ast = FLAT_AST_INIT();
+    struct timespec *times = calloc(5 * PARAM_BENCH_ITERS, sizeof(struct timespec));
+    char *input = make_param_sum("param_bench_", PARAM_BENCH_COUNT);
+    struct AstNode *expr = input != NULL ? fast_parse(&symbol_table, input, NULL) : NULL;
+    char (*names)[32] = calloc(PARAM_BENCH_COUNT, sizeof(*names));
+    int *params = NULL;
+    int status = 1;
+
+    printf("\nBenchmarking compiling and binding %d parameters with %d iterations:\n\n",
+        PARAM_BENCH_COUNT, PARAM_BENCH_ITERS);
+
+    if (times == NULL || expr == NULL || names == NULL) {
+        perror("allocating parameter benchmark");
+        goto cleanup;
+    }
+
+    for (size_t index = 0; index < PARAM_BENCH_COUNT; ++ index) {
+        snprintf(names[index], sizeof(names[index]), "param_bench_%zu", index);
+    }
+
+    for (size_t iter = 0; iter < PARAM_BENCH_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        bytecode_clear(&bytecode);
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        bool ok = bytecode_compile(&bytecode, expr);
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+
+        if (!ok) {
+            perror("bytecode_compile()");
+            goto cleanup;
+        }
+        times[iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    params = bytecode_alloc_params(&bytecode);
+    if (params == NULL) {
+        perror("bytecode_alloc_params()");
+        goto cleanup;
+    }
+
+    for (size_t iter = 0; iter < PARAM_BENCH_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        bool ok = true;
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t index = 0; index < PARAM_BENCH_COUNT; ++ index) {
+            ok &= bytecode_set_param(&bytecode, params, names[index], (int)iter);
+        }
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+
+        if (!ok) {
+            fprintf(stderr, "*** Error binding benchmark parameters\n");
+            goto cleanup;
+        }
+        times[PARAM_BENCH_ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // the other compilers look up the parameter index of every variable too
+    for (size_t iter = 0; iter < PARAM_BENCH_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        bool ok = closure_compile(&closure, expr);
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+
+        if (!ok) {
+            perror("closure_compile()");
+            goto cleanup;
+        }
+        times[2 * PARAM_BENCH_ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    for (size_t iter = 0; iter < PARAM_BENCH_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        regcode_clear(&regcode);
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        bool ok = regcode_compile(&regcode, expr);
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+
+        if (!ok) {
+            perror("regcode_compile()");
+            goto cleanup;
+        }
+        times[3 * PARAM_BENCH_ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    for (size_t iter = 0; iter < PARAM_BENCH_ITERS; ++ iter) {
+        struct timespec ts_start, ts_end;
+        flat_ast_clear(&flat_ast);
+        int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        bool ok = flat_ast_from_ast(&flat_ast, expr);
+        int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+
+        if (!ok) {
+            perror("flat_ast_from_ast()");
+            goto cleanup;
+        }
+        times[4 * PARAM_BENCH_ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    struct Stats stats[5] = {
+        make_stats(times, PARAM_BENCH_ITERS),
+        make_stats(times + PARAM_BENCH_ITERS, PARAM_BENCH_ITERS),
+        make_stats(times + 2 * PARAM_BENCH_ITERS, PARAM_BENCH_ITERS),
+        make_stats(times + 3 * PARAM_BENCH_ITERS, PARAM_BENCH_ITERS),
+        make_stats(times + 4 * PARAM_BENCH_ITERS, PARAM_BENCH_ITERS),
+    };
+    struct Stats stats_max = max_stats(stats, 5);
+
+    printf("Parameter benchmark result:\n");
+    print_bench_header(17);
+    print_bench("compile",           17, &stats[0], &stats_max);
+    print_bench("bind by name",      17, &stats[1], &stats_max);
+    print_bench("closure compile",   17, &stats[2], &stats_max);
+    print_bench("regcode compile",   17, &stats[3], &stats_max);
+    print_bench("flat ast from ast", 17, &stats[4], &stats_max);
+
+    status = 0;
+
+cleanup:
+    bytecode_free(&bytecode);
+    closure_free(&closure);
+    regcode_free(&regcode);
+    flat_ast_free(&flat_ast);
+    ast_free(expr);
+    free(input);
+    free(names);
+    free(params);
+    free(times);
+
+    return status;
+}
+
+// Tokenizing up front versus scanning while parsing. The token array is
+// reused, so the rows with it don't include allocating it.
+#define TOKEN_ARRAY_COUNT 6
+
+// Tokenizes input TOKENIZER_BULK_ITERS times, *token_count gets the number of
+// tokens without TOK_EOF.
+bool bench_bulk_tokenizer(const char *input, struct timespec *times, size_t *token_count) {
+    struct timespec ts_start, ts_end;
+    int res_start, res_end;
+
+    for (size_t iter = 0; iter < TOKENIZER_BULK_ITERS; ++ iter) {
+        struct Tokenizer tokenizer = TOKENIZER_INIT(input);
+        size_t count = 0;
+
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (enum TokenType token = next_token(&tokenizer); token != TOK_EOF; token = next_token(&tokenizer)) {
+            if (token_is_error(token)) {
+                fprintf(stderr, "*** Error tokenizing bulk input at %zu\n", tokenizer.token_pos);
+                return false;
+            }
+            ++ count;
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        times[iter] = timespec_sub(ts_end, ts_start);
+        *token_count = count;
+        tokenizer_free(&tokenizer);
+    }
+
+    return true;
+}
+
+int bench_token_array(void) {
+    struct Arena arena = ARENA_INIT();
+    struct TokenArray tokens = TOKEN_ARRAY_INIT();
+    struct TokenArray *all_tokens = NULL;
+    struct timespec *times = calloc(TOKEN_ARRAY_COUNT * TOKEN_ARRAY_ITERS, sizeof(struct timespec));
+    size_t test_count = 0;
+    int status = 1;
+
+    printf("\nBenchmarking parsing from token arrays with %d iterations:\n\n", TOKEN_ARRAY_ITERS);
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+        ++ test_count;
+    }
+
+    all_tokens = calloc(test_count, sizeof(struct TokenArray));
+    if (times == NULL || all_tokens == NULL) {
+        perror("allocating token array benchmark");
+        goto cleanup;
+    }
+
+    for (size_t index = 0; index < test_count; ++ index) {
+        if (!token_array_tokenize(&all_tokens[index], TESTS[index].expr)) {
+            perror("token_array_tokenize()");
+            goto cleanup;
+        }
+    }
+
+    for (size_t index = 0; index < TOKEN_ARRAY_COUNT; ++ index) {
+        const bool fast = index >= TOKEN_ARRAY_COUNT / 2;
+        const size_t mode = index % (TOKEN_ARRAY_COUNT / 2);
+
+        for (size_t iter = 0; iter < TOKEN_ARRAY_ITERS; ++ iter) {
+            struct timespec ts_start, ts_end;
+            int res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+            for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+                const char *input = TESTS[test_index].expr;
+                struct AstNode *expr = NULL;
+
+                if (mode == 0) {
+                    // scan while parsing
+                    expr = fast ? fast_parse_in(&arena, &symbol_table, input, NULL) : parse_in(&arena, &symbol_table, input, NULL);
+                } else if (mode == 1) {
+                    // tokenize, then parse
+                    if (token_array_tokenize(&tokens, input)) {
+                        expr = fast ?
+                            fast_parse_tokens_in(&arena, &symbol_table, &tokens, NULL) :
+                            parse_tokens_in(&arena, &symbol_table, &tokens, NULL);
+                    }
+                } else {
+                    // parse only, tokenized before
+                    expr = fast ?
+                        fast_parse_tokens_in(&arena, &symbol_table, &all_tokens[test_index], NULL) :
+                        parse_tokens_in(&arena, &symbol_table, &all_tokens[test_index], NULL);
+                }
+
+                if (expr == NULL) {
+                    fprintf(stderr, "*** Error parsing expression: %s\n", input);
+                    goto cleanup;
+                }
+            }
+            arena_reset(&arena);
+            int res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+            assert(res_start == 0); (void)res_start;
+            assert(res_end == 0); (void)res_end;
+            times[index * TOKEN_ARRAY_ITERS + iter] = timespec_sub(ts_end, ts_start);
+        }
+    }
+
+    struct Stats stats[TOKEN_ARRAY_COUNT];
+    for (size_t index = 0; index < TOKEN_ARRAY_COUNT; ++ index) {
+        stats[index] = make_stats(times + index * TOKEN_ARRAY_ITERS, TOKEN_ARRAY_ITERS);
+    }
+    struct Stats stats_max = max_stats(stats, TOKEN_ARRAY_COUNT);
+
+    printf("Token array benchmark result:\n");
+    print_bench_header(32);
+    print_bench("Recursive Descent (scanning)",     32, &stats[0], &stats_max);
+    print_bench("Recursive Descent (tokenize)",     32, &stats[1], &stats_max);
+    print_bench("Recursive Descent (tokens only)",  32, &stats[2], &stats_max);
+    print_bench("Pratt (scanning)",                 32, &stats[3], &stats_max);
+    print_bench("Pratt (tokenize)",                 32, &stats[4], &stats_max);
+    print_bench("Pratt (tokens only)",              32, &stats[5], &stats_max);
+
+    status = 0;
+
+cleanup:
+    if (all_tokens != NULL) {
+        for (size_t index = 0; index < test_count; ++ index) {
+            token_array_free(&all_tokens[index]);
+        }
+    }
+    free(all_tokens);
+    token_array_free(&tokens);
+    arena_free(&arena);
+    free(times);
+
+    return status;
+}
+
+// Prints how often single instructions and sequences of two and three
+// instructions occur in the optimized bytecode of all tests. Sequences don't
+// extend over jump targets, because they couldn't be fused. Unreachable code is
+// skipped.
+#define CENSUS_TOP 16
+
+struct CensusEntry {
+    size_t count;
+    size_t key;
+};
+
+static int census_entry_cmp(const void *lhs, const void *rhs) {
+    const struct CensusEntry *lhs_entry = lhs;
+    const struct CensusEntry *rhs_entry = rhs;
+    return lhs_entry->count < rhs_entry->count ? 1 : lhs_entry->count > rhs_entry->count ? -1 : 0;
+}
+
+bool print_census(FILE *stream) {
+    const size_t sizes[] = { INSTR_COUNT, INSTR_COUNT * INSTR_COUNT, INSTR_COUNT * INSTR_COUNT * INSTR_COUNT };
+    struct CensusEntry *counts[3] = { NULL, NULL, NULL };
+    struct Bytecode bytecode = BYTECODE_INIT();
+    bool *is_target = NULL;
+    size_t is_target_size = 0;
+    size_t totals[3] = { 0, 0, 0 };
+    size_t instrs_bytes = 0;
+    bool ok = false;
+
+    for (size_t n = 0; n < 3; ++ n) {
+        counts[n] = calloc(sizes[n], sizeof(struct CensusEntry));
+        if (counts[n] == NULL) {
+            perror("calloc(sizes[n], sizeof(struct CensusEntry))");
+            goto cleanup;
+        }
+        for (size_t key = 0; key < sizes[n]; ++ key) {
+            counts[n][key].key = key;
+        }
+    }
+
+    for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+        struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+        if (expr == NULL) {
+            perror(test->expr);
+            goto cleanup;
+        }
+
+        struct AstNode *opt_expr = ast_optimize(expr);
+        ast_free(expr);
+        if (opt_expr == NULL) {
+            perror(test->expr);
+            goto cleanup;
+        }
+
+        bool compiled = bytecode_compile(&bytecode, opt_expr) && bytecode_optimize(&bytecode);
+        ast_free(opt_expr);
+        if (!compiled) {
+            perror(test->expr);
+            goto cleanup;
+        }
+
+        instrs_bytes += bytecode.instrs_size * sizeof(*bytecode.instrs);
+
+        if (is_target_size < bytecode.instrs_size) {
+            free(is_target);
+            is_target_size = bytecode.instrs_size;
+            is_target = malloc(is_target_size * sizeof(bool));
+            if (is_target == NULL) {
+                perror("malloc(is_target_size * sizeof(bool))");
+                goto cleanup;
+            }
+        }
+        memset(is_target, 0, bytecode.instrs_size * sizeof(bool));
+
+        for (size_t index = 0; index < bytecode.instrs_size; index += bytecode_instr_size(BYTECODE_INSTR(bytecode.instrs[index]))) {
+            size_t target;
+            if (bytecode_get_jump_target(&bytecode, index, &target)) {
+                is_target[target] = true;
+            }
+        }
+
+        size_t window[3] = { 0, 0, 0 };
+        size_t window_size = 0;
+        bool reachable = true;
+        for (size_t index = 0; index < bytecode.instrs_size; index += bytecode_instr_size(BYTECODE_INSTR(bytecode.instrs[index]))) {
+            if (is_target[index]) {
+                window_size = 0;
+                reachable = true;
+            } else if (!reachable) {
+                // e.g. the padding left by bytecode_optimize()
+                continue;
+            }
+
+            const enum Instr instr = BYTECODE_INSTR(bytecode.instrs[index]);
+            if (instr == INSTR_RET || instr == INSTR_JMP || instr == INSTR_JMP_WIDE || instr == INSTR_RET_INT || instr == INSTR_RET_INT_WIDE || instr == INSTR_RET_VAR) {
+                reachable = false;
+            }
+
+            window[0] = window[1];
+            window[1] = window[2];
+            window[2] = instr;
+            if (window_size < 3) {
+                ++ window_size;
+            }
+
+            // count the sequences of length 1 to 3 that end here
+            for (size_t n = 0; n < window_size; ++ n) {
+                size_t key = 0;
+                for (size_t pos = 2 - n; pos <= 2; ++ pos) {
+                    key = key * INSTR_COUNT + window[pos];
+                }
+                ++ counts[n][key].count;
+                ++ totals[n];
+            }
+        }
+    }
+
+    fprintf(stream, "bytecode size: %zu bytes\n\n", instrs_bytes);
+
+    for (size_t n = 0; n < 3; ++ n) {
+        qsort(counts[n], sizes[n], sizeof(struct CensusEntry), census_entry_cmp);
+
+        fprintf(stream, "%s%zu instruction sequences (%zu total):\n", n > 0 ? "\n" : "", n + 1, totals[n]);
+        for (size_t index = 0; index < CENSUS_TOP && index < sizes[n] && counts[n][index].count > 0; ++ index) {
+            const struct CensusEntry *entry = &counts[n][index];
+            size_t instrs[3];
+            size_t key = entry->key;
+            for (size_t pos = n + 1; pos > 0; -- pos) {
+                instrs[pos - 1] = key % INSTR_COUNT;
+                key /= INSTR_COUNT;
+            }
+
+            fprintf(stream, "%8zu %6.2f %%  ", entry->count, entry->count * 100.0 / totals[n]);
+            for (size_t pos = 0; pos <= n; ++ pos) {
+                fprintf(stream, "%s%s", pos > 0 ? "; " : "", bytecode_instr_name(instrs[pos]));
+            }
+            fputc('\n', stream);
+        }
+    }
+
+    ok = true;
+
+cleanup:
+    for (size_t n = 0; n < 3; ++ n) {
+        free(counts[n]);
+    }
+    free(is_target);
+    bytecode_free(&bytecode);
+
+    return ok;
+}
+
+// Random values in the range of -100 to 100, with a lot of zeros.
+int *batch_random_columns(size_t row_count) {
+    int *values = calloc(BATCH_VAR_COUNT * row_count, sizeof(int));
+    if (values == NULL) {
+        return NULL;
+    }
+
+    uint32_t state = 12345;
+    for (size_t index = 0; index < BATCH_VAR_COUNT * row_count; ++ index) {
+        state = state * 1103515245 + 12345;
+        int value = (int)((state >> 16) % 251) - 125;
+        values[index] = value < -100 || value > 100 ? 0 : value;
+    }
+
+    return values;
+}
+
+// Compiles source and maps the variables a, b, and c to the given columns. The
+// parameters are also stored row by row for bytecode_execute().
+bool batch_item_init(struct BatchItem *item, const char *source, int *const columns[], size_t row_count) {
+    *item = (struct BatchItem){
+        .bytecode   = BYTECODE_INIT(),
+        .params     = NULL,
+        .columns    = NULL,
+        .row_params = NULL,
+        .results    = NULL,
+    };
+
+    struct AstNode *expr = fast_parse(&symbol_table, source, NULL);
+    if (expr == NULL) {
+        return false;
+    }
+
+    struct AstNode *opt_expr = ast_optimize(expr);
+    ast_free(expr);
+    if (opt_expr == NULL) {
+        return false;
+    }
+
+    bool ok = bytecode_compile(&item->bytecode, opt_expr) && bytecode_optimize(&item->bytecode);
+    ast_free(opt_expr);
+    if (!ok) {
+        batch_item_free(item);
+        return false;
+    }
+
+    const size_t params_size = item->bytecode.params_size;
+    item->params     = calloc(params_size + 1, sizeof(int*));
+    item->row_params = calloc(params_size * row_count + 1, sizeof(int));
+    item->results    = calloc(row_count, sizeof(int));
+
+    if (item->params == NULL || item->row_params == NULL || item->results == NULL) {
+        batch_item_free(item);
+        return false;
+    }
+
+    for (size_t param_index = 0; param_index < params_size; ++ param_index) {
+        const char *name = item->bytecode.params[param_index]->name;
+        size_t column_index = (size_t)(name[0] - 'a');
+        if (name[1] != 0 || column_index >= BATCH_VAR_COUNT) {
+            batch_item_free(item);
+            errno = EINVAL;
+            return false;
+        }
+        item->params[param_index] = columns[column_index];
+
+        for (size_t row_index = 0; row_index < row_count; ++ row_index) {
+            item->row_params[row_index * params_size + param_index] = columns[column_index][row_index];
+        }
+    }
+
+    return true;
+}
+
+void batch_item_free(struct BatchItem *item) {
+    bytecode_free(&item->bytecode);
+    free(item->params);
+    free(item->columns);
+    free(item->row_params);
+    free(item->results);
+    item->params     = NULL;
+    item->columns    = NULL;
+    item->row_params = NULL;
+    item->results    = NULL;
+}
+
+// Compares bytecode_execute_batch() with every kernel type supported by the CPU
+// to bytecode_execute() on every row.
+size_t test_batch(const char *source, const struct BatchItem *item, size_t row_count) {
+    const struct Bytecode *bytecode = &item->bytecode;
+    const struct BatchKernels *default_kernels = batch_kernels_get();
+    int *stack = bytecode_alloc_stack(bytecode);
+    int *batch_stack = bytecode_alloc_batch_stack(bytecode);
+    size_t error_count = 0;
+
+    if (stack == NULL || batch_stack == NULL) {
+        fprintf(stderr, "*** Error allocating stack: %s\n", strerror(errno));
+        ++ error_count;
+    } else for (int type = 0; type < BATCH_KERNELS_TYPE_COUNT; ++ type) {
+        if (!batch_kernels_select(type)) {
+            continue;
+        }
+
+        if (!bytecode_execute_batch(bytecode, item->params, row_count, item->results, batch_stack)) {
+            fprintf(stderr, "*** Error in batch execution (%s): %s\nExpression: %s\n",
+                batch_kernels_get()->name, strerror(errno), source);
+            ++ error_count;
+            continue;
+        }
+
+        for (size_t row_index = 0; row_index < row_count; ++ row_index) {
+            const int *params = item->row_params + row_index * bytecode->params_size;
+            int expected = bytecode_execute(bytecode, params, stack);
+            int result = item->results[row_index];
+
+            if (result != expected) {
+                fprintf(stderr, "*** Batch execution (%s) result missmatch in row %zu:\nParameters:\n",
+                    batch_kernels_get()->name, row_index);
+                for (size_t param_index = 0; param_index < bytecode->params_size; ++ param_index) {
+                    fprintf(stderr, "    %s = %d\n", bytecode->params[param_index]->name, params[param_index]);
+                }
+                fprintf(stderr, "Expression:\n    %s\nBytecode:\n", source);
+                bytecode_print(bytecode, stderr);
+                fprintf(stderr,
+                    "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                    result, expected);
+
+                ++ error_count;
+                break;
+            }
+        }
+    }
+
+    batch_kernels_select(default_kernels->type);
+
+    free(stack);
+    free(batch_stack);
+
+    return error_count;
+}
+
+int main(int argc, char *argv[]) {
+    struct ErrorInfo error;
+    struct timespec ts_start, ts_end;
+    int res_start, res_end;
+    size_t error_count = 0;
+    struct Bytecode bytecode = BYTECODE_INIT();
+
+    if (argc > 1 && strcmp(argv[1], "--census") == 0) {
+        return print_census(stdout) ? 0 : 1;
+    }
+
+    for (const struct ParseFunc *func = PARSE_FUNCS; func->name; ++ func) {
+        printf("Testing with %s parser...\n", func->name);
+        for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+            struct AstNode *expr = func->parse(&symbol_table, test->expr, &error);
+            if (expr == NULL) {
+                fprintf(stderr, "*** [%s] Error parsing expression: \"%s\"\n", func->name, test->expr);
+                print_parser_error(stderr, test->expr, &error, 1);
+                ++ error_count;
+            } else {
+                // Test AST interpreter
+                char **environ_bakup = environ;
+                environ = test->environ;
+                int result = ast_execute_with_environ(expr);
+                environ = environ_bakup;
+
+                if (result != test->result) {
+                    fprintf(stderr, "*** [%s] Result missmatch of ast_execute_with_environ():\nEnvironment:\n", func->name);
+                    for (char **ptr = test->environ; *ptr; ++ ptr) {
+                        fprintf(stderr, "    %s\n", *ptr);
+                    }
+                    fprintf(stderr,
+                        "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
+                    ast_print(stderr, expr);
+
+                    if (func->parse != parse) {
+                        struct AstNode *rd_expr = parse(&symbol_table, test->expr, NULL);
+                        if (rd_expr != NULL) {
+                            fprintf(stderr, "\nRD Parser:\n    ");
+                            ast_print(stderr, rd_expr);
+                            ast_free(rd_expr);
+                        }
+                    }
+
+                    fprintf(stderr, "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                        result, test->result);
+
+                    ++ error_count;
+                }
+
+                struct Param *ast_params = ast_params_from_environ(test->environ);
+                size_t ast_params_size = ast_params_len(ast_params);
+                if (ast_params == NULL) {
+                    fprintf(stderr, "[%s] Error creating ast params: %s\n", func->name, strerror(errno));
+                    ++ error_count;
+                } else {
+                    int result = ast_execute_with_params(expr, ast_params, ast_params_size);
+
+                    error_count += test_ast_slots(func->name, test, expr, ast_params, ast_params_size);
+                    error_count += test_specialize(func->name, test, expr, ast_params, ast_params_size);
+                    error_count += test_optimize_ranges(func->name, test, expr, ast_params, ast_params_size);
+
+                    if (result != test->result) {
+                        fprintf(stderr, "*** [%s] Result missmatch of ast_execute_with_params():\nParameters:\n", func->name);
+                        for (const struct Param *param = ast_params; param->name; ++ param) {
+                            fprintf(stderr, "    %s = %d\n", param->name, param->value);
+                        }
+                        fprintf(stderr,
+                            "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
+                        ast_print(stderr, expr);
+                        fprintf(stderr, "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                            result, test->result);
+
+                        ++ error_count;
+                    }
+                }
+
+                // Test bytecode interpreter
+                if (!bytecode_compile(&bytecode, expr)) {
+                    fprintf(stderr, "*** [%s] Error compiling to bytecode: %s\n", func->name, strerror(errno));
+                    fprintf(stderr, "Expression: %s\n", test->expr);
+                    ++ error_count;
+                } else {
+                    int *stack = bytecode_alloc_stack(&bytecode);
+                    if (stack == NULL) {
+                        fprintf(stderr, "*** [%s] Error allocating stack: %s\n", func->name, strerror(errno));
+                        fprintf(stderr, "Expression: %s\n", test->expr);
+                        ++ error_count;
+                    } else {
+                        int *params = bytecode_alloc_params(&bytecode);
+                        if (params == NULL) {
+                            fprintf(stderr, "*** [%s] Error allocating params: %s\n", func->name, strerror(errno));
+                            fprintf(stderr, "Expression: %s\n", test->expr);
+                            ++ error_count;
+                        } else {
+                            if (!params_from_environ(&bytecode, params, test->environ)) {
+                                fprintf(stderr, "*** [%s] Error initializing params: %s\n", func->name, strerror(errno));
+                                fprintf(stderr, "Expression: %s\nEnvironment:\n", test->expr);
+                                for (char **ptr = test->environ; *ptr; ++ ptr) {
+                                    fprintf(stderr, "    %s\n", *ptr);
+                                }
+                                ++ error_count;
+                            } else {
+                                result = bytecode_execute(&bytecode, params, stack);
+
+                                if (result != test->result) {
+                                    fprintf(stderr, "*** [%s] Bytecode execution result missmatch:\nEnvironment:\n", func->name);
+                                    for (char **ptr = test->environ; *ptr; ++ ptr) {
+                                        fprintf(stderr, "    %s\n", *ptr);
+                                    }
+                                    fprintf(stderr, "Expression:\n    %s\nBytecode:\n", test->expr);
+                                    bytecode_print(&bytecode, stderr);
+                                    fprintf(stderr,
+                                        "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                                        result, test->result);
+
+                                    ++ error_count;
+                                }
+
+                                // Test JIT compiled bytecode
+                                error_count += test_jit(func->name, test, &bytecode, params);
+
+                                // Test threaded code
+                                error_count += test_threaded(func->name, test, &bytecode, params);
+
+                                // Test tail call interpreter
+                                error_count += test_tailcall(func->name, test, &bytecode, params);
+
+                                // Test verifier and checked execution
+                                error_count += test_verify(func->name, test, &bytecode, params);
+                            }
+
+                            free(params);
+                        }
+
+                        free(stack);
+                    }
+                }
+
+                bytecode_clear(&bytecode);
+
+                // Test register code interpreter
+                error_count += test_regcode(func->name, test, expr);
+
+                // Test closure compiler
+                error_count += test_closure(func->name, test, expr);
+
+                // Optimizations
+                struct AstNode *opt_expr = ast_optimize(expr);
+                if (opt_expr == NULL) {
+                    fprintf(stderr,
+                        "*** [%s] Error optimizing expression \"%s\": %s\n",
+                        func->name, test->expr, strerror(errno));
+                    ++ error_count;
+                } else {
+                    // Test AST interpreter on optimized AST
+                    environ = test->environ;
+                    int result = ast_execute_with_environ(opt_expr);
+                    environ = environ_bakup;
+                    if (result != test->result) {
+                        fprintf(stderr, "*** [%s] Optimized result missmatch of ast_execute_with_environ():\nEnvironment:\n", func->name);
+                        for (char **ptr = test->environ; *ptr; ++ ptr) {
+                            fprintf(stderr, "    %s\n", *ptr);
+                        }
+                        fprintf(stderr,
+                            "Expression:\n    %s\nOptimized Expression:\n    ",
+                            test->expr);
+                        ast_print(stderr, opt_expr);
+                        fprintf(stderr,
+                            "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                            result, test->result);
+
+                        ++ error_count;
+                    }
+
+                    if (ast_params != NULL) {
+                        int result = ast_execute_with_params(expr, ast_params, ast_params_size);
+
+                        if (result != test->result) {
+                            fprintf(stderr, "*** [%s] Optimized result missmatch of ast_execute_with_params():\nParameters:\n", func->name);
+                            for (const struct Param *param = ast_params; param->name; ++ param) {
+                                fprintf(stderr, "    %s = %d\n", param->name, param->value);
+                            }
+                            fprintf(stderr,
+                                "Expression:\n    %s\nParsed Expression:\n    ", test->expr);
+                            ast_print(stderr, expr);
+                            fprintf(stderr, "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                                result, test->result);
+
+                            ++ error_count;
+                        }
+                    }
+
+                    // Test optimized bytecode interpreter on optimized AST
+                    if (!bytecode_compile(&bytecode, opt_expr)) {
+                        fprintf(stderr, "*** [%s] Error compiling to bytecode: %s\n", func->name, strerror(errno));
+                        fprintf(stderr, "Expression: %s\n", test->expr);
+                        ++ error_count;
+                    } else if (!bytecode_optimize(&bytecode)) {
+                            fprintf(stderr, "*** [%s] Error optimizing bytecode: %s\n", func->name, strerror(errno));
+                            fprintf(stderr, "Expression: %s\n", test->expr);
+                            ++ error_count;
+                    } else {
+                        int *stack = bytecode_alloc_stack(&bytecode);
+                        if (stack == NULL) {
+                            fprintf(stderr, "*** [%s] Error allocating stack: %s\n", func->name, strerror(errno));
+                            fprintf(stderr, "Expression: %s\n", test->expr);
+                            ++ error_count;
+                        } else {
+                            int *params = bytecode_alloc_params(&bytecode);
+                            if (params == NULL) {
+                                fprintf(stderr, "*** [%s] Error allocating params: %s\n", func->name, strerror(errno));
+                                fprintf(stderr, "Expression: %s\n", test->expr);
+                                ++ error_count;
+                            } else {
+                                if (!params_from_environ(&bytecode, params, test->environ)) {
+                                    fprintf(stderr, "*** [%s] Error initializing params: %s\n", func->name, strerror(errno));
+                                    fprintf(stderr, "Expression: %s\nEnvironment:\n", test->expr);
+                                    for (char **ptr = test->environ; *ptr; ++ ptr) {
+                                        fprintf(stderr, "    %s\n", *ptr);
+                                    }
+                                    ++ error_count;
+                                } else {
+                                    result = bytecode_execute(&bytecode, params, stack);
+
+                                    if (result != test->result) {
+                                        fprintf(stderr, "*** [%s] Bytecode execution result missmatch:\nEnvironment:\n", func->name);
+                                        for (char **ptr = test->environ; *ptr; ++ ptr) {
+                                            fprintf(stderr, "    %s\n", *ptr);
+                                        }
+                                        fprintf(stderr,
+                                            "Expression:\n    %s\nOptimized Expression:\n    ",
+                                            test->expr);
+                                        ast_print(stderr, opt_expr);
+                                        fprintf(stderr, "\nOptimized Bytecode:\n");
+                                        bytecode_print(&bytecode, stderr);
+                                        fprintf(stderr,
+                                            "\nResult:\n    %d\nExpected:\n    %d\n\n",
+                                            result, test->result);
+
+                                        ++ error_count;
+                                    }
+
+                                    // Test JIT compiled optimized bytecode
+                                    error_count += test_jit(func->name, test, &bytecode, params);
+
+                                    // Test threaded code of optimized bytecode
+                                    error_count += test_threaded(func->name, test, &bytecode, params);
+
+                                    // Test tail call interpreter on optimized bytecode
+                                    error_count += test_tailcall(func->name, test, &bytecode, params);
+
+                                    // Test verifier and checked execution on optimized bytecode
+                                    error_count += test_verify(func->name, test, &bytecode, params);
+                                }
+
+                                free(params);
+                            }
+
+                            free(stack);
+                        }
+                    }
 
                     bytecode_clear(&bytecode);
+
+                    // Test register code interpreter on optimized AST
+                    error_count += test_regcode(func->name, test, opt_expr);
+
+                    // Test closure compiler on optimized AST
+                    error_count += test_closure(func->name, test, opt_expr);
+
                     ast_free(opt_expr);
                 }
 
@@ -650,6 +4005,129 @@ int main(int argc, char *argv[]) {
 
     bytecode_free(&bytecode);
 
+    printf("Testing batch execution...\n");
+    {
+        int *values = batch_random_columns(BATCH_TEST_ROWS);
+        if (values == NULL) {
+            perror("batch_random_columns(BATCH_TEST_ROWS)");
+            return 1;
+        }
+
+        int *columns[BATCH_VAR_COUNT];
+        for (size_t index = 0; index < BATCH_VAR_COUNT; ++ index) {
+            columns[index] = values + index * BATCH_TEST_ROWS;
+        }
+
+        for (const char **source = BATCH_EXPRS; *source; ++ source) {
+            struct BatchItem item;
+            if (!batch_item_init(&item, *source, columns, BATCH_TEST_ROWS)) {
+                fprintf(stderr, "*** Error preparing batch expression \"%s\": %s\n", *source, strerror(errno));
+                ++ error_count;
+                continue;
+            }
+
+            error_count += test_batch(*source, &item, BATCH_TEST_ROWS);
+            batch_item_free(&item);
+        }
+
+        free(values);
+
+        // every row of a test case uses the same parameters
+        for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+            struct AstNode *expr = fast_parse(&symbol_table, test->expr, NULL);
+            if (expr == NULL || !bytecode_compile(&bytecode, expr)) {
+                fprintf(stderr, "*** Error compiling expression \"%s\": %s\n", test->expr, strerror(errno));
+                ast_free(expr);
+                ++ error_count;
+                continue;
+            }
+            ast_free(expr);
+
+            const size_t params_size = bytecode.params_size;
+            struct BatchItem item = {
+                .bytecode   = bytecode,
+                .params     = calloc(params_size + 1, sizeof(int*)),
+                .columns    = calloc(params_size * BATCH_TEST_ROWS + 1, sizeof(int)),
+                .row_params = calloc(params_size * BATCH_TEST_ROWS + 1, sizeof(int)),
+                .results    = calloc(BATCH_TEST_ROWS, sizeof(int)),
+            };
+            bytecode = (struct Bytecode)BYTECODE_INIT();
+
+            if (item.params == NULL || item.columns == NULL || item.row_params == NULL || item.results == NULL) {
+                perror("allocating batch parameters");
+                batch_item_free(&item);
+                return 1;
+            }
+
+            params_from_environ(&item.bytecode, item.row_params, test->environ);
+            for (size_t row_index = 1; row_index < BATCH_TEST_ROWS; ++ row_index) {
+                memcpy(item.row_params + row_index * params_size, item.row_params, params_size * sizeof(int));
+            }
+
+            for (size_t param_index = 0; param_index < params_size; ++ param_index) {
+                int *column = item.columns + param_index * BATCH_TEST_ROWS;
+                for (size_t row_index = 0; row_index < BATCH_TEST_ROWS; ++ row_index) {
+                    column[row_index] = item.row_params[param_index];
+                }
+                item.params[param_index] = column;
+            }
+
+            error_count += test_batch(test->expr, &item, BATCH_TEST_ROWS);
+            batch_item_free(&item);
+        }
+    }
+
+    printf("Testing bytecode encoding...\n");
+    error_count += test_bytecode_encoding();
+
+    printf("Testing wide jumps and parameter indices...\n");
+    error_count += test_bytecode_wide();
+
+    printf("Testing bytecode verifier...\n");
+    error_count += test_bytecode_verifier();
+
+    printf("Testing multi-expression bytecode...\n");
+    error_count += test_bytecode_multi();
+
+    printf("Testing common subexpression elimination...\n");
+    error_count += test_bytecode_cse();
+
+    printf("Testing arena allocated ASTs...\n");
+    error_count += test_arena_ast();
+
+    printf("Testing bound ASTs...\n");
+    error_count += test_ast_binding();
+
+    printf("Testing environment snapshots...\n");
+    error_count += test_ast_environ();
+
+    printf("Testing specialization...\n");
+    error_count += test_specialize_branches();
+
+    printf("Testing range analysis...\n");
+    error_count += test_range_folding();
+
+    printf("Testing flat ASTs...\n");
+    error_count += test_flat_ast();
+
+    printf("Testing interned symbols...\n");
+    error_count += test_symbols();
+
+    printf("Testing tokenizer runs...\n");
+    error_count += test_tokenizer_runs();
+
+    printf("Testing iterative parser...\n");
+    error_count += test_iterative_parser();
+
+    printf("Testing parsing from token arrays...\n");
+    error_count += test_token_array_parsers();
+
+    printf("Testing single pass bytecode compiler...\n");
+    error_count += test_bytecode_source();
+
+    printf("Testing parameter lookup...\n");
+    error_count += test_bytecode_params();
+
     if (error_count > 0) {
         fprintf(stderr, "%zu errors!\n", error_count);
         return 1;
@@ -700,11 +4178,109 @@ int main(int argc, char *argv[]) {
 
     free(tok_times);
 
+    // all test expressions as one big rule file, one rule per line with some
+    // indentation and comments
+    char *bulk = malloc(TOKENIZER_BULK_SIZE + 1);
+    tok_times = calloc(TOKENIZER_BULK_ITERS, sizeof(struct timespec));
+    if (bulk == NULL || tok_times == NULL) {
+        perror("allocating bulk tokenizer input");
+        free(bulk);
+        free(tok_times);
+        return 1;
+    }
+
+    size_t bulk_size = 0;
+    size_t bulk_tokens = 0;
+    for (const struct TestCase *test = TESTS; bulk_size < TOKENIZER_BULK_SIZE; ++ test) {
+        if (test->expr == NULL) {
+            test = TESTS;
+        }
+        const size_t length = strlen(test->expr);
+        if (bulk_size + length + 32 > TOKENIZER_BULK_SIZE) {
+            break;
+        }
+        memcpy(bulk + bulk_size, "    ", 4);
+        memcpy(bulk + bulk_size + 4, test->expr, length);
+        bulk_size += 4 + length;
+        const char *suffix = (test - TESTS) % 4 == 0 ? " # generated rule\n" : "\n";
+        memcpy(bulk + bulk_size, suffix, strlen(suffix));
+        bulk_size += strlen(suffix);
+    }
+    bulk[bulk_size] = 0;
+
+    if (!bench_bulk_tokenizer(bulk, tok_times, &bulk_tokens)) {
+        free(bulk);
+        free(tok_times);
+        return 1;
+    }
+
+    struct Stats stats_bulk = make_stats(tok_times, TOKENIZER_BULK_ITERS);
+
+    struct TokenArray bulk_array = TOKEN_ARRAY_INIT();
+    for (size_t iter = 0; iter < TOKENIZER_BULK_ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        const bool ok = token_array_tokenize(&bulk_array, bulk);
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+
+        if (!ok || bulk_array.size != bulk_tokens + 1) {
+            fprintf(stderr, "*** Error tokenizing bulk input into a token array\n");
+            token_array_free(&bulk_array);
+            free(bulk);
+            free(tok_times);
+            return 1;
+        }
+        tok_times[iter] = timespec_sub(ts_end, ts_start);
+    }
+    token_array_free(&bulk_array);
+
+    struct Stats stats_bulk_array = make_stats(tok_times, TOKENIZER_BULK_ITERS);
+
+    printf("\nBulk tokenizer benchmark result (%zu bytes, %zu tokens, %d iterations):\n",
+        bulk_size, bulk_tokens, TOKENIZER_BULK_ITERS);
+    print_bench_header_short(11);
+    print_bench("Tokenizer",   11, &stats_bulk, NULL);
+    print_bench("Token array", 11, &stats_bulk_array, NULL);
+
+    // The same size with the long runs the block scan is for: deep
+    // indentation, long names, big numbers and long comments. Compare with a
+    // build with -DMINMATH_NO_SIMD for the gain over the scalar scan.
+    size_t runs_size = 0;
+    size_t runs_tokens = 0;
+    for (size_t index = 0; runs_size + 256 < TOKENIZER_BULK_SIZE; ++ index) {
+        const int length = snprintf(bulk + runs_size, TOKENIZER_BULK_SIZE + 1 - runs_size,
+            "%24s# rule %zu of the generated sensor thresholds, keep in sync with the plant layout\n"
+            "%24smeasured_sensor_temperature_%zu > configured_maximum_temperature_%zu ? 1234567890 : 0\n",
+            "", index, "", index, index);
+        assert(length > 0);
+        runs_size += (size_t)length;
+    }
+
+    if (!bench_bulk_tokenizer(bulk, tok_times, &runs_tokens)) {
+        free(bulk);
+        free(tok_times);
+        return 1;
+    }
+
+    struct Stats stats_runs = make_stats(tok_times, TOKENIZER_BULK_ITERS);
+
+    printf("\nLong runs tokenizer benchmark result (%zu bytes, %zu tokens, %d iterations):\n",
+        runs_size, runs_tokens, TOKENIZER_BULK_ITERS);
+    print_bench_header_short(11);
+    print_bench("Tokenizer", 11, &stats_runs, NULL);
+
+    free(bulk);
+    free(tok_times);
+
     printf("\nBenchmarking parsing with %d iterations:\n\n", ITERS);
 
-#define PARSER_COUNT 2
-#define INDEX_SLOW_PARSER 0
-#define INDEX_FAST_PARSER 1
+#define PARSER_COUNT 5
+#define INDEX_SLOW_PARSER       0
+#define INDEX_FAST_PARSER       1
+#define INDEX_SLOW_PARSER_ARENA 2
+#define INDEX_FAST_PARSER_ARENA 3
+#define INDEX_FAST_PARSER_FLAT  4
 
     struct timespec *parse_times = calloc(PARSER_COUNT * ITERS, sizeof(struct timespec));
     if (parse_times == NULL) {
@@ -715,7 +4291,7 @@ int main(int argc, char *argv[]) {
     for (size_t iter = 0; iter < ITERS; ++ iter) {
         res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
         for (const struct TestCase *test = TESTS; test->expr; ++ test) {
-            struct AstNode *expr = parse(test->expr, &error);
+            struct AstNode *expr = parse(&symbol_table, test->expr, &error);
             if (expr == NULL) {
                 fprintf(stderr, "*** Error parsing expression: %s\n", test->expr);
                 print_parser_error(stderr, test->expr, &error, 1);
@@ -734,7 +4310,7 @@ int main(int argc, char *argv[]) {
     for (size_t iter = 0; iter < ITERS; ++ iter) {
         res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
         for (const struct TestCase *test = TESTS; test->expr; ++ test) {
-            struct AstNode *expr = fast_parse(test->expr, &error);
+            struct AstNode *expr = fast_parse(&symbol_table, test->expr, &error);
             if (expr == NULL) {
                 fprintf(stderr, "*** Error parsing expression: %s\n", test->expr);
                 print_parser_error(stderr, test->expr, &error, 1);
@@ -750,20 +4326,85 @@ int main(int argc, char *argv[]) {
         parse_times[INDEX_FAST_PARSER * ITERS + iter] = timespec_sub(ts_end, ts_start);
     }
 
+    // the same with all trees of an iteration in one arena, released at once
+    struct Arena arena = ARENA_INIT();
+
+    for (size_t parser_index = INDEX_SLOW_PARSER_ARENA; parser_index <= INDEX_FAST_PARSER_ARENA; ++ parser_index) {
+        for (size_t iter = 0; iter < ITERS; ++ iter) {
+            res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+            for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+                struct AstNode *expr = parser_index == INDEX_SLOW_PARSER_ARENA ?
+                    parse_in(&arena, &symbol_table, test->expr, &error) :
+                    fast_parse_in(&arena, &symbol_table, test->expr, &error);
+                if (expr == NULL) {
+                    fprintf(stderr, "*** Error parsing expression: %s\n", test->expr);
+                    print_parser_error(stderr, test->expr, &error, 1);
+                    arena_free(&arena);
+                    free(parse_times);
+                    return 1;
+                }
+            }
+            arena_reset(&arena);
+            res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+            assert(res_start == 0); (void)res_start;
+            assert(res_end == 0); (void)res_end;
+            parse_times[parser_index * ITERS + iter] = timespec_sub(ts_end, ts_start);
+        }
+    }
+
+    arena_free(&arena);
+
+    // flat ASTs, the node arrays are reused by every iteration
+    struct FlatAst flat_ast = FLAT_AST_INIT();
+
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (const struct TestCase *test = TESTS; test->expr; ++ test) {
+            if (!fast_parse_flat(&symbol_table, test->expr, &flat_ast, &error)) {
+                fprintf(stderr, "*** Error parsing expression: %s\n", test->expr);
+                print_parser_error(stderr, test->expr, &error, 1);
+                flat_ast_free(&flat_ast);
+                free(parse_times);
+                return 1;
+            }
+            flat_ast_clear(&flat_ast);
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        parse_times[INDEX_FAST_PARSER_FLAT * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    flat_ast_free(&flat_ast);
+
     struct Stats stats_slow_parser = make_stats(parse_times + INDEX_SLOW_PARSER * ITERS, ITERS);
     struct Stats stats_fast_parser = make_stats(parse_times + INDEX_FAST_PARSER * ITERS, ITERS);
+    struct Stats stats_slow_parser_arena = make_stats(parse_times + INDEX_SLOW_PARSER_ARENA * ITERS, ITERS);
+    struct Stats stats_fast_parser_arena = make_stats(parse_times + INDEX_FAST_PARSER_ARENA * ITERS, ITERS);
+    struct Stats stats_fast_parser_flat  = make_stats(parse_times + INDEX_FAST_PARSER_FLAT * ITERS, ITERS);
     struct Stats stats_parser_max = max_stats((struct Stats[]){
         stats_slow_parser,
         stats_fast_parser,
+        stats_slow_parser_arena,
+        stats_fast_parser_arena,
+        stats_fast_parser_flat,
     }, PARSER_COUNT);
 
     printf("Parser benchmark result:\n");
-    print_bench_header(17);
-    print_bench("Recursive Descent", 17, &stats_slow_parser, &stats_parser_max);
-    print_bench("Pratt",             17, &stats_fast_parser, &stats_parser_max);
+    print_bench_header(25);
+    print_bench("Recursive Descent",         25, &stats_slow_parser,       &stats_parser_max);
+    print_bench("Pratt",                     25, &stats_fast_parser,       &stats_parser_max);
+    print_bench("Recursive Descent (arena)", 25, &stats_slow_parser_arena, &stats_parser_max);
+    print_bench("Pratt (arena)",             25, &stats_fast_parser_arena, &stats_parser_max);
+    print_bench("Pratt (flat)",              25, &stats_fast_parser_flat,  &stats_parser_max);
 
     free(parse_times);
 
+    if (bench_parser_shapes() != 0 || bench_token_array() != 0 || bench_one_shot() != 0 ||
+        bench_param_binding() != 0) {
+        return 1;
+    }
+
     printf("\nBenchmarking execution with %d iterations:\n\n", ITERS);
 
     // Benchmarking optimizations
@@ -774,13 +4415,16 @@ int main(int argc, char *argv[]) {
     }
 
     size_t max_stack_size = 0;
+    size_t max_regs_size = 0;
+    bool has_jit = true;
+    bool has_threaded = true;
     for (size_t index = 0; index < test_count; ++ index) {
         struct OptItem *opt_item = &opt_items[index];
         const struct TestCase *test = &TESTS[index];
 
-        opt_item->expr = fast_parse(test->expr, NULL);
+        opt_item->expr = fast_parse(&symbol_table, test->expr, NULL);
         if (opt_item->expr == NULL) {
-            perror("fast_parse(test->expr, NULL)");
+            perror("fast_parse(&symbol_table, test->expr, NULL)");
             goto opt_init_loop_error;
         }
 
@@ -790,6 +4434,11 @@ int main(int argc, char *argv[]) {
             goto opt_init_loop_error;
         }
 
+        if (!fast_parse_flat(&symbol_table, test->expr, &opt_item->flat_ast, NULL)) {
+            perror("fast_parse_flat(&symbol_table, test->expr, &opt_item->flat_ast, NULL)");
+            goto opt_init_loop_error;
+        }
+
         if (!bytecode_compile(&opt_item->unopt_bytecode, opt_item->expr)) {
             perror("bytecode_compile(&opt_item->unopt_bytecode, opt_item->expr)");
             goto opt_init_loop_error;
@@ -810,6 +4459,39 @@ int main(int argc, char *argv[]) {
             goto opt_init_loop_error;
         }
 
+        if (!bytecode_shrink_to_fit(&opt_item->opt_bytecode)) {
+            perror("bytecode_shrink_to_fit(&opt_item->opt_bytecode)");
+            goto opt_init_loop_error;
+        }
+
+        if (!regcode_compile(&opt_item->regcode, opt_item->opt_expr)) {
+            perror("regcode_compile(&opt_item->regcode, opt_item->opt_expr)");
+            goto opt_init_loop_error;
+        }
+
+        if (!closure_compile(&opt_item->closure, opt_item->opt_expr)) {
+            perror("closure_compile(&opt_item->closure, opt_item->opt_expr)");
+            goto opt_init_loop_error;
+        }
+
+        if (has_threaded && !threaded_compile(&opt_item->threaded, &opt_item->opt_bytecode)) {
+            if (errno != ENOSYS) {
+                perror("threaded_compile(&opt_item->threaded, &opt_item->opt_bytecode)");
+                goto opt_init_loop_error;
+            }
+            fprintf(stderr, "Threaded code is not available: %s\n", strerror(errno));
+            has_threaded = false;
+        }
+
+        if (has_jit && !jit_compile(&opt_item->jit, &opt_item->opt_bytecode)) {
+            if (!jit_is_unavailable(errno)) {
+                perror("jit_compile(&opt_item->jit, &opt_item->opt_bytecode)");
+                goto opt_init_loop_error;
+            }
+            fprintf(stderr, "JIT is not available: %s\n", strerror(errno));
+            has_jit = false;
+        }
+
         opt_item->unopt_params = bytecode_alloc_params(&opt_item->unopt_bytecode);
         if (opt_item->unopt_params == NULL) {
             perror("bytecode_alloc_params(&opt_item->unopt_bytecode)");
@@ -822,6 +4504,22 @@ int main(int argc, char *argv[]) {
             goto opt_init_loop_error;
         }
 
+        opt_item->reg_params = regcode_alloc_params(&opt_item->regcode);
+        if (opt_item->reg_params == NULL) {
+            perror("regcode_alloc_params(&opt_item->regcode)");
+            goto opt_init_loop_error;
+        }
+
+        opt_item->closure_params = closure_alloc_params(&opt_item->closure);
+        if (opt_item->closure_params == NULL && opt_item->closure.params_size > 0) {
+            perror("closure_alloc_params(&opt_item->closure)");
+            goto opt_init_loop_error;
+        }
+
+        if (opt_item->regcode.regs_size > max_regs_size) {
+            max_regs_size = opt_item->regcode.regs_size;
+        }
+
         if (opt_item->unopt_bytecode.stack_size > max_stack_size) {
             max_stack_size = opt_item->unopt_bytecode.stack_size;
         }
@@ -834,6 +4532,11 @@ int main(int argc, char *argv[]) {
             max_stack_size = opt_item->opt_bytecode.stack_size;
         }
 
+        // used as scratch buffer of flat_ast_execute_with_params()
+        if (opt_item->flat_ast.vars_size + opt_item->flat_ast.stack_size > max_stack_size) {
+            max_stack_size = opt_item->flat_ast.vars_size + opt_item->flat_ast.stack_size;
+        }
+
         if (!params_from_environ(&opt_item->unopt_bytecode, opt_item->unopt_params, test->environ)) {
             perror("params_from_environ(&opt_item->unopt_bytecode, opt_item->unopt_params, test->environ)");
             goto opt_init_loop_error;
@@ -844,6 +4547,16 @@ int main(int argc, char *argv[]) {
             goto opt_init_loop_error;
         }
 
+        if (!regcode_params_from_environ(&opt_item->regcode, opt_item->reg_params, test->environ)) {
+            perror("regcode_params_from_environ(&opt_item->regcode, opt_item->reg_params, test->environ)");
+            goto opt_init_loop_error;
+        }
+
+        if (!closure_params_from_environ(&opt_item->closure, opt_item->closure_params, test->environ)) {
+            perror("closure_params_from_environ(&opt_item->closure, opt_item->closure_params, test->environ)");
+            goto opt_init_loop_error;
+        }
+
         opt_item->ast_params = ast_params_from_environ(test->environ);
         if (opt_item->ast_params == NULL) {
             perror("ast_params_from_environ(test->environ)");
@@ -851,20 +4564,30 @@ int main(int argc, char *argv[]) {
         }
         opt_item->ast_params_size = ast_params_len(opt_item->ast_params);
 
+        opt_item->flat_values = calloc(opt_item->flat_ast.vars_size + 1, sizeof(int));
+        if (opt_item->flat_values == NULL) {
+            perror("calloc(opt_item->flat_ast.vars_size + 1, sizeof(int))");
+            goto opt_init_loop_error;
+        }
+        for (size_t var = 0; var < opt_item->flat_ast.vars_size; ++ var) {
+            opt_item->flat_values[var] = params_get(opt_item->ast_params, opt_item->ast_params_size, opt_item->flat_ast.vars[var]->name);
+        }
+
         continue;
     opt_init_loop_error:
         opt_items_free(opt_items, index + 1);
         return 1;
     }
 
-    int *stack = calloc(max_stack_size, sizeof(int));
+    // also used as the register file of the register code
+    int *stack = calloc(MAX(max_stack_size, max_regs_size), sizeof(int));
     if (stack == NULL) {
-        perror("calloc(max_stack_size, sizeof(int))");
+        perror("calloc(MAX(max_stack_size, max_regs_size), sizeof(int))");
         opt_items_free(opt_items, test_count);
         return 1;
     }
 
-#define BENCH_COUNT 7
+#define BENCH_COUNT 16
 #define INDEX_AST_EXECUTE                 0
 #define INDEX_OPT_AST_EXECUTE             1
 #define INDEX_AST_EXECUTE_WITH_PARAMS     2
@@ -872,6 +4595,15 @@ int main(int argc, char *argv[]) {
 #define INDEX_UNOPT_BYTECODE_EXECUTE      4
 #define INDEX_BYTECODE_EXECUTE            5
 #define INDEX_OPT_BYTECODE_EXECUTE        6
+#define INDEX_REGCODE_EXECUTE             7
+#define INDEX_CLOSURE_EXECUTE             8
+#define INDEX_THREADED_EXECUTE            9
+#define INDEX_TAILCALL_EXECUTE           10
+#define INDEX_JIT_EXECUTE                11
+#define INDEX_FLAT_AST_EXECUTE           12
+#define INDEX_AST_EXECUTE_WITH_SLOTS     13
+#define INDEX_AST_EXECUTE_WITH_SNAPSHOT  14
+#define INDEX_FLAT_AST_EXECUTE_WITH_VALUES 15
 
     struct timespec *exec_times = calloc(ITERS * BENCH_COUNT, sizeof(struct timespec));
     if (exec_times == NULL) {
@@ -955,6 +4687,124 @@ int main(int argc, char *argv[]) {
         exec_times[INDEX_AST_EXECUTE_WITH_PARAMS * ITERS + iter] = timespec_sub(ts_end, ts_start);
     }
 
+    // ast_execute_with_snapshot(), the snapshot of each tree is taken once
+    // before
+    for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+        struct OptItem *opt_item = &opt_items[test_index];
+        char **environ_bakup = environ;
+        environ = TESTS[test_index].environ;
+        const bool ok = ast_environ_snapshot(&opt_item->env, opt_item->expr);
+        environ = environ_bakup;
+
+        if (!ok) {
+            fprintf(stderr, "%zu: %s: %s\n", test_index, TESTS[test_index].expr, strerror(errno));
+            opt_items_free(opt_items, test_count);
+            free(stack);
+            free(exec_times);
+            return 1;
+        }
+    }
+
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+
+            int result = ast_execute_with_snapshot(opt_item->expr, &opt_item->env);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_AST_EXECUTE_WITH_SNAPSHOT * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // ast_bind() + ast_execute_with_slots(), binding replaces the slots of
+    // the snapshot
+    for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+        struct OptItem *opt_item = &opt_items[test_index];
+        if (!ast_bind_params(&opt_item->binding, opt_item->expr, opt_item->ast_params, opt_item->ast_params_size, &opt_item->slot_values)) {
+            fprintf(stderr, "%zu: %s: %s\n", test_index, TESTS[test_index].expr, strerror(errno));
+            opt_items_free(opt_items, test_count);
+            free(stack);
+            free(exec_times);
+            return 1;
+        }
+    }
+
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = ast_execute_with_slots(opt_item->expr, opt_item->slot_values);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_AST_EXECUTE_WITH_SLOTS * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // flat_ast_execute_with_params()
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = flat_ast_execute_with_params(&opt_item->flat_ast, opt_item->ast_params, opt_item->ast_params_size, stack);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_FLAT_AST_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // flat_ast_execute() with the variables resolved before
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = flat_ast_execute(&opt_item->flat_ast, opt_item->flat_values, stack);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_FLAT_AST_EXECUTE_WITH_VALUES * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
     // ast_optimize() + ast_execute_with_environ()
     for (size_t iter = 0; iter < ITERS; ++ iter) {
         res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
@@ -1043,6 +4893,116 @@ int main(int argc, char *argv[]) {
         exec_times[INDEX_OPT_BYTECODE_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
     }
 
+    // ast_optimize() + regcode_execute()
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = regcode_execute(&opt_item->regcode, opt_item->reg_params, stack);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_REGCODE_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // ast_optimize() + closure_execute()
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = closure_execute(&opt_item->closure, opt_item->closure_params);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_CLOSURE_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // ast_optimize() + bytecode_optimize() + threaded_execute()
+    for (size_t iter = 0; has_threaded && iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = threaded_execute(&opt_item->threaded, opt_item->params, stack);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_THREADED_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // ast_optimize() + bytecode_optimize() + bytecode_execute_tailcall()
+    for (size_t iter = 0; iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = bytecode_execute_tailcall(&opt_item->opt_bytecode, opt_item->params, stack);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_TAILCALL_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // ast_optimize() + bytecode_optimize() + jit_execute()
+    for (size_t iter = 0; has_jit && iter < ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t test_index = 0; test_index < test_count; ++ test_index) {
+            const struct TestCase *test = &TESTS[test_index];
+            struct OptItem *opt_item = &opt_items[test_index];
+            int result = jit_execute(&opt_item->jit, opt_item->params);
+
+            if (result != test->result) {
+                fprintf(stderr, "%zu: %s -> %d != %d\n", test_index, test->expr, result, test->result);
+                opt_items_free(opt_items, test_count);
+                free(stack);
+                free(exec_times);
+                return 1;
+            }
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        exec_times[INDEX_JIT_EXECUTE * ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
     opt_items_free(opt_items, test_count);
     free(stack);
 
@@ -1050,30 +5010,205 @@ int main(int argc, char *argv[]) {
     struct Stats stats_opt_ast_execute             = make_stats(exec_times + INDEX_OPT_AST_EXECUTE * ITERS, ITERS);
     struct Stats stats_ast_execute_with_params     = make_stats(exec_times + INDEX_AST_EXECUTE_WITH_PARAMS * ITERS, ITERS);
     struct Stats stats_opt_ast_execute_with_params = make_stats(exec_times + INDEX_OPT_AST_EXECUTE_WITH_PARAMS * ITERS, ITERS);
+    struct Stats stats_flat_ast_execute            = make_stats(exec_times + INDEX_FLAT_AST_EXECUTE * ITERS, ITERS);
+    struct Stats stats_flat_ast_execute_with_values = make_stats(exec_times + INDEX_FLAT_AST_EXECUTE_WITH_VALUES * ITERS, ITERS);
+    struct Stats stats_ast_execute_with_slots      = make_stats(exec_times + INDEX_AST_EXECUTE_WITH_SLOTS * ITERS, ITERS);
+    struct Stats stats_ast_execute_with_snapshot   = make_stats(exec_times + INDEX_AST_EXECUTE_WITH_SNAPSHOT * ITERS, ITERS);
     struct Stats stats_unopt_bytecode_execute      = make_stats(exec_times + INDEX_UNOPT_BYTECODE_EXECUTE * ITERS, ITERS);
     struct Stats stats_bytecode_execute            = make_stats(exec_times + INDEX_BYTECODE_EXECUTE * ITERS, ITERS);
     struct Stats stats_opt_bytecode_execute        = make_stats(exec_times + INDEX_OPT_BYTECODE_EXECUTE * ITERS, ITERS);
+    struct Stats stats_regcode_execute             = make_stats(exec_times + INDEX_REGCODE_EXECUTE * ITERS, ITERS);
+    struct Stats stats_closure_execute             = make_stats(exec_times + INDEX_CLOSURE_EXECUTE * ITERS, ITERS);
+    struct Stats stats_threaded_execute            = make_stats(exec_times + INDEX_THREADED_EXECUTE * ITERS, ITERS);
+    struct Stats stats_tailcall_execute            = make_stats(exec_times + INDEX_TAILCALL_EXECUTE * ITERS, ITERS);
+    struct Stats stats_jit_execute                 = make_stats(exec_times + INDEX_JIT_EXECUTE * ITERS, ITERS);
     struct Stats stats_max = max_stats((struct Stats[]){
         stats_ast_execute,
         stats_opt_ast_execute,
         stats_ast_execute_with_params,
         stats_opt_ast_execute_with_params,
+        stats_flat_ast_execute,
+        stats_ast_execute_with_slots,
+        stats_ast_execute_with_snapshot,
         stats_unopt_bytecode_execute,
         stats_bytecode_execute,
         stats_opt_bytecode_execute,
-    }, BENCH_COUNT);
+        stats_regcode_execute,
+        stats_closure_execute,
+        stats_threaded_execute,
+        stats_tailcall_execute,
+        stats_flat_ast_execute_with_values,
+        stats_jit_execute,
+    }, has_jit ? BENCH_COUNT : BENCH_COUNT - 1);
 
     printf("Execution benchmark result:\n");
     print_bench_header(32);
     print_bench("ast with environ",                 32, &stats_ast_execute,                 &stats_max);
     print_bench("optimized ast with environ",       32, &stats_opt_ast_execute,             &stats_max);
+    print_bench("ast with environ snapshot",        32, &stats_ast_execute_with_snapshot,   &stats_max);
     print_bench("ast with params",                  32, &stats_ast_execute_with_params,     &stats_max);
     print_bench("optimized ast with params",        32, &stats_opt_ast_execute_with_params, &stats_max);
+    print_bench("flat ast with params",             32, &stats_flat_ast_execute,            &stats_max);
+    print_bench("flat ast with resolved values",    32, &stats_flat_ast_execute_with_values, &stats_max);
+    print_bench("ast with bound slots",             32, &stats_ast_execute_with_slots,      &stats_max);
     print_bench("bytecode",                         32, &stats_unopt_bytecode_execute,      &stats_max);
     print_bench("optimized ast+bytecode",           32, &stats_bytecode_execute,            &stats_max);
     print_bench("optimized ast+optimized bytecode", 32, &stats_opt_bytecode_execute,        &stats_max);
+    print_bench("optimized ast+tail call bytecode", 32, &stats_tailcall_execute,            &stats_max);
+    print_bench("optimized ast+register code",      32, &stats_regcode_execute,             &stats_max);
+    print_bench("optimized ast+closures",           32, &stats_closure_execute,             &stats_max);
+    if (has_threaded) {
+        print_bench("optimized ast+threaded code",  32, &stats_threaded_execute,            &stats_max);
+    }
+    if (has_jit) {
+        print_bench("optimized ast+jit",            32, &stats_jit_execute,                 &stats_max);
+    }
 
     free(exec_times);
 
-    return 0;
+    // Benchmarking batch execution
+    printf("\nBenchmarking batch execution of %d rows with %d iterations:\n\n", BATCH_ROWS, BATCH_ITERS);
+
+    const size_t batch_expr_count = sizeof(BATCH_EXPRS) / sizeof(BATCH_EXPRS[0]) - 1;
+    struct BatchItem *batch_items = calloc(batch_expr_count, sizeof(struct BatchItem));
+    int *batch_values = batch_random_columns(BATCH_ROWS);
+    struct timespec *batch_times = calloc(BATCH_ITERS * (1 + BATCH_KERNELS_TYPE_COUNT), sizeof(struct timespec));
+    int *batch_stack = NULL;
+    size_t max_batch_stack_size = 0;
+
+    if (batch_items == NULL || batch_values == NULL || batch_times == NULL) {
+        perror("allocating batch benchmark");
+        free(batch_items);
+        free(batch_values);
+        free(batch_times);
+        return 1;
+    }
+
+    int *batch_columns[BATCH_VAR_COUNT];
+    for (size_t index = 0; index < BATCH_VAR_COUNT; ++ index) {
+        batch_columns[index] = batch_values + index * BATCH_ROWS;
+    }
+
+    for (size_t expr_index = 0; expr_index < batch_expr_count; ++ expr_index) {
+        if (!batch_item_init(&batch_items[expr_index], BATCH_EXPRS[expr_index], batch_columns, BATCH_ROWS)) {
+            perror(BATCH_EXPRS[expr_index]);
+            for (size_t index = 0; index < expr_index; ++ index) {
+                batch_item_free(&batch_items[index]);
+            }
+            free(batch_items);
+            free(batch_values);
+            free(batch_times);
+            return 1;
+        }
+        max_batch_stack_size = MAX(max_batch_stack_size, batch_items[expr_index].bytecode.stack_size);
+    }
+
+    // enough for bytecode_execute() too
+    batch_stack = calloc(max_batch_stack_size * BYTECODE_BATCH_SIZE * BYTECODE_BATCH_FRAMES, sizeof(int));
+    if (batch_stack == NULL) {
+        perror("allocating batch stack");
+        for (size_t index = 0; index < batch_expr_count; ++ index) {
+            batch_item_free(&batch_items[index]);
+        }
+        free(batch_items);
+        free(batch_values);
+        free(batch_times);
+        return 1;
+    }
+
+#define INDEX_ROW_EXECUTE   0
+#define INDEX_BATCH_EXECUTE 1
+
+    const struct BatchKernels *default_kernels = batch_kernels_get();
+    int checksum_rows = 0;
+    int checksum_batch[BATCH_KERNELS_TYPE_COUNT] = { 0 };
+    bool has_kernels[BATCH_KERNELS_TYPE_COUNT] = { false };
+
+    // bytecode_execute() row by row
+    for (size_t iter = 0; iter < BATCH_ITERS; ++ iter) {
+        res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+        for (size_t expr_index = 0; expr_index < batch_expr_count; ++ expr_index) {
+            struct BatchItem *item = &batch_items[expr_index];
+            const size_t params_size = item->bytecode.params_size;
+            for (size_t row_index = 0; row_index < BATCH_ROWS; ++ row_index) {
+                item->results[row_index] = bytecode_execute(&item->bytecode, item->row_params + row_index * params_size, batch_stack);
+            }
+            checksum_rows += item->results[BATCH_ROWS - 1];
+        }
+        res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+        assert(res_start == 0); (void)res_start;
+        assert(res_end == 0); (void)res_end;
+        batch_times[INDEX_ROW_EXECUTE * BATCH_ITERS + iter] = timespec_sub(ts_end, ts_start);
+    }
+
+    // bytecode_execute_batch() with every supported kernel type
+    for (int type = 0; type < BATCH_KERNELS_TYPE_COUNT; ++ type) {
+        if (!batch_kernels_select(type)) {
+            continue;
+        }
+        has_kernels[type] = true;
+
+        for (size_t iter = 0; iter < BATCH_ITERS; ++ iter) {
+            res_start = clock_gettime(CLOCK_MONOTONIC, &ts_start);
+            for (size_t expr_index = 0; expr_index < batch_expr_count; ++ expr_index) {
+                struct BatchItem *item = &batch_items[expr_index];
+                if (!bytecode_execute_batch(&item->bytecode, item->params, BATCH_ROWS, item->results, batch_stack)) {
+                    perror(BATCH_EXPRS[expr_index]);
+                    break;
+                }
+                checksum_batch[type] += item->results[BATCH_ROWS - 1];
+            }
+            res_end = clock_gettime(CLOCK_MONOTONIC, &ts_end);
+            assert(res_start == 0); (void)res_start;
+            assert(res_end == 0); (void)res_end;
+            batch_times[(INDEX_BATCH_EXECUTE + type) * BATCH_ITERS + iter] = timespec_sub(ts_end, ts_start);
+        }
+    }
+    batch_kernels_select(default_kernels->type);
+
+    for (size_t index = 0; index < batch_expr_count; ++ index) {
+        batch_item_free(&batch_items[index]);
+    }
+    free(batch_items);
+    free(batch_values);
+    free(batch_stack);
+
+    for (int type = 0; type < BATCH_KERNELS_TYPE_COUNT; ++ type) {
+        if (has_kernels[type] && checksum_rows != checksum_batch[type]) {
+            fprintf(stderr, "*** Batch benchmark (%s) checksum missmatch: %d != %d\n",
+                batch_kernels_get_type(type)->name, checksum_batch[type], checksum_rows);
+            free(batch_times);
+            return 1;
+        }
+    }
+
+    struct Stats stats_batch[1 + BATCH_KERNELS_TYPE_COUNT];
+    const char *stats_batch_names[1 + BATCH_KERNELS_TYPE_COUNT];
+    size_t stats_batch_count = 0;
+
+    stats_batch_names[stats_batch_count] = "bytecode row by row";
+    stats_batch[stats_batch_count ++] = make_stats(batch_times + INDEX_ROW_EXECUTE * BATCH_ITERS, BATCH_ITERS);
+
+    char batch_name_buf[BATCH_KERNELS_TYPE_COUNT][32];
+    for (int type = 0; type < BATCH_KERNELS_TYPE_COUNT; ++ type) {
+        if (has_kernels[type]) {
+            snprintf(batch_name_buf[type], sizeof(batch_name_buf[type]), "bytecode batch (%s)", batch_kernels_get_type(type)->name);
+            stats_batch_names[stats_batch_count] = batch_name_buf[type];
+            stats_batch[stats_batch_count ++] = make_stats(batch_times + (INDEX_BATCH_EXECUTE + type) * BATCH_ITERS, BATCH_ITERS);
+        }
+    }
+
+    struct Stats stats_batch_max = max_stats(stats_batch, stats_batch_count);
+
+    printf("Batch execution benchmark result:\n");
+    print_bench_header(32);
+    for (size_t index = 0; index < stats_batch_count; ++ index) {
+        print_bench(stats_batch_names[index], 32, &stats_batch[index], &stats_batch_max);
+    }
+
+    free(batch_times);
+
+    const int status = bench_multi();
+    symbol_table_free(&symbol_table);
+    return status;
 }
@@ -0,0 +1,429 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "threaded.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(MINMATH_ADDRESS_FROM_LABEL)
+#   define MINMATH_ADDRESS_FROM_LABEL
+#endif
+
+#ifdef MINMATH_ADDRESS_FROM_LABEL
+
+#define NEXT_INSTR goto *ip->handler;
+
+// Handlers are only addressable from within this function, so called with
+// ip == NULL it just returns the handler table.
+static int threaded_run(const union ThreadedSlot *ip, const int *params, int *stack, const void *const **handlers) {
+    static const void *const HANDLERS[INSTR_COUNT] = {
+        [INSTR_INT]             = &&DO_INT,
+        [INSTR_VAR]             = &&DO_VAR,
+        [INSTR_ADD]             = &&DO_ADD,
+        [INSTR_SUB]             = &&DO_SUB,
+        [INSTR_MUL]             = &&DO_MUL,
+        [INSTR_DIV]             = &&DO_DIV,
+        [INSTR_MOD]             = &&DO_MOD,
+        [INSTR_BIT_AND]         = &&DO_BIT_AND,
+        [INSTR_BIT_XOR]         = &&DO_BIT_XOR,
+        [INSTR_BIT_OR]          = &&DO_BIT_OR,
+        [INSTR_LT]              = &&DO_LT,
+        [INSTR_LE]              = &&DO_LE,
+        [INSTR_GT]              = &&DO_GT,
+        [INSTR_GE]              = &&DO_GE,
+        [INSTR_EQ]              = &&DO_EQ,
+        [INSTR_NE]              = &&DO_NE,
+        [INSTR_NEG]             = &&DO_NEG,
+        [INSTR_BIT_NEG]         = &&DO_BIT_NEG,
+        [INSTR_NOT]             = &&DO_NOT,
+        [INSTR_JMP]             = &&DO_JMP,
+        [INSTR_JEZ]             = &&DO_JEZ,
+        [INSTR_JNZ]             = &&DO_JNZ,
+        [INSTR_JZP]             = &&DO_JZP,
+        [INSTR_BOOL]            = &&DO_BOOL,
+        [INSTR_LSHIFT]          = &&DO_LSHIFT,
+        [INSTR_RSHIFT]          = &&DO_RSHIFT,
+        [INSTR_RET]             = &&DO_RET,
+
+        [INSTR_ADD_INT]         = &&DO_ADD_INT,
+        [INSTR_SUB_INT]         = &&DO_SUB_INT,
+        [INSTR_MUL_INT]         = &&DO_MUL_INT,
+        [INSTR_DIV_INT]         = &&DO_DIV_INT,
+        [INSTR_MOD_INT]         = &&DO_MOD_INT,
+        [INSTR_BIT_AND_INT]     = &&DO_BIT_AND_INT,
+        [INSTR_BIT_XOR_INT]     = &&DO_BIT_XOR_INT,
+        [INSTR_BIT_OR_INT]      = &&DO_BIT_OR_INT,
+        [INSTR_LT_INT]          = &&DO_LT_INT,
+        [INSTR_LE_INT]          = &&DO_LE_INT,
+        [INSTR_GT_INT]          = &&DO_GT_INT,
+        [INSTR_GE_INT]          = &&DO_GE_INT,
+        [INSTR_EQ_INT]          = &&DO_EQ_INT,
+        [INSTR_NE_INT]          = &&DO_NE_INT,
+        [INSTR_LSHIFT_INT]      = &&DO_LSHIFT_INT,
+        [INSTR_RSHIFT_INT]      = &&DO_RSHIFT_INT,
+
+        [INSTR_ADD_VAR]         = &&DO_ADD_VAR,
+        [INSTR_SUB_VAR]         = &&DO_SUB_VAR,
+        [INSTR_MUL_VAR]         = &&DO_MUL_VAR,
+        [INSTR_DIV_VAR]         = &&DO_DIV_VAR,
+        [INSTR_MOD_VAR]         = &&DO_MOD_VAR,
+        [INSTR_BIT_AND_VAR]     = &&DO_BIT_AND_VAR,
+        [INSTR_BIT_XOR_VAR]     = &&DO_BIT_XOR_VAR,
+        [INSTR_BIT_OR_VAR]      = &&DO_BIT_OR_VAR,
+        [INSTR_LT_VAR]          = &&DO_LT_VAR,
+        [INSTR_LE_VAR]          = &&DO_LE_VAR,
+        [INSTR_GT_VAR]          = &&DO_GT_VAR,
+        [INSTR_GE_VAR]          = &&DO_GE_VAR,
+        [INSTR_EQ_VAR]          = &&DO_EQ_VAR,
+        [INSTR_NE_VAR]          = &&DO_NE_VAR,
+        [INSTR_LSHIFT_VAR]      = &&DO_LSHIFT_VAR,
+        [INSTR_RSHIFT_VAR]      = &&DO_RSHIFT_VAR,
+
+        [INSTR_JZP_LT]          = &&DO_JZP_LT,
+        [INSTR_JZP_LE]          = &&DO_JZP_LE,
+        [INSTR_JZP_GT]          = &&DO_JZP_GT,
+        [INSTR_JZP_GE]          = &&DO_JZP_GE,
+        [INSTR_JZP_EQ]          = &&DO_JZP_EQ,
+        [INSTR_JZP_NE]          = &&DO_JZP_NE,
+        [INSTR_JZP_VAR]         = &&DO_JZP_VAR,
+        [INSTR_RET_INT]         = &&DO_RET_INT,
+        [INSTR_RET_VAR]         = &&DO_RET_VAR,
+
+        // the value of a wide constant fits into a slot just as well
+        [INSTR_INT_WIDE]        = &&DO_INT,
+        [INSTR_ADD_INT_WIDE]    = &&DO_ADD_INT,
+        [INSTR_SUB_INT_WIDE]    = &&DO_SUB_INT,
+        [INSTR_MUL_INT_WIDE]    = &&DO_MUL_INT,
+        [INSTR_DIV_INT_WIDE]    = &&DO_DIV_INT,
+        [INSTR_MOD_INT_WIDE]    = &&DO_MOD_INT,
+        [INSTR_BIT_AND_INT_WIDE]= &&DO_BIT_AND_INT,
+        [INSTR_BIT_XOR_INT_WIDE]= &&DO_BIT_XOR_INT,
+        [INSTR_BIT_OR_INT_WIDE] = &&DO_BIT_OR_INT,
+        [INSTR_LT_INT_WIDE]     = &&DO_LT_INT,
+        [INSTR_LE_INT_WIDE]     = &&DO_LE_INT,
+        [INSTR_GT_INT_WIDE]     = &&DO_GT_INT,
+        [INSTR_GE_INT_WIDE]     = &&DO_GE_INT,
+        [INSTR_EQ_INT_WIDE]     = &&DO_EQ_INT,
+        [INSTR_NE_INT_WIDE]     = &&DO_NE_INT,
+        [INSTR_LSHIFT_INT_WIDE] = &&DO_LSHIFT_INT,
+        [INSTR_RSHIFT_INT_WIDE] = &&DO_RSHIFT_INT,
+        [INSTR_RET_INT_WIDE]    = &&DO_RET_INT,
+
+        // so do the parameter indices and jump targets of the other wide forms
+        [INSTR_VAR_WIDE]        = &&DO_VAR,
+        [INSTR_JMP_WIDE]        = &&DO_JMP,
+        [INSTR_JEZ_WIDE]        = &&DO_JEZ,
+        [INSTR_JNZ_WIDE]        = &&DO_JNZ,
+        [INSTR_JZP_WIDE]        = &&DO_JZP,
+
+        [INSTR_LOAD]            = &&DO_LOAD,
+        [INSTR_STORE]           = &&DO_STORE,
+    };
+
+    if (ip == NULL) {
+        *handlers = HANDLERS;
+        return 0;
+    }
+
+    // points behind the top of the stack
+    int *sp = stack;
+
+    NEXT_INSTR
+
+    DO_INT:
+    *sp ++ = ip[1].value;
+    ip += 2;
+    NEXT_INSTR
+
+    DO_VAR:
+    *sp ++ = params[ip[1].index];
+    ip += 2;
+    NEXT_INSTR
+
+// DO_<op> works on the stack, DO_<op>_INT and DO_<op>_VAR take the right hand
+// side from the operand slot.
+#define THREADED_BINARY(NAME, EXPR)                               \
+    DO_ ## NAME:                                                  \
+    { -- sp; int lhs = sp[-1]; int rhs = sp[0]; sp[-1] = (EXPR); } \
+    ++ ip;                                                        \
+    NEXT_INSTR                                                    \
+                                                                  \
+    DO_ ## NAME ## _INT:                                          \
+    { int lhs = sp[-1]; int rhs = ip[1].value; sp[-1] = (EXPR); } \
+    ip += 2;                                                      \
+    NEXT_INSTR                                                    \
+                                                                  \
+    DO_ ## NAME ## _VAR:                                          \
+    { int lhs = sp[-1]; int rhs = params[ip[1].index]; sp[-1] = (EXPR); } \
+    ip += 2;                                                      \
+    NEXT_INSTR
+
+    THREADED_BINARY(ADD,     lhs +  rhs)
+    THREADED_BINARY(SUB,     lhs -  rhs)
+    THREADED_BINARY(MUL,     lhs *  rhs)
+    THREADED_BINARY(DIV,     lhs /  rhs)
+    THREADED_BINARY(MOD,     lhs %  rhs)
+    THREADED_BINARY(BIT_AND, lhs &  rhs)
+    THREADED_BINARY(BIT_XOR, lhs ^  rhs)
+    THREADED_BINARY(BIT_OR,  lhs |  rhs)
+    THREADED_BINARY(LT,      lhs <  rhs)
+    THREADED_BINARY(LE,      lhs <= rhs)
+    THREADED_BINARY(GT,      lhs >  rhs)
+    THREADED_BINARY(GE,      lhs >= rhs)
+    THREADED_BINARY(EQ,      lhs == rhs)
+    THREADED_BINARY(NE,      lhs != rhs)
+    THREADED_BINARY(LSHIFT,  lhs << rhs)
+    THREADED_BINARY(RSHIFT,  lhs >> rhs)
+
+#undef THREADED_BINARY
+
+    DO_NEG:
+    sp[-1] = -sp[-1];
+    ++ ip;
+    NEXT_INSTR
+
+    DO_BIT_NEG:
+    sp[-1] = ~sp[-1];
+    ++ ip;
+    NEXT_INSTR
+
+    DO_NOT:
+    sp[-1] = !sp[-1];
+    ++ ip;
+    NEXT_INSTR
+
+    DO_BOOL:
+    sp[-1] = sp[-1] != 0;
+    ++ ip;
+    NEXT_INSTR
+
+    DO_JMP:
+    ip = ip[1].target;
+    NEXT_INSTR
+
+    DO_JEZ:
+    if (sp[-1]) {
+        -- sp;
+        ip += 2;
+    } else {
+        ip = ip[1].target;
+    }
+    NEXT_INSTR
+
+    DO_JNZ:
+    if (sp[-1]) {
+        sp[-1] = 1;
+        ip = ip[1].target;
+    } else {
+        -- sp;
+        ip += 2;
+    }
+    NEXT_INSTR
+
+    DO_JZP:
+    -- sp;
+    ip = *sp ? ip + 2 : ip[1].target;
+    NEXT_INSTR
+
+#define THREADED_JZP_CMP(NAME, OP)                      \
+    DO_JZP_ ## NAME:                                    \
+    sp -= 2;                                            \
+    ip = sp[0] OP sp[1] ? ip + 2 : ip[1].target;        \
+    NEXT_INSTR
+
+    THREADED_JZP_CMP(LT, <)
+    THREADED_JZP_CMP(LE, <=)
+    THREADED_JZP_CMP(GT, >)
+    THREADED_JZP_CMP(GE, >=)
+    THREADED_JZP_CMP(EQ, ==)
+    THREADED_JZP_CMP(NE, !=)
+
+#undef THREADED_JZP_CMP
+
+    DO_JZP_VAR:
+    ip = params[ip[1].index] ? ip + 3 : ip[2].target;
+    NEXT_INSTR
+
+    // the operand is the index of the temporary in the stack
+    DO_LOAD:
+    *sp ++ = stack[ip[1].index];
+    ip += 2;
+    NEXT_INSTR
+
+    DO_STORE:
+    stack[ip[1].index] = sp[-1];
+    ip += 2;
+    NEXT_INSTR
+
+    DO_RET:
+    assert(sp == stack + 1);
+    return sp[-1];
+
+    DO_RET_INT:
+    assert(sp == stack);
+    return ip[1].value;
+
+    DO_RET_VAR:
+    assert(sp == stack);
+    return params[ip[1].index];
+}
+
+// number of slots of an instruction, 0 for illegal instructions and
+// INSTR_OUT, which has nowhere to write to
+static size_t threaded_instr_slots(enum Instr instr) {
+    switch (instr) {
+        case INSTR_OUT:
+            return 0;
+
+        case INSTR_JZP_VAR:
+            return 3;
+
+        case INSTR_ADD:
+        case INSTR_SUB:
+        case INSTR_MUL:
+        case INSTR_DIV:
+        case INSTR_MOD:
+        case INSTR_BIT_AND:
+        case INSTR_BIT_XOR:
+        case INSTR_BIT_OR:
+        case INSTR_LT:
+        case INSTR_LE:
+        case INSTR_GT:
+        case INSTR_GE:
+        case INSTR_EQ:
+        case INSTR_NE:
+        case INSTR_NEG:
+        case INSTR_BIT_NEG:
+        case INSTR_NOT:
+        case INSTR_BOOL:
+        case INSTR_LSHIFT:
+        case INSTR_RSHIFT:
+        case INSTR_RET:
+            return 1;
+
+        default:
+            return (size_t)instr < INSTR_COUNT ? 2 : 0;
+    }
+}
+
+bool threaded_compile(struct ThreadedCode *code, const struct Bytecode *bytecode) {
+    const void *const *handlers = NULL;
+    const uint32_t *instrs = bytecode->instrs;
+    const size_t instrs_size = bytecode->instrs_size;
+    union ThreadedSlot *slots = NULL;
+    size_t slots_size = 0;
+    bool ok = false;
+
+    threaded_run(NULL, NULL, NULL, &handlers);
+
+    // slot offset of every instruction, SIZE_MAX inside of instructions
+    size_t *offsets = malloc((instrs_size + 1) * sizeof(size_t));
+    if (offsets == NULL) {
+        return false;
+    }
+
+    for (size_t index = 0; index < instrs_size + 1; ++ index) {
+        offsets[index] = SIZE_MAX;
+    }
+
+    for (size_t index = 0; index < instrs_size;) {
+        const enum Instr instr = BYTECODE_INSTR(instrs[index]);
+        const size_t slot_count = threaded_instr_slots(instr);
+        if (slot_count == 0 || bytecode_instr_size(instr) > instrs_size - index) {
+            errno = EINVAL;
+            goto cleanup;
+        }
+        offsets[index] = slots_size;
+        slots_size += slot_count;
+        index += bytecode_instr_size(instr);
+    }
+
+    slots = calloc(slots_size + 1, sizeof(union ThreadedSlot));
+    if (slots == NULL) {
+        goto cleanup;
+    }
+
+    for (size_t index = 0; index < instrs_size; index += bytecode_instr_size(BYTECODE_INSTR(instrs[index]))) {
+        const uint32_t word = instrs[index];
+        const enum Instr instr = BYTECODE_INSTR(word);
+        union ThreadedSlot *slot = slots + offsets[index];
+
+        slot[0].handler = handlers[instr];
+
+        size_t target;
+        if (bytecode_get_jump_target(bytecode, index, &target)) {
+            if (target >= instrs_size || offsets[target] == SIZE_MAX) {
+                errno = EINVAL;
+                goto cleanup;
+            }
+            slot[threaded_instr_slots(instr) - 1].target = slots + offsets[target];
+        }
+
+        if (instr == INSTR_VAR || instr == INSTR_RET_VAR || instr == INSTR_JZP_VAR ||
+                (instr >= INSTR_ADD_VAR && instr <= INSTR_RSHIFT_VAR)) {
+            if (BYTECODE_UARG(word) >= bytecode->params_size) {
+                errno = EINVAL;
+                goto cleanup;
+            }
+            slot[1].index = BYTECODE_UARG(word);
+        } else if (instr == INSTR_VAR_WIDE) {
+            if (instrs[index + 1] >= bytecode->params_size) {
+                errno = EINVAL;
+                goto cleanup;
+            }
+            slot[1].index = instrs[index + 1];
+        } else if (instr == INSTR_LOAD || instr == INSTR_STORE) {
+            if (BYTECODE_UARG(word) >= bytecode->temps_size || bytecode->temps_size > bytecode->stack_size) {
+                errno = EINVAL;
+                goto cleanup;
+            }
+            slot[1].index = bytecode->stack_size - bytecode->temps_size + BYTECODE_UARG(word);
+        } else if (instr >= INSTR_INT_WIDE && instr <= INSTR_RET_INT_WIDE) {
+            slot[1].value = (int32_t)instrs[index + 1];
+        } else if (instr == INSTR_INT || instr == INSTR_RET_INT ||
+                (instr >= INSTR_ADD_INT && instr <= INSTR_RSHIFT_INT)) {
+            slot[1].value = BYTECODE_ARG(word);
+        }
+    }
+
+    threaded_free(code);
+    code->slots = slots;
+    code->slots_size = slots_size;
+    slots = NULL;
+    ok = true;
+
+cleanup:
+    free(offsets);
+    free(slots);
+
+    return ok;
+}
+
+int threaded_execute(const struct ThreadedCode *code, const int *params, int *stack) {
+    return threaded_run(code->slots, params, stack, NULL);
+}
+
+#else
+
+bool threaded_compile(struct ThreadedCode *code, const struct Bytecode *bytecode) {
+    (void)code;
+    (void)bytecode;
+    errno = ENOSYS;
+    return false;
+}
+
+int threaded_execute(const struct ThreadedCode *code, const int *params, int *stack) {
+    (void)code;
+    (void)params;
+    (void)stack;
+    assert(false);
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+void threaded_free(struct ThreadedCode *code) {
+    free(code->slots);
+    code->slots = NULL;
+    code->slots_size = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef MINMATH_THREADED_H__
+#define MINMATH_THREADED_H__
+#pragma once
+
+#include "bytecode.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Direct-threaded code: every instruction starts with the address of its
+// handler, followed by its operands. Jump operands point directly to the
+// target instruction.
+union ThreadedSlot {
+    const void *handler;
+    const union ThreadedSlot *target;
+    size_t index;
+    int value;
+};
+
+struct ThreadedCode {
+    union ThreadedSlot *slots;
+    size_t slots_size;
+};
+
+#define THREADED_CODE_INIT() { \
+    .slots = NULL,             \
+    .slots_size = 0,           \
+}
+
+// Converts bytecode into direct-threaded code. The bytecode stays the portable
+// representation (e.g. for serialization), threaded code is only valid in the
+// running process. Needs computed goto, fails with ENOSYS otherwise.
+bool threaded_compile(struct ThreadedCode *code, const struct Bytecode *bytecode);
+/// params and stack are the same as for bytecode_execute()
+int  threaded_execute(const struct ThreadedCode *code, const int *params, int *stack);
+void threaded_free(struct ThreadedCode *code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,15 +4,160 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
+#include <errno.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__) && !defined(MINMATH_NO_SIMD)
+#   define MINMATH_TOKENIZER_SSE2
+#   include <emmintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define MINMATH_TOKENIZER_SWAR
+#endif
+
+#define IS_SPACE(CH) ((CH) == ' ' || ((CH) >= '\t' && (CH) <= '\r'))
+#define IS_DIGIT(CH) ((CH) >= '0' && (CH) <= '9')
+#define IS_IDENT(CH) (((CH) >= 'a' && (CH) <= 'z') || ((CH) >= 'A' && (CH) <= 'Z') || (CH) == '_' || IS_DIGIT(CH))
+
+enum CharClass {
+    CHAR_CLASS_SPACE,
+    CHAR_CLASS_IDENT,
+    CHAR_CLASS_DIGIT,
+    CHAR_CLASS_COMMENT, // everything but newline
+};
+
+#ifdef MINMATH_TOKENIZER_SSE2
+// bytes that are in [lo, hi], as unsigned compare of ch - lo
+static inline __m128i tokenizer_in_range(__m128i block, char lo, char hi) {
+    const __m128i offset = _mm_add_epi8(block, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(offset, _mm_set1_epi8((char)(0x80 + hi - lo + 1)));
+}
+
+// Bit i is set if byte i of the block is in the class. The terminating zero is
+// in no class.
+static inline uint32_t tokenizer_class_mask(__m128i block, enum CharClass char_class) {
+    __m128i mask;
+    switch (char_class) {
+        case CHAR_CLASS_SPACE:
+            mask = _mm_or_si128(
+                _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                tokenizer_in_range(block, '\t', '\r'));
+            break;
+
+        case CHAR_CLASS_IDENT:
+            // setting bit 5 maps upper case letters to lower case and nothing
+            // else onto letters
+            mask = _mm_or_si128(
+                _mm_or_si128(
+                    tokenizer_in_range(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 'z'),
+                    _mm_cmpeq_epi8(block, _mm_set1_epi8('_'))),
+                tokenizer_in_range(block, '0', '9'));
+            break;
+
+        case CHAR_CLASS_DIGIT:
+            mask = tokenizer_in_range(block, '0', '9');
+            break;
+
+        case CHAR_CLASS_COMMENT:
+            mask = _mm_or_si128(
+                _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+                _mm_cmpeq_epi8(block, _mm_setzero_si128()));
+            return ~(uint32_t)_mm_movemask_epi8(mask) & 0xFFFF;
+
+        default:
+            assert(false);
+            return 0;
+    }
+    return (uint32_t)_mm_movemask_epi8(mask);
+}
+#endif
+
+// Returns the position of the first char at or after pos that is not in the
+// class. Runs are classified 16 bytes at a time with unaligned loads as long
+// as the whole block is before the terminating zero at input[size], the rest
+// is scanned one char at a time. The terminating zero is in no class.
+static inline size_t tokenizer_skip(const char *input, size_t size, size_t pos, enum CharClass char_class) {
+#ifdef MINMATH_TOKENIZER_SSE2
+    while (pos + 16 <= size) {
+        const uint32_t outside = ~tokenizer_class_mask(_mm_loadu_si128((const __m128i*)(input + pos)), char_class) & 0xFFFF;
+        if (outside != 0) {
+            return pos + __builtin_ctz(outside);
+        }
+        pos += 16;
+    }
+#else
+    (void)size;
+#endif
+    char ch = input[pos];
+    switch (char_class) {
+        case CHAR_CLASS_SPACE:
+            while (IS_SPACE(ch)) {
+                ch = input[++ pos];
+            }
+            break;
+
+        case CHAR_CLASS_IDENT:
+            while (IS_IDENT(ch)) {
+                ch = input[++ pos];
+            }
+            break;
+
+        case CHAR_CLASS_DIGIT:
+            while (IS_DIGIT(ch)) {
+                ch = input[++ pos];
+            }
+            break;
+
+        case CHAR_CLASS_COMMENT:
+            while (ch != '\n' && ch != 0) {
+                ch = input[++ pos];
+            }
+            break;
+
+        default:
+            assert(false);
+    }
+    return pos;
+}
+
+// Converts count digits. The arithmetic wraps around like the digit by digit
+// calculation of value * 10 + digit. Eight digits at a time are converted
+// with SWAR: pairs of digits, then pairs of pairs and then the two halves are
+// combined by multiplications within one 64-bit word.
+static inline int tokenizer_parse_digits(const char *digits, size_t count) {
+    uint32_t value = 0;
+#ifdef MINMATH_TOKENIZER_SWAR
+    while (count >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, digits, sizeof(chunk));
+        chunk -= UINT64_C(0x3030303030303030);
+        chunk = (chunk * 10) + (chunk >> 8);
+        chunk = (((chunk & UINT64_C(0x000000FF000000FF)) * (100 + (UINT64_C(1000000) << 32))) +
+                 (((chunk >> 16) & UINT64_C(0x000000FF000000FF)) * (1 + (UINT64_C(10000) << 32)))) >> 32;
+        value = value * 100000000u + (uint32_t)chunk;
+        digits += 8;
+        count  -= 8;
+    }
+#endif
+    for (size_t index = 0; index < count; ++ index) {
+        value = value * 10 + (uint32_t)(digits[index] - '0');
+    }
+    return (int)value;
+}
 
 void tokenizer_free(struct Tokenizer *tokenizer) {
     tokenizer->input = NULL;
+    tokenizer->input_size = 0;
     tokenizer->input_pos = 0;
+    tokenizer->tokens = NULL;
+    tokenizer->token_index = 0;
     tokenizer->token = TOK_EOF;
     tokenizer->value = -1;
     tokenizer->ident_start  = 0;
     tokenizer->ident_length = 0;
+    tokenizer->ident_hash   = 0;
 }
 
 bool token_is_error(enum TokenType token) {
@@ -64,12 +209,48 @@ enum TokenType peek_token(struct Tokenizer *tokenizer) {
     return tokenizer->token;
 }
 
+// reads the next token of tokenizer->tokens, stays on the last one like
+// scanning does at the end of the input
+static inline enum TokenType tokenizer_next_from_array(struct Tokenizer *tokenizer) {
+    const struct TokenArray *tokens = tokenizer->tokens;
+    const size_t index = tokenizer->token_index;
+    assert(index < tokens->size);
+
+    const enum TokenType token = (enum TokenType)tokens->types[index];
+    tokenizer->token_pos = tokens->offsets[index];
+
+    if (token == TOK_INT) {
+        tokenizer->value = tokens->values[index];
+    } else if (token == TOK_IDENT) {
+        tokenizer->ident_start  = tokens->offsets[index];
+        tokenizer->ident_length = tokens->lengths[index];
+        tokenizer->ident_hash   = (uint32_t)tokens->values[index];
+    }
+
+    if (index + 1 < tokens->size) {
+        tokenizer->token_index = index + 1;
+    }
+
+    return tokenizer->token = token;
+}
+
+static inline enum TokenType tokenizer_scan(struct Tokenizer *tokenizer);
+
 enum TokenType next_token(struct Tokenizer *tokenizer) {
     if (tokenizer->peeked) {
         tokenizer->peeked = false;
         return tokenizer->token;
     }
 
+    if (tokenizer->tokens != NULL) {
+        return tokenizer_next_from_array(tokenizer);
+    }
+
+    return tokenizer_scan(tokenizer);
+}
+
+// scans the next token of tokenizer->input
+static inline enum TokenType tokenizer_scan(struct Tokenizer *tokenizer) {
     // One could cache fields of the tokenizer as locals like this and only
     // update them on return, but apparently the compiler does that already
     // better than doing it manually:
@@ -80,12 +261,14 @@ enum TokenType next_token(struct Tokenizer *tokenizer) {
 
     // skip whitespace and comments
     for (;;) {
-        // skip whitespace
-        // no decernable speed difference between these two ways of writing this condition
-        while (ch == ' ' || (ch >= '\t' && ch <= '\r')) {
-        // while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r') {
+        // skip whitespace, single spaces between tokens are the common case
+        if (IS_SPACE(ch)) {
             tokenizer->input_pos ++;
             ch = tokenizer->input[tokenizer->input_pos];
+            if (IS_SPACE(ch)) {
+                tokenizer->input_pos = tokenizer_skip(tokenizer->input, tokenizer->input_size, tokenizer->input_pos, CHAR_CLASS_SPACE);
+                ch = tokenizer->input[tokenizer->input_pos];
+            }
         }
 
         if (ch == 0) {
@@ -98,12 +281,8 @@ enum TokenType next_token(struct Tokenizer *tokenizer) {
         }
 
         // skip comment
-        tokenizer->input_pos ++;
+        tokenizer->input_pos = tokenizer_skip(tokenizer->input, tokenizer->input_size, tokenizer->input_pos + 1, CHAR_CLASS_COMMENT);
         ch = tokenizer->input[tokenizer->input_pos];
-        while (ch != '\n' && ch != 0) {
-            tokenizer->input_pos ++;
-            ch = tokenizer->input[tokenizer->input_pos];
-        }
     }
 
     tokenizer->token_pos = tokenizer->input_pos;
@@ -115,16 +294,12 @@ enum TokenType next_token(struct Tokenizer *tokenizer) {
             char op = ch;
             tokenizer->input_pos ++;
             ch = tokenizer->input[tokenizer->input_pos];
-            if (ch >= '0' && ch <= '9') {
-                int value = 0;
-                while (ch >= '0' && ch <= '9') {
-                    value *= 10;
-                    value += ch - '0';
-                    tokenizer->input_pos ++;
-                    ch = tokenizer->input[tokenizer->input_pos];
-                }
+            if (IS_DIGIT(ch)) {
+                size_t start_pos = tokenizer->input_pos;
+                tokenizer->input_pos = tokenizer_skip(tokenizer->input, tokenizer->input_size, start_pos + 1, CHAR_CLASS_DIGIT);
+                int value = tokenizer_parse_digits(tokenizer->input + start_pos, tokenizer->input_pos - start_pos);
                 if (op == '-') {
-                    value = -value;
+                    value = (int)-(unsigned int)value;
                 }
                 tokenizer->value = value;
                 return tokenizer->token = TOK_INT;
@@ -226,14 +401,18 @@ enum TokenType next_token(struct Tokenizer *tokenizer) {
         case 'z': case 'Z':
         case '_':
         {
+            // find the end first, so hashing doesn't need to classify chars
             size_t start_pos = tokenizer->input_pos;
-            do {
-                tokenizer->input_pos ++;
-                ch = tokenizer->input[tokenizer->input_pos];
-            } while ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || (ch >= '0' && ch <= '9'));
+            tokenizer->input_pos = tokenizer_skip(tokenizer->input, tokenizer->input_size, start_pos + 1, CHAR_CLASS_IDENT);
+
+            uint32_t hash = SYMBOL_HASH_INIT;
+            for (size_t pos = start_pos; pos < tokenizer->input_pos; ++ pos) {
+                hash = SYMBOL_HASH_STEP(hash, tokenizer->input[pos]);
+            }
 
             tokenizer->ident_start  = start_pos;
             tokenizer->ident_length = tokenizer->input_pos - start_pos;
+            tokenizer->ident_hash   = hash;
 
             return tokenizer->token = TOK_IDENT;
         }
@@ -248,16 +427,9 @@ enum TokenType next_token(struct Tokenizer *tokenizer) {
         case '8':
         case '9':
         {
-            int value = ch - '0';
-            tokenizer->input_pos ++;
-            ch = tokenizer->input[tokenizer->input_pos];
-            while (ch >= '0' && ch <= '9') {
-                value *= 10;
-                value += ch - '0';
-                tokenizer->input_pos ++;
-                ch = tokenizer->input[tokenizer->input_pos];
-            }
-            tokenizer->value = value;
+            size_t start_pos = tokenizer->input_pos;
+            tokenizer->input_pos = tokenizer_skip(tokenizer->input, tokenizer->input_size, start_pos + 1, CHAR_CLASS_DIGIT);
+            tokenizer->value = tokenizer_parse_digits(tokenizer->input + start_pos, tokenizer->input_pos - start_pos);
             return tokenizer->token = TOK_INT;
         }
         default:
@@ -276,3 +448,110 @@ char *tokenizer_get_ident(const struct Tokenizer *tokenizer) {
     ident[len] = 0;
     return ident;
 }
+
+const struct Symbol *tokenizer_get_symbol(const struct Tokenizer *tokenizer, struct SymbolTable *table) {
+    assert(tokenizer->token == TOK_IDENT);
+    return symbol_intern_hashed(
+        table,
+        tokenizer->input + tokenizer->ident_start,
+        tokenizer->ident_length,
+        tokenizer->ident_hash);
+}
+
+static bool token_array_grow(struct TokenArray *tokens) {
+    size_t new_capacity;
+    if (tokens->capacity == 0) {
+        new_capacity = 64;
+    } else if (tokens->capacity > SIZE_MAX / 2 / sizeof(size_t)) {
+        errno = ENOMEM;
+        return false;
+    } else {
+        new_capacity = tokens->capacity * 2;
+    }
+
+    int16_t *types = realloc(tokens->types, new_capacity * sizeof(int16_t));
+    if (types == NULL) {
+        return false;
+    }
+    tokens->types = types;
+
+    size_t *offsets = realloc(tokens->offsets, new_capacity * sizeof(size_t));
+    if (offsets == NULL) {
+        return false;
+    }
+    tokens->offsets = offsets;
+
+    int32_t *values = realloc(tokens->values, new_capacity * sizeof(int32_t));
+    if (values == NULL) {
+        return false;
+    }
+    tokens->values = values;
+
+    uint32_t *lengths = realloc(tokens->lengths, new_capacity * sizeof(uint32_t));
+    if (lengths == NULL) {
+        return false;
+    }
+    tokens->lengths = lengths;
+    tokens->capacity = new_capacity;
+
+    return true;
+}
+
+bool token_array_tokenize(struct TokenArray *tokens, const char *input) {
+    tokens->input = input;
+    tokens->size  = 0;
+
+    struct Tokenizer tokenizer = TOKENIZER_INIT(input);
+
+    for (;;) {
+        if (tokens->size == tokens->capacity && !token_array_grow(tokens)) {
+            return false;
+        }
+
+        // tokenizer_scan() is inlined here, so lexing is one tight loop
+        const enum TokenType token = tokenizer_scan(&tokenizer);
+        const size_t index = tokens->size;
+        tokens->types[index]   = (int16_t)token;
+        tokens->offsets[index] = tokenizer.token_pos;
+
+        switch (token) {
+            case TOK_INT:
+                tokens->values[index]  = tokenizer.value;
+                tokens->lengths[index] = 0;
+                break;
+
+            case TOK_IDENT:
+                if (tokenizer.ident_length > UINT32_MAX) {
+                    errno = ERANGE;
+                    return false;
+                }
+                tokens->values[index]  = (int32_t)tokenizer.ident_hash;
+                tokens->lengths[index] = (uint32_t)tokenizer.ident_length;
+                break;
+
+            default:
+                tokens->values[index]  = 0;
+                tokens->lengths[index] = 0;
+                break;
+        }
+        ++ tokens->size;
+
+        if (token == TOK_EOF || token == TOK_ERROR_TOKEN) {
+            return true;
+        }
+    }
+}
+
+void token_array_clear(struct TokenArray *tokens) {
+    tokens->input = NULL;
+    tokens->size  = 0;
+}
+
+void token_array_free(struct TokenArray *tokens) {
+    free(tokens->types);
+    free(tokens->offsets);
+    free(tokens->values);
+    free(tokens->lengths);
+
+    *tokens = (struct TokenArray)TOKEN_ARRAY_INIT();
+}
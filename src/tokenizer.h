@@ -3,7 +3,11 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "symbol.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,27 +45,74 @@ enum TokenType {
     TOK_RSHIFT  = ('>' << 8) | '>',
 };
 
+// The tokens of a whole input as struct of arrays, indexed by token number.
+// The last token is TOK_EOF or TOK_ERROR_TOKEN, nothing after an error is
+// tokenized. Identifiers span lengths[index] chars from offsets[index].
+struct TokenArray {
+    const char *input;
+    int16_t  *types;   // enum TokenType, all fit into 16 bits
+    size_t   *offsets; // token_pos
+    int32_t  *values;  // TOK_INT: value, TOK_IDENT: symbol_hash()
+    uint32_t *lengths; // TOK_IDENT: length
+    size_t size;
+    size_t capacity;
+};
+
+#define TOKEN_ARRAY_INIT() { \
+    .input    = NULL,        \
+    .types    = NULL,        \
+    .offsets  = NULL,        \
+    .values   = NULL,        \
+    .lengths  = NULL,        \
+    .size     = 0,           \
+    .capacity = 0,           \
+}
+
 struct Tokenizer {
     const char *input;
+    size_t input_size; // strlen(input), scanning never loads past it
     size_t input_pos;
     size_t token_pos;
+    const struct TokenArray *tokens; // NULL to scan input while parsing
+    size_t token_index; // of the next token in tokens
 
     enum TokenType token;
     bool peeked;
     int value;
     size_t ident_start;
     size_t ident_length;
+    uint32_t ident_hash; // symbol_hash() of the identifier
 };
 
 #define TOKENIZER_INIT(INPUT) {  \
     .input  = (INPUT),           \
+    .input_size = strlen(INPUT), \
     .input_pos = 0,              \
     .token_pos = 0,              \
+    .tokens = NULL,              \
+    .token_index = 0,            \
     .token  = TOK_START,         \
     .peeked = false,             \
     .value  = -1,                \
     .ident_start  = 0,           \
     .ident_length = 0,           \
+    .ident_hash   = 0,           \
+}
+
+// reads the tokens from a struct TokenArray instead of scanning the input
+#define TOKENIZER_INIT_TOKENS(TOKENS) { \
+    .input  = (TOKENS)->input,          \
+    .input_size = 0,                    \
+    .input_pos = 0,                     \
+    .token_pos = 0,                     \
+    .tokens = (TOKENS),                 \
+    .token_index = 0,                   \
+    .token  = TOK_START,                \
+    .peeked = false,                    \
+    .value  = -1,                       \
+    .ident_start  = 0,                  \
+    .ident_length = 0,                  \
+    .ident_hash   = 0,                  \
 }
 
 enum TokenType peek_token(struct Tokenizer *tokenizer);
@@ -70,6 +121,15 @@ bool token_is_error(enum TokenType token);
 void tokenizer_free(struct Tokenizer *tokenizer);
 const char *get_token_name(enum TokenType token);
 char *tokenizer_get_ident(const struct Tokenizer *tokenizer);
+/// interns the identifier into table with the hash computed while scanning it
+const struct Symbol *tokenizer_get_symbol(const struct Tokenizer *tokenizer, struct SymbolTable *table);
+
+/// Tokenizes all of input, replacing the tokens of a previous call. Returns
+/// false and sets errno if out of memory, a syntax error is no error here but
+/// the last token. input has to outlive the array, tokens refer to it.
+bool token_array_tokenize(struct TokenArray *tokens, const char *input);
+void token_array_clear(struct TokenArray *tokens);
+void token_array_free(struct TokenArray *tokens);
 
 #define TOKEN_IS_ERROR(token) ((token) == TOK_ERROR_TOKEN)
 #define token_is_error(token) TOKEN_IS_ERROR(token)